@@ -1,6 +1,7 @@
 
 # Modified to use pkg config and use standard var names
 # Find double-precision version of FFTW3
+# (FFTW3F_LIBRARIES is also set if the single-precision version is found)
 
 INCLUDE(FindPkgConfig)
 PKG_CHECK_MODULES(PC_FFTW3F "fftw3 >= 3.0")
@@ -24,6 +25,16 @@ FIND_LIBRARY(
           /usr/lib64
 )
 
+FIND_LIBRARY(
+    FFTW3F_LIBRARIES
+    NAMES fftw3f libfftw3f
+    HINTS $ENV{FFTW3_DIR}/lib
+        ${PC_FFTW3_LIBDIR}
+    PATHS /usr/local/lib
+          /usr/lib
+          /usr/lib64
+)
+
 FIND_LIBRARY(
     FFTW3_THREADS_LIBRARIES
     NAMES fftw3_threads libfftw3_threads
@@ -37,4 +48,4 @@ FIND_LIBRARY(
 
 INCLUDE(FindPackageHandleStandardArgs)
 FIND_PACKAGE_HANDLE_STANDARD_ARGS(FFTW3 DEFAULT_MSG FFTW3_LIBRARIES FFTW3_INCLUDE_DIRS)
-MARK_AS_ADVANCED(FFTW3_LIBRARIES FFTW3_INCLUDE_DIRS FFTW3_THREADS_LIBRARIES)
\ No newline at end of file
+MARK_AS_ADVANCED(FFTW3_LIBRARIES FFTW3F_LIBRARIES FFTW3_INCLUDE_DIRS FFTW3_THREADS_LIBRARIES)
\ No newline at end of file
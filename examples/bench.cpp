@@ -0,0 +1,382 @@
+/*! \file bench.cpp
+ *  \brief Microbenchmarks for the hot paths of the fun_ofdm library.
+ *
+ *  This file times each receiver chain block, the viterbi coder, ppdu encoding and the
+ *  frame_builder in isolation on fixed (seeded) inputs for every PHY rate and prints the
+ *  results as JSON so that builds can be compared against each other.
+ *
+ *  Usage: fun_ofdm_bench [iterations] [payload length in bytes]
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "frame_builder.h"
+#include "frame_detector.h"
+#include "timing_sync.h"
+#include "fft_symbols.h"
+#include "channel_est.h"
+#include "phase_tracker.h"
+#include "freq_domain.h"
+#include "frame_decoder.h"
+#include "viterbi.h"
+#include "ppdu.h"
+#include "rates.h"
+
+using namespace fun;
+
+/*!
+ * \brief Timing results of one benchmark
+ */
+struct bench_result
+{
+    std::string name;   //!< Name of the benchmarked function
+    std::string rate;   //!< Name of the PHY rate of the input
+    long samples;       //!< Baseband samples represented by one iteration's input
+    long bits;          //!< Payload bits represented by one iteration's input
+    int iterations;     //!< Number of timed iterations
+    double seconds;     //!< Total time spent in the timed function
+    double cycles;      //!< Total TSC cycles spent in the timed function
+};
+
+static std::vector<bench_result> results;
+
+/*!
+ * \brief Reads the CPU's time stamp counter (0 if there isn't one).
+ */
+static inline unsigned long long read_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*!
+ * \brief Simple stopwatch measuring both wall time and TSC cycles.
+ */
+struct stopwatch
+{
+    std::chrono::steady_clock::time_point t0; //!< Wall time at the last start()
+    unsigned long long c0;                    //!< TSC at the last start()
+    double seconds;                           //!< Accumulated wall time
+    double cycles;                            //!< Accumulated TSC cycles
+
+    stopwatch() : c0(0), seconds(0), cycles(0) {} //!< Constructor for a zeroed stopwatch
+
+    void start() { t0 = std::chrono::steady_clock::now(); c0 = read_cycles(); } //!< Starts timing
+
+    void stop() //!< Stops timing and accumulates the elapsed time
+    {
+        unsigned long long c1 = read_cycles();
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        cycles += double(c1 - c0);
+    }
+};
+
+/*!
+ * \brief Records the result of one benchmark.
+ */
+static void record(std::string name, RateParams & rp, long samples, long bits, int iterations, stopwatch & sw)
+{
+    bench_result r;
+    r.name = name;
+    r.rate = rp.name;
+    r.samples = samples;
+    r.bits = bits;
+    r.iterations = iterations;
+    r.seconds = sw.seconds;
+    r.cycles = sw.cycles;
+    results.push_back(r);
+}
+
+/*!
+ * \brief Benchmarks a receiver chain block.
+ * \param b The block to benchmark
+ * \param chunks The input buffers to pass to the block, in order
+ * \param tags The tags of each input buffer (see block::input_tags).
+ * \param outputs Filled with the block's output buffers in the untimed warm up pass so
+ *  they can be used as the input of the next block in the chain.
+ * \param output_tags Filled with the tags of the block's output buffers in the warm up pass.
+ * \param iterations Number of timed passes over all of the chunks
+ */
+template<typename I, typename O>
+static stopwatch bench_block(block<I, O> * b, const std::vector<std::vector<I> > & chunks,
+                             const std::vector<std::vector<stream_tag> > & tags,
+                             std::vector<std::vector<O> > & outputs,
+                             std::vector<std::vector<stream_tag> > & output_tags, int iterations)
+{
+    outputs.clear();
+    output_tags.clear();
+    for(int c = 0; c < chunks.size(); c++)
+    {
+        b->input_buffer = chunks[c];
+        b->input_tags = tags[c];
+        b->output_buffer.clear();
+        b->work();
+        outputs.push_back(b->output_buffer);
+        output_tags.push_back(b->output_tags);
+    }
+
+    stopwatch sw;
+    for(int i = 0; i < iterations; i++)
+    {
+        for(int c = 0; c < chunks.size(); c++)
+        {
+            b->input_buffer = chunks[c];
+            b->input_tags = tags[c];
+            b->output_buffer.clear();
+            sw.start();
+            b->work();
+            sw.stop();
+        }
+    }
+    return sw;
+}
+
+/*!
+ * \brief Runs all of the benchmarks for a single rate.
+ * \param rate The PHY rate
+ * \param length The payload length in bytes
+ * \param iterations The number of timed iterations of each benchmark
+ */
+static void bench_rate(Rate rate, int length, int iterations)
+{
+    RateParams rp(rate);
+    std::mt19937 rng(1234);
+    std::normal_distribution<double> noise(0.0, 0.001);
+
+    std::vector<unsigned char> payload(length);
+    for(int x = 0; x < length; x++) payload[x] = rng() & 0xFF;
+    long bits = 8L * length;
+
+    // frame_builder::build_frame (frame cache disabled so every iteration is encoded)
+    frame_builder fb(0);
+    std::vector<complex_t > frame = fb.build_frame(payload, rate);
+    {
+        stopwatch sw;
+        for(int i = 0; i < iterations; i++)
+        {
+            sw.start();
+            std::vector<complex_t > f = fb.build_frame(payload, rate);
+            sw.stop();
+        }
+        record("frame_builder::build_frame", rp, frame.size(), bits, iterations, sw);
+    }
+
+    // The same on the built in 64 point kernel
+    {
+        frame_builder native_fb(0, 0, FFT_BACKEND_NATIVE);
+        stopwatch sw;
+        for(int i = 0; i < iterations; i++)
+        {
+            sw.start();
+            std::vector<complex_t > f = native_fb.build_frame(payload, rate);
+            sw.stop();
+        }
+        record("frame_builder::build_frame (native fft)", rp, frame.size(), bits, iterations, sw);
+    }
+
+    // frame_builder::build_frames on a batch of 32 payloads using every core
+    {
+        int threads = std::thread::hardware_concurrency();
+        frame_builder batch_fb(0, threads > 1 ? threads - 1 : 0);
+        std::vector<std::vector<unsigned char> > batch(32, payload);
+        stopwatch sw;
+        for(int i = 0; i < iterations; i++)
+        {
+            sw.start();
+            std::vector<std::vector<complex_t > > f = batch_fb.build_frames(batch, rate);
+            sw.stop();
+        }
+        record("frame_builder::build_frames", rp, frame.size() * batch.size(), bits * batch.size(), iterations, sw);
+    }
+
+    // ppdu::encode
+    {
+        stopwatch sw;
+        for(int i = 0; i < iterations; i++)
+        {
+            ppdu p(payload, rate);
+            sw.start();
+            std::vector<complex_t > f = p.encode();
+            sw.stop();
+        }
+        record("ppdu::encode", rp, frame.size(), bits, iterations, sw);
+    }
+
+    // viterbi::conv_encode & viterbi::conv_decode on one frame's worth of data bits
+    {
+        int num_symbols = (16 + 8 * (length + 4) + 6 + rp.dbps - 1) / rp.dbps;
+        int data_bits = num_symbols * rp.dbps - 6;
+        std::vector<unsigned char> data(data_bits / 8 + 2);
+        for(int x = 0; x < data.size(); x++) data[x] = rng() & 0xFF;
+        std::vector<unsigned char> coded(2 * (data_bits + 6));
+        std::vector<unsigned char> decoded(data.size());
+
+        stopwatch enc;
+        for(int i = 0; i < iterations; i++)
+        {
+            enc.start();
+            viterbi::conv_encode(&data[0], &coded[0], data_bits);
+            enc.stop();
+        }
+        record("viterbi::conv_encode", rp, frame.size(), bits, iterations, enc);
+
+        for(int x = 0; x < coded.size(); x++) coded[x] = coded[x] ? 255 : 0;
+        viterbi v(data_bits);
+        stopwatch dec;
+        for(int i = 0; i < iterations; i++)
+        {
+            dec.start();
+            v.conv_decode(&coded[0], &decoded[0], data_bits);
+            dec.stop();
+        }
+        record("viterbi::conv_decode", rp, frame.size(), bits, iterations, dec);
+
+        // The same frame split into segments decoded on every core
+        int threads = std::thread::hardware_concurrency();
+        viterbi segmented(data_bits, threads > 1 ? threads - 1 : 1);
+        stopwatch seg;
+        for(int i = 0; i < iterations; i++)
+        {
+            seg.start();
+            segmented.conv_decode(&coded[0], &decoded[0], data_bits);
+            seg.stop();
+        }
+        record("viterbi::conv_decode (segmented)", rp, frame.size(), bits, iterations, seg);
+    }
+
+    // The receiver chain blocks, each fed the previous block's output
+    std::vector<complex_t > stream(2000, 0);
+    for(int f = 0; f < 4; f++)
+    {
+        stream.insert(stream.end(), frame.begin(), frame.end());
+        stream.insert(stream.end(), 2000, complex_t(0, 0));
+    }
+    stream.insert(stream.end(), 8192, complex_t(0, 0)); // Flush the last frame through
+    for(int x = 0; x < stream.size(); x++) stream[x] += complex_t(noise(rng), noise(rng));
+    long stream_bits = 4 * bits;
+
+    std::vector<std::vector<complex_t > > raw_chunks;
+    for(int x = 0; x + 4096 <= stream.size(); x += 4096)
+    {
+        raw_chunks.push_back(std::vector<complex_t >(stream.begin() + x, stream.begin() + x + 4096));
+    }
+    long stream_samples = 4096L * raw_chunks.size();
+
+    std::vector<std::vector<complex_t > > detected, synced;
+    std::vector<std::vector<tagged_vector<64> > > symbols, equalized;
+    std::vector<std::vector<tagged_vector<48> > > tracked;
+    std::vector<std::vector<std::vector<unsigned char> > > decoded;
+    std::vector<std::vector<stream_tag> > raw_tags(raw_chunks.size());
+    std::vector<std::vector<stream_tag> > detected_tags, synced_tags, symbol_tags, equalized_tags, tracked_tags, decoded_tags;
+
+    frame_detector * detector = new frame_detector();
+    stopwatch sw = bench_block(detector, raw_chunks, raw_tags, detected, detected_tags, iterations);
+    record("frame_detector::work", rp, stream_samples, stream_bits, iterations, sw);
+
+    timing_sync * sync = new timing_sync();
+    sw = bench_block(sync, detected, detected_tags, synced, synced_tags, iterations);
+    record("timing_sync::work", rp, stream_samples, stream_bits, iterations, sw);
+
+    fft_symbols * ffts = new fft_symbols();
+    sw = bench_block(ffts, synced, synced_tags, symbols, symbol_tags, iterations);
+    record("fft_symbols::work", rp, stream_samples, stream_bits, iterations, sw);
+
+    // The same block on the built in 64 point kernel
+    std::vector<std::vector<tagged_vector<64> > > native_symbols;
+    std::vector<std::vector<stream_tag> > native_symbol_tags;
+    fft_symbols * native_ffts = new fft_symbols(NULL, FFT_BACKEND_NATIVE);
+    sw = bench_block(native_ffts, synced, synced_tags, native_symbols, native_symbol_tags, iterations);
+    record("fft_symbols::work (native fft)", rp, stream_samples, stream_bits, iterations, sw);
+
+    channel_est * chan = new channel_est();
+    sw = bench_block(chan, symbols, symbol_tags, equalized, equalized_tags, iterations);
+    record("channel_est::work", rp, stream_samples, stream_bits, iterations, sw);
+
+    phase_tracker * phase = new phase_tracker();
+    sw = bench_block(phase, equalized, equalized_tags, tracked, tracked_tags, iterations);
+    record("phase_tracker::work", rp, stream_samples, stream_bits, iterations, sw);
+
+    // The fused block in place of the three above
+    std::vector<std::vector<tagged_vector<48> > > fused;
+    std::vector<std::vector<stream_tag> > fused_tags;
+    freq_domain * freq = new freq_domain();
+    sw = bench_block(freq, synced, synced_tags, fused, fused_tags, iterations);
+    record("freq_domain::work", rp, stream_samples, stream_bits, iterations, sw);
+
+    frame_decoder * decoder = new frame_decoder();
+    sw = bench_block(decoder, tracked, tracked_tags, decoded, decoded_tags, iterations);
+    record("frame_decoder::work", rp, stream_samples, stream_bits, iterations, sw);
+
+    int received = 0;
+    for(int x = 0; x < decoded.size(); x++) received += decoded[x].size();
+    if(received != 4) std::cerr << rp.name << ": decoded " << received << " of 4 frames" << std::endl;
+
+    delete detector;
+    delete sync;
+    delete ffts;
+    delete native_ffts;
+    delete chan;
+    delete phase;
+    delete freq;
+    delete decoder;
+}
+
+/*!
+ * \brief Prints the results as a JSON document.
+ */
+static void print_json(int iterations, int length)
+{
+    printf("{\n");
+    printf("  \"iterations\": %d,\n", iterations);
+    printf("  \"payload_bytes\": %d,\n", length);
+#ifdef FUN_OFDM_SINGLE_PRECISION
+    printf("  \"precision\": \"single\",\n");
+#else
+    printf("  \"precision\": \"double\",\n");
+#endif
+    printf("  \"results\": [\n");
+    for(int x = 0; x < results.size(); x++)
+    {
+        bench_result & r = results[x];
+        double samples = double(r.samples) * r.iterations;
+        double bits = double(r.bits) * r.iterations;
+        printf("    {\"name\": \"%s\", \"rate\": \"%s\", \"ns_per_sample\": %.4f, \"msps\": %.3f, \"cycles_per_bit\": %.3f}%s\n",
+               r.name.c_str(), r.rate.c_str(),
+               r.seconds * 1e9 / samples,
+               samples / r.seconds / 1e6,
+               r.cycles / bits,
+               (x + 1 < results.size()) ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
+
+int main(int argc, char * argv[])
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : 20;
+    int length = (argc > 2) ? atoi(argv[2]) : 1500;
+
+    Rate rates[11] = {RATE_1_2_BPSK, RATE_2_3_BPSK, RATE_3_4_BPSK,
+                      RATE_1_2_QPSK, RATE_2_3_QPSK, RATE_3_4_QPSK,
+                      RATE_1_2_QAM16, RATE_2_3_QAM16, RATE_3_4_QAM16,
+                      RATE_2_3_QAM64, RATE_3_4_QAM64};
+    for(int r = 0; r < 11; r++) bench_rate(rates[r], length, iterations);
+
+    print_json(iterations, length);
+    return 0;
+}
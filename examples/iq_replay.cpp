@@ -0,0 +1,174 @@
+/*! \file iq_replay.cpp
+ *  \brief Records frames to an IQ file and replays IQ files through the receive chain.
+ *
+ *  "record" builds frames with the frame_builder and writes them (separated by silence) to an
+ *  IQ file. "replay" streams an IQ file (e.g. a field capture or a recording made with "record")
+ *  through the receiver_chain as fast as the CPU allows and reports the number of packets
+ *  decoded and the throughput in samples per second. "batch" decodes the whole file at once with
+ *  the batch_decoder which splits it into segments decoded on every core.
+ *
+ *  Usage:
+ *   - fun_ofdm_replay record <file> [cf32|cf64|sc16] [frames]
+ *   - fun_ofdm_replay replay <file> [cf32|cf64|sc16] [chunk size]
+ *   - fun_ofdm_replay batch <file> [cf32|cf64|sc16] [threads]
+ *
+ *  Files ending in .sigmf-data are written with & read from their SigMF metadata, which then
+ *  overrides the format given on the command line.
+ *
+ *  In the profiling build (FUN_OFDM_PERF_COUNTERS) "replay" also reports the hardware counters
+ *  of every block and ppdu stage.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "iq_file.h"
+#include "frame_builder.h"
+#include "receiver_chain.h"
+#include "batch_decoder.h"
+
+using namespace fun;
+
+/*!
+ * \brief Parses a sample format name, defaulting to cf32
+ */
+static iq_format parse_format(const char * name)
+{
+    if(strcmp(name, "cf64") == 0) return IQ_CF64;
+    if(strcmp(name, "sc16") == 0) return IQ_SC16;
+    return IQ_CF32;
+}
+
+/*!
+ * \brief Writes frames at every PHY rate separated by 1000 samples of silence
+ */
+static int record(std::string path, iq_format format, int frames)
+{
+    iq_file_sink sink(path, format, 5e6);
+    if(!sink.is_open()) return 1;
+
+    frame_builder fb;
+    std::vector<complex_t > silence(1000, complex_t(0, 0));
+    std::vector<unsigned char> payload(1500);
+    for(int f = 0; f < frames; f++)
+    {
+        for(int x = 0; x < payload.size(); x++) payload[x] = (f + x) & 0xFF;
+        std::vector<complex_t > frame = fb.build_frame(payload, Rate(f % 8));
+        // Keep the samples within [-1, 1) so sc16 doesn't clip
+        for(int x = 0; x < frame.size(); x++) frame[x] *= real_t(0.5);
+        sink.write(silence);
+        sink.write(frame);
+    }
+    sink.write(silence);
+
+    std::cout << "Recorded " << frames << " frames (" << sink.size() << " samples) to " << path << std::endl;
+    return 0;
+}
+
+#ifdef FUN_OFDM_PERF_COUNTERS
+/*!
+ * \brief Prints the cycles per sample, IPC, cache & branch misses of every block and ppdu stage
+ */
+static void print_perf(receiver_chain * chain)
+{
+    std::vector<block_stats> blocks = chain->get_block_stats();
+    std::cout << "block / stage: cycles/sample, IPC, LLC misses/call, branch misses/call" << std::endl;
+    for(int x = 0; x < blocks.size(); x++)
+    {
+        const block_stats & b = blocks[x];
+        std::cout << "  " << b.name << ": " << b.cycles_per_sample() << ", " << b.perf.ipc() << ", "
+                  << (b.calls ? double(b.perf.llc_misses) / b.calls : 0) << ", "
+                  << (b.calls ? double(b.perf.branch_misses) / b.calls : 0) << std::endl;
+    }
+
+    std::vector<perf_stage_stats> stages = perf_counters::get_stage_stats();
+    for(int x = 0; x < stages.size(); x++)
+    {
+        const perf_stage_stats & s = stages[x];
+        if(s.calls == 0) continue;
+        std::cout << "  " << s.name << ": " << s.counts.cycles / s.calls << " cycles/call, " << s.counts.ipc() << ", "
+                  << double(s.counts.llc_misses) / s.calls << ", " << double(s.counts.branch_misses) / s.calls << std::endl;
+    }
+}
+#endif
+
+/*!
+ * \brief Streams the file through the receiver_chain a chunk at a time
+ *
+ * The chunk buffer is swapped in and out of the receiver_chain so the only copy of the
+ * samples is the one out of the mapped file.
+ */
+static int replay(std::string path, iq_format format, int chunk_size)
+{
+    iq_file_source source(path, format);
+    if(!source.is_open()) return 1;
+
+    receiver_chain chain;
+    std::vector<complex_t > buffer;
+    int packets = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while(source.read(buffer, chunk_size) > 0)
+    {
+        packets += chain.process_buffer(buffer).size();
+    }
+
+    // Push the last chunks through the pipeline
+    for(int x = 0; x < 6; x++)
+    {
+        buffer.assign(chunk_size, complex_t(0, 0));
+        packets += chain.process_buffer(buffer).size();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Replayed " << source.size() << " samples in " << elapsed.count() << " s ("
+              << source.size() / elapsed.count() / 1e6 << " Msps";
+    if(source.sample_rate() > 0) std::cout << ", " << source.size() / elapsed.count() / source.sample_rate() << "x real time";
+    std::cout << ")" << std::endl;
+    std::cout << "Received " << packets << " packets" << std::endl;
+#ifdef FUN_OFDM_PERF_COUNTERS
+    print_perf(&chain);
+#endif
+    return 0;
+}
+
+/*!
+ * \brief Decodes the whole file in segments on every core
+ */
+static int batch(std::string path, iq_format format, int threads)
+{
+    iq_file_source source(path, format);
+    if(!source.is_open()) return 1;
+
+    batch_decoder decoder(threads);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<packet> packets = decoder.decode(source);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Decoded " << source.size() << " samples in " << elapsed.count() << " s ("
+              << source.size() / elapsed.count() / 1e6 << " Msps";
+    if(source.sample_rate() > 0) std::cout << ", " << source.size() / elapsed.count() / source.sample_rate() << "x real time";
+    std::cout << ")" << std::endl;
+    std::cout << "Received " << packets.size() << " packets" << std::endl;
+    return 0;
+}
+
+int main(int argc, char * argv[])
+{
+    if(argc < 3 || (strcmp(argv[1], "record") != 0 && strcmp(argv[1], "replay") != 0 && strcmp(argv[1], "batch") != 0))
+    {
+        std::cerr << "Usage: " << argv[0] << " record <file> [cf32|cf64|sc16] [frames]" << std::endl;
+        std::cerr << "       " << argv[0] << " replay <file> [cf32|cf64|sc16] [chunk size]" << std::endl;
+        std::cerr << "       " << argv[0] << " batch <file> [cf32|cf64|sc16] [threads]" << std::endl;
+        return 1;
+    }
+
+    iq_format format = (argc > 3) ? parse_format(argv[3]) : IQ_CF32;
+    if(strcmp(argv[1], "record") == 0) return record(argv[2], format, (argc > 4) ? atoi(argv[4]) : 100);
+    if(strcmp(argv[1], "batch") == 0) return batch(argv[2], format, (argc > 4) ? atoi(argv[4]) : 0);
+    return replay(argv[2], format, (argc > 4) ? atoi(argv[4]) : 4096);
+}
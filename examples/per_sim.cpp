@@ -0,0 +1,320 @@
+/*! \file per_sim.cpp
+ *  \brief Monte Carlo simulation of the packet & bit error rates of every PHY rate over a simulated channel.
+ *
+ *  Sweeps SNR x PHY rate x payload length. At each point random payloads are built into frames
+ *  with the frame_builder, passed through a channel_sim (AWGN plus optional carrier frequency
+ *  offset, rayleigh multipath & timing offset) and received by a receiver_chain, which gives the
+ *  packet error rate of the whole receiver including synchronization and channel estimation.
+ *  The receiver chain also returns the payloads that fail their CRC (see receiver_chain_params::keep_failed),
+ *  and each payload it returns is matched to the frame it came from by where the frame started. The bit
+ *  error rate is taken over those payloads, i.e. over every frame whose header was decoded. Frames that
+ *  were missed altogether only count towards the PER.
+ *
+ *  The points are spread over every core, each thread with its own receiver chain in low latency
+ *  mode. No USRP is needed. Each point prints one line with the SNR (dB), rate, payload length
+ *  (bytes), number of frames, PER, BER ("-" if no payload came back) and the receiver chain's decode
+ *  throughput in mega samples per second on that thread.
+ *
+ *  Usage: fun_ofdm_per_sim [option value]...
+ *   - --snr first:step:last SNRs in dB (default 0:2:30)
+ *   - --rates r,r,...       Rate enum values (default every rate)
+ *   - --lengths l,l,...     Payload lengths in bytes (default 100,1500)
+ *   - --frames n            Frames per point (default 200)
+ *   - --threads n           Threads (default one per core)
+ *   - --cfo hz              Carrier frequency offset (default 0)
+ *   - --taps n              Multipath taps (default 1, a flat channel)
+ *   - --spread samples      Decay of the multipath power delay profile (default 1)
+ *   - --offset samples      Largest random timing offset (default 0)
+ *   - --seed n              Seed of the simulation (default 1)
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_builder.h"
+#include "receiver_chain.h"
+#include "channel_sim.h"
+
+using namespace fun;
+
+/*!
+ * \brief Number of noise only samples between two frames.
+ */
+#define SIM_IDLE_SAMPLES 400
+
+/*!
+ * \brief Number of samples passed to the receiver chain at a time.
+ */
+#define SIM_CHUNK_SIZE 4096
+
+/*!
+ * \brief One point of the sweep and its results.
+ */
+struct sim_point
+{
+    double snr;                     //!< SNR in dB
+    Rate rate;                      //!< PHY rate
+    int length;                     //!< Payload length in bytes
+    int frames;                     //!< Frames sent
+    int received;                   //!< Frames received by the receiver chain with the right payload
+    unsigned long long bits;        //!< Payload bits of the frames the receiver chain returned a payload for
+    unsigned long long bit_errors;  //!< Payload bits the receiver chain decoded wrong
+    unsigned long long samples;     //!< Samples passed to the receiver chain
+    double seconds;                 //!< Time spent in the receiver chain
+};
+
+/*!
+ * \brief One simulation thread's receiver chain & frame builder and everything the points share.
+ */
+struct sim_worker
+{
+    receiver_chain * chain;                 //!< Receives the frames
+    frame_builder * builder;                //!< Builds the frames
+    packet_pool * pool;                     //!< The packets chain delivers into
+    std::vector<sim_point> * points;        //!< Every point of the sweep
+    std::atomic<int> * next_point;          //!< Index of the next point to simulate
+    channel_params channel;                 //!< Channel of every point (but the SNR & seed)
+    unsigned long long fed;                 //!< Samples passed to the chain so far (the base of packet_info::sample_index)
+};
+
+/*!
+ * \brief Counts the bit errors of a payload returned by the receiver chain against the payload sent.
+ *
+ * Bytes missing from the payload (i.e. its header was decoded with the wrong length) count as 0.
+ */
+static void count_bit_errors(sim_point & point, const std::vector<unsigned char> & sent, const std::vector<unsigned char> & decoded)
+{
+    for(int x = 0; x < sent.size(); x++)
+    {
+        unsigned char errors = sent[x] ^ ((x < decoded.size()) ? decoded[x] : 0);
+        point.bit_errors += __builtin_popcount(errors);
+    }
+    point.bits += sent.size() * 8;
+}
+
+/*!
+ * \brief Passes the samples in stream up to the last full chunk (or all of them if flush) through
+ *  the worker's chain and matches each payload to one of the next frames sent.
+ *
+ * A payload belongs to the frame that started within half an idle gap of its packet_info::sample_index.
+ */
+static void receive(sim_worker & worker, sim_point & point, std::vector<complex_t > & stream, bool flush,
+                    const std::vector<std::vector<unsigned char> > & sent, const std::vector<unsigned long long> & starts,
+                    int & next_sent)
+{
+    size_t used = 0;
+    std::vector<complex_t > chunk;
+    std::vector<packet *> packets;
+    while(stream.size() - used >= SIM_CHUNK_SIZE || (flush && used < stream.size()))
+    {
+        size_t count = std::min<size_t>(SIM_CHUNK_SIZE, stream.size() - used);
+        chunk.assign(stream.begin() + used, stream.begin() + used + count);
+        used += count;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        worker.chain->process_packets(chunk, *worker.pool, packets);
+        point.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        point.samples += count;
+        worker.fed += count;
+
+        // The frames come out in order so each payload can only be one of the later frames
+        for(int p = 0; p < packets.size(); p++)
+        {
+            const packet_info & info = packets[p]->info;
+            for(int s = next_sent; s < starts.size(); s++)
+            {
+                long long offset = (long long) info.sample_index - (long long) starts[s];
+                if(offset < -SIM_IDLE_SAMPLES / 2) break;
+                if(offset > SIM_IDLE_SAMPLES / 2) continue;
+                count_bit_errors(point, sent[s], packets[p]->payload);
+                if(info.crc_ok && sent[s] == packets[p]->payload) point.received++;
+                next_sent = s + 1;
+                break;
+            }
+            worker.pool->release(packets[p]);
+        }
+        packets.clear();
+    }
+    stream.erase(stream.begin(), stream.begin() + used);
+}
+
+/*!
+ * \brief Simulates one point of the sweep.
+ *
+ * The channel, payloads & timing offsets are seeded from the point's index so a point's results
+ * don't depend on the number of threads or which thread simulated it.
+ */
+static void simulate(sim_worker & worker, int index)
+{
+    sim_point & point = (*worker.points)[index];
+    channel_params params = worker.channel;
+    params.snr = point.snr;
+    params.seed = worker.channel.seed * 7919 + index;
+    channel_sim channel(params);
+    std::mt19937 generator(params.seed);
+
+    std::vector<std::vector<unsigned char> > sent(point.frames, std::vector<unsigned char>(point.length));
+    std::vector<unsigned long long> starts;
+    std::vector<complex_t > stream;
+    int next_sent = 0;
+    for(int f = 0; f < point.frames; f++)
+    {
+        for(int x = 0; x < point.length; x++) sent[f][x] = generator() & 0xFF;
+        std::vector<complex_t > frame = worker.builder->build_frame(sent[f], point.rate);
+        starts.push_back(worker.fed + channel.apply(frame, SIM_IDLE_SAMPLES, stream));
+        receive(worker, point, stream, false, sent, starts, next_sent);
+    }
+
+    // Flush the last frame out of the receiver chain
+    channel.add_idle(4 * SIM_CHUNK_SIZE, stream);
+    receive(worker, point, stream, true, sent, starts, next_sent);
+}
+
+/*!
+ * \brief Simulates points until none are left.
+ */
+static void sim_thread(sim_worker * worker)
+{
+    while(true)
+    {
+        int index = (*worker->next_point)++;
+        if(index >= worker->points->size()) return;
+        simulate(*worker, index);
+    }
+}
+
+/*!
+ * \brief Parses a comma separated list of integers
+ */
+static std::vector<int> parse_list(const char * list)
+{
+    std::vector<int> values;
+    while(*list)
+    {
+        char * end;
+        values.push_back(strtol(list, &end, 10));
+        if(end == list) break;
+        list = (*end == ',') ? end + 1 : end;
+    }
+    return values;
+}
+
+int main(int argc, char * argv[])
+{
+    double snr_first = 0, snr_step = 2, snr_last = 30;
+    std::vector<int> rates;
+    for(int r = 0; r < 11; r++) rates.push_back(r);
+    std::vector<int> lengths;
+    lengths.push_back(100);
+    lengths.push_back(1500);
+    int frames = 200;
+    int threads = std::max<int>(1, std::thread::hardware_concurrency());
+    channel_params channel;
+
+    for(int a = 1; a + 1 < argc; a += 2)
+    {
+        std::string option(argv[a]);
+        const char * value = argv[a + 1];
+        if(option == "--snr") sscanf(value, "%lf:%lf:%lf", &snr_first, &snr_step, &snr_last);
+        else if(option == "--rates") rates = parse_list(value);
+        else if(option == "--lengths") lengths = parse_list(value);
+        else if(option == "--frames") frames = atoi(value);
+        else if(option == "--threads") threads = std::max(1, atoi(value));
+        else if(option == "--cfo") channel.cfo = atof(value);
+        else if(option == "--taps") channel.multipath_taps = atoi(value);
+        else if(option == "--spread") channel.delay_spread = atof(value);
+        else if(option == "--offset") channel.timing_offset = atof(value);
+        else if(option == "--seed") channel.seed = atoi(value);
+        else
+        {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+    if(snr_step <= 0) snr_step = 1;
+
+    std::vector<sim_point> points;
+    for(double snr = snr_first; snr <= snr_last + 1e-9; snr += snr_step)
+    {
+        for(int r = 0; r < rates.size(); r++)
+        {
+            for(int l = 0; l < lengths.size(); l++)
+            {
+                sim_point point;
+                point.snr = snr;
+                point.rate = Rate(rates[r]);
+                point.length = lengths[l];
+                point.frames = frames;
+                point.received = 0;
+                point.bits = 0;
+                point.bit_errors = 0;
+                point.samples = 0;
+                point.seconds = 0;
+                points.push_back(point);
+            }
+        }
+    }
+
+    // Every worker gets its own chain, builder & packet pool
+    std::atomic<int> next_point(0);
+    std::vector<sim_worker> workers(threads);
+    receiver_chain_params chain_params;
+    chain_params.low_latency = true;
+    chain_params.sample_rate = channel.sample_rate;
+    chain_params.chunk_size = SIM_CHUNK_SIZE;
+    chain_params.keep_failed = true;
+    for(int x = 0; x < threads; x++)
+    {
+        workers[x].chain = new receiver_chain(chain_params);
+        workers[x].builder = new frame_builder(0);
+        workers[x].pool = new packet_pool();
+        workers[x].points = &points;
+        workers[x].next_point = &next_point;
+        workers[x].channel = channel;
+        workers[x].fed = 0;
+    }
+
+    // Every failed frame is reported on std::cerr, which would drown the results
+    std::cerr.setstate(std::ios::failbit);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> sim_threads;
+    for(int x = 1; x < threads; x++) sim_threads.push_back(std::thread(sim_thread, &workers[x]));
+    sim_thread(&workers[0]);
+    for(int x = 0; x < sim_threads.size(); x++) sim_threads[x].join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr.clear();
+
+    printf("# cfo %g Hz, %d taps (spread %g), timing offset %g, %d frames per point, %d threads\n",
+           channel.cfo, channel.multipath_taps, channel.delay_spread, channel.timing_offset, frames, threads);
+    printf("# snr_db rate length frames per ber decode_msps\n");
+    unsigned long long samples = 0;
+    for(int x = 0; x < points.size(); x++)
+    {
+        sim_point & p = points[x];
+        samples += p.samples;
+        char ber[16] = "        -"; // No payload came back to count the bit errors of
+        if(p.bits > 0) snprintf(ber, sizeof(ber), "%.3e", double(p.bit_errors) / p.bits);
+        printf("%6.1f %-10s %5d %5d %.6f %s %8.2f\n",
+               p.snr, RateParams(p.rate).name.c_str(), p.length, p.frames,
+               1.0 - double(p.received) / p.frames, ber,
+               (p.seconds > 0) ? p.samples / p.seconds / 1e6 : 0.0);
+    }
+    printf("# %llu samples in %.2f s (%.2f Msps on %d threads)\n", samples, elapsed, samples / elapsed / 1e6, threads);
+
+    for(int x = 0; x < threads; x++)
+    {
+        delete workers[x].chain;
+        delete workers[x].builder;
+        delete workers[x].pool;
+    }
+    return 0;
+}
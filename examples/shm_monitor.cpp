@@ -0,0 +1,50 @@
+/*! \file shm_monitor.cpp
+ *  \brief Reads the packets a receiver publishes to a shared memory ring from another process.
+ *
+ *  Attaches to the ring named on the command line (see receiver_params::output_ring) and prints
+ *  the metadata of every packet as it arrives along with the number of packets the writer
+ *  overwrote before they were read.
+ *
+ *  Usage:
+ *   - fun_ofdm_shm_monitor <ring name, e.g. /fun_ofdm_rx>
+ */
+
+#include <iostream>
+#include <unistd.h>
+
+#include "shm_ring.h"
+
+using namespace fun;
+
+int main(int argc, char * argv[])
+{
+    if(argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <ring name>" << std::endl;
+        return 1;
+    }
+
+    shm_ring_reader reader(argv[1]);
+    if(!reader.is_open())
+    {
+        std::cerr << "Couldn't attach to " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::vector<unsigned char> payload;
+    packet_info info;
+    unsigned long long packets = 0;
+    while(1)
+    {
+        if(!reader.read(payload, info))
+        {
+            usleep(1000);
+            continue;
+        }
+        packets++;
+        std::cout << "packet " << packets << ": " << payload.size() << " bytes, rate " << info.rate
+                  << ", snr " << info.snr << " dB, on air at " << info.air_start
+                  << " (" << reader.lost() << " lost)" << std::endl;
+    }
+    return 0;
+}
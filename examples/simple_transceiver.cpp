@@ -14,8 +14,9 @@ int main()
     set_realtime_priority();
 
     usrp_params params = usrp_params();
-    transmitter tx = transmitter(params);
-    receiver rx = receiver(&callback, params);
+    // The same payload is sent over and over so keep its frame cached
+    transmitter tx(params, transmitter_params(16, TX_QUEUE_BLOCK, FFT_BACKEND_FFTW, FRAME_CACHE_SIZE));
+    receiver rx(&callback, params);
 
     std::string s = "Hello World";
     std::vector<unsigned char> data = std::vector<unsigned char>(12);
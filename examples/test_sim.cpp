@@ -53,22 +53,22 @@ void test_sim()
     for(int x = 0; x < repeat; x++) memcpy(&payload[x*data.length()], &data[0], data.length());
 
     // Build a frame
-    std::vector<std::complex<double>> samples = fb->build_frame(payload, phy_rate);
+    std::vector<complex_t> samples = fb->build_frame(payload, phy_rate);
 
     int pad_length = samples.size()*1000;
 
     // Concatenate num_frames frames together
     int num_frames = 100;
     std::cout << "Transmitting " << num_frames << " frames" << std::endl;
-    std::vector<std::complex<double>> samples_con(samples.size() * num_frames + pad_length);
+    std::vector<complex_t> samples_con(samples.size() * num_frames + pad_length);
     for(int x = 0; x < num_frames; x++)
     {
-        memcpy(&samples_con[x*samples.size()], &samples[0], samples.size() * sizeof(std::complex<double>));
+        memcpy(&samples_con[x*samples.size()], &samples[0], samples.size() * sizeof(complex_t));
     }
 
     //Pad the end with 0's to flush receive chain
-    std::vector<std::complex<double> > zeros(pad_length);
-    memcpy(&samples_con[num_frames*samples.size()], &zeros[0], zeros.size()*sizeof(std::complex<double>));
+    std::vector<complex_t > zeros(pad_length);
+    memcpy(&samples_con[num_frames*samples.size()], &zeros[0], zeros.size()*sizeof(complex_t));
 
     boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
 
@@ -82,7 +82,7 @@ void test_sim()
         int start = x;
         int end = x + chunk_size;
         if(end > samples_con.size()) end = samples_con.size();
-        std::vector<std::complex<double> > chunk(&samples_con[start], &samples_con[end]);
+        std::vector<complex_t > chunk(&samples_con[start], &samples_con[end]);
 
         std::vector<std::vector<unsigned char> > rec_frames = receiver->process_samples(chunk);
         count += rec_frames.size();
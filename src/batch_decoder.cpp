@@ -0,0 +1,201 @@
+/*! \file batch_decoder.cpp
+ *  \brief C++ file for the batch_decoder class.
+ *
+ *  The batch_decoder decodes a whole recording (e.g. an iq_file_source) at once by splitting
+ *  it into segments that are decoded on every core, each by its own receiver_chain, and then
+ *  merging the packets found in each segment back into a single stream of packets.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include "batch_decoder.h"
+#include "iq_file.h"
+#include "receiver_chain.h"
+#include "frame_builder.h"
+
+namespace fun
+{
+    //! Orders packets by the sample their frame starts at
+    static bool starts_before(const packet & a, const packet & b)
+    {
+        return a.info.sample_index < b.info.sample_index;
+    }
+
+    /*!
+     * - Initializations:
+     *   + #m_workers -> threads (one per core if 0) low latency receiver chains
+     *   + #m_max_frame -> A #BATCH_MAX_PAYLOAD byte frame at the lowest rate
+     */
+    batch_decoder::batch_decoder(int threads, unsigned long long segment_length, int chunk_size) :
+        m_segment_length(segment_length),
+        m_chunk_size(chunk_size),
+        m_max_frame(frame_builder::frame_length(BATCH_MAX_PAYLOAD, RATE_1_2_BPSK))
+    {
+        if(threads <= 0) threads = std::max<int>(1, std::thread::hardware_concurrency());
+        receiver_chain_params params;
+        params.low_latency = true;
+        params.chunk_size = chunk_size;
+        for(int x = 0; x < threads; x++)
+        {
+            batch_worker worker;
+            worker.chain = new receiver_chain(params);
+            worker.position = 0;
+            worker.pool = new packet_pool();
+            m_workers.push_back(worker);
+        }
+    }
+
+    batch_decoder::~batch_decoder()
+    {
+        for(int x = 0; x < m_workers.size(); x++)
+        {
+            delete m_workers[x].chain;
+            delete m_workers[x].pool;
+        }
+    }
+
+    std::vector<packet> batch_decoder::decode(iq_file_source & source)
+    {
+        batch_input input;
+        input.source = &source;
+        input.samples = NULL;
+        input.count = source.size();
+        return decode(input);
+    }
+
+    std::vector<packet> batch_decoder::decode(const complex_t * samples, unsigned long long count)
+    {
+        batch_input input;
+        input.source = NULL;
+        input.samples = samples;
+        input.count = count;
+        return decode(input);
+    }
+
+    /*!
+     * The calling thread decodes segments alongside the workers' threads. The segments are handed
+     * out one at a time so a thread that gets a quiet segment simply decodes more of them. Each
+     * segment's packets are kept apart until every segment is done, then they are put in order of
+     * their frames' first samples and any frame found by two neighbouring segments (i.e. close to
+     * the end of one segment and the start of the next) is only kept once.
+     */
+    std::vector<packet> batch_decoder::decode(const batch_input & input)
+    {
+        unsigned long long segments = (input.count + m_segment_length - 1) / m_segment_length;
+        std::vector<std::vector<packet> > results(segments);
+        std::atomic<unsigned long long> next_segment(0);
+
+        std::vector<std::thread> threads;
+        for(int x = 1; x < m_workers.size(); x++)
+        {
+            threads.push_back(std::thread(&batch_decoder::decode_worker, this, &m_workers[x], &input, &results, &next_segment));
+        }
+        decode_worker(&m_workers[0], &input, &results, &next_segment);
+        for(int x = 0; x < threads.size(); x++) threads[x].join();
+
+        // Merge the segments
+        std::vector<packet> packets;
+        for(int s = 0; s < segments; s++)
+        {
+            for(int p = 0; p < results[s].size(); p++)
+            {
+                packets.push_back(packet());
+                packets.back().payload.swap(results[s][p].payload);
+                packets.back().info = results[s][p].info;
+            }
+        }
+        std::stable_sort(packets.begin(), packets.end(), starts_before);
+
+        // Two frames can't start within a preamble of each other so anything closer with the
+        // same payload is the same frame seen by two segments
+        std::vector<packet> merged;
+        merged.reserve(packets.size());
+        for(int p = 0; p < packets.size(); p++)
+        {
+            bool duplicate = false;
+            for(int m = merged.size() - 1; m >= 0; m--)
+            {
+                if(packets[p].info.sample_index - merged[m].info.sample_index >= PREAMBLE_LENGTH) break;
+                if(merged[m].payload == packets[p].payload) duplicate = true;
+            }
+            if(duplicate) continue;
+            merged.push_back(packet());
+            merged.back().payload.swap(packets[p].payload);
+            merged.back().info = packets[p].info;
+        }
+        return merged;
+    }
+
+    void batch_decoder::decode_worker(batch_worker * worker, const batch_input * input,
+                                      std::vector<std::vector<packet> > * results, std::atomic<unsigned long long> * next_segment)
+    {
+        if(worker != &m_workers[0]) configure_thread("fun_batch");
+        while(true)
+        {
+            unsigned long long segment = (*next_segment)++;
+            if(segment >= results->size()) return;
+            decode_segment(*worker, *input, segment, (*results)[segment]);
+        }
+    }
+
+    /*!
+     * Segment n keeps the frames that start from #BATCH_LEAD_IN samples before it to #BATCH_LEAD_IN
+     * samples after it. Its chain is fed from another #BATCH_LEAD_IN samples earlier (to lock on to
+     * the first frames) to the longest possible frame past the last frame it keeps, and then the
+     * same number of zeros so that no frame is left half decoded in the chain for the next segment.
+     */
+    void batch_decoder::decode_segment(batch_worker & worker, const batch_input & input, unsigned long long segment, std::vector<packet> & packets)
+    {
+        long long count = input.count;
+        long long first = segment * m_segment_length;
+        long long last = std::min<long long>(count, first + m_segment_length);
+        first = std::max<long long>(0, first - BATCH_LEAD_IN);
+        last = std::min<long long>(count, last + BATCH_LEAD_IN);
+
+        long long start = std::max<long long>(0, first - BATCH_LEAD_IN);
+        start -= start % m_chunk_size; // Chunks at the same samples as decoding the whole recording in one chain
+        long long end = std::min<long long>(count, last + m_max_frame);
+        long long base = start - (long long) worker.position;
+
+        std::vector<complex_t > chunk;
+        for(long long x = start; x < end; x += m_chunk_size)
+        {
+            int n = std::min<long long>(m_chunk_size, end - x);
+            chunk.resize(n);
+            if(input.source != NULL) input.source->read_at(x, &chunk[0], n);
+            else memcpy(&chunk[0], input.samples + x, n * sizeof(complex_t));
+            decode_chunk(worker, chunk, base, first, last, packets);
+        }
+
+        // Flush the chain
+        for(long long x = 0; x < m_max_frame; x += m_chunk_size)
+        {
+            chunk.assign(m_chunk_size, complex_t(0, 0));
+            decode_chunk(worker, chunk, base, first, last, packets);
+        }
+    }
+
+    void batch_decoder::decode_chunk(batch_worker & worker, std::vector<complex_t > & chunk, long long base,
+                                     long long first, long long last, std::vector<packet> & packets)
+    {
+        worker.position += chunk.size();
+        std::vector<packet *> decoded;
+        worker.chain->process_packets(chunk, *worker.pool, decoded);
+        for(int x = 0; x < decoded.size(); x++)
+        {
+            long long index = (long long) decoded[x]->info.sample_index + base;
+            if(index >= first && index < last)
+            {
+                packets.push_back(packet());
+                packets.back().payload.swap(decoded[x]->payload);
+                packets.back().info = decoded[x]->info;
+                packets.back().info.sample_index = index;
+                packets.back().info.latency = -1;
+            }
+            worker.pool->release(decoded[x]);
+        }
+    }
+}
@@ -0,0 +1,160 @@
+/*! \file batch_decoder.h
+ *  \brief Header file for the batch_decoder class.
+ *
+ *  The batch_decoder decodes a whole recording (e.g. an iq_file_source) at once by splitting
+ *  it into segments that are decoded on every core, each by its own receiver_chain, and then
+ *  merging the packets found in each segment back into a single stream of packets.
+ */
+
+#ifndef BATCH_DECODER_H
+#define BATCH_DECODER_H
+
+#include <vector>
+#include <atomic>
+
+#include "precision.h"
+#include "packet_pool.h"
+
+/*! \def BATCH_SEGMENT_LENGTH
+ *  \brief Default number of samples in each segment of a batch decode.
+ *
+ *  Each segment costs about two of the longest possible frames worth of extra samples (see
+ *  batch_decoder::decode()) so segments should be much longer than that.
+ */
+#define BATCH_SEGMENT_LENGTH 4194304
+
+/*! \def BATCH_LEAD_IN
+ *  \brief Number of samples each segment's receiver_chain starts before the frames it keeps.
+ *
+ *  Gives the frame detector & timing sync time to lock on to a frame starting right at the start
+ *  of a segment. Frames found this close to either end of a segment are kept by both neighbouring
+ *  segments and merged.
+ */
+#define BATCH_LEAD_IN 2048
+
+/*! \def BATCH_MAX_PAYLOAD
+ *  \brief Longest payload a PLCP header can describe (a 12 bit length field).
+ *
+ *  Each segment is decoded past its end by a frame of this length at the lowest rate so that a
+ *  frame starting inside the segment always ends inside it as well.
+ */
+#define BATCH_MAX_PAYLOAD 4095
+
+namespace fun
+{
+    class iq_file_source;
+    class receiver_chain;
+
+    /*!
+     * \brief The batch_decoder class.
+     *
+     *  Usage: Create the batch_decoder once (creating its receiver chains plans their FFTs) and
+     *  call decode() on each recording. The packets come back in the order their frames start
+     *  in the recording with packet_info::sample_index counting from the start of the recording.
+     *
+     *  The receiver chains run in low latency mode (see receiver_chain_params::low_latency) on the
+     *  decode threads so nothing but the segments themselves are shared between threads, which
+     *  lets the throughput scale with the number of cores.
+     */
+    class batch_decoder
+    {
+    public:
+
+        /*!
+         * \brief Constructor for batch_decoder.
+         * \param threads Number of threads (and receiver chains) to decode with. If 0 (the default)
+         *  one per core.
+         * \param segment_length Number of samples in each segment.
+         * \param chunk_size Number of samples passed to a receiver_chain at a time.
+         */
+        batch_decoder(int threads = 0, unsigned long long segment_length = BATCH_SEGMENT_LENGTH, int chunk_size = 4096);
+
+        ~batch_decoder(); //!< Deletes the receiver chains
+
+        /*!
+         * \brief Decodes every frame of a recording.
+         * \param source The recording. Its position() isn't changed.
+         * \return The decoded packets in the order their frames start.
+         */
+        std::vector<packet> decode(iq_file_source & source);
+
+        /*!
+         * \brief Decodes every frame in a buffer of samples.
+         * \param samples The samples
+         * \param count Number of samples
+         * \return The decoded packets in the order their frames start.
+         */
+        std::vector<packet> decode(const complex_t * samples, unsigned long long count);
+
+    private:
+
+        batch_decoder(const batch_decoder &);               //!< Not copyable
+        batch_decoder & operator=(const batch_decoder &);   //!< Not copyable
+
+        /*!
+         * \brief The recording being decoded, either a file or a buffer.
+         */
+        struct batch_input
+        {
+            const iq_file_source * source;  //!< The file, NULL for a buffer
+            const complex_t * samples;      //!< The buffer if #source is NULL
+            unsigned long long count;       //!< Number of samples
+        };
+
+        /*!
+         * \brief One decode thread's receiver chain and how many samples it has been fed so far.
+         */
+        struct batch_worker
+        {
+            receiver_chain * chain;       //!< The worker's receiver chain
+            unsigned long long position;  //!< Number of samples passed to #chain so far (what its packet_info::sample_index counts)
+            packet_pool * pool;           //!< The packets #chain delivers into
+        };
+
+        /*!
+         * \brief Splits the input into segments, decodes them on every worker and merges the results.
+         */
+        std::vector<packet> decode(const batch_input & input);
+
+        /*!
+         * \brief Decodes segments until none are left.
+         * \param worker The calling thread's worker
+         * \param input The recording
+         * \param results The packets of each segment
+         * \param next_segment Index of the next segment to decode
+         */
+        void decode_worker(batch_worker * worker, const batch_input * input,
+                           std::vector<std::vector<packet> > * results, std::atomic<unsigned long long> * next_segment);
+
+        /*!
+         * \brief Decodes one segment.
+         * \param worker The calling thread's worker
+         * \param input The recording
+         * \param segment Index of the segment
+         * \param packets The packets of the segment's frames are appended here
+         */
+        void decode_segment(batch_worker & worker, const batch_input & input, unsigned long long segment, std::vector<packet> & packets);
+
+        /*!
+         * \brief Passes one chunk of samples through a worker's chain.
+         * \param worker The worker
+         * \param chunk The samples, swapped with a spent buffer
+         * \param base Added to the packet_info::sample_index of the chain's packets to get their index in the recording
+         * \param first First sample index (in the recording) of the frames to keep
+         * \param last One past the last sample index of the frames to keep
+         * \param packets The kept packets are appended here
+         */
+        void decode_chunk(batch_worker & worker, std::vector<complex_t > & chunk, long long base,
+                          long long first, long long last, std::vector<packet> & packets);
+
+        std::vector<batch_worker> m_workers; //!< One per decode thread
+
+        unsigned long long m_segment_length; //!< Number of samples in each segment
+
+        int m_chunk_size; //!< Number of samples passed to a receiver_chain at a time
+
+        int m_max_frame; //!< Number of samples in the longest possible frame
+    };
+}
+
+#endif // BATCH_DECODER_H
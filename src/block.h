@@ -9,21 +9,20 @@
 #ifndef BLOCK_H
 #define BLOCK_H
 
-/*! \def BUFFER_MAX
- *  \brief Maximum buffer size of for the input & output buffers
+/*! \def BUFFER_CHUNKS
+ *  \brief Number of chunks worth of items block::reserve_buffers() reserves in each buffer.
  *
- *  Techinically each block uses the
- * ~~~{.cpp}
- * std::vector::reserve(size_type n)
- * ~~~
- * function to reserve BUFFER_MAX * sizeof(size_type) bytes
+ *  A block's buffers hold one chunk's worth of items plus whatever it carries over from the
+ *  previous chunk, so twice a chunk means they never have to grow in steady state. Anything
+ *  larger (i.e. a larger receiver chunk size) simply makes the buffers grow once.
  */
-
-#define BUFFER_MAX 65536
+#define BUFFER_CHUNKS 2
 
 #include <vector>
 #include <string>
 
+#include "tagged_vector.h"
+
 namespace fun
 {
     /*!
@@ -46,6 +45,8 @@ namespace fun
         {
         }
 
+        virtual ~block_base() {} //!< Virtual destructor so blocks can be deleted through a base pointer
+
         /*!
          * \brief The main work function.
          *
@@ -53,6 +54,19 @@ namespace fun
          */
         virtual void work() = 0;
 
+        /*!
+         * \brief Number of items currently in the block's input buffer.
+         *
+         * Used by the receiver_chain to keep per block statistics.
+         */
+        virtual size_t input_size() const = 0;
+
+        /*!
+         * \brief Reserves room in the block's buffers for the items of a chunk of raw samples.
+         * \param chunk_size Number of raw samples passed to the receiver chain at a time
+         */
+        virtual void reserve_buffers(size_t chunk_size) = 0;
+
         /*!
          * \brief the public name of the block
          */
@@ -73,42 +87,77 @@ namespace fun
         /*!
          * \brief constructor
          *
-         * Reserves BUFFER_MAX * sizeof(size_type) for the input and output buffers.
+         * The buffers start out empty, see reserve_buffers().
          * \param block_name the name of the block as a std::string
+         * \param input_length Number of raw samples each input item stands for (e.g. 80 for an OFDM symbol)
+         * \param output_length Number of raw samples each output item stands for
          */
-        block(std::string block_name) :
-            block_base(block_name)
+        block(std::string block_name, size_t input_length = 1, size_t output_length = 1) :
+            block_base(block_name),
+            m_input_length(input_length),
+            m_output_length(output_length)
         {
-            input_buffer.reserve(BUFFER_MAX);
-            output_buffer.reserve(BUFFER_MAX);
         }
 
         /*!
          * \brief The main work function.
          *
          * This function is purely virtual.
-         * This function must consume input_buffer and fill output_buffer.
+         * This function must consume input_buffer (and input_tags) and fill output_buffer (and output_tags).
          * In doing so it should be sure to resize the output_buffer accordingly and
          * carryover any items from the input_buffer that it might need on its next call.
          */
         virtual void work() = 0;
 
+        virtual size_t input_size() const { return input_buffer.size(); } //!< Number of items in #input_buffer
+
+        /*!
+         * \brief Reserves #BUFFER_CHUNKS chunks worth of items in the input and output buffers.
+         *
+         * The number of items in a chunk comes from the number of raw samples each item stands for
+         * so a buffer of OFDM symbols reserves 80 times fewer items than a buffer of samples.
+         * \param chunk_size Number of raw samples passed to the receiver chain at a time
+         */
+        virtual void reserve_buffers(size_t chunk_size)
+        {
+            input_buffer.reserve(BUFFER_CHUNKS * ((chunk_size + m_input_length - 1) / m_input_length));
+            output_buffer.reserve(BUFFER_CHUNKS * ((chunk_size + m_output_length - 1) / m_output_length));
+        }
+
         /*!
          * \brief input_buffer contains new input items to be consumed
          *
          * Contains new input items of type I. There is no guarantee on the number of items
-         * passed to the input_buffer for each call to work except that it must be less than
-         * #BUFFER_MAX.
+         * passed to the input_buffer for each call to work.
          */
         std::vector<I> input_buffer;
 
         /*!
          * \brief output_buffer is where the output items of the block should be placed
          *
-         * There is no restriction on the number of output items a block must produce on each call
-         * except that it must be less than #BUFFER_MAX.
+         * There is no restriction on the number of output items a block must produce on each call.
          */
         std::vector<O> output_buffer;
+
+        /*!
+         * \brief The tags on the items in #input_buffer sorted by stream_tag::offset.
+         *
+         * Only the blocks passing plain samples (frame_detector -> timing_sync -> fft_symbols)
+         * use tags, the other blocks carry their tag inside each item (see tagged_vector).
+         */
+        std::vector<stream_tag> input_tags;
+
+        /*!
+         * \brief The tags on the items in #output_buffer sorted by stream_tag::offset.
+         *
+         * A block that sets tags must rewrite them on every call to work(), even when it has no input.
+         */
+        std::vector<stream_tag> output_tags;
+
+    private:
+
+        size_t m_input_length;  //!< Number of raw samples each input item stands for
+        size_t m_output_length; //!< Number of raw samples each output item stands for
     };
 
 }
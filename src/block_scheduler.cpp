@@ -0,0 +1,167 @@
+/*! \file block_scheduler.cpp
+ *  \brief C++ file for the block_scheduler class.
+ *
+ *  The block_scheduler is a work stealing thread pool that any number of receiver chains can
+ *  share to run their blocks on (see receiver_chain_params::scheduler) instead of each chain
+ *  running every block on a thread of its own.
+ */
+
+#include <algorithm>
+
+#include "block_scheduler.h"
+#include "thread_config.h"
+
+namespace fun
+{
+    /*!
+     * - Initializations:
+     *   + #m_queues -> One empty queue per worker
+     *   + #m_workers -> threads (one per core if 0) worker threads
+     */
+    block_scheduler::block_scheduler(int threads) :
+        m_queued(0),
+        m_next_queue(0),
+        m_stop(false)
+    {
+        if(threads <= 0) threads = std::max<int>(1, std::thread::hardware_concurrency());
+        for(int x = 0; x < threads; x++)
+        {
+            m_queues.push_back(new worker_queue());
+            m_queues.back()->head = 0;
+            m_queues.back()->tail = 0;
+        }
+        for(int x = 0; x < threads; x++)
+        {
+            m_workers.push_back(std::thread(&block_scheduler::worker, this, x));
+        }
+    }
+
+    block_scheduler::~block_scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_stop = true;
+        }
+        m_sleep_cond.notify_all();
+        for(int x = 0; x < m_workers.size(); x++) m_workers[x].join();
+        for(int x = 0; x < m_queues.size(); x++) delete m_queues[x];
+    }
+
+    int block_scheduler::size() { return m_workers.size(); }
+
+    /*!
+     * Every task but the first is queued, the first is run straight away by the calling thread,
+     * which then keeps running queued tasks (stealing them like a worker) until none of the
+     * group's tasks are left in a queue, and then sleeps until the last of them has finished.
+     */
+    void block_scheduler::run(scheduler_task * tasks, int count, task_group & group)
+    {
+        if(count == 0) return;
+        group.pending = count;
+        for(int x = 0; x < count; x++) tasks[x].group = &group;
+
+        int queued = 0;
+        for(int x = 1; x < count; x++)
+        {
+            if(!push(tasks[x])) execute(tasks[x]);
+            else queued++;
+        }
+        if(queued > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            }
+            if(queued == 1) m_sleep_cond.notify_one();
+            else m_sleep_cond.notify_all();
+        }
+        execute(tasks[0]);
+
+        scheduler_task task;
+        while(group.pending > 0 && steal(-1, task)) execute(task);
+
+        // Only trust pending == 0 under the mutex, the last worker may still be notifying
+        std::unique_lock<std::mutex> lock(group.mutex);
+        while(group.pending > 0) group.done_cond.wait(lock);
+    }
+
+    /*!
+     * The queues are tried in turn starting from a different one each time.
+     */
+    bool block_scheduler::push(const scheduler_task & task)
+    {
+        unsigned int first = m_next_queue++;
+        for(int x = 0; x < m_queues.size(); x++)
+        {
+            worker_queue * queue = m_queues[(first + x) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if(queue->tail - queue->head == SCHEDULER_QUEUE_SIZE) continue;
+            queue->tasks[queue->tail % SCHEDULER_QUEUE_SIZE] = task;
+            queue->tail++;
+            m_queued++;
+            return true;
+        }
+        return false;
+    }
+
+    bool block_scheduler::pop(int queue, scheduler_task & task)
+    {
+        worker_queue * q = m_queues[queue];
+        std::lock_guard<std::mutex> lock(q->mutex);
+        if(q->tail == q->head) return false;
+        q->tail--;
+        task = q->tasks[q->tail % SCHEDULER_QUEUE_SIZE];
+        m_queued--;
+        return true;
+    }
+
+    bool block_scheduler::steal(int queue, scheduler_task & task)
+    {
+        int start = (queue < 0) ? 0 : queue + 1;
+        for(int x = 0; x < m_queues.size(); x++)
+        {
+            int victim = (start + x) % m_queues.size();
+            if(victim == queue) continue;
+            worker_queue * q = m_queues[victim];
+            std::lock_guard<std::mutex> lock(q->mutex);
+            if(q->tail == q->head) continue;
+            task = q->tasks[q->head % SCHEDULER_QUEUE_SIZE];
+            q->head++;
+            m_queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void block_scheduler::execute(const scheduler_task & task)
+    {
+        task_group * group = task.group;
+        task.function(task.context, task.index);
+
+        // The last decrement and the notify both happen under the group's mutex so the
+        // submitter can't see pending reach 0 and free the group while it is still in use
+        std::lock_guard<std::mutex> lock(group->mutex);
+        if(--group->pending == 0) group->done_cond.notify_all();
+    }
+
+    /*!
+     * A worker only sleeps once every queue is empty. It runs its own newest task first (its
+     * data is the most likely to still be in the cache) and steals the oldest tasks of the others.
+     */
+    void block_scheduler::worker(int queue)
+    {
+        configure_thread("fun_sched");
+        scheduler_task task;
+        while(true)
+        {
+            if(pop(queue, task) || steal(queue, task))
+            {
+                execute(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            while(m_queued == 0 && !m_stop) m_sleep_cond.wait(lock);
+            if(m_stop) return;
+        }
+    }
+}
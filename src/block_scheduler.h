@@ -0,0 +1,145 @@
+/*! \file block_scheduler.h
+ *  \brief Header file for the block_scheduler class and the scheduler_task & task_group structs.
+ *
+ *  The block_scheduler is a work stealing thread pool that any number of receiver chains can
+ *  share to run their blocks on (see receiver_chain_params::scheduler) instead of each chain
+ *  running every block on a thread of its own.
+ */
+
+#ifndef BLOCK_SCHEDULER_H
+#define BLOCK_SCHEDULER_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/*! \def SCHEDULER_QUEUE_SIZE
+ *  \brief Number of tasks each worker's queue of a block_scheduler can hold.
+ *
+ *  A task that doesn't fit in any queue is run by the thread submitting it.
+ */
+#define SCHEDULER_QUEUE_SIZE 256
+
+namespace fun
+{
+    /*!
+     * \brief The task_group struct tracks a set of tasks submitted together so that the submitter
+     *  can wait for all of them to finish (see block_scheduler::run()).
+     */
+    struct task_group
+    {
+        std::atomic<int> pending;           //!< Number of tasks of the group that haven't finished yet
+        std::mutex mutex;                   //!< Held while #pending is decremented and while waiting on #done_cond
+        std::condition_variable done_cond;  //!< Signalled when #pending drops to 0
+
+        task_group() : pending(0) {} //!< Constructor for an empty task_group
+    };
+
+    /*!
+     * \brief The scheduler_task struct is one call to run on a block_scheduler.
+     */
+    struct scheduler_task
+    {
+        void (*function)(void * context, int index);    //!< The function to call
+        void * context;                                 //!< First argument of #function
+        int index;                                      //!< Second argument of #function
+        task_group * group;                             //!< The group of the task (set by block_scheduler::run())
+    };
+
+    /*!
+     * \brief The block_scheduler class.
+     *
+     *  Each worker thread has its own queue of tasks. Submitted tasks are spread over the queues
+     *  and a worker that runs out of tasks steals them from the other queues (oldest first) before
+     *  going to sleep, so the load evens out across the workers no matter which chain submitted
+     *  the tasks. The queues are fixed size rings so scheduling a task never allocates.
+     */
+    class block_scheduler
+    {
+    public:
+
+        /*!
+         * \brief Constructor for block_scheduler.
+         * \param threads Number of worker threads. If 0 (the default) one per core.
+         */
+        block_scheduler(int threads = 0);
+
+        ~block_scheduler(); //!< Stops and joins the workers. Every task must have finished.
+
+        int size(); //!< Number of worker threads
+
+        /*!
+         * \brief Runs a set of tasks and waits for all of them to finish.
+         *
+         * The tasks may run in any order and in parallel. While waiting the calling thread runs
+         * tasks itself (its own or other submitters'), so it can be called from any thread,
+         * including from a task.
+         * \param tasks The tasks. Their scheduler_task::group is overwritten.
+         * \param count Number of tasks
+         * \param group The group that tracks the tasks. Must not be in use by another call to run().
+         */
+        void run(scheduler_task * tasks, int count, task_group & group);
+
+    private:
+
+        block_scheduler(const block_scheduler &);               //!< Not copyable
+        block_scheduler & operator=(const block_scheduler &);   //!< Not copyable
+
+        /*!
+         * \brief The task queue of one worker.
+         */
+        struct worker_queue
+        {
+            std::mutex mutex;                       //!< Protects everything below
+            scheduler_task tasks[SCHEDULER_QUEUE_SIZE]; //!< Ring buffer of tasks
+            unsigned int head;                      //!< Index of the oldest task (mod #SCHEDULER_QUEUE_SIZE)
+            unsigned int tail;                      //!< Index one past the newest task (mod #SCHEDULER_QUEUE_SIZE)
+        };
+
+        /*!
+         * \brief Adds a task to one of the queues.
+         * \return false if every queue is full
+         */
+        bool push(const scheduler_task & task);
+
+        /*!
+         * \brief Takes the newest task of a worker's own queue.
+         */
+        bool pop(int queue, scheduler_task & task);
+
+        /*!
+         * \brief Takes the oldest task of the first other queue that has one.
+         * \param queue The stealing worker's own queue, or -1 for a thread of its own.
+         */
+        bool steal(int queue, scheduler_task & task);
+
+        /*!
+         * \brief Runs a task and marks it finished in its group.
+         */
+        void execute(const scheduler_task & task);
+
+        /*!
+         * \brief Main loop of a worker thread.
+         * \param queue Index of the worker's queue
+         */
+        void worker(int queue);
+
+        std::vector<worker_queue *> m_queues; //!< One queue per worker
+
+        std::vector<std::thread> m_workers; //!< The worker threads
+
+        std::atomic<int> m_queued; //!< Number of tasks in all of the queues
+
+        std::atomic<unsigned int> m_next_queue; //!< Queue the next task is pushed to first
+
+        std::mutex m_sleep_mutex; //!< Protects sleeping on #m_sleep_cond and #m_stop
+
+        std::condition_variable m_sleep_cond; //!< Signalled when tasks are queued or on #m_stop
+
+        bool m_stop; //!< Tells the workers to exit
+    };
+}
+
+#endif // BLOCK_SCHEDULER_H
@@ -6,25 +6,87 @@
  *  of the channel attenuation & phase rotation to each of the subcarriers.
  */
 
+#include <algorithm>
 #include <cstring>
+#include <cmath>
 
 #include "channel_est.h"
 #include "preamble.h"
 
 namespace fun
 {
+    /*!
+     * \brief Equalizes a batch of symbols.
+     *
+     * Each sample is multiplied by the channel estimate of its subcarrier, which is stored as
+     * split real & imaginary arrays so the multiplies vectorize without any shuffling of the
+     * estimate. This is always inlined into the ISA specific wrappers below so the compiler
+     * generates a separate SSE and AVX2 version of it.
+     */
+    static inline __attribute__((always_inline))
+    void equalizer_kernel_impl(const tagged_vector<64> * __restrict__ input, tagged_vector<64> * __restrict__ output, int count,
+                               const real_t * __restrict__ chan_re, const real_t * __restrict__ chan_im)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            const real_t * in = reinterpret_cast<const real_t *>(input[i].samples);
+            real_t * out = reinterpret_cast<real_t *>(output[i].samples);
+            for(int j = 0; j < 64; j++)
+            {
+                real_t re = in[2 * j];
+                real_t im = in[2 * j + 1];
+                out[2 * j] = chan_re[j] * re - chan_im[j] * im;
+                out[2 * j + 1] = chan_re[j] * im + chan_im[j] * re;
+            }
+        }
+    }
+
+    //! SSE4.1 version of the equalizer kernel (the baseline compile flags).
+    static void equalizer_kernel_sse(const tagged_vector<64> * input, tagged_vector<64> * output, int count,
+                                     const real_t * chan_re, const real_t * chan_im)
+    {
+        equalizer_kernel_impl(input, output, count, chan_re, chan_im);
+    }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    //! AVX2 version of the equalizer kernel.
+    __attribute__((target("avx2")))
+    static void equalizer_kernel_avx2(const tagged_vector<64> * input, tagged_vector<64> * output, int count,
+                                      const real_t * chan_re, const real_t * chan_im)
+    {
+        equalizer_kernel_impl(input, output, count, chan_re, chan_im);
+    }
+#endif
+
     /*!
      * - Initializations:
-     *   + #m_chan_est -> 64 complex doubles each initialized to (1+0j)
+     *   + #m_kernel -> AVX2 kernel if the CPU supports it, SSE kernel otherwise
+     *   + #m_smoothing -> smoothing
+     *   + #m_chan_re & #m_chan_im -> 64 complex values each initialized to (1+0j)
      *   + #m_lts_flag -> 0 or in other words not in the LTS
      *   + #m_frame_start -> false
+     *   + #m_first_lts -> 64 samples
+     *   + #m_snr -> 0
+     *   + #m_sample_index -> 0
      */
-    channel_est::channel_est() :
-        block("channel_est"),        
-        m_chan_est(64, std::complex<double>(1, 0)),
+    channel_est::channel_est(bool smoothing) :
+        block("channel_est", 80, 80),
+        m_kernel(equalizer_kernel_sse),
+        m_smoothing(smoothing),
         m_lts_flag(0),
-        m_frame_start(false)
+        m_frame_start(false),
+        m_first_lts(64),
+        m_snr(0),
+        m_sample_index(0)
     {
+        for(int j = 0; j < 64; j++)
+        {
+            m_chan_re[j] = 1;
+            m_chan_im[j] = 0;
+        }
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        if(__builtin_cpu_supports("avx2")) m_kernel = equalizer_kernel_avx2;
+#endif
     }
 
     /*!
@@ -32,29 +94,78 @@ namespace fun
      * Once this symbol is found it then compares each sample in the two LTS symbols with the known
      * transmitted sample and calculates the inverse channel effect. It then applies this
      * channel correction to the rest of the symbol.
+     *
+     * The two LTS symbols are identical so the SNR of the frame is estimated from the power of
+     * their average (signal) and of their difference (noise) over the occupied subcarriers.
+     * The estimate and the frame's first sample index are passed on with the #START_OF_FRAME symbol.
      */
     void channel_est::work(){
 
-        if(input_buffer.size() == 0) return;
         output_buffer.resize(0);
+        if(input_buffer.size() == 0) return;
+
+        process(&input_buffer[0], input_buffer.size(), output_buffer);
+    }
 
-        for(int i = 0; i < input_buffer.size(); i++)
+    /*!
+     * The output is sized for every input symbol up front and the data symbols are equalized
+     * straight into it by #m_kernel, a run of consecutive data symbols (i.e. sharing the same
+     * channel estimate) at a time. The inverse channel is computed as ref * conj(rec) / |rec|^2
+     * so each LTS bin only needs a single real division.
+     */
+    void channel_est::process(const tagged_vector<64> * input, int count, std::vector<tagged_vector<64> > & output)
+    {
+        int first = output.size();
+        output.resize(first + count);
+        int out = first;
+        int run = 0; // Number of data symbols waiting to be equalized
+
+        for(int i = 0; i < count; i++)
         {
+            bool lts = input[i].tag == LTS_START || m_lts_flag > 0;
+            if(lts && run > 0)
+            {
+                // Equalize the data symbols before the estimate changes
+                m_kernel(&input[i - run], &output[out - run], run, m_chan_re, m_chan_im);
+                run = 0;
+            }
+
             // Start of LTS found
-            if(input_buffer[i].tag == LTS_START)
+            if(input[i].tag == LTS_START)
             {
                 m_lts_flag = 1;
-                for(int j = 0; j < 64; j++) m_chan_est[j] = std::complex<double>(0.0,0.0);
+                m_sample_index = input[i].sample_index;
+                m_quality = input[i].quality;
+                for(int j = 0; j < 64; j++)
+                {
+                    m_chan_re[j] = 0;
+                    m_chan_im[j] = 0;
+                }
             }
 
             if(m_lts_flag > 0) // This is a LTS symbol
             {
                 // Calculate channel correction
+                const real_t * rec = reinterpret_cast<const real_t *>(input[i].samples);
                 for(int j = 0; j < 64; j++)
                 {
-                    std::complex<double> ref_lts_sample = LTS_FREQ_DOMAIN[j];
-                    std::complex<double> rec_lts_sample = input_buffer[i].samples[j];
-                    m_chan_est[j] += ref_lts_sample / rec_lts_sample / 2.0;
+                    real_t ref = LTS_FREQ_DOMAIN[j].real(); // The LTS is real
+                    real_t scale = ref / (2 * (rec[2 * j] * rec[2 * j] + rec[2 * j + 1] * rec[2 * j + 1]));
+                    m_chan_re[j] += rec[2 * j] * scale;
+                    m_chan_im[j] -= rec[2 * j + 1] * scale;
+                }
+
+                if(m_lts_flag == 1) memcpy(&m_first_lts[0], input[i].samples, 64 * sizeof(complex_t));
+                else
+                {
+                    double signal = 0, noise = 0;
+                    for(int j = 0; j < 64; j++)
+                    {
+                        if(LTS_FREQ_DOMAIN[j] == complex_t(0, 0)) continue;
+                        signal += std::norm(m_first_lts[j] + input[i].samples[j]) / 4;
+                        noise += std::norm(m_first_lts[j] - input[i].samples[j]) / 2;
+                    }
+                    m_snr = 10 * std::log10(signal / std::max(noise, 1e-30));
                 }
 
                 m_lts_flag++;
@@ -62,28 +173,71 @@ namespace fun
                 {
                     m_lts_flag = 0;
                     m_frame_start = true; // Next symbol is the start of frame
+                    if(m_smoothing) smooth_estimate();
                 }
             }
             else
             {
-                tagged_vector<64> symbol;
+                tagged_vector<64> & symbol = output[out++];
+                symbol.tag = NONE;
+                symbol.snr = 0;
+                symbol.sample_index = 0;
+                symbol.quality = detection_quality();
                 if(m_frame_start)
                 {
                     symbol.tag = START_OF_FRAME;
+                    symbol.snr = m_snr;
+                    symbol.sample_index = m_sample_index;
+                    symbol.quality = m_quality;
                     m_frame_start = false;
                 }
-
-                // Apply channel correction
-                for(int j = 0; j < 64; j++)
-                {
-                    std::complex<double> out_sample = m_chan_est[j] * input_buffer[i].samples[j];
-                    symbol.samples[j] = out_sample;
-                }
-                output_buffer.push_back(symbol);
+                run++;
             }
         }
+
+        // Apply channel correction to the last run
+        if(run > 0) m_kernel(&input[count - run], &output[out - run], run, m_chan_re, m_chan_im);
+        output.resize(out);
     }
 
-}
+    void channel_est::smooth_estimate()
+    {
+        // Average phase step between neighbouring occupied subcarriers
+        complex_t step_acc(0, 0);
+        for(int j = 0; j + 1 < 64; j++)
+        {
+            if(LTS_FREQ_DOMAIN[j] == complex_t(0, 0) || LTS_FREQ_DOMAIN[j + 1] == complex_t(0, 0)) continue;
+            step_acc += complex_t(m_chan_re[j + 1], m_chan_im[j + 1]) * complex_t(m_chan_re[j], -m_chan_im[j]);
+        }
+        double step = std::arg(step_acc);
 
+        // Take out the ramp
+        complex_t flat[64];
+        for(int j = 0; j < 64; j++)
+        {
+            flat[j] = complex_t(m_chan_re[j], m_chan_im[j]) * complex_t(std::cos(-step * j), std::sin(-step * j));
+        }
 
+        // [1 2 1] / 4 over the occupied neighbours (renormalized at the edges) & then put the ramp back
+        for(int j = 0; j < 64; j++)
+        {
+            if(LTS_FREQ_DOMAIN[j] == complex_t(0, 0)) continue;
+            complex_t sum = real_t(2) * flat[j];
+            real_t weight = 2;
+            if(j > 0 && LTS_FREQ_DOMAIN[j - 1] != complex_t(0, 0))
+            {
+                sum += flat[j - 1];
+                weight += 1;
+            }
+            if(j < 63 && LTS_FREQ_DOMAIN[j + 1] != complex_t(0, 0))
+            {
+                sum += flat[j + 1];
+                weight += 1;
+            }
+            complex_t smoothed = sum / weight * complex_t(std::cos(step * j), std::sin(step * j));
+            m_chan_re[j] = smoothed.real();
+            m_chan_im[j] = smoothed.imag();
+        }
+    }
+
+}
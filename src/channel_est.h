@@ -17,6 +17,14 @@
 
 namespace fun
 {
+    /*!
+     * \brief Signature of the vectorized equalizer kernels.
+     *
+     * See channel_est.cpp for the SSE and AVX2 versions that are selected
+     * between at runtime.
+     */
+    typedef void (*equalizer_kernel)(const tagged_vector<64> * input, tagged_vector<64> * output, int count,
+                                     const real_t * chan_re, const real_t * chan_im);
 
     /*!
      * \brief The channel_est block.
@@ -28,20 +36,54 @@ namespace fun
      * The Channel Estimate block is in charge of estimating the current channel conditions
      * using the two known LTS symbols and equalizing the channel affect by applying the inverse
      * of the channel attenuation & phase rotation to each of the subcarriers.
+     *
+     * The estimate can optionally be smoothed across neighbouring subcarriers which averages
+     * out some of the noise in the two LTS symbols at the cost of a few operations per frame.
      */
     class channel_est : public fun::block<tagged_vector<64>, tagged_vector<64> >
     {
     public:
 
 
-        channel_est(); //!< Construct for Channel Estimate block.
+        /*!
+         * \brief Construct for Channel Estimate block.
+         * \param smoothing [Optional] Whether to smooth the channel estimate across subcarriers. Defaults to false.
+         */
+        channel_est(bool smoothing = false);
 
         virtual void work(); //!< Signal Processing happens here.
 
+        /*!
+         * \brief Does what work() does to the given symbols instead of the input_buffer.
+         * \param input The symbols
+         * \param count Number of symbols
+         * \param output The equalized symbols are appended to this vector
+         */
+        void process(const tagged_vector<64> * input, int count, std::vector<tagged_vector<64> > & output);
+
     private:
 
+        /*!
+         * \brief Smooths the channel estimate across the occupied subcarriers.
+         *
+         * The linear phase ramp across the subcarriers (from the timing offset of the symbols)
+         * is taken out first so that neighbouring subcarriers can be averaged without losing
+         * amplitude, then the estimate is averaged with [1 2 1] / 4 weights & the ramp put back.
+         */
+        void smooth_estimate();
+
+        /*!
+         * \brief The kernel used to equalize the symbols.
+         *
+         * Chosen in the constructor based on the instruction sets the CPU supports.
+         */
+        equalizer_kernel m_kernel;
+
+        bool m_smoothing; //!< Whether the channel estimate is smoothed
 
-        std::vector<std::complex<double> > m_chan_est; //!< Current channel estimate for each subcarrier.
+        alignas(16) real_t m_chan_re[64]; //!< Current (inverse) channel estimate for each subcarrier (real parts).
+
+        alignas(16) real_t m_chan_im[64]; //!< Current (inverse) channel estimate for each subcarrier (imaginary parts).
 
         /*!
          * \brief Flag to indicate whether the current symbols are part of the LTS or not.
@@ -58,6 +100,14 @@ namespace fun
          * or in other words the first symbol after the second LTS symbol.
          */
         bool m_frame_start;
+
+        std::vector<complex_t > m_first_lts; //!< The first LTS symbol of the current frame.
+
+        float m_snr; //!< SNR estimate (in dB) of the current frame (see tagged_vector::snr)
+
+        unsigned long long m_sample_index; //!< First sample of the current frame (see tagged_vector::sample_index)
+
+        detection_quality m_quality; //!< Detection metrics of the current frame (see tagged_vector::quality)
     };
 }
 
@@ -0,0 +1,134 @@
+/*! \file channel_sim.cpp
+ *  \brief C++ file for the channel_sim class.
+ *
+ *  The channel_sim class passes baseband samples through a simulated radio channel (multipath,
+ *  timing offset, carrier frequency offset and additive white gaussian noise) so that the
+ *  transmit & receive chains can be tested and qualified without a USRP.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include "channel_sim.h"
+
+namespace fun
+{
+    /*!
+     * - Initializations:
+     *   + #m_generator -> Seeded with channel_params::seed
+     *   + #m_taps -> A single tap of 1 (flat channel)
+     *   + #m_noise_amplitude -> 0 until the first frame sets it
+     *   + #m_phase -> 0
+     */
+    channel_sim::channel_sim(channel_params params) :
+        m_params(params),
+        m_generator(params.seed),
+        m_normal(0.0, 1.0),
+        m_uniform(0.0, 1.0),
+        m_taps(1, std::complex<double>(1, 0)),
+        m_noise_amplitude(0),
+        m_phase(0)
+    {
+        if(m_params.multipath_taps < 1) m_params.multipath_taps = 1;
+    }
+
+    channel_params channel_sim::get_params() { return m_params; }
+
+    /*!
+     * Tap i has a complex gaussian gain with a variance proportional to exp(-i / delay spread),
+     * normalized so that the expected power gain of the channel is 1.
+     */
+    void channel_sim::fade()
+    {
+        int count = m_params.multipath_taps;
+        m_taps.resize(count);
+        if(count == 1)
+        {
+            m_taps[0] = std::complex<double>(1, 0);
+            return;
+        }
+
+        double spread = std::max(m_params.delay_spread, 1e-3);
+        double total = 0;
+        for(int x = 0; x < count; x++) total += std::exp(-x / spread);
+        for(int x = 0; x < count; x++)
+        {
+            double sigma = std::sqrt(std::exp(-x / spread) / total / 2);
+            m_taps[x] = std::complex<double>(m_normal(m_generator) * sigma, m_normal(m_generator) * sigma);
+        }
+    }
+
+    /*!
+     * The frame goes through its own multipath channel and is delayed by the timing offset (the
+     * fractional part by linear interpolation between two samples). The carrier frequency offset
+     * rotates every sample that comes out of the channel (idle ones too) and the noise is added last.
+     */
+    size_t channel_sim::apply(const std::vector<complex_t > & frame, int idle, std::vector<complex_t > & output)
+    {
+        // The noise power follows the frame's average power
+        double power = 0;
+        for(int x = 0; x < frame.size(); x++) power += std::norm(frame[x]);
+        if(frame.size() > 0) power /= frame.size();
+        m_noise_amplitude = std::sqrt(power / std::pow(10.0, m_params.snr / 10) / 2);
+
+        fade();
+
+        // Multipath
+        int taps = m_taps.size();
+        m_scratch.assign(frame.size() + taps - 1, std::complex<double>(0, 0));
+        for(int x = 0; x < frame.size(); x++)
+        {
+            std::complex<double> sample(frame[x].real(), frame[x].imag());
+            for(int t = 0; t < taps; t++) m_scratch[x + t] += sample * m_taps[t];
+        }
+
+        // Timing offset
+        double delay = m_uniform(m_generator) * m_params.timing_offset;
+        int whole = (int) delay;
+        double fraction = delay - whole;
+
+        size_t start = output.size() + idle + whole;
+        int length = idle + whole + m_scratch.size() + 1;
+        output.reserve(output.size() + length);
+
+        double step = 2 * M_PI * m_params.cfo / m_params.sample_rate;
+        for(int x = 0; x < length; x++)
+        {
+            // Sample x of the output is made up of samples k and k - 1 of the multipath output
+            int k = x - idle - whole;
+            std::complex<double> sample(0, 0);
+            if(k >= 0 && k < m_scratch.size()) sample += m_scratch[k] * (1 - fraction);
+            if(k >= 1 && k <= m_scratch.size()) sample += m_scratch[k - 1] * fraction;
+
+            sample *= std::polar(1.0, m_phase);
+            m_phase = std::fmod(m_phase + step, 2 * M_PI);
+
+            sample += std::complex<double>(m_normal(m_generator) * m_noise_amplitude, m_normal(m_generator) * m_noise_amplitude);
+            output.push_back(complex_t(sample.real(), sample.imag()));
+        }
+        return start;
+    }
+
+    void channel_sim::add_idle(int count, std::vector<complex_t > & output)
+    {
+        double step = 2 * M_PI * m_params.cfo / m_params.sample_rate;
+        m_phase = std::fmod(m_phase + step * count, 2 * M_PI);
+        output.reserve(output.size() + count);
+        for(int x = 0; x < count; x++)
+        {
+            output.push_back(complex_t(m_normal(m_generator) * m_noise_amplitude, m_normal(m_generator) * m_noise_amplitude));
+        }
+    }
+
+    void channel_sim::add_noise(complex_t * symbols, int count, double snr)
+    {
+        double power = 0;
+        for(int x = 0; x < count; x++) power += std::norm(symbols[x]);
+        if(count > 0) power /= count;
+        double amplitude = std::sqrt(power / std::pow(10.0, snr / 10) / 2);
+        for(int x = 0; x < count; x++)
+        {
+            symbols[x] += complex_t(m_normal(m_generator) * amplitude, m_normal(m_generator) * amplitude);
+        }
+    }
+}
@@ -0,0 +1,147 @@
+/*! \file channel_sim.h
+ *  \brief Header file for the channel_sim class and the channel_params struct.
+ *
+ *  The channel_sim class passes baseband samples through a simulated radio channel (multipath,
+ *  timing offset, carrier frequency offset and additive white gaussian noise) so that the
+ *  transmit & receive chains can be tested and qualified without a USRP.
+ */
+
+#ifndef CHANNEL_SIM_H
+#define CHANNEL_SIM_H
+
+#include <vector>
+#include <random>
+
+#include "precision.h"
+
+namespace fun
+{
+    /*!
+     * \brief The channel_params struct holds the impairments of a simulated channel.
+     */
+    struct channel_params
+    {
+        double snr;             //!< Signal to noise ratio in dB (of the average signal power of each frame)
+        double cfo;             //!< Carrier frequency offset in Hz
+        double sample_rate;     //!< Sample rate in samples per second (scales #cfo)
+
+        /*!
+         * \brief Number of multipath taps.
+         *
+         * Each frame goes through a new rayleigh faded channel with this many taps one sample
+         * apart and an exponential power delay profile (see #delay_spread). 1 (the default) is
+         * a flat channel without any fading.
+         */
+        int multipath_taps;
+
+        double delay_spread;    //!< Decay constant of the exponential power delay profile in samples
+
+        /*!
+         * \brief Largest timing offset in samples.
+         *
+         * Each frame is delayed by a random (fractional) number of samples up to this many, on top
+         * of the idle samples before it, so that it doesn't start at the same sample of a chunk
+         * or on the sample grid of the transmitter.
+         */
+        double timing_offset;
+
+        unsigned int seed;      //!< Seed of the noise, fading & timing offset generators
+
+        /*!
+         * \brief Constructor for channel_params.
+         * \param snr -> #snr
+         * \param cfo -> #cfo
+         * \param sample_rate -> #sample_rate
+         * \param multipath_taps -> #multipath_taps
+         * \param delay_spread -> #delay_spread
+         * \param timing_offset -> #timing_offset
+         * \param seed -> #seed
+         */
+        channel_params(double snr = 30, double cfo = 0, double sample_rate = 5e6, int multipath_taps = 1,
+                       double delay_spread = 1, double timing_offset = 0, unsigned int seed = 1) :
+            snr(snr),
+            cfo(cfo),
+            sample_rate(sample_rate),
+            multipath_taps(multipath_taps),
+            delay_spread(delay_spread),
+            timing_offset(timing_offset),
+            seed(seed)
+        {
+        }
+    };
+
+    /*!
+     * \brief The channel_sim class.
+     *
+     *  Usage: Pass each frame to apply() along with the number of idle samples to put in front of
+     *  it. Frames applied one after the other make up one continuous stream of samples, i.e. the
+     *  carrier phase carries on from one call to the next like it would over the air.
+     *
+     *  The noise power is set from the average power of each frame, so the SNR is the same no
+     *  matter how the frames were scaled. A channel_sim isn't thread safe, use one per thread.
+     */
+    class channel_sim
+    {
+    public:
+
+        /*!
+         * \brief Constructor for channel_sim.
+         * \param params The channel's impairments.
+         */
+        channel_sim(channel_params params = channel_params());
+
+        /*!
+         * \brief Passes one frame through the channel.
+         * \param frame The transmitted frame
+         * \param idle Number of (noise only) samples before the frame
+         * \param output The received samples are appended here. That is #idle samples, then the
+         *  timing offset and the frame followed by the tail of the multipath channel.
+         * \return Index in output (before appending) of the frame's first sample rounded down.
+         */
+        size_t apply(const std::vector<complex_t > & frame, int idle, std::vector<complex_t > & output);
+
+        /*!
+         * \brief Appends samples of noise only (e.g. to flush a receiver chain after the last frame).
+         *
+         * The noise has the same power as the previous frame's noise (none before the first frame).
+         * \param count Number of samples
+         * \param output The samples are appended here
+         */
+        void add_idle(int count, std::vector<complex_t > & output);
+
+        /*!
+         * \brief Adds noise to a buffer of symbols in place (e.g. frequency domain data symbols).
+         * \param symbols The symbols
+         * \param count Number of symbols
+         * \param snr Signal to noise ratio in dB of the average power of the symbols
+         */
+        void add_noise(complex_t * symbols, int count, double snr);
+
+        channel_params get_params(); //!< Get the channel's impairments
+
+    private:
+
+        /*!
+         * \brief Draws new taps for the multipath channel of the next frame
+         */
+        void fade();
+
+        channel_params m_params; //!< The channel's impairments
+
+        std::mt19937 m_generator; //!< Drives everything random
+
+        std::normal_distribution<double> m_normal; //!< Unit variance gaussian
+
+        std::uniform_real_distribution<double> m_uniform; //!< Uniform over [0, 1)
+
+        std::vector<std::complex<double> > m_taps; //!< Multipath taps of the current frame
+
+        double m_noise_amplitude; //!< Standard deviation of each component of the noise of the current frame
+
+        double m_phase; //!< Carrier phase offset of the next sample in radians
+
+        std::vector<std::complex<double> > m_scratch; //!< The current frame after the multipath channel
+    };
+}
+
+#endif // CHANNEL_SIM_H
@@ -0,0 +1,217 @@
+/*! \file channelized_receiver.cpp
+ *  \brief C++ file for the channelized_receiver class.
+ *
+ *  The channelized_receiver class receives 802.11a OFDM frames on several adjacent channels at
+ *  once from a single wideband USRP stream, splitting it with a channelizer and running an
+ *  independent receiver chain for each channel.
+ */
+
+#include <algorithm>
+
+#include "channelized_receiver.h"
+
+namespace fun
+{
+
+    /*!
+     * \brief Returns a copy of params streaming one RX channel covering the given number of channels
+     */
+    static usrp_params wideband(usrp_params params, int channels)
+    {
+        params.rate *= channels;
+        params.rx_channels = 1;
+        return params;
+    }
+
+    /*!
+     * -Initializations
+     *  + #m_usrp -> Streaming one RX channel at the per channel rate times the number of channels
+     *  + #m_channelizer -> One channel per callback
+     *  + #m_capture -> #RX_RING_SIZE wideband buffers of chunk_size samples per channel
+     *  + #m_chains -> One receiver_chain per channel running at the per channel rate
+     *  + #m_rings -> One #RX_RING_SIZE buffer ring per channel
+     */
+    channelized_receiver::channelized_receiver(std::vector<void(*)(std::vector<std::vector<unsigned char> > packets)> callbacks,
+                                               usrp_params params,
+                                               receiver_params rx_params,
+                                               int taps_per_channel) :
+        m_callbacks(callbacks),
+        m_params(params),
+        m_usrp(wideband(params, callbacks.size())),
+        m_rx_params(rx_params),
+        m_channelizer(callbacks.size(), taps_per_channel)
+    {
+        int channels = m_callbacks.size();
+        m_rx_params.chain.sample_rate = params.rate;
+        m_rx_params.chain.chunk_size = m_rx_params.chunk_size;
+        m_capture = new rx_ring(RX_RING_SIZE, m_rx_params.chunk_size * channels);
+        for(int c = 0; c < channels; c++)
+        {
+            m_chains.push_back(new receiver_chain(m_rx_params.chain));
+            m_rings.push_back(new rx_ring(RX_RING_SIZE, m_channelizer.max_outputs(m_rx_params.chunk_size * channels)));
+        }
+
+        sem_init(&m_pause, 0, 1); //Initial value is 1 so that the capture_loop() will begin executing immediately
+        for(int c = 0; c < channels; c++)
+        {
+            m_channel_threads.push_back(std::thread(&channelized_receiver::channel_loop, this, c));
+        }
+        m_channelizer_thread = std::thread(&channelized_receiver::channelizer_loop, this);
+        m_capture_thread = std::thread(&channelized_receiver::capture_loop, this);
+    }
+
+    /*!
+     *  This function loops forever (unless it is paused) receiving the wideband samples with
+     *  usrp::get_samples() straight into the capture ring. If the ring is full the samples are
+     *  received into a scratch buffer and dropped (see rx_ring::capture()).
+     */
+    void channelized_receiver::capture_loop()
+    {
+        int channels = m_callbacks.size();
+        rx_ring::capture(m_usrp, std::vector<rx_ring *>(1, m_capture), m_rx_params.chunk_size * channels,
+                         m_params.rate * channels, m_rx_params.capture_thread, &m_pause);
+    }
+
+    /*!
+     *  This function loops forever splitting each wideband buffer into a buffer of every channel's
+     *  ring in a single channelizer pass. The wideband buffer goes straight back to the capture
+     *  thread afterwards. A channel whose ring is full has its samples written to a scratch buffer
+     *  and dropped without holding up the other channels.
+     *
+     *  The time of each channel buffer is the time its first sample was on the air, i.e. the time
+     *  of the wideband sample it lines up with less the delay of the channelizer's filter.
+     */
+    void channelized_receiver::channelizer_loop()
+    {
+        int channels = m_callbacks.size();
+        double wide_rate = m_params.rate * channels;
+        int capacity = m_channelizer.max_outputs(m_rx_params.chunk_size * channels);
+        std::vector<complex_t > wide;
+        std::vector<std::vector<complex_t > > buffers(channels);
+        std::vector<std::vector<complex_t > > scratch(channels);
+        std::vector<complex_t *> targets(channels);
+        std::vector<bool> have_buffer(channels);
+        rx_error_counts no_errors;
+        configure_thread("fun_rx_chan", m_rx_params.process_thread);
+        while(1)
+        {
+            double time;
+            m_capture->pop_filled(wide, time);
+
+            int needed = std::max(capacity, m_channelizer.max_outputs(wide.size()));
+            for(int c = 0; c < channels; c++)
+            {
+                have_buffer[c] = buffers[c].size() != 0 || m_rings[c]->spare.pop(buffers[c]);
+                std::vector<complex_t > & target = have_buffer[c] ? buffers[c] : scratch[c];
+                target.resize(needed);
+                targets[c] = target.data();
+            }
+
+            int first = 0;
+            int produced = m_channelizer.process(wide.data(), wide.size(), targets, &first);
+            double channel_time = (time >= 0) ? time + (first - m_channelizer.delay()) / wide_rate : -1;
+
+            if(wide.capacity() < m_rx_params.chunk_size * channels) wide.reserve(m_rx_params.chunk_size * channels);
+            m_capture->spare.push(wide);
+
+            for(int c = 0; c < channels; c++)
+            {
+                m_rings[c]->record(produced, no_errors);
+                if(!have_buffer[c])
+                {
+                    m_rings[c]->dropped_buffers.fetch_add(1, std::memory_order_relaxed);
+                }
+                else if(produced > 0)
+                {
+                    buffers[c].resize(produced);
+                    m_rings[c]->push_filled(buffers[c], channel_time);
+                }
+            }
+        }
+    }
+
+    /*!
+     *  This function loops forever passing the channel's filled buffers through the channel's
+     *  receiver chain and passing any successfully decoded packets to the channel's callback.
+     *  If receiver_params::process_thread lists several cpus the thread is pinned to one of them.
+     */
+    void channelized_receiver::channel_loop(int channel)
+    {
+        rx_ring * ring = m_rings[channel];
+        receiver_chain * chain = m_chains[channel];
+        std::vector<complex_t > buffer;
+        int capacity = m_channelizer.max_outputs(m_rx_params.chunk_size * m_callbacks.size());
+
+        thread_params thread = m_rx_params.process_thread;
+        if(thread.cpus.size() > 1) thread.cpus = std::vector<int>(1, thread.cpus[channel % thread.cpus.size()]);
+        configure_thread("fun_rx_ch" + std::to_string(channel), thread);
+        while(1)
+        {
+            double time;
+            ring->pop_filled(buffer, time);
+
+            std::vector<std::vector<unsigned char> > packets = chain->process_buffer(buffer, time);
+
+            if(buffer.capacity() < capacity) buffer.reserve(capacity);
+            ring->spare.push(buffer);
+
+            m_callbacks[channel](packets);
+        }
+    }
+
+    /*!
+     *  Uses an internal semaphore to block the capture loop until channelized_receiver::resume() is called.
+     *  Samples that were already captured are still processed while the receiver is paused.
+     */
+    void channelized_receiver::pause()
+    {
+        sem_wait(&m_pause);
+    }
+
+    void channelized_receiver::resume()
+    {
+        sem_post(&m_pause);
+    }
+
+    int channelized_receiver::get_channel_count()
+    {
+        return m_callbacks.size();
+    }
+
+    double channelized_receiver::get_channel_freq(int channel)
+    {
+        return m_params.freq + (channel - int(m_callbacks.size()) / 2) * m_params.rate;
+    }
+
+    receiver_stats channelized_receiver::get_stats(int channel)
+    {
+        receiver_stats stats = m_rings[channel]->snapshot();
+        receiver_stats capture = m_capture->snapshot();
+        stats.overflows = capture.overflows;
+        stats.timeouts = capture.timeouts;
+        stats.late_commands = capture.late_commands;
+        stats.other_errors = capture.other_errors;
+        stats.dropped_buffers += capture.dropped_buffers;
+        return stats;
+    }
+
+    std::vector<block_stats> channelized_receiver::get_block_stats(int channel)
+    {
+        return m_chains[channel]->get_block_stats();
+    }
+
+    block_stats channelized_receiver::get_latency_stats(int channel)
+    {
+        return m_chains[channel]->get_latency_stats();
+    }
+
+    overload_stats channelized_receiver::get_overload_stats(int channel)
+    {
+        return m_chains[channel]->get_overload_stats();
+    }
+
+    detection_stats channelized_receiver::get_detection_stats(int channel)
+    {
+        return m_chains[channel]->get_detection_stats();
+    }
+}
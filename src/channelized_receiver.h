@@ -0,0 +1,156 @@
+/*! \file channelized_receiver.h
+ *  \brief Header file for the channelized_receiver class.
+ *
+ *  The channelized_receiver class receives 802.11a OFDM frames on several adjacent channels at
+ *  once from a single wideband USRP stream, splitting it with a channelizer and running an
+ *  independent receiver chain for each channel.
+ */
+
+#ifndef CHANNELIZED_RECEIVER_H
+#define CHANNELIZED_RECEIVER_H
+
+#include <semaphore.h>
+#include <vector>
+#include <thread>
+#include "receiver.h"
+#include "channelizer.h"
+
+namespace fun
+{
+
+    /*!
+     * \brief The channelized_receiver class monitors several adjacent channels with one capture.
+     *
+     *  Usage: Create a channelized_receiver object passing it one callback function per channel.
+     *  With N callbacks the USRP captures N * usrp_params::rate samples per second around
+     *  usrp_params::freq and channel c (centered at freq + (c - N / 2) * rate) is processed by its
+     *  own receiver_chain, passing the packets it receives to callbacks[c].
+     *
+     *  A capture thread receives the wideband samples into a ring of preallocated buffers (see
+     *  #RX_RING_SIZE & receiver_params::chunk_size, which is the chunk size of each channel so a
+     *  wideband buffer holds N times as many samples). A channelizer thread makes a single
+     *  polyphase filter bank pass over each wideband buffer straight into every channel's own
+     *  ring, and each channel has its own processing thread passing its buffers through its
+     *  receiver_chain and calling its callback. Like the multi_receiver a slow channel only drops
+     *  its own samples.
+     */
+    class channelized_receiver
+    {
+    public:
+
+        /*!
+         * \brief Constructor for the channelized_receiver
+         * \param callbacks One callback function per channel. The number of callbacks sets the number
+         *  of channels.
+         * \param params [Optional] The usrp parameters you want to use for this receiver. The rate is
+         *  the sample rate of each channel (and the channel spacing), the USRP runs at that times the
+         *  number of channels. usrp_params::rx_channels is ignored.
+         * \param rx_params [Optional] The configuration of every channel's receiver_chain and of the
+         *  threads. The receiver_params::process_thread applies to the channelizer thread and every
+         *  channel's processing thread, except that if it lists several cpus each channel's thread is
+         *  pinned to one of them in turn so the chains run on separate cores.
+         * \param taps_per_channel [Optional] Length of the channelizer's prototype filter per channel
+         */
+        channelized_receiver(std::vector<void(*)(std::vector<std::vector<unsigned char> > packets)> callbacks,
+                             usrp_params params = usrp_params(),
+                             receiver_params rx_params = receiver_params(),
+                             int taps_per_channel = CHANNELIZER_TAPS);
+
+        /*!
+         * \brief Pauses the capture thread (for every channel).
+         */
+        void pause();
+
+        /*!
+         * \brief Resumes the capture thread after it has been paused.
+         */
+        void resume();
+
+        /*!
+         * \brief Gets the number of channels.
+         */
+        int get_channel_count();
+
+        /*!
+         * \brief Gets the center frequency of a channel.
+         * \param channel The channel
+         */
+        double get_channel_freq(int channel);
+
+        /*!
+         * \brief Gets the counters of one channel. Can be called from any thread.
+         * \param channel The channel
+         * \return A snapshot of the counters. The samples are the channel's own (decimated) samples,
+         *  the UHD error counts are shared by all channels and the dropped buffers include the
+         *  wideband buffers dropped by the capture thread.
+         */
+        receiver_stats get_stats(int channel);
+
+        /*!
+         * \brief Gets the timing statistics of one channel's receiver_chain blocks.
+         * \param channel The channel
+         * \return See receiver_chain::get_block_stats()
+         */
+        std::vector<block_stats> get_block_stats(int channel);
+
+        /*!
+         * \brief Gets the end to end latency statistics of one channel's received packets.
+         * \param channel The channel
+         * \return See receiver_chain::get_latency_stats()
+         */
+        block_stats get_latency_stats(int channel);
+
+        /*!
+         * \brief Gets the counters of one channel's load watchdog. Can be called from any thread.
+         * \param channel The channel
+         * \return See receiver_chain::get_overload_stats()
+         */
+        overload_stats get_overload_stats(int channel);
+
+        /*!
+         * \brief Gets the number of detected frames each stage of one channel's receiver_chain dropped. Can be called from any thread.
+         * \param channel The channel
+         * \return See receiver_chain::get_detection_stats()
+         */
+        detection_stats get_detection_stats(int channel);
+
+    private:
+
+        void capture_loop(); //!< Infinite while loop where the wideband samples are received into the capture ring
+
+        void channelizer_loop(); //!< Infinite while loop where the wideband buffers are split into the channel rings
+
+        /*!
+         * \brief Infinite while loop where one channel's samples are processed by its receiver_chain
+         * \param channel The channel
+         */
+        void channel_loop(int channel);
+
+        std::vector<void(*)(std::vector<std::vector<unsigned char> > packets)> m_callbacks; //!< Callback function pointer per channel
+
+        usrp_params m_params; //!< The usrp parameters (with the per channel rate)
+
+        usrp m_usrp; //!< The usrp object streaming the wideband samples
+
+        receiver_params m_rx_params; //!< The configuration of the receiver chains & threads
+
+        channelizer m_channelizer; //!< Splits the wideband samples into the channels
+
+        rx_ring * m_capture; //!< The wideband capture ring & counters
+
+        std::vector<receiver_chain *> m_chains; //!< The receiver chain per channel
+
+        std::vector<rx_ring *> m_rings; //!< The channelized ring & counters per channel
+
+        std::vector<std::thread> m_channel_threads; //!< The processing thread per channel
+
+        std::thread m_channelizer_thread; //!< The thread running the channelizer
+
+        std::thread m_capture_thread; //!< The thread that receives samples from the USRP
+
+        sem_t m_pause; //!< Semaphore used to pause the capture thread
+    };
+
+}
+
+#endif // CHANNELIZED_RECEIVER_H
@@ -0,0 +1,144 @@
+/*! \file channelizer.cpp
+ *  \brief C++ file for the channelizer class.
+ *
+ *  The channelizer class splits one wideband stream of samples into adjacent, equally spaced
+ *  narrowband channels with a polyphase filter bank so that one capture can feed a receiver
+ *  chain per channel.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "channelizer.h"
+
+namespace fun
+{
+    /*!
+     * \brief Zeroth order modified Bessel function of the first kind (for the Kaiser window).
+     */
+    static double bessel_i0(double x)
+    {
+        double sum = 1, term = 1;
+        for(int k = 1; k < 50; k++)
+        {
+            term *= (x / (2 * k)) * (x / (2 * k));
+            sum += term;
+            if(term < 1e-12 * sum) break;
+        }
+        return sum;
+    }
+
+    /*!
+     * - Initializations:
+     *   + #m_channels -> channels
+     *   + #m_taps_per_channel -> taps_per_channel
+     *   + #m_history -> channels * taps_per_channel - 1
+     *   + #m_phase -> 0 (the first output lines up with the first input sample)
+     *   + #m_buffer -> #m_history zeros
+     *   + #m_fft -> channels point FFT batched over consecutive channels samples
+     *
+     * The prototype is a Kaiser windowed (beta 7) sinc cut off at half the channel spacing and
+     * normalized to a DC gain of 1, so a signal keeps its amplitude in its channel.
+     */
+    channelizer::channelizer(int channels, int taps_per_channel) :
+        m_channels(channels),
+        m_taps_per_channel(taps_per_channel),
+        m_history(channels * taps_per_channel - 1),
+        m_phase(0),
+        m_buffer(channels * taps_per_channel - 1, complex_t(0, 0)),
+        m_acc(2 * channels),
+        m_fft(channels, channels)
+    {
+        int length = m_channels * m_taps_per_channel;
+        std::vector<double> prototype(length);
+        double center = (length - 1) / 2.0;
+        double cutoff = 0.5 / m_channels;
+        double beta = 7.0;
+        double sum = 0;
+        for(int n = 0; n < length; n++)
+        {
+            double t = n - center;
+            double sinc = (t == 0) ? 1 : std::sin(2 * M_PI * cutoff * t) / (2 * M_PI * cutoff * t);
+            double ratio = (length > 1) ? 2.0 * n / (length - 1) - 1 : 0;
+            double window = bessel_i0(beta * std::sqrt(std::max(0.0, 1 - ratio * ratio))) / bessel_i0(beta);
+            prototype[n] = sinc * window;
+            sum += prototype[n];
+        }
+
+        m_taps.resize(2 * length);
+        for(int r = 0; r < m_taps_per_channel; r++)
+        {
+            for(int q = 0; q < m_channels; q++)
+            {
+                real_t tap = prototype[r * m_channels + m_channels - 1 - q] / sum;
+                m_taps[r * 2 * m_channels + 2 * q] = tap;
+                m_taps[r * 2 * m_channels + 2 * q + 1] = tap;
+            }
+        }
+
+        m_bins.resize(m_channels);
+        for(int c = 0; c < m_channels; c++)
+        {
+            m_bins[c] = ((m_channels / 2 - c) % m_channels + m_channels) % m_channels;
+        }
+    }
+
+    /*!
+     * Output m of channel k (counting k from the center frequency up) is
+     *
+     *     y_k[m] = sum_p u_p[m] e^(j 2 pi k p / M),   u_p[m] = sum_r h[r M + p] x[(m - r) M - p]
+     *
+     * i.e. the inverse DFT across the M branch filters u_p, which is the forward DFT read from
+     * bin -k. The branches of every output of the call are computed first (each a run of
+     * multiply adds over 2 * M contiguous reals per prototype row, which vectorizes), then all
+     * of them are transformed with one batched FFT.
+     */
+    int channelizer::process(const complex_t * samples, int count, const std::vector<complex_t *> & outputs, int * first)
+    {
+        const int M = m_channels;
+        int produced = (m_phase < count) ? (count - m_phase + M - 1) / M : 0;
+
+        m_buffer.resize(m_history + count);
+        if(count > 0) memcpy(&m_buffer[m_history], samples, count * sizeof(complex_t));
+
+        if(produced > 0)
+        {
+            if(m_branches.size() < produced * M) m_branches.resize(produced * M);
+            if(first != NULL) *first = m_phase;
+
+            const real_t * input = reinterpret_cast<const real_t *>(m_buffer.data());
+            std::vector<real_t> & acc = m_acc;
+            for(int o = 0; o < produced; o++)
+            {
+                int base = m_history + m_phase + o * M;
+                std::fill(acc.begin(), acc.end(), real_t(0));
+                for(int r = 0; r < m_taps_per_channel; r++)
+                {
+                    const real_t * taps = &m_taps[r * 2 * M];
+                    const real_t * x = input + 2 * (base - r * M - (M - 1));
+                    for(int q = 0; q < 2 * M; q++) acc[q] += taps[q] * x[q];
+                }
+
+                complex_t * branches = &m_branches[o * M];
+                for(int p = 0; p < M; p++) branches[p] = complex_t(acc[2 * (M - 1 - p)], acc[2 * (M - 1 - p) + 1]);
+            }
+
+            m_fft.forward_batch(m_branches.data(), produced);
+
+            for(int c = 0; c < M; c++)
+            {
+                complex_t * out = outputs[c];
+                int bin = m_bins[c];
+                for(int o = 0; o < produced; o++) out[o] = m_branches[o * M + bin];
+            }
+        }
+
+        // Keep the history for the next call
+        memmove(&m_buffer[0], &m_buffer[count], m_history * sizeof(complex_t));
+        m_buffer.resize(m_history);
+        m_phase = m_phase + produced * M - count;
+
+        return produced;
+    }
+}
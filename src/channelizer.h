@@ -0,0 +1,115 @@
+/*! \file channelizer.h
+ *  \brief Header file for the channelizer class.
+ *
+ *  The channelizer class splits one wideband stream of samples into adjacent, equally spaced
+ *  narrowband channels with a polyphase filter bank so that one capture can feed a receiver
+ *  chain per channel.
+ */
+
+#ifndef CHANNELIZER_H
+#define CHANNELIZER_H
+
+#include <vector>
+
+#include "precision.h"
+#include "fft.h"
+
+/*! \def CHANNELIZER_TAPS
+ *  \brief Default number of prototype filter taps per channel.
+ *
+ *  24 taps per channel give the Kaiser windowed prototype about 70 dB of stop band attenuation
+ *  with the transition band between the edge of the 52 occupied 802.11a subcarriers and the
+ *  point where the neighbouring channel starts to alias in.
+ */
+#define CHANNELIZER_TAPS 24
+
+namespace fun
+{
+    /*!
+     * \brief The channelizer class
+     *
+     *  A critically sampled polyphase analysis filter bank: the input at M times the channel
+     *  rate is split into M channels spaced by the channel rate, each decimated by M. Every
+     *  output sample of all M channels costs one M tap dot product per channel and one M point
+     *  FFT across the channels, instead of the M full length filters and mixers of tuning each
+     *  channel separately.
+     *
+     *  The prototype low pass filter is cut off halfway between channels. Since the output is
+     *  critically sampled the neighbouring channels alias into the outer edge of each channel,
+     *  which is fine for 802.11a where only 52 of the 64 subcarriers are occupied and the
+     *  prototype's transition band is placed in the unoccupied guard band.
+     *
+     *  Channel c is centered (c - M / 2) channel spacings away from the center of the input
+     *  (integer division, so channel M / 2 is the one in the middle).
+     */
+    class channelizer
+    {
+    public:
+
+        /*!
+         * \brief Constructor for channelizer.
+         * \param channels Number of channels M (also the decimation)
+         * \param taps_per_channel Length of the prototype filter divided by M
+         */
+        channelizer(int channels, int taps_per_channel = CHANNELIZER_TAPS);
+
+        /*!
+         * \brief Splits the next samples of the input stream into the channels.
+         * \param samples The next input samples
+         * \param count Number of input samples
+         * \param outputs One buffer per channel, each with room for max_outputs(count) samples
+         * \param first [Optional] Set to the index in samples of the input sample the first output
+         *  lines up with (before the filter's delay(), see delay()). Left alone if there is no output.
+         * \return The number of samples written to each channel's buffer
+         *
+         * The state is kept between calls so the input can be passed in chunks of any size.
+         */
+        int process(const complex_t * samples, int count, const std::vector<complex_t *> & outputs, int * first = NULL);
+
+        /*!
+         * \brief Gets the most output samples per channel that process() can produce.
+         * \param count Number of input samples
+         */
+        int max_outputs(int count) const { return count / m_channels + 1; }
+
+        /*!
+         * \brief Gets the delay of the prototype filter in input samples.
+         *
+         *  Output sample m holds what was on the air at input sample m * M - delay().
+         */
+        double delay() const { return (m_taps_per_channel * m_channels - 1) / 2.0; }
+
+        int channels() const { return m_channels; } //!< Gets the number of channels
+
+    private:
+
+        int m_channels; //!< Number of channels M
+
+        int m_taps_per_channel; //!< Prototype taps per channel P
+
+        int m_history; //!< Input samples kept between calls (M * P - 1)
+
+        int m_phase; //!< Index in the next input of the sample the next output lines up with
+
+        /*!
+         * \brief The prototype filter in polyphase order for the dot products.
+         *
+         *  Entry (r, q) is tap r * M + M - 1 - q of the prototype, duplicated for the real and
+         *  imaginary components, so the branches of one output are a straight run of multiply
+         *  adds over contiguous input samples. P rows of 2 * M.
+         */
+        std::vector<real_t> m_taps;
+
+        std::vector<complex_t> m_buffer; //!< The last #m_history input samples followed by the new input
+
+        std::vector<complex_t> m_branches; //!< The branch outputs of every output of a call, FFT'd in place
+
+        std::vector<real_t> m_acc; //!< The branch accumulators of one output (2 * M reals)
+
+        fft m_fft; //!< M point forward FFT batched over #m_branches
+
+        std::vector<int> m_bins; //!< FFT bin holding each channel
+    };
+}
+
+#endif // CHANNELIZER_H
@@ -0,0 +1,67 @@
+/*! \file crc32.cpp
+ *  \brief C++ file for the crc32 function.
+ *
+ *  The IEEE CRC-32 (the 802.11 FCS) appended to every payload by the ppdu on transmit
+ *  and checked on receive, computed 8 bytes at a time.
+ */
+
+#include <cstring>
+
+#include "crc32.h"
+
+namespace fun
+{
+    /*!
+     * \brief The slice-by-8 lookup tables.
+     *
+     * table[0] is the usual byte at a time table and table[k][b] is the CRC of byte b
+     * followed by k zero bytes, which is what lets 8 bytes be folded in with 8 independent
+     * lookups instead of 8 dependent ones.
+     */
+    struct crc32_tables
+    {
+        unsigned int table[8][256]; //!< The lookup tables
+
+        //! Builds the tables
+        crc32_tables()
+        {
+            for(int b = 0; b < 256; b++)
+            {
+                unsigned int crc = b;
+                for(int i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+                table[0][b] = crc;
+            }
+            for(int b = 0; b < 256; b++)
+            {
+                for(int k = 1; k < 8; k++) table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+            }
+        }
+    };
+
+    /*!
+     * The 8 byte steps read the data as two little endian words so on big endian machines
+     * every byte goes through the byte at a time loop instead.
+     */
+    unsigned int crc32(const unsigned char * data, int length)
+    {
+        static const crc32_tables tables;
+        const unsigned int (*t)[256] = tables.table;
+        unsigned int crc = 0xFFFFFFFF;
+        int x = 0;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        for(; x + 8 <= length; x += 8)
+        {
+            unsigned int lo, hi;
+            memcpy(&lo, data + x, 4);
+            memcpy(&hi, data + x + 4, 4);
+            lo ^= crc;
+            crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+                  t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        }
+#endif
+        for(; x < length; x++) crc = (crc >> 8) ^ t[0][(crc ^ data[x]) & 0xFF];
+
+        return crc ^ 0xFFFFFFFF;
+    }
+}
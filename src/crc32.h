@@ -0,0 +1,27 @@
+/*! \file crc32.h
+ *  \brief Header file for the crc32 function.
+ *
+ *  The IEEE CRC-32 (the 802.11 FCS) appended to every payload by the ppdu on transmit
+ *  and checked on receive, computed 8 bytes at a time.
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+namespace fun
+{
+    /*!
+     * \brief Computes the IEEE CRC-32 of the data.
+     *
+     * Identical to boost::crc_32_type (reflected polynomial 0xEDB88320, initial value and
+     * final XOR 0xFFFFFFFF) but uses the slice-by-8 algorithm so it processes 8 bytes per
+     * step instead of 1.
+     *
+     * \param data The data
+     * \param length Number of bytes
+     * \return The CRC-32 checksum
+     */
+    unsigned int crc32(const unsigned char * data, int length);
+}
+
+#endif // CRC32_H
@@ -6,9 +6,11 @@
  */
 
 #include <cstring>
+#include <cstdlib>
 #include <assert.h>
 
 #include "fft.h"
+#include "fft64.h"
 
 namespace fun
 {
@@ -23,20 +25,114 @@ namespace fun
       0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31
     };
 
+    std::map<std::pair<int, int>, fft::fft_plans> fft::m_plans;
+    std::mutex fft::m_plan_mutex;
+    std::string fft::m_wisdom_file;
+    bool fft::m_wisdom_chosen = false;
+
     /*!
      * -Initializations:
      *  + #m_fft_length -> 64 because we always deal with 64 point FFTs since there are 64 OFDM subcarriers
+     *  + #m_native -> true if the native backend was asked for and fft_length is 64
+     *  + #m_batch_stride -> batch_stride or fft_length if batch_stride is 0
+     *  + The plans -> The shared plans for fft_length & #m_batch_stride (see get_plans())
+     *
+     * The fftw3 plans are made for the native backend as well, they are shared with every other
+     * fft of the same size and keep every member valid no matter which backend runs.
      */
-    fft::fft(int fft_length) :
-        m_fft_length(fft_length)
+    fft::fft(int fft_length, int batch_stride, fft_backend backend) :
+        m_fft_length(fft_length),
+        m_native(backend == FFT_BACKEND_NATIVE && fft_length == 64),
+        m_batch_stride(batch_stride > 0 ? batch_stride : fft_length)
     {
         // Allocate the FFT buffers
-        m_fftw_in_forward = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * m_fft_length);
-        m_fftw_out_forward = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * m_fft_length);
-        m_fftw_in_inverse = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * m_fft_length);
-        m_fftw_out_inverse = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * m_fft_length);
-        m_fftw_plan_forward = fftw_plan_dft_1d(m_fft_length, m_fftw_in_forward, m_fftw_out_forward, FFTW_FORWARD, FFTW_MEASURE);
-        m_fftw_plan_inverse = fftw_plan_dft_1d(m_fft_length, m_fftw_in_inverse, m_fftw_out_inverse, FFTW_BACKWARD, FFTW_MEASURE);
+        m_fftw_in_forward = (FFTW(complex) *)FFTW(malloc)(sizeof(FFTW(complex)) * m_fft_length);
+        m_fftw_out_forward = (FFTW(complex) *)FFTW(malloc)(sizeof(FFTW(complex)) * m_fft_length);
+        m_fftw_in_inverse = (FFTW(complex) *)FFTW(malloc)(sizeof(FFTW(complex)) * m_fft_length);
+        m_fftw_out_inverse = (FFTW(complex) *)FFTW(malloc)(sizeof(FFTW(complex)) * m_fft_length);
+
+        const fft_plans & plans = get_plans(m_fft_length, m_batch_stride);
+        m_fftw_plan_forward = plans.forward;
+        m_fftw_plan_inverse = plans.inverse;
+        m_fftw_plan_batch = plans.batch;
+        m_fftw_plan_batch_single = plans.batch_single;
+    }
+
+    fft::fft(const fft & other) :
+        fft(other.m_fft_length, other.m_batch_stride, other.get_backend())
+    {
+    }
+
+    fft::~fft()
+    {
+        FFTW(free)(m_fftw_in_forward);
+        FFTW(free)(m_fftw_out_forward);
+        FFTW(free)(m_fftw_in_inverse);
+        FFTW(free)(m_fftw_out_inverse);
+    }
+
+    /*!
+     * Loading the wisdom only adds to what fftw3 already knows, so plans made before this call
+     * are kept as they are.
+     */
+    bool fft::use_wisdom_file(const std::string & filename)
+    {
+        std::lock_guard<std::mutex> lock(m_plan_mutex);
+        m_wisdom_file = filename;
+        m_wisdom_chosen = true;
+        if(filename.empty()) return false;
+        return FFTW(import_wisdom_from_filename)(filename.c_str()) != 0;
+    }
+
+    /*!
+     * The plans are made on scratch buffers allocated with fftw's allocator, which gives them
+     * the same alignment as every fft object's own buffers so the new array execute functions
+     * can run them on those. The batched plans are made with FFTW_UNALIGNED since they are
+     * executed directly on the caller's buffers which are not guaranteed to have the alignment
+     * fftw prefers. The wisdom file is rewritten after each new set of plans.
+     */
+    const fft::fft_plans & fft::get_plans(int fft_length, int batch_stride)
+    {
+        std::lock_guard<std::mutex> lock(m_plan_mutex);
+
+        if(!m_wisdom_chosen)
+        {
+            m_wisdom_chosen = true;
+            const char * env = std::getenv(FFT_WISDOM_ENV);
+            if(env != NULL && env[0] != 0)
+            {
+                m_wisdom_file = env;
+                FFTW(import_wisdom_from_filename)(env);
+            }
+        }
+
+        std::pair<int, int> key(fft_length, batch_stride);
+        std::map<std::pair<int, int>, fft_plans>::iterator it = m_plans.find(key);
+        if(it != m_plans.end()) return it->second;
+
+        fft_plans plans;
+        FFTW(complex) * in = (FFTW(complex) *)FFTW(malloc)(sizeof(FFTW(complex)) * fft_length);
+        FFTW(complex) * out = (FFTW(complex) *)FFTW(malloc)(sizeof(FFTW(complex)) * fft_length);
+        plans.forward = FFTW(plan_dft_1d)(fft_length, in, out, FFTW_FORWARD, FFTW_MEASURE);
+        plans.inverse = FFTW(plan_dft_1d)(fft_length, in, out, FFTW_BACKWARD, FFTW_MEASURE);
+        FFTW(free)(in);
+        FFTW(free)(out);
+
+        // Plan the batched forward FFTs on a scratch buffer (planning overwrites it)
+        FFTW(complex) * batch = (FFTW(complex) *)FFTW(malloc)(sizeof(FFTW(complex)) * batch_stride * FFT_BATCH_SIZE);
+        plans.batch = FFTW(plan_many_dft)(1, &fft_length, FFT_BATCH_SIZE,
+                                          batch, NULL, 1, batch_stride,
+                                          batch, NULL, 1, batch_stride,
+                                          FFTW_FORWARD, FFTW_MEASURE | FFTW_UNALIGNED);
+        plans.batch_single = FFTW(plan_many_dft)(1, &fft_length, 1,
+                                                 batch, NULL, 1, batch_stride,
+                                                 batch, NULL, 1, batch_stride,
+                                                 FFTW_FORWARD, FFTW_MEASURE | FFTW_UNALIGNED);
+        FFTW(free)(batch);
+
+        if(!m_wisdom_file.empty()) FFTW(export_wisdom_to_filename)(m_wisdom_file.c_str());
+
+        return m_plans[key] = plans;
     }
 
 
@@ -47,14 +143,45 @@ namespace fun
      * This function handles the shifting from all positive (0-63) indexing to
      * positive & negative frequency indexing.
      */
-    void fft::forward(std::complex<double> data[64])
+    void fft::forward(complex_t data[64])
     {
-        memcpy(m_fftw_in_forward, &data[0], m_fft_length * sizeof(std::complex<double>));
-        fftw_execute(m_fftw_plan_forward);
+        if(m_native)
+        {
+            fft64::forward(data, 1, 64, true);
+            return;
+        }
+
+        memcpy(m_fftw_in_forward, reinterpret_cast<FFTW(complex) *>(data), m_fft_length * sizeof(complex_t));
+        FFTW(execute_dft)(m_fftw_plan_forward, m_fftw_in_forward, m_fftw_out_forward);
 
         for(int s = 0; s < 64; s++)
         {
-            memcpy(&data[s], &m_fftw_out_forward[fft_map[s]], sizeof(std::complex<double>));
+            memcpy(reinterpret_cast<FFTW(complex) *>(&data[s]), &m_fftw_out_forward[fft_map[s]], sizeof(complex_t));
+        }
+    }
+
+    /*!
+     * This function runs the #FFT_BATCH_SIZE plan over as many full batches as possible
+     * and then the single symbol plan over whatever is left, all in place.
+     */
+    void fft::forward_batch(complex_t * data, int count)
+    {
+        if(m_native)
+        {
+            fft64::forward(data, count, m_batch_stride, false);
+            return;
+        }
+
+        FFTW(complex) * symbols = reinterpret_cast<FFTW(complex) *>(data);
+
+        int x = 0;
+        for(; x + FFT_BATCH_SIZE <= count; x += FFT_BATCH_SIZE)
+        {
+            FFTW(execute_dft)(m_fftw_plan_batch, symbols + x * m_batch_stride, symbols + x * m_batch_stride);
+        }
+        for(; x < count; x++)
+        {
+            FFTW(execute_dft)(m_fftw_plan_batch_single, symbols + x * m_batch_stride, symbols + x * m_batch_stride);
         }
     }
 
@@ -65,10 +192,16 @@ namespace fun
      * all positive (0 to 63) indexing.
      * This function also scales the output by 1/64 to be consistent with the IFFT function.
      */
-    void fft::inverse(std::vector<std::complex<double> > & data)
+    void fft::inverse(std::vector<complex_t > & data)
     {
         assert(data.size() % m_fft_length == 0);
 
+        if(m_native)
+        {
+            fft64::inverse(data.data(), data.size() / 64, 64, true);
+            return;
+        }
+
         // Run the IFFT on each m_fft_length samples
         for(int x = 0; x < data.size(); x += m_fft_length)
         {
@@ -76,16 +209,16 @@ namespace fun
             {
                 for(int s = 0; s < 64; s++)
                 {
-                    memcpy(&m_fftw_in_inverse[s], &data[x + fft_map[s]], sizeof(std::complex<double>));
+                    memcpy(&m_fftw_in_inverse[s], reinterpret_cast<FFTW(complex) *>(&data[x + fft_map[s]]), sizeof(complex_t));
                 }
             }
             else
             {
-                memcpy(&m_fftw_in_inverse[0], &data[x], m_fft_length * sizeof(std::complex<double>));
+                memcpy(&m_fftw_in_inverse[0], reinterpret_cast<FFTW(complex) *>(&data[x]), m_fft_length * sizeof(complex_t));
             }
 
-            fftw_execute(m_fftw_plan_inverse);
-            memcpy(&data[x], m_fftw_out_inverse, m_fft_length * sizeof(std::complex<double>));
+            FFTW(execute_dft)(m_fftw_plan_inverse, m_fftw_in_inverse, m_fftw_out_inverse);
+            memcpy(reinterpret_cast<FFTW(complex) *>(&data[x]), m_fftw_out_inverse, m_fft_length * sizeof(complex_t));
         }
 
         // Scale by 1/fft_length
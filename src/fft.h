@@ -11,9 +11,46 @@
 #include <complex>
 #include <fftw3.h>
 #include <vector>
+#include <string>
+#include <map>
+#include <utility>
+#include <mutex>
+
+#include "precision.h"
+
+/*! \def FFTW
+ *  \brief Selects the fftw3 function or type for the configured sample precision.
+ *
+ *  For example FFTW(plan) is fftw_plan in the default double precision build and
+ *  fftwf_plan when FUN_OFDM_SINGLE_PRECISION is defined.
+ */
+#ifdef FUN_OFDM_SINGLE_PRECISION
+#define FFTW(name) fftwf_ ## name
+#else
+#define FFTW(name) fftw_ ## name
+#endif
+
+/*! \def FFT_BATCH_SIZE
+ *  \brief Number of symbols transformed by each execution of the batched forward FFT plan.
+ */
+#define FFT_BATCH_SIZE 16
+
+/*! \def FFT_WISDOM_ENV
+ *  \brief Environment variable naming the FFTW wisdom file if fft::use_wisdom_file() is never called.
+ */
+#define FFT_WISDOM_ENV "FUN_OFDM_FFT_WISDOM"
 
 namespace fun
 {
+    /*!
+     * \brief The fft_backend enum selects the implementation behind an fft object.
+     */
+    enum fft_backend
+    {
+        FFT_BACKEND_FFTW,   //!< The fftw3 library (the default)
+        FFT_BACKEND_NATIVE  //!< The built in 64 point kernel (see fft64), falls back to fftw3 for any other length
+    };
+
     /*!
      * \brief The fft class
      *
@@ -29,15 +66,44 @@ namespace fun
         /*!
          * \brief Constructor for fft object
          * \param fft_length length of FFT - i.e. 64 point FFT
+         * \param batch_stride Distance in samples between consecutive symbols passed
+         *  to #forward_batch(). Defaults to fft_length (i.e. contiguous symbols).
+         * \param backend Implementation of the transforms.
          */
-        fft(int fft_length);
+        fft(int fft_length, int batch_stride = 0, fft_backend backend = FFT_BACKEND_FFTW);
+
+        /*!
+         * \brief Copy constructor for fft. The copy shares the plans but gets FFT buffers of its own.
+         * \param other The fft to copy
+         */
+        fft(const fft & other);
+
+        ~fft(); //!< Frees the FFT buffers (the plans are shared & live as long as the program)
+
+        /*!
+         * \brief Gets the implementation actually in use.
+         * \return #FFT_BACKEND_NATIVE if the built in kernel runs the transforms, otherwise #FFT_BACKEND_FFTW
+         */
+        fft_backend get_backend() const { return m_native ? FFT_BACKEND_NATIVE : FFT_BACKEND_FFTW; }
 
         /*!
          * \brief In place 64 point forward FFT.
          * \param data Array of 64 complex samples in time domain to be
          *  converted to frequency domain.
          */
-        void forward(std::complex<double> data[64]);
+        void forward(complex_t data[64]);
+
+        /*!
+         * \brief In place forward FFTs of many symbols at once.
+         * \param data Pointer to the first sample of the first symbol.
+         * \param count The number of symbols to transform.
+         *
+         * Symbol i starts at data + i * batch_stride (see #fft()). Unlike #forward()
+         * the output is not reordered, instead the caller is expected to have negated
+         * the odd numbered time domain samples of each symbol which shifts the output
+         * into positive & negative frequency order for free.
+         */
+        void forward_batch(complex_t * data, int count);
 
         /*!
          * \brief In place inverse FFT of input data.
@@ -45,10 +111,55 @@ namespace fun
          *  converted to time domain. The length of the data vector must
          *  be an integer multiple of #m_fft_length.
          */
-        void inverse(std::vector<std::complex<double> > & data);
+        void inverse(std::vector<complex_t > & data);
+
+        /*!
+         * \brief Sets the file FFTW wisdom is kept in.
+         * \param filename Path of the wisdom file. Empty to stop using a file.
+         * \return true if wisdom was loaded from the file, false if it doesn't exist (yet) or can't be read
+         *
+         * The wisdom in the file is loaded right away and the file is rewritten whenever a plan
+         * is made that the wisdom didn't already cover, so only the first run of a program
+         * on a machine pays for FFTW_MEASURE. Call it before the first fft is constructed
+         * (i.e. before any receiver or transmitter). If it is never called the file named by
+         * the #FFT_WISDOM_ENV environment variable (if set) is used instead.
+         */
+        static bool use_wisdom_file(const std::string & filename);
 
     private:
 
+        fft & operator=(const fft &);   //!< Not assignable since it owns the FFT buffers
+
+        /*!
+         * \brief The fftw3 plans for one fft length & batch stride, shared by every fft object with those sizes.
+         */
+        struct fft_plans
+        {
+            FFTW(plan) forward;         //!< Out of place forward FFT
+            FFTW(plan) inverse;         //!< Out of place inverse FFT
+            FFTW(plan) batch;           //!< In place forward FFT of #FFT_BATCH_SIZE strided symbols
+            FFTW(plan) batch_single;    //!< In place forward FFT of one symbol of a batch
+        };
+
+        /*!
+         * \brief Gets the plans for the given sizes, making them the first time they are asked for.
+         * \param fft_length Length of the FFT
+         * \param batch_stride Distance in samples between consecutive symbols of a batch
+         * \return The plans, which live as long as the program
+         *
+         * Thread safe. The plans are always executed with the new array functions of fftw3
+         * (i.e. on the caller's buffers), which fftw3 allows from any number of threads at once.
+         */
+        static const fft_plans & get_plans(int fft_length, int batch_stride);
+
+        static std::map<std::pair<int, int>, fft_plans> m_plans; //!< Plans made so far by (length, batch stride)
+
+        static std::mutex m_plan_mutex; //!< Serializes the fftw3 planner (which isn't thread safe) & protects #m_plans
+
+        static std::string m_wisdom_file; //!< The wisdom file or empty if there is none
+
+        static bool m_wisdom_chosen; //!< Whether the wisdom file has been picked (by use_wisdom_file() or #FFT_WISDOM_ENV)
+
         /*!
          * \brief Mapping to/from FFT order.
          */
@@ -60,35 +171,55 @@ namespace fun
          */
         int m_fft_length;        
 
+        /*!
+         * \brief Whether the transforms run on the built in fft64 kernel instead of fftw3.
+         */
+        bool m_native;
+
         /*!
          * \brief Forward input buffer for use by fftw3 library.
          */
-        fftw_complex * m_fftw_in_forward;
+        FFTW(complex) * m_fftw_in_forward;
 
         /*!
          * \brief Forward output buffer for use by fftw3 library.
          */
-        fftw_complex * m_fftw_out_forward;
+        FFTW(complex) * m_fftw_out_forward;
 
         /*!
          * \brief Inverse input buffer for use by fftw3 library.
          */
-        fftw_complex * m_fftw_in_inverse;
+        FFTW(complex) * m_fftw_in_inverse;
 
         /*!
          * \brief Inverse output buffer for use by fftw3 library.
          */
-        fftw_complex * m_fftw_out_inverse;
+        FFTW(complex) * m_fftw_out_inverse;
+
+        /*!
+         * \brief Forward FFT plan for use by fftw3 library (shared, see get_plans()).
+         */
+        FFTW(plan) m_fftw_plan_forward;
+
+        /*!
+         * \brief Inverse FFT plan for use by fftw3 library (shared, see get_plans()).
+         */
+        FFTW(plan) m_fftw_plan_inverse;
+
+        /*!
+         * \brief Distance in samples between consecutive symbols in #forward_batch().
+         */
+        int m_batch_stride;
 
         /*!
-         * \brief Forward FFT plan for use by fftw3 library.
+         * \brief In place forward FFT plan for #FFT_BATCH_SIZE strided symbols (shared, see get_plans()).
          */
-        fftw_plan m_fftw_plan_forward;
+        FFTW(plan) m_fftw_plan_batch;
 
         /*!
-         * \brief Inverse FFT plan for use by fftw3 library.
+         * \brief In place forward FFT plan for the leftover symbols of a batch (shared, see get_plans()).
          */
-        fftw_plan m_fftw_plan_inverse;
+        FFTW(plan) m_fftw_plan_batch_single;
     };
 }
 
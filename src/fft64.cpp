@@ -0,0 +1,162 @@
+/*! \file fft64.cpp
+ *  \brief C++ file for the fft64 class.
+ *
+ *  The fft64 class is the built in 64 point FFT & IFFT kernel behind the fft class's
+ *  #FFT_BACKEND_NATIVE backend. It is specialized for the 64 subcarriers of 802.11a.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include "fft64.h"
+
+namespace fun
+{
+    /*!
+     * \brief The twiddles and permutations of the 64 point kernel.
+     */
+    struct fft64_tables
+    {
+        real_t cos[64];     //!< cos(2 pi k / 64)
+        real_t sin[64];     //!< sin(2 pi k / 64)
+        int natural[64];    //!< Point k of the transform is left at natural[k] (base-4 digit reversal)
+        int shifted[64];    //!< Output sample s in positive & negative frequency order comes from shifted[s]
+        int identity[64];   //!< Loads the input in order
+        int unshift[64];    //!< Loads an input in positive & negative frequency order
+
+        /*!
+         * \brief Constructor for fft64_tables, fills in every table.
+         */
+        fft64_tables()
+        {
+            for(int k = 0; k < 64; k++)
+            {
+                cos[k] = std::cos(2 * M_PI * k / 64);
+                sin[k] = std::sin(2 * M_PI * k / 64);
+                natural[k] = 16 * (k & 3) + 4 * ((k >> 2) & 3) + (k >> 4);
+                identity[k] = k;
+                unshift[k] = (k + 32) & 63;
+            }
+            for(int s = 0; s < 64; s++) shifted[s] = natural[(s + 32) & 63];
+        }
+    };
+
+    /*!
+     * \brief The tables, built the first time they are needed.
+     */
+    static const fft64_tables & tables()
+    {
+        static const fft64_tables t;
+        return t;
+    }
+
+    /*!
+     * Each stage splits every block of L points into four interleaved blocks of L/4 with a
+     * radix-4 butterfly followed by the twiddles of that stage, so point k of the transform
+     * ends up at the base-4 digit reversal of k. The last stage (L = 4) has no twiddles.
+     * The only difference between the two directions is the sign of the imaginary unit.
+     */
+    template<bool INVERSE>
+    void fft64::transform(complex_t * data, int lanes, int stride, const int * in_map, const int * out_map, real_t scale)
+    {
+        const fft64_tables & t = tables();
+        const real_t sign = INVERSE ? 1 : -1;
+
+        alignas(32) real_t re[64 * FFT64_LANES];
+        alignas(32) real_t im[64 * FFT64_LANES];
+
+        // Transpose the symbols into the split arrays
+        for(int l = 0; l < lanes; l++)
+        {
+            const complex_t * symbol = data + l * stride;
+            for(int n = 0; n < 64; n++)
+            {
+                re[n * FFT64_LANES + l] = symbol[in_map[n]].real();
+                im[n * FFT64_LANES + l] = symbol[in_map[n]].imag();
+            }
+        }
+
+        for(int L = 64; L >= 4; L /= 4)
+        {
+            const int q = L / 4;
+            const int step = 64 / L;
+            for(int g = 0; g < 64; g += L)
+            {
+                for(int j = 0; j < q; j++)
+                {
+                    const real_t w1_re = t.cos[j * step], w1_im = sign * t.sin[j * step];
+                    const real_t w2_re = t.cos[2 * j * step], w2_im = sign * t.sin[2 * j * step];
+                    const real_t w3_re = t.cos[3 * j * step], w3_im = sign * t.sin[3 * j * step];
+
+                    real_t * a_re = &re[(g + j) * FFT64_LANES];
+                    real_t * a_im = &im[(g + j) * FFT64_LANES];
+                    real_t * b_re = a_re + q * FFT64_LANES;
+                    real_t * b_im = a_im + q * FFT64_LANES;
+                    real_t * c_re = b_re + q * FFT64_LANES;
+                    real_t * c_im = b_im + q * FFT64_LANES;
+                    real_t * d_re = c_re + q * FFT64_LANES;
+                    real_t * d_im = c_im + q * FFT64_LANES;
+
+                    for(int l = 0; l < FFT64_LANES; l++)
+                    {
+                        real_t t0_re = a_re[l] + c_re[l], t0_im = a_im[l] + c_im[l];
+                        real_t t1_re = a_re[l] - c_re[l], t1_im = a_im[l] - c_im[l];
+                        real_t t2_re = b_re[l] + d_re[l], t2_im = b_im[l] + d_im[l];
+
+                        // (b - d) times -i (forward) or i (inverse)
+                        real_t t3_re = -sign * (b_im[l] - d_im[l]);
+                        real_t t3_im = sign * (b_re[l] - d_re[l]);
+
+                        real_t y1_re = t1_re + t3_re, y1_im = t1_im + t3_im;
+                        real_t y2_re = t0_re - t2_re, y2_im = t0_im - t2_im;
+                        real_t y3_re = t1_re - t3_re, y3_im = t1_im - t3_im;
+
+                        a_re[l] = t0_re + t2_re;
+                        a_im[l] = t0_im + t2_im;
+                        b_re[l] = y1_re * w1_re - y1_im * w1_im;
+                        b_im[l] = y1_re * w1_im + y1_im * w1_re;
+                        c_re[l] = y2_re * w2_re - y2_im * w2_im;
+                        c_im[l] = y2_re * w2_im + y2_im * w2_re;
+                        d_re[l] = y3_re * w3_re - y3_im * w3_im;
+                        d_im[l] = y3_re * w3_im + y3_im * w3_re;
+                    }
+                }
+            }
+        }
+
+        // Transpose back undoing the digit reversal (and shifting)
+        for(int l = 0; l < lanes; l++)
+        {
+            complex_t * symbol = data + l * stride;
+            for(int k = 0; k < 64; k++)
+            {
+                int p = out_map[k] * FFT64_LANES + l;
+                symbol[k] = complex_t(re[p] * scale, im[p] * scale);
+            }
+        }
+    }
+
+    /*!
+     * The butterflies always run over all #FFT64_LANES lanes, a short batch at the end just
+     * leaves the unused lanes holding whatever they held.
+     */
+    void fft64::forward(complex_t * data, int count, int stride, bool shift)
+    {
+        const fft64_tables & t = tables();
+        const int * out_map = shift ? t.shifted : t.natural;
+        for(int x = 0; x < count; x += FFT64_LANES)
+        {
+            transform<false>(data + x * stride, std::min(FFT64_LANES, count - x), stride, t.identity, out_map, 1);
+        }
+    }
+
+    void fft64::inverse(complex_t * data, int count, int stride, bool shift)
+    {
+        const fft64_tables & t = tables();
+        const int * in_map = shift ? t.unshift : t.identity;
+        for(int x = 0; x < count; x += FFT64_LANES)
+        {
+            transform<true>(data + x * stride, std::min(FFT64_LANES, count - x), stride, in_map, t.natural, 1.0 / 64);
+        }
+    }
+}
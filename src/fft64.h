@@ -0,0 +1,71 @@
+/*! \file fft64.h
+ *  \brief Header file for the fft64 class.
+ *
+ *  The fft64 class is the built in 64 point FFT & IFFT kernel behind the fft class's
+ *  #FFT_BACKEND_NATIVE backend. It is specialized for the 64 subcarriers of 802.11a.
+ */
+
+#ifndef FFT64_H
+#define FFT64_H
+
+#include "precision.h"
+
+/*! \def FFT64_LANES
+ *  \brief Number of symbols the fft64 kernel transforms side by side.
+ *
+ *  The butterflies work on this many symbols at once with the symbols in the innermost
+ *  loop, so each butterfly is a straight line of vector operations across the symbols.
+ */
+#define FFT64_LANES 8
+
+namespace fun
+{
+    /*!
+     * \brief The fft64 class
+     *
+     * A radix-4 decimation in frequency FFT over 64 points (three radix-4 stages). The
+     * symbols are transposed into split real & imaginary arrays on the way in so the
+     * butterflies vectorize across #FFT64_LANES symbols, and the base-4 digit reversal of
+     * the output is folded into the permutation that transposes them back together with the
+     * fftshift (if any).
+     */
+    class fft64
+    {
+    public:
+
+        /*!
+         * \brief In place forward FFTs of many symbols.
+         * \param data Pointer to the first sample of the first symbol
+         * \param count Number of symbols
+         * \param stride Distance in samples between consecutive symbols
+         * \param shift Whether to reorder the output into positive & negative frequency order
+         *  (like fft::forward()) instead of leaving it in natural order (like fft::forward_batch())
+         */
+        static void forward(complex_t * data, int count, int stride, bool shift);
+
+        /*!
+         * \brief In place inverse FFTs of many symbols, scaled by 1/64.
+         * \param data Pointer to the first sample of the first symbol
+         * \param count Number of symbols
+         * \param stride Distance in samples between consecutive symbols
+         * \param shift Whether the input is in positive & negative frequency order (like fft::inverse())
+         */
+        static void inverse(complex_t * data, int count, int stride, bool shift);
+
+    private:
+
+        /*!
+         * \brief Transforms up to #FFT64_LANES symbols.
+         * \param data Pointer to the first sample of the first symbol
+         * \param lanes Number of symbols (at most #FFT64_LANES)
+         * \param stride Distance in samples between consecutive symbols
+         * \param in_map in_map[n] is the input sample loaded into point n
+         * \param out_map out_map[k] is the point stored into output sample k
+         * \param scale Scale applied to the output
+         */
+        template<bool INVERSE>
+        static void transform(complex_t * data, int lanes, int stride, const int * in_map, const int * out_map, real_t scale);
+    };
+}
+
+#endif // FFT64_H
@@ -10,47 +10,91 @@
 
 #include "fft.h"
 #include "fft_symbols.h"
+#include "timing_sync.h"
 
 namespace fun
 {
     /*!
      * - Initializations:
      *   + #m_offset -> 0
-     *   + #m_ffft -> Instance of 64 point forward fft class
+     *   + #m_ffft -> Instance of 64 point forward fft class batched over the output buffer using the given backend
+     *   + #m_sample_count -> 0
+     *   + #m_gate_log -> gate_log
+     *   + #m_max_symbols -> max_symbols
+     *   + #m_frame_symbols -> max_symbols, i.e. dropping samples until the first #LTS1 if there is a limit
+     *   + #m_window -> Window starting at the first sample (i.e. no gating)
      */
-    fft_symbols::fft_symbols() :
-        block("fft_symbols"),
+    fft_symbols::fft_symbols(spsc_queue<gate_window> * gate_log, fft_backend backend, int max_symbols) :
+        block("fft_symbols", 1, 80 /* one symbol per 80 samples */),
         m_offset(0),
-        m_ffft(64)
+        m_ffft(64, sizeof(tagged_vector<64>) / sizeof(complex_t), backend),
+        m_sample_count(0),
+        m_max_symbols(max_symbols),
+        m_frame_symbols(max_symbols),
+        m_gate_log(gate_log),
+        m_has_next_window(false)
     {
+        static_assert(sizeof(tagged_vector<64>) % sizeof(complex_t) == 0,
+                      "tagged_vector<64> must be a whole number of samples for the batched FFT");
     }
 
     /*!
      * This block removes the cyclic prefix and vectorizes the samples into 64 sample symbols
      * based on the tags marking the frame boundaries. It then performs a  64 point forward
      * fft on each symbol to convert it from time domain to frequency domain.
+     *
+     * The odd numbered samples of each symbol are negated as they are copied in, which is
+     * equivalent to fftshifting the output of the FFT. All of the symbols are then
+     * transformed in place in the output buffer with a single batched call.
+     *
+     * The first LTS symbol of each frame is also stamped with the index of the frame's first
+     * sample. The timing_sync block delays the samples by #CARRYOVER_LENGTH and marks #LTS1
+     * 24 samples into the LTS which itself follows the 160 sample STS. If the frame_detector is
+     * gated its gate windows are used to map the position back to the original sample index.
+     *
+     * With a limit on the symbols per frame the samples are skipped outright once a frame has
+     * had its symbols. A symbol is always completed before the limit applies, so the block is
+     * left at the start of a symbol ready for the next #LTS1.
      */
     void fft_symbols::work()
     {
-        if(input_buffer.size() == 0) return;
         output_buffer.resize(0);
+        if(input_buffer.size() == 0) return;
+
+        process(&input_buffer[0], input_buffer.size(), input_tags, output_buffer);
+    }
+
+    void fft_symbols::process(const complex_t * input, int count, const std::vector<stream_tag> & tags,
+                              std::vector<tagged_vector<64> > & output)
+    {
+        int first = output.size();
 
         // Step through the input samples
-        for(int x = 0; x < input_buffer.size(); x++)
+        int t = 0;
+        for(int x = 0; x < count; x++)
         {
+            vector_tag tag = NONE;
+            if(t < tags.size() && tags[t].offset == x) tag = tags[t++].tag;
+
             // Check if this is the start of a new frame
-            if(input_buffer[x].tag == LTS1)
+            if(tag == LTS1)
             {
                 // Push the current vector to the output buffer if
                 // we've written any data to it
-                if(m_offset > 15) output_buffer.push_back(m_current_vector);
+                if(m_offset > 15) output.push_back(m_current_vector);
 
                 // Start a new vector
                 m_current_vector.tag = LTS_START;
+                m_current_vector.sample_index = input_index(m_sample_count + x - CARRYOVER_LENGTH) - 24 - 160;
+                m_current_vector.quality = tags[t - 1].quality;
                 m_offset = 16;
+                m_frame_symbols = 0;
             }
 
-            if(input_buffer[x].tag == LTS2)
+            // Drop the rest of a frame that has had all its symbols
+            if(m_max_symbols > 0 && m_frame_symbols >= m_max_symbols) continue;
+
+            if(tag == LTS2)
             {
                 m_offset = 16;
             }
@@ -58,26 +102,42 @@ namespace fun
             // Copy over samples past the cyclic prefix
             if(m_offset > 15)
             {
-                m_current_vector.samples[m_offset - 16] = input_buffer[x].sample;
+                if(m_offset & 1) m_current_vector.samples[m_offset - 16] = -input[x];
+                else m_current_vector.samples[m_offset - 16] = input[x];
             }
 
             // Increment the offset and reset if we're at the end of the symbol
             m_offset++;
             if(m_offset == 80)
             {
-                output_buffer.push_back(m_current_vector);
+                output.push_back(m_current_vector);
                 m_current_vector.tag = NONE;
                 m_offset = 0;
+                m_frame_symbols++;
             }
         }
+        m_sample_count += count;
 
         // Perform forward FFT
-        for(int x = 0; x < output_buffer.size(); x++)
+        if(output.size() > first)
         {
-            m_ffft.forward(output_buffer[x].samples);
+            m_ffft.forward_batch(output[first].samples, output.size() - first);
+        }
+    }
 
+    /*!
+     * Gate windows are consumed in order as the samples they start at come through, they are
+     * pushed (by the frame_detector) well before that.
+     */
+    unsigned long long fft_symbols::input_index(unsigned long long position)
+    {
+        while(m_gate_log != NULL)
+        {
+            if(!m_has_next_window) m_has_next_window = m_gate_log->pop(m_next_window);
+            if(!m_has_next_window || m_next_window.gated_start > position) break;
+            m_window = m_next_window;
+            m_has_next_window = false;
         }
+        return m_window.raw_start + (position - m_window.gated_start);
     }
 }
-
-
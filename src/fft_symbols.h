@@ -16,27 +16,51 @@
 #include "tagged_vector.h"
 #include "block.h"
 #include "fft.h"
+#include "frame_detector.h"
 
 namespace fun
 {
     /*!
      * \brief The fft_symbols block.
      *
-     * Inputs tagged_samples from timing_sync block (time domain samples).
+     * Inputs samples & their tags from timing_sync block (time domain samples).
      * Outputs tagged_vectors to channel estimator block (frequency domain samples).
      *
      * This FFT Symbols aligns the input samples into symbols, chops off the cyclic prefixes,
      * and performs a forward FFT on vectorized samples to convert them from time domain
      * to frequency domain symbols.
      */
-    class fft_symbols : public fun::block<tagged_sample, tagged_vector<64> >
+    class fft_symbols : public fun::block<complex_t, tagged_vector<64> >
     {
     public:
 
-        fft_symbols(); //!< Constructor for fft_symbols block.
+        /*!
+         * \brief Constructor for fft_symbols block.
+         * \param gate_log [Optional] The queue a gated frame_detector pushes its gate windows into.
+         *  Must be set if the frame_detector is gated so that tagged_vector::sample_index stays correct.
+         * \param backend [Optional] Implementation of the forward FFT (see fft_backend).
+         * \param max_symbols [Optional] Most symbols output per frame counting from its first LTS symbol
+         *  (e.g. 3 for the two LTS symbols and the SIGNAL symbol). The samples after them are dropped
+         *  until the next #LTS1 tag, so neither this block nor the ones after it spend anything on the
+         *  data symbols or on the noise between frames. 0 (the default) for every symbol.
+         */
+        fft_symbols(spsc_queue<gate_window> * gate_log = NULL, fft_backend backend = FFT_BACKEND_FFTW, int max_symbols = 0);
 
         virtual void work(); //!< Signal processing happens here.
 
+        /*!
+         * \brief Does what work() does to the given samples instead of the input_buffer.
+         * \param input The samples
+         * \param count Number of samples
+         * \param tags The tags on the samples (offsets relative to input)
+         * \param output The symbols completed by these samples are appended to this vector
+         *
+         * The samples must follow on from the ones passed in by the previous call (or work()).
+         * This lets the freq_domain block run the block on a slice of its input at a time.
+         */
+        void process(const complex_t * input, int count, const std::vector<stream_tag> & tags,
+                     std::vector<tagged_vector<64> > & output);
+
     private:
 
         /*!
@@ -53,6 +77,30 @@ namespace fun
          * \brief Forward FFT
          */
         fft m_ffft;
+
+        /*!
+         * \brief Number of samples input to this block before the current work() call
+         */
+        unsigned long long m_sample_count;
+
+        int m_max_symbols; //!< Most symbols output per frame, 0 for no limit (see fft_symbols())
+
+        int m_frame_symbols; //!< Symbols output since the last #LTS1 tag
+
+        /*!
+         * \brief Maps a position in the frame_detector's output to the index of the sample in its input.
+         * \param position Index of a sample in the frame_detector's output
+         * \return Index of the sample in the frame_detector's input
+         */
+        unsigned long long input_index(unsigned long long position);
+
+        spsc_queue<gate_window> * m_gate_log; //!< The gate windows of a gated frame_detector (or NULL)
+
+        gate_window m_window; //!< The latest gate window that started at or before the current sample
+
+        gate_window m_next_window; //!< The next gate window if #m_has_next_window
+
+        bool m_has_next_window; //!< Whether #m_next_window has been popped from #m_gate_log already
     };
 }
 
@@ -0,0 +1,94 @@
+/*! \file frame_arena.cpp
+ *  \brief C++ file for the frame_arena class.
+ *
+ *  The frame_arena is a bump allocator for the scratch buffers needed to decode one frame
+ *  (soft bits, decoded bytes, ...). Everything allocated from it is released at once by
+ *  reset() at the start of the next frame, so after the first few frames decoding a frame
+ *  doesn't touch the heap at all.
+ */
+
+#include <cstdlib>
+
+#include "frame_arena.h"
+
+namespace fun
+{
+    //! Rounds a size up to a multiple of 16 bytes
+    static size_t round_up(size_t bytes)
+    {
+        return (bytes + 15) & ~size_t(15);
+    }
+
+    //! Allocates a 16 byte aligned block, NULL on failure
+    static unsigned char * allocate_block(size_t bytes)
+    {
+        void * p;
+        if(posix_memalign(&p, 16, bytes)) return NULL;
+        return static_cast<unsigned char *>(p);
+    }
+
+    /*!
+     * - Initializations:
+     *   + #m_block -> size bytes (rounded up to a multiple of 16)
+     */
+    frame_arena::frame_arena(size_t size) :
+        m_block(NULL),
+        m_size(round_up(size)),
+        m_used(0),
+        m_overflow_bytes(0)
+    {
+        if(m_size > 0) m_block = allocate_block(m_size);
+        if(m_block == NULL) m_size = 0;
+        m_overflow.reserve(8);
+    }
+
+    frame_arena::~frame_arena()
+    {
+        for(int x = 0; x < m_overflow.size(); x++) free(m_overflow[x]);
+        free(m_block);
+    }
+
+    void * frame_arena::allocate_bytes(size_t bytes)
+    {
+        bytes = round_up(bytes > 0 ? bytes : 1);
+        if(m_used + bytes <= m_size)
+        {
+            void * p = m_block + m_used;
+            m_used += bytes;
+            return p;
+        }
+
+        unsigned char * p = allocate_block(bytes);
+        m_overflow.push_back(p);
+        m_overflow_bytes += bytes;
+        return p;
+    }
+
+    /*!
+     * If the previous frame overflowed the block it is replaced with one that would have held
+     * all of that frame's allocations.
+     */
+    void frame_arena::reset()
+    {
+        if(!m_overflow.empty())
+        {
+            for(int x = 0; x < m_overflow.size(); x++) free(m_overflow[x]);
+            m_overflow.clear();
+
+            size_t size = m_size + m_overflow_bytes;
+            unsigned char * block = allocate_block(size);
+            if(block != NULL)
+            {
+                free(m_block);
+                m_block = block;
+                m_size = size;
+            }
+            m_overflow_bytes = 0;
+        }
+        m_used = 0;
+    }
+
+    size_t frame_arena::capacity() { return m_size; }
+
+    size_t frame_arena::used() { return m_used + m_overflow_bytes; }
+}
@@ -0,0 +1,87 @@
+/*! \file frame_arena.h
+ *  \brief Header file for the frame_arena class.
+ *
+ *  The frame_arena is a bump allocator for the scratch buffers needed to decode one frame
+ *  (soft bits, decoded bytes, ...). Everything allocated from it is released at once by
+ *  reset() at the start of the next frame, so after the first few frames decoding a frame
+ *  doesn't touch the heap at all.
+ */
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+/*! \def FRAME_ARENA_SIZE
+ *  \brief Default initial capacity of a frame_arena in bytes.
+ *
+ *  Enough for the scratch buffers of a #MAX_FRAME_SIZE frame at any rate.
+ */
+#define FRAME_ARENA_SIZE 131072
+
+namespace fun
+{
+    /*!
+     * \brief The frame_arena class.
+     *
+     *  Allocations are carved out of one block, 16 byte aligned. If a frame needs more than
+     *  the block holds the extra allocations get their own overflow blocks, and the next reset()
+     *  replaces the block with one large enough for everything that frame needed so the arena
+     *  only ever grows to the size of the largest frame.
+     */
+    class frame_arena
+    {
+    public:
+
+        /*!
+         * \brief Constructor for frame_arena
+         * \param size Initial capacity in bytes
+         */
+        frame_arena(size_t size = FRAME_ARENA_SIZE);
+
+        ~frame_arena(); //!< Frees the block and any overflow blocks
+
+        /*!
+         * \brief Allocates an uninitialized 16 byte aligned buffer that lives until the next reset().
+         * \param count Number of items
+         * \return The buffer
+         */
+        template<typename T>
+        T * allocate(size_t count)
+        {
+            return static_cast<T *>(allocate_bytes(count * sizeof(T)));
+        }
+
+        /*!
+         * \brief Releases everything allocated since the previous reset().
+         */
+        void reset();
+
+        size_t capacity(); //!< Size of the block in bytes
+
+        size_t used(); //!< Bytes allocated since the previous reset() (including overflow blocks)
+
+    private:
+
+        frame_arena(const frame_arena &);               //!< Not copyable
+        frame_arena & operator=(const frame_arena &);   //!< Not copyable
+
+        /*!
+         * \brief Allocates bytes from the block or an overflow block.
+         */
+        void * allocate_bytes(size_t bytes);
+
+        unsigned char * m_block; //!< The block, NULL if its size is 0
+
+        size_t m_size; //!< Size of #m_block in bytes
+
+        size_t m_used; //!< Bytes of #m_block in use
+
+        size_t m_overflow_bytes; //!< Bytes in #m_overflow
+
+        std::vector<unsigned char *> m_overflow; //!< Overflow blocks allocated since the previous reset()
+    };
+}
+
+#endif // FRAME_ARENA_H
@@ -12,8 +12,8 @@
  * so that it can be passed to the USRP for transmission.
  */
 
+#include <cstring>
 #include <arpa/inet.h>
-#include <boost/crc.hpp>
 
 #include "frame_builder.h"
 #include "interleaver.h"
@@ -27,6 +27,7 @@
 #include "parity.h"
 #include "modulator.h"
 #include "puncturer.h"
+#include "thread_config.h"
 
 
 #define preamble_length 256 //!< Not cyclic prefixed at this point yet
@@ -35,11 +36,50 @@ namespace fun
 {
     /*!
     * -Initializations
-    *  + #m_ifft -> 64 point IFFT object
+    *  + #m_ifft -> 64 point IFFT object using the given backend
+    *  + #m_cache_size -> cache_size encoded frames
+    *  + #m_pool -> build_threads build worker threads or NULL if build_threads is 0
+    *
+    * Each worker's frame_builder is made here on the constructing thread, they all share
+    * the same IFFT plans (see fft::get_plans()).
     */
-    frame_builder::frame_builder() :
-        m_ifft(64)
+    frame_builder::frame_builder(int cache_size, int build_threads, fft_backend backend) :
+        m_ifft(64, 0, backend),
+        m_cache_size(cache_size),
+        m_pool(NULL)
     {
+        m_payload.reserve(MAX_FRAME_SIZE);
+        if(build_threads <= 0) return;
+
+        m_pool = new build_pool();
+        m_pool->batch = NULL;
+        m_pool->frames = NULL;
+        m_pool->rate = RATE_1_2_BPSK;
+        m_pool->next_frame = 0;
+        m_pool->batch_count = 0;
+        m_pool->busy_workers = 0;
+        m_pool->stop = false;
+        for(int x = 0; x < build_threads; x++)
+        {
+            m_pool->builders.push_back(new frame_builder(cache_size, 0, backend));
+        }
+        for(int x = 0; x < build_threads; x++)
+        {
+            m_pool->workers.push_back(std::thread(&frame_builder::build_worker, this, m_pool->builders[x]));
+        }
+    }
+
+    frame_builder::~frame_builder()
+    {
+        if(m_pool == NULL) return;
+        {
+            std::lock_guard<std::mutex> lock(m_pool->mutex);
+            m_pool->stop = true;
+        }
+        m_pool->batch_cond.notify_all();
+        for(int x = 0; x < m_pool->workers.size(); x++) m_pool->workers[x].join();
+        for(int x = 0; x < m_pool->builders.size(); x++) delete m_pool->builders[x];
+        delete m_pool;
     }
 
     /*!
@@ -50,35 +90,178 @@ namespace fun
      * and IFFT (go figure). The cyclic prefixes are added and finally the preamble is prepended to
      * complete the frame which is then returned to be passed to the usrp block.
      */
-    std::vector<std::complex<double> > frame_builder::build_frame(std::vector<unsigned char> payload, Rate rate)
+    std::vector<complex_t > frame_builder::build_frame(std::vector<unsigned char> payload, Rate rate)
+    {
+        std::vector<complex_t > frame(frame_length(payload.size(), rate));
+        build_frame(payload.data(), payload.size(), rate, frame.data());
+        return frame;
+    }
+
+    /*!
+     * The frame cache is keyed by a 64 bit FNV-1a hash of the payload and the rate and
+     * is kept in least recently used order. A hit is confirmed by comparing the payloads
+     * so a hash collision can never send the wrong frame. On a miss the frame is encoded
+     * straight into the caller's buffer and then copied into the cache.
+     */
+    int frame_builder::build_frame(const unsigned char * payload, int length, Rate rate, complex_t * frame, bool preamble_written)
+    {
+        int symbols_length = frame_length(length, rate) - PREAMBLE_LENGTH;
+        if(!preamble_written) write_preamble(frame);
+        complex_t * out = frame + PREAMBLE_LENGTH;
+
+        if(m_cache_size <= 0)
+        {
+            m_payload.assign(payload, payload + length);
+            encode_symbols(m_payload, rate, out);
+            return symbols_length + PREAMBLE_LENGTH;
+        }
+
+        // Hash the payload
+        unsigned long long hash = 14695981039346656037ULL;
+        for(int x = 0; x < length; x++) hash = (hash ^ payload[x]) * 1099511628211ULL;
+
+        // Look for it in the cache
+        for(std::list<frame_cache_entry>::iterator it = m_cache.begin(); it != m_cache.end(); it++)
+        {
+            if(it->hash != hash || it->rate != rate || it->payload.size() != length) continue;
+            if(length != 0 && memcmp(it->payload.data(), payload, length) != 0) continue;
+
+            memcpy(out, it->samples.data(), symbols_length * sizeof(complex_t));
+            m_cache.splice(m_cache.begin(), m_cache, it);
+            return symbols_length + PREAMBLE_LENGTH;
+        }
+
+        // Encode it and add it to the cache reusing the least recently used entry's buffers
+        m_payload.assign(payload, payload + length);
+        encode_symbols(m_payload, rate, out);
+
+        if(m_cache.size() < m_cache_size) m_cache.push_front(frame_cache_entry());
+        else m_cache.splice(m_cache.begin(), m_cache, --m_cache.end());
+        frame_cache_entry & entry = m_cache.front();
+        entry.hash = hash;
+        entry.rate = rate;
+        entry.payload.swap(m_payload);
+        entry.samples.assign(out, out + symbols_length);
+
+        return symbols_length + PREAMBLE_LENGTH;
+    }
+
+    /*!
+     * The calling thread builds frames alongside the workers. The payloads are handed out one at
+     * a time through build_pool::next_frame so a worker that gets short payloads simply builds more of
+     * them, and every frame is built straight into its slot of the result so the frames come out
+     * in order without any reordering.
+     */
+    std::vector<std::vector<complex_t > > frame_builder::build_frames(const std::vector<std::vector<unsigned char> > & batch, Rate rate)
+    {
+        std::vector<std::vector<complex_t > > frames(batch.size());
+        if(m_pool == NULL || batch.size() < 2)
+        {
+            for(int x = 0; x < batch.size(); x++)
+            {
+                frames[x].resize(frame_length(batch[x].size(), rate));
+                build_frame(batch[x].data(), batch[x].size(), rate, frames[x].data());
+            }
+            return frames;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_pool->mutex);
+            m_pool->batch = &batch;
+            m_pool->frames = &frames;
+            m_pool->rate = rate;
+            m_pool->next_frame = 0;
+            m_pool->busy_workers = m_pool->workers.size();
+            m_pool->batch_count++;
+        }
+        m_pool->batch_cond.notify_all();
+
+        build_batch(this);
+
+        std::unique_lock<std::mutex> lock(m_pool->mutex);
+        while(m_pool->busy_workers > 0) m_pool->done_cond.wait(lock);
+        return frames;
+    }
+
+    void frame_builder::build_batch(frame_builder * builder)
+    {
+        const std::vector<std::vector<unsigned char> > & batch = *m_pool->batch;
+        std::vector<std::vector<complex_t > > & frames = *m_pool->frames;
+        while(true)
+        {
+            int x = m_pool->next_frame++;
+            if(x >= batch.size()) return;
+
+            frames[x].resize(frame_length(batch[x].size(), m_pool->rate));
+            builder->build_frame(batch[x].data(), batch[x].size(), m_pool->rate, frames[x].data());
+        }
+    }
+
+    /*!
+     * Each worker owns its own frame_builder so the workers never share any state besides
+     * the current batch, and each frame of the result is only ever written by one thread.
+     */
+    void frame_builder::build_worker(frame_builder * builder)
+    {
+        configure_thread("fun_build");
+        unsigned long long batches = 0;
+        while(true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_pool->mutex);
+                while(m_pool->batch_count == batches && !m_pool->stop) m_pool->batch_cond.wait(lock);
+                if(m_pool->stop) return;
+                batches = m_pool->batch_count;
+            }
+
+            build_batch(builder);
+
+            {
+                std::lock_guard<std::mutex> lock(m_pool->mutex);
+                m_pool->busy_workers--;
+            }
+            m_pool->done_cond.notify_all();
+        }
+    }
+
+    /*!
+     * Each OFDM symbol is 64 samples plus a 16 sample cyclic prefix and there is one symbol for
+     * the header plus enough symbols to carry the service field, payload, CRC and tail bits.
+     */
+    int frame_builder::frame_length(int length, Rate rate)
+    {
+        RateParams rate_params = RateParams(rate);
+        int num_symbols = (16 /* service */ + 8 * (length + 4 /* CRC */) + 6 /* tail */ + rate_params.dbps - 1) / rate_params.dbps;
+        return PREAMBLE_LENGTH + (num_symbols + 1 /* header */) * 80;
+    }
+
+    void frame_builder::write_preamble(complex_t * frame)
+    {
+        memcpy(frame, &PREAMBLE_SAMPLES[0], PREAMBLE_LENGTH * sizeof(complex_t));
+    }
+
+    /*!
+     * The cyclic prefixes are copied straight into the output buffer as each symbol is
+     * laid out instead of building a separate prefixed copy of the frame.
+     */
+    void frame_builder::encode_symbols(const std::vector<unsigned char> & payload, Rate rate, complex_t * out)
     {
         //Append header, scramble, code, interleave, & modulate
-        ppdu ppdu_frame(payload, rate);        
-        std::vector<std::complex<double> > samples = ppdu_frame.encode();
+        ppdu ppdu_frame(payload, rate);
+        std::vector<complex_t > samples = ppdu_frame.encode();
 
         // Map the subcarriers and insert pilots
         symbol_mapper mapper = symbol_mapper();
-        std::vector<std::complex<double> > mapped = mapper.map(samples);
+        std::vector<complex_t > mapped = mapper.map(samples);
 
         // Perform the IFFT
         m_ifft.inverse(mapped);
 
         // Add the cyclic prefixes
-        std::vector<std::complex<double> > prefixed(mapped.size() * 80 / 64);
         for(int x = 0; x < mapped.size() / 64; x++)
         {
-            memcpy(&prefixed[x*80], &mapped[x*64+48], 16*sizeof(std::complex<double>));
-            memcpy(&prefixed[x*80+16], &mapped[x*64], 64*sizeof(std::complex<double>));
+            memcpy(&out[x*80], &mapped[x*64+48], 16*sizeof(complex_t));
+            memcpy(&out[x*80+16], &mapped[x*64], 64*sizeof(complex_t));
         }
-
-        // Prepend the preamble
-        std::vector<std::complex<double> > frame(prefixed.size() + 320);
-
-        memcpy(&frame[0], &PREAMBLE_SAMPLES[0], 320 * sizeof(std::complex<double>));
-        memcpy(&frame[320], &prefixed[0], prefixed.size() * sizeof(std::complex<double>));
-
-        // Return the samples
-        return frame;
     }
 }
-
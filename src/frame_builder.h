@@ -18,9 +18,26 @@
 
 #include <vector>
 #include <complex>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include "fft.h"
 #include "rates.h"
+#include "precision.h"
+
+/*! \def FRAME_CACHE_SIZE
+ *  \brief Suggested number of encoded frames for the frame_builder's frame cache when it is
+ *  turned on, i.e. by callers that send the same payloads over and over.
+ */
+#define FRAME_CACHE_SIZE 8
+
+/*! \def PREAMBLE_LENGTH
+ *  \brief Number of samples in the preamble at the start of every frame.
+ */
+#define PREAMBLE_LENGTH 320
 
 namespace fun
 {
@@ -49,8 +66,18 @@ namespace fun
 
         /*!
          * \brief Constructor for frame_builder class
+         * \param cache_size Number of encoded frames to keep in the frame cache. Repeated
+         *  payloads (i.e. beacons or ACKs) sent at the same rate are copied out of the cache
+         *  instead of being encoded again. 0 (the default) disables the cache, which only
+         *  costs a hash and a copy per frame for callers whose payloads never repeat.
+         * \param build_threads Number of worker threads (besides the calling thread) that
+         *  build_frames() spreads a batch of payloads over. If 0 (the default) batches are
+         *  built on the calling thread.
+         * \param backend Implementation of the IFFT (see fft_backend), also used by the workers.
          */
-        frame_builder();
+        frame_builder(int cache_size = 0, int build_threads = 0, fft_backend backend = FFT_BACKEND_FFTW);
+
+        ~frame_builder(); //!< Stops and joins the build workers (if any).
 
         /*!
          * \brief Main function for building a PHY frame
@@ -59,12 +86,108 @@ namespace fun
          * \return A vector of complex doubles representing the digital base-band time domain signal
          *  to be passed to the usrp class for up-conversion and transmission over the air.
          */
-        std::vector<std::complex<double> >  build_frame(std::vector<unsigned char> payload, Rate rate);
+        std::vector<complex_t >  build_frame(std::vector<unsigned char> payload, Rate rate);
+
+        /*!
+         * \brief Builds a PHY frame into a caller provided buffer
+         * \param payload (MPDU) the data that needs to be transmitted over the air.
+         * \param length the number of bytes in the payload.
+         * \param rate the PHY transmission rate at which to transmit the respective data at.
+         * \param frame the buffer to build the frame in. Must hold at least frame_length(length, rate) samples.
+         * \param preamble_written true if the first #PREAMBLE_LENGTH samples of the frame buffer already
+         *  hold the preamble (see write_preamble()) so that it doesn't have to be copied again.
+         * \return The number of samples in the frame.
+         */
+        int build_frame(const unsigned char * payload, int length, Rate rate, complex_t * frame, bool preamble_written = false);
+
+        /*!
+         * \brief Builds the PHY frames of many payloads at once
+         * \param batch the payloads (MPDUs) that need to be transmitted over the air.
+         * \param rate the PHY transmission rate at which to transmit every payload in the batch.
+         * \return The frames in the same order as the payloads, each as build_frame() would return it.
+         *
+         * The payloads are encoded in parallel by the calling thread and the build workers.
+         */
+        std::vector<std::vector<complex_t > > build_frames(const std::vector<std::vector<unsigned char> > & batch, Rate rate);
+
+        /*!
+         * \brief Gets the number of samples in a frame
+         * \param length the number of bytes in the payload.
+         * \param rate the PHY transmission rate.
+         * \return The number of samples in the frame including the preamble.
+         */
+        static int frame_length(int length, Rate rate);
+
+        /*!
+         * \brief Writes the #PREAMBLE_LENGTH preamble samples to the start of a frame buffer
+         * \param frame the frame buffer
+         */
+        static void write_preamble(complex_t * frame);
 
     private:
 
+        /*!
+         * \brief The frame_cache_entry struct holds one encoded frame in the frame cache.
+         */
+        struct frame_cache_entry
+        {
+            unsigned long long hash;            //!< Hash of the payload
+            Rate rate;                          //!< PHY rate the frame was encoded at
+            std::vector<unsigned char> payload; //!< The payload (to rule out hash collisions)
+            std::vector<complex_t > samples;    //!< The frame samples following the preamble
+        };
+
+        /*!
+         * \brief Encodes the ppdu, maps the subcarriers, runs the IFFT and adds the cyclic prefixes.
+         * \param payload the payload
+         * \param rate the PHY rate
+         * \param out Buffer for the frame samples following the preamble
+         */
+        void encode_symbols(const std::vector<unsigned char> & payload, Rate rate, complex_t * out);
+
+        /*!
+         * \brief The build workers and the batch they are working on, shared by build_frames() and the workers.
+         *
+         * Everything but #next_frame and the batch itself is protected by #mutex.
+         */
+        struct build_pool
+        {
+            std::mutex mutex;                                    //!< Protects everything below
+            std::condition_variable batch_cond;                  //!< Signalled when a batch is handed out or on #stop
+            std::condition_variable done_cond;                   //!< Signalled when a worker runs out of frames to build
+            std::vector<frame_builder *> builders;               //!< One frame_builder per worker
+            std::vector<std::thread> workers;                    //!< The build worker threads
+            const std::vector<std::vector<unsigned char> > * batch; //!< The payloads of the current batch
+            std::vector<std::vector<complex_t > > * frames;      //!< The frames of the current batch
+            Rate rate;                                           //!< The PHY rate of the current batch
+            std::atomic<int> next_frame;                         //!< Index of the next payload of the batch to build
+            unsigned long long batch_count;                      //!< Number of batches handed out so far
+            int busy_workers;                                    //!< Number of workers still building the batch
+            bool stop;                                           //!< Tells the workers to exit
+        };
+
+        /*!
+         * \brief Builds frames of the current batch until none are left.
+         * \param builder The frame_builder (i.e. the IFFT & scratch buffers) of the calling thread
+         */
+        void build_batch(frame_builder * builder);
+
+        /*!
+         * \brief Main loop of a build worker thread.
+         * \param builder The worker's own frame_builder
+         */
+        void build_worker(frame_builder * builder);
+
         fft m_ifft; //!< The fft instance used to perform the inverse FFT on the OFDM symbols
 
+        int m_cache_size; //!< Maximum number of entries in #m_cache
+
+        std::list<frame_cache_entry> m_cache; //!< The frame cache, most recently used entry first
+
+        std::vector<unsigned char> m_payload; //!< Scratch copy of the payload for encoding
+
+        build_pool * m_pool; //!< The build workers, NULL if there are none
+
     };
 }
 
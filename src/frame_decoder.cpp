@@ -7,8 +7,8 @@
 
 #include <iostream>
 #include <cstring>
+#include <cmath>
 #include <arpa/inet.h>
-#include <boost/crc.hpp>
 
 #include "frame_decoder.h"
 #include "qam.h"
@@ -20,18 +20,227 @@
 #include "puncturer.h"
 #include "interleaver.h"
 #include "ppdu.h"
+#include "thread_config.h"
+#include "frame_detector.h"
 
 namespace fun
 {
     /*!
      * - Initializations:
      *   + #m_current_frame -> Reset to a frame of 0 length with RATE_1_2_BPSK
+     *   + #m_viterbi -> Trellis preallocated for a #MAX_FRAME_SIZE frame at the highest rate with viterbi_threads segment workers
+     *     (none if incremental, unused if header_only)
+     *   + #m_header_viterbi -> Trellis preallocated for a header
+     *   + #m_incremental -> incremental
+     *   + #m_header_only -> header_only
+     *   + #m_spare_payloads -> Room for the buffers of 64 payloads
+     *   + #m_workers -> decode_threads decode worker threads (none if incremental or header_only)
+     *   + #m_decode_rates -> Every rate
+     *   + #m_max_header_evm -> 0 (every header is decoded)
+     *   + #m_keep_failed -> false (payloads that fail their CRC are dropped)
+     *   + #m_feedback -> feedback
      */
-    frame_decoder::frame_decoder() :
-        block("frame_decoder"),
-        m_current_frame(FrameData(RateParams(RATE_1_2_BPSK)))
+    frame_decoder::frame_decoder(int decode_threads, int viterbi_threads, bool incremental, bool header_only,
+                                 gate_feedback * feedback) :
+        block("frame_decoder", 80, 480 /* preamble, header & one data symbol */),
+        m_current_frame(FrameData(RateParams(RATE_1_2_BPSK))),
+        m_viterbi(header_only ? 0 : 16 /* service */ + 8 * (MAX_FRAME_SIZE + 4 /* CRC */) + 6 /* tail */ + 216 /* padding (max dbps) */,
+                  incremental || header_only ? 0 : viterbi_threads),
+        m_header_viterbi(18 /* header */),
+        m_incremental(incremental && !header_only),
+        m_header_only(header_only),
+        m_stop(false),
+        m_work_calls(0),
+        m_decode_rates(~0u),
+        m_skipped_frames(0),
+        m_max_header_evm(0),
+        m_rejected_headers(0),
+        m_failed_headers(0),
+        m_keep_failed(false),
+        m_feedback(feedback)
     {
         m_current_frame.Reset(RateParams(RATE_1_2_BPSK), 0, 0);
+        m_spare_payloads.reserve(64);
+        for(int x = 0; x < (incremental || header_only ? 0 : decode_threads); x++)
+        {
+            m_workers.push_back(std::thread(&frame_decoder::decode_worker, this));
+        }
+    }
+
+    frame_decoder::~frame_decoder()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_job_mutex);
+            m_stop = true;
+        }
+        m_job_cond.notify_all();
+        for(int x = 0; x < m_workers.size(); x++) m_workers[x].join();
+        for(int x = 0; x < m_pending.size(); x++) delete m_pending[x];
+        for(int x = 0; x < m_free_jobs.size(); x++) delete m_free_jobs[x];
+    }
+
+    /*!
+     * Each worker owns its own viterbi decoder, ppdu and arena so the workers never share
+     * any state besides the job queue.
+     */
+    void frame_decoder::decode_worker()
+    {
+        configure_thread("fun_decode");
+        viterbi decoder(16 /* service */ + 8 * (MAX_FRAME_SIZE + 4 /* CRC */) + 6 /* tail */ + 216 /* padding (max dbps) */);
+        ppdu frame;
+        frame_arena arena;
+        while(true)
+        {
+            decode_job * job;
+            {
+                std::unique_lock<std::mutex> lock(m_job_mutex);
+                while(m_jobs.empty() && !m_stop) m_job_cond.wait(lock);
+                if(m_stop) return;
+                job = m_jobs.front();
+                m_jobs.pop_front();
+            }
+
+            frame.reset(job->rate, job->length);
+            job->success = frame.decode_data(job->samples.data(), job->samples.size(), &decoder, &arena);
+            frame.swap_payload(job->payload);
+
+            {
+                std::lock_guard<std::mutex> lock(m_job_mutex);
+                job->done = true;
+            }
+            m_done_cond.notify_all();
+        }
+    }
+
+    /*!
+     * The current frame's samples are swapped into the job so that the block keeps the
+     * job's (previously used) sample buffer for the next frame instead of copying.
+     * At most 4 frames per worker are allowed to be in flight, past that the block waits
+     * for the oldest frame to finish which pushes the back pressure up the receiver chain
+     * instead of growing without bound.
+     */
+    void frame_decoder::submit_frame()
+    {
+        if(m_pending.size() >= 4 * m_workers.size())
+        {
+            std::unique_lock<std::mutex> lock(m_job_mutex);
+            while(!m_pending.front()->done) m_done_cond.wait(lock);
+        }
+        collect_frames();
+
+        decode_job * job;
+        if(m_free_jobs.empty()) job = new decode_job();
+        else
+        {
+            job = m_free_jobs.back();
+            m_free_jobs.pop_back();
+        }
+        job->rate = m_current_frame.rate_params.rate;
+        job->length = m_current_frame.length;
+        job->success = false;
+        job->done = false;
+        job->info = current_info(m_work_calls - 1);
+        job->samples.swap(m_current_frame.samples);
+        m_pending.push_back(job);
+
+        {
+            std::lock_guard<std::mutex> lock(m_job_mutex);
+            m_jobs.push_back(job);
+        }
+        m_job_cond.notify_one();
+    }
+
+    packet_info frame_decoder::current_info(unsigned long long sequence)
+    {
+        packet_info info;
+        info.rate = m_current_frame.rate_params.rate;
+        info.length = m_current_frame.length;
+        info.snr = m_current_frame.snr;
+        info.sample_index = m_current_frame.sample_index;
+        info.quality = m_current_frame.quality;
+        info.sequence = sequence;
+        return info;
+    }
+
+    /*!
+     * The frame is made of the 320 sample preamble, the 80 sample SIGNAL symbol and then its
+     * 80 sample data symbols. A frame whose header wasn't decoded is reported as just its
+     * preamble & SIGNAL symbol since nothing after it will be looked at.
+     */
+    void frame_decoder::report_frame(unsigned long long start, int data_symbols)
+    {
+        if(m_feedback == NULL) return;
+        frame_span frame;
+        frame.start = start;
+        frame.end = start + 400 + 80 * data_symbols;
+        m_feedback->frames.push(frame);
+    }
+
+    void frame_decoder::output_payload(bool crc_ok, unsigned long long sequence)
+    {
+        if(!crc_ok && !m_keep_failed.load(std::memory_order_relaxed)) return;
+        output_buffer.push_back(std::vector<unsigned char>());
+        take_spare(output_buffer.back());
+        m_ppdu.swap_payload(output_buffer.back());
+        output_info.push_back(current_info(sequence));
+        output_info.back().crc_ok = crc_ok;
+    }
+
+    /*!
+     * The SIGNAL symbol is always BPSK, so after equalization & phase tracking every subcarrier
+     * should sit on +1 or -1. The error is taken from the nearer of the two.
+     */
+    float frame_decoder::header_evm(const complex_t * samples)
+    {
+        real_t error = 0;
+        for(int s = 0; s < 48; s++)
+        {
+            real_t re = samples[s].real();
+            real_t im = samples[s].imag();
+            real_t dist = std::abs(re) - 1;
+            error += dist * dist + im * im;
+        }
+        return std::sqrt(error / 48);
+    }
+
+    void frame_decoder::collect_frames()
+    {
+        while(!m_pending.empty() && m_pending.front()->done)
+        {
+            decode_job * job = m_pending.front();
+            m_pending.pop_front();
+            if(job->success || m_keep_failed.load(std::memory_order_relaxed))
+            {
+                output_buffer.push_back(std::vector<unsigned char>());
+                output_buffer.back().swap(job->payload);
+                output_info.push_back(job->info);
+                output_info.back().crc_ok = job->success;
+                take_spare(job->payload);
+            }
+            m_free_jobs.push_back(job);
+        }
+    }
+
+    void frame_decoder::take_spare(std::vector<unsigned char> & buffer)
+    {
+        if(m_spare_payloads.empty()) return;
+        buffer.swap(m_spare_payloads.back());
+        m_spare_payloads.pop_back();
+    }
+
+    /*!
+     * Buffers that have never held a payload aren't worth keeping. Past the reserved
+     * capacity of #m_spare_payloads the rest are freed rather than growing it.
+     */
+    void frame_decoder::recycle_payloads(std::vector<std::vector<unsigned char> > & payloads)
+    {
+        for(int x = 0; x < payloads.size(); x++)
+        {
+            if(payloads[x].capacity() == 0 || m_spare_payloads.size() == m_spare_payloads.capacity()) continue;
+            m_spare_payloads.push_back(std::vector<unsigned char>());
+            m_spare_payloads.back().swap(payloads[x]);
+        }
+        payloads.clear();
     }
 
     /*!
@@ -40,30 +249,54 @@ namespace fun
      * then tries to decode the payload of the frame using the parameters it gathered from
      * header.  If that is successful as deteremined by an IEEE CRC-32 check, the decoded payload
      * is passed to the output_buffer to be returned to the receive chain so that it can be passed
-     * up to the MAC layer.
+     * up to the MAC layer. A payload that fails its CRC check is only passed on (flagged as such
+     * in its packet_info::crc_ok) if the failed payloads are kept (see set_keep_failed()).
+     *
+     * If the block has decode workers the payloads are decoded by them instead and show
+     * up in the output_buffer of a later call to this function, still in the order the
+     * frames were received.
+     *
+     * In incremental mode the data symbols aren't collected at all, each one goes straight
+     * into the ppdu's incremental decode as it arrives.
+     *
+     * In header only mode a frame is never started, so its data symbols fall through as if
+     * they were noise between frames while its header goes straight to the output_buffer.
      */
     void frame_decoder::work()
     {
-        if(input_buffer.size() == 0) return;
+        unsigned long long sequence = m_work_calls++;
         output_buffer.resize(0);
+        output_info.resize(0);
+        if(!m_workers.empty()) collect_frames();
+        if(input_buffer.size() == 0) return;
 
         // Step through each 48 sample symbol
         for(int x = 0; x < input_buffer.size(); x++)
         {
-            // Copy over available symbols
+            // Copy over (or decode) available symbols
             if(m_current_frame.samples_copied < m_current_frame.sample_count)
             {
-                memcpy(&m_current_frame.samples[m_current_frame.samples_copied], &input_buffer[x].samples[0], 48 * sizeof(std::complex<double>));
+                if(m_incremental) m_ppdu.decode_symbol(input_buffer[x].samples, &m_viterbi);
+                else memcpy(&m_current_frame.samples[m_current_frame.samples_copied], &input_buffer[x].samples[0], 48 * sizeof(complex_t));
                 m_current_frame.samples_copied += 48;
             }
 
             // Decode the frame if possible
             if(m_current_frame.samples_copied >= m_current_frame.sample_count && m_current_frame.sample_count != 0)
             {
-                ppdu frame = ppdu(m_current_frame.rate_params.rate, m_current_frame.length);
-                if(frame.decode_data(m_current_frame.samples))
+                if(m_incremental)
                 {
-                    output_buffer.push_back(frame.get_payload());
+                    output_payload(m_ppdu.end_decode_data(&m_viterbi, &m_arena), sequence);
+                }
+                else if(!m_workers.empty())
+                {
+                    submit_frame();
+                }
+                else
+                {
+                    m_ppdu.reset(m_current_frame.rate_params.rate, m_current_frame.length);
+                    output_payload(m_ppdu.decode_data(m_current_frame.samples.data(), m_current_frame.samples.size(), &m_viterbi, &m_arena),
+                                   sequence);
                 }
                 m_current_frame.sample_count = 0;
             }
@@ -71,20 +304,58 @@ namespace fun
             // Look for a start of frame
             if(input_buffer[x].tag == START_OF_FRAME)
             {
+                // Drop the frames whose SIGNAL symbol doesn't look like BPSK at all
+                detection_quality quality = input_buffer[x].quality;
+                quality.evm = header_evm(input_buffer[x].samples);
+                float max_evm = m_max_header_evm.load(std::memory_order_relaxed);
+                if(max_evm > 0 && !(quality.evm <= max_evm))
+                {
+                    m_rejected_headers.fetch_add(1, std::memory_order_relaxed);
+                    report_frame(input_buffer[x].sample_index, 0);
+                    continue;
+                }
+
                 // Attempt to decode the header
-                ppdu h = ppdu();
-                std::vector<std::complex<double> > header_samples(48);
-                memcpy(header_samples.data(), input_buffer[x].samples, 48 * sizeof(std::complex<double>));
-                if(!h.decode_header(header_samples)) continue;
+                if(!m_ppdu.decode_header(input_buffer[x].samples, &m_header_viterbi))
+                {
+                    m_failed_headers.fetch_add(1, std::memory_order_relaxed);
+                    report_frame(input_buffer[x].sample_index, 0);
+                    continue;
+                }
+                report_frame(input_buffer[x].sample_index, m_ppdu.get_num_symbols());
+
+                // Report just the header, the rates to decode only apply to payloads
+                if(m_header_only)
+                {
+                    m_current_frame.Reset(RateParams(m_ppdu.get_rate()), 0, m_ppdu.get_length());
+                    m_current_frame.snr = input_buffer[x].snr;
+                    m_current_frame.sample_index = input_buffer[x].sample_index;
+                    m_current_frame.quality = quality;
+                    output_buffer.push_back(std::vector<unsigned char>());
+                    output_info.push_back(current_info(sequence));
+                    continue;
+                }
+
+                // Drop the frames of the rates we don't decode
+                if(!(m_decode_rates.load(std::memory_order_relaxed) & (1u << m_ppdu.get_rate())))
+                {
+                    m_current_frame.sample_count = 0;
+                    m_skipped_frames.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
 
                 // Calculate the frame sample count
-                int length = h.get_length();
-                RateParams rate_params = RateParams(h.get_rate());
-                int frame_sample_count = h.get_num_symbols() * 48;
+                int length = m_ppdu.get_length();
+                RateParams rate_params = RateParams(m_ppdu.get_rate());
+                int frame_sample_count = m_ppdu.get_num_symbols() * 48;
 
                 // Start a new frame
                 m_current_frame.Reset(rate_params, frame_sample_count, length);
-                m_current_frame.samples.resize(h.get_num_symbols() * 48);
+                if(m_incremental) m_ppdu.begin_decode_data(&m_viterbi);
+                else m_current_frame.samples.resize(frame_sample_count);
+                m_current_frame.snr = input_buffer[x].snr;
+                m_current_frame.sample_index = input_buffer[x].sample_index;
+                m_current_frame.quality = quality;
                 continue;
             }
         }
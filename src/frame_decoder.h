@@ -14,13 +14,31 @@
 
 #include <complex>
 #include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include "tagged_vector.h"
+#include "packet_pool.h"
 #include "rates.h"
 #include "block.h"
+#include "viterbi.h"
+#include "ppdu.h"
+#include "frame_arena.h"
+
+/*! \def MAX_FRAME_SAMPLES
+ *  \brief Number of data subcarrier samples in a #MAX_FRAME_SIZE frame at the lowest rate.
+ *
+ *  48 samples per symbol with 24 data bits per symbol for the service field, the payload,
+ *  the CRC and the tail bits.
+ */
+#define MAX_FRAME_SAMPLES (48 * ((16 + 8 * (MAX_FRAME_SIZE + 4) + 6 + 23) / 24))
 
 namespace fun
 {
+    struct gate_feedback;
+
     /*!
      * \brief The FrameData struct
      *
@@ -31,9 +49,12 @@ namespace fun
       int sample_count;                          //!< Number of samples in this frame
       int samples_copied;                        //!< Number of samples already copied
       RateParams rate_params;                    //!< Rate parameters for this frame
-      std::vector<std::complex<double> > samples; //!< Decoded Samples
+      std::vector<complex_t > samples; //!< Decoded Samples
       int length;                                //!< Data length
       int required_samples;                      //!< Number of samples required to decode frame
+      float snr;                                 //!< SNR estimate of the frame (see tagged_vector::snr)
+      unsigned long long sample_index;           //!< First sample of the frame (see tagged_vector::sample_index)
+      detection_quality quality;                 //!< Detection metrics of the frame (see tagged_vector::quality)
 
       /*!
        * \brief Constructor for FrameData
@@ -42,7 +63,7 @@ namespace fun
       FrameData(RateParams _rate_params) :
         rate_params(_rate_params)
       {
-        samples.reserve(100000);
+        samples.reserve(MAX_FRAME_SAMPLES);
       }
 
       /*!
@@ -52,7 +73,7 @@ namespace fun
        * \param _length new length for this frame
        *
        * Also calculates #required_samples from the above parameters and resets
-       * #samples_copied to 0.
+       * #samples_copied, #snr, #sample_index & #quality to 0.
        */
       void Reset(RateParams _rate_params, int _sample_count, int _length)
       {
@@ -61,9 +82,30 @@ namespace fun
           sample_count = _sample_count;
           required_samples = _sample_count / _rate_params.bpsc;
           samples_copied = 0;
+          snr = 0;
+          sample_index = 0;
+          quality = detection_quality();
       }
     };
 
+    /*!
+     * \brief The decode_job struct
+     *
+     * A completed frame handed off to a decode worker along with the result of decoding it.
+     */
+    struct decode_job
+    {
+        Rate rate;                          //!< PHY rate of the frame's payload
+        int length;                         //!< Payload length in bytes
+        std::vector<complex_t > samples;    //!< The frame's data subcarrier samples
+        bool success;                       //!< Whether the payload passed its CRC check
+        std::vector<unsigned char> payload; //!< The decoded payload (with bit errors unless #success)
+        std::atomic<bool> done;             //!< Set by the worker once #success and #payload are valid
+        packet_info info;                   //!< The metadata of the frame's payload
+
+        decode_job() : rate(RATE_1_2_BPSK), length(0), success(false), done(false) {} //!< Constructor for an empty decode_job
+    };
+
     /*!
      * \brief The frame_decoder block.
      *
@@ -81,14 +123,200 @@ namespace fun
     {
     public:
 
-        frame_decoder(); //!< Constructor for frame_decoder block.
+        /*!
+         * \brief Constructor for frame_decoder block.
+         * \param decode_threads Number of worker threads to decode the frame payloads with.
+         *  If 0 (the default) payloads are decoded inline in #work().
+         * \param viterbi_threads Number of worker threads the inline viterbi decoder splits long
+         *  payloads across (see viterbi::viterbi()), to lower the latency of each frame rather
+         *  than raise the throughput like decode_threads.
+         * \param incremental Decode each payload incrementally: every data symbol is demodulated,
+         *  deinterleaved and run through the viterbi trellis in the call to #work() it arrives in,
+         *  so only the chainback, descrambling and CRC check are left once the last symbol is in.
+         *  This spreads the cost of a long frame over the chunks it spans and cuts the time from
+         *  its last sample to its payload. The payloads are decoded inline, so decode_threads and
+         *  viterbi_threads are ignored.
+         * \param header_only Only decode the frame headers: each frame whose header passes its parity
+         *  check is reported right away as an empty payload whose output_info holds the header's rate &
+         *  length, and the frame's data symbols are ignored. For monitoring the channel occupancy without
+         *  paying for the payloads. decode_threads, viterbi_threads & incremental are ignored.
+         * \param feedback [Optional] The gate_feedback of the gated frame_detector upstream, the extent
+         *  of every frame whose SIGNAL symbol arrives is reported to it.
+         */
+        frame_decoder(int decode_threads = 0, int viterbi_threads = 0, bool incremental = false, bool header_only = false,
+                      gate_feedback * feedback = NULL);
+
+        ~frame_decoder(); //!< Stops and joins the decode workers.
 
         virtual void work(); //!< Signal processing happens here.
 
+        /*!
+         * \brief The metadata of each payload in the output_buffer.
+         *
+         * packet_info::sequence is the index of the call to work() (counting from 0) whose input
+         * completed the payload's frame. It lets the receiver_chain work out which chunk of samples
+         * each payload came from. packet_info::latency is left for the receiver_chain to fill in.
+         */
+        std::vector<packet_info> output_info;
+
+        /*!
+         * \brief Hands spent payload buffers back to the block to decode later payloads into.
+         * \param payloads Payload buffers taken from the output_buffer and no longer needed.
+         *  It is left empty.
+         *
+         * Must not be called while work() is running. Once enough buffers have come back the
+         * block doesn't allocate any memory for new payloads.
+         */
+        void recycle_payloads(std::vector<std::vector<unsigned char> > & payloads);
+
+        /*!
+         * \brief Sets which rates' payloads are decoded.
+         * \param rates Bit r set to decode the payloads of frames whose header shows Rate r. The
+         *  other frames are dropped right after their header. Defaults to every rate.
+         *
+         * Can be called from any thread, it applies from the next frame header on.
+         */
+        void set_decode_rates(unsigned int rates) { m_decode_rates.store(rates, std::memory_order_relaxed); }
+
+        /*!
+         * \brief Number of frames dropped after their header because of set_decode_rates(). Can be called from any thread.
+         */
+        unsigned long long skipped_frames() const { return m_skipped_frames.load(std::memory_order_relaxed); }
+
+        /*!
+         * \brief Sets the highest detection_quality::evm of a SIGNAL symbol whose header is decoded.
+         * \param evm Frames whose SIGNAL symbol is further off the BPSK constellation are dropped before
+         *  their header goes through the viterbi decoder. 0 (the default) decodes every header.
+         *
+         * Can be called from any thread, it applies from the next frame header on.
+         */
+        void set_max_header_evm(float evm) { m_max_header_evm.store(evm, std::memory_order_relaxed); }
+
+        /*!
+         * \brief Number of frames dropped because of set_max_header_evm(). Can be called from any thread.
+         */
+        unsigned long long rejected_headers() const { return m_rejected_headers.load(std::memory_order_relaxed); }
+
+        /*!
+         * \brief Number of headers that failed their parity or rate check. Can be called from any thread.
+         */
+        unsigned long long failed_headers() const { return m_failed_headers.load(std::memory_order_relaxed); }
+
+        /*!
+         * \brief Sets whether the payloads that fail their CRC check are output as well.
+         * \param keep If true such a payload is output with its bit errors and packet_info::crc_ok
+         *  cleared (e.g. to measure the bit error rate), otherwise (the default) it is dropped.
+         *
+         * Can be called from any thread, it applies from the next payload decoded on.
+         */
+        void set_keep_failed(bool keep) { m_keep_failed.store(keep, std::memory_order_relaxed); }
+
+        /*!
+         * \brief Whether the block is between frames, i.e. not waiting on the rest of a frame's symbols.
+         *
+         * Must not be called while work() is running.
+         */
+        bool idle() const { return m_current_frame.sample_count == 0; }
+
     private:
 
+        /*!
+         * \brief Hands the current frame to the decode workers.
+         *
+         * Blocks if there are already too many frames waiting to be decoded.
+         */
+        void submit_frame();
+
+        /*!
+         * \brief Moves the payloads of all decoded frames at the front of #m_pending
+         *  into the output_buffer (i.e. in the order the frames were received).
+         */
+        void collect_frames();
+
+        /*!
+         * \brief Main loop of a decode worker thread.
+         */
+        void decode_worker();
+
+        /*!
+         * \brief Puts a spare payload buffer (if there is one) into the buffer.
+         */
+        void take_spare(std::vector<unsigned char> & buffer);
+
+        /*!
+         * \brief Gets the metadata of the current frame.
+         * \param sequence Index of the work() call that completed the frame
+         */
+        packet_info current_info(unsigned long long sequence);
+
+        /*!
+         * \brief Outputs the payload decoded inline by #m_ppdu if it passed its CRC check or failed ones are kept.
+         * \param crc_ok Whether it passed
+         * \param sequence Index of the work() call that completed the frame
+         */
+        void output_payload(bool crc_ok, unsigned long long sequence);
+
+        /*!
+         * \brief Reports the extent of a frame to #m_feedback (if any).
+         * \param start Index of the frame's first sample (tagged_vector::sample_index)
+         * \param data_symbols Number of data symbols following its SIGNAL symbol (0 if its header wasn't decoded)
+         */
+        void report_frame(unsigned long long start, int data_symbols);
+
+        /*!
+         * \brief Measures the RMS error vector magnitude of an equalized SIGNAL symbol (see detection_quality::evm).
+         * \param samples The 48 data subcarriers of the symbol
+         */
+        static float header_evm(const complex_t * samples);
+
         FrameData m_current_frame; //!< Current frame that is being decoded.
 
+        viterbi m_viterbi; //!< Viterbi decoder reused for every header and payload.
+
+        viterbi m_header_viterbi; //!< Viterbi decoder for the headers, so they don't disturb an incremental payload decode.
+
+        bool m_incremental; //!< Whether the payloads are decoded incrementally (see frame_decoder())
+
+        bool m_header_only; //!< Whether only the headers are decoded (see frame_decoder())
+
+        ppdu m_ppdu; //!< PPDU reused to decode every header and (inline) payload.
+
+        frame_arena m_arena; //!< Scratch buffers for decoding a payload inline, reset for every frame.
+
+        std::vector<std::vector<unsigned char> > m_spare_payloads; //!< Payload buffers handed back by recycle_payloads()
+
+        std::vector<std::thread> m_workers; //!< The decode worker threads
+
+        std::deque<decode_job *> m_pending; //!< Submitted frames in the order they were received
+
+        std::deque<decode_job *> m_jobs; //!< Submitted frames that no worker has picked up yet
+
+        std::vector<decode_job *> m_free_jobs; //!< Collected jobs kept around to reuse their buffers
+
+        std::mutex m_job_mutex; //!< Protects #m_jobs and #m_stop
+
+        std::condition_variable m_job_cond; //!< Signaled when a job is added to #m_jobs or on #m_stop
+
+        std::condition_variable m_done_cond; //!< Signaled when a worker finishes a job
+
+        bool m_stop; //!< Tells the workers to exit
+
+        unsigned long long m_work_calls; //!< Number of calls to work() so far
+
+        std::atomic<unsigned int> m_decode_rates; //!< See set_decode_rates()
+
+        std::atomic<unsigned long long> m_skipped_frames; //!< See skipped_frames()
+
+        std::atomic<float> m_max_header_evm; //!< See set_max_header_evm()
+
+        std::atomic<unsigned long long> m_rejected_headers; //!< See rejected_headers()
+
+        std::atomic<unsigned long long> m_failed_headers; //!< See failed_headers()
+
+        std::atomic<bool> m_keep_failed; //!< See set_keep_failed()
+
+        gate_feedback * m_feedback; //!< Where the extent of each frame is reported (or NULL)
+
     };
 
 }
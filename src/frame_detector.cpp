@@ -5,6 +5,8 @@
  * short training sequence in the preamble.
  */
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <iostream>
 
@@ -12,62 +14,224 @@
 
 namespace fun
 {
+    /*!
+     * \brief Computes which samples have a normalized auto-correlation above the threshold.
+     *
+     * The running sums of the original sample by sample implementation are replaced
+     * with sliding window sums over whole blocks that the compiler can vectorize:
+     *  1. The per sample correlation with the 16 sample delayed conjugate and the per
+     *     sample power are computed into #sum_re, #sum_im & #sum_power with the
+     *     #STS_LENGTH values from the previous call (#history) in front of them.
+     *  2. The 16 sample window sums are built up in 4 doubling passes
+     *     (2, 4, 8 & then 16 samples) which ping pong between the sum and scratch arrays.
+     *     Unlike a running sum this can't drift no matter how long the receiver runs.
+     *  3. |corr| / power > #PLATEAU_THRESHOLD is evaluated without the square root or
+     *     the divide as |corr|^2 > #PLATEAU_THRESHOLD^2 * power^2.
+     *
+     * NaN samples are zeroed just like circular_accumulator::add() does.
+     *
+     * This is always inlined into the ISA specific wrappers below so the compiler
+     * generates a separate SSE and AVX2 version of it.
+     */
+    static inline __attribute__((always_inline))
+    void detector_kernel_impl(const complex_t * __restrict__ input, const complex_t * __restrict__ carryover, int count,
+                              real_t * __restrict__ history, real_t * __restrict__ sum_re, real_t * __restrict__ sum_im,
+                              real_t * __restrict__ sum_power, real_t * __restrict__ scratch_re,
+                              real_t * __restrict__ scratch_im, real_t * __restrict__ scratch_power,
+                              unsigned char * __restrict__ above_threshold)
+    {
+        const real_t * in = reinterpret_cast<const real_t *>(input);
+        const real_t * carry = reinterpret_cast<const real_t *>(carryover);
+        const int total = count + STS_LENGTH;
+        const real_t threshold2 = real_t(PLATEAU_THRESHOLD * PLATEAU_THRESHOLD);
+
+        // Step 1: per sample correlation & power
+        for(int k = 0; k < STS_LENGTH; k++)
+        {
+            sum_re[k] = history[k];
+            sum_im[k] = history[STS_LENGTH + k];
+            sum_power[k] = history[2 * STS_LENGTH + k];
+        }
+        for(int x = 0; x < count; x++)
+        {
+            const real_t * d = (x < STS_LENGTH) ? &carry[2 * x] : &in[2 * (x - STS_LENGTH)];
+            real_t re = in[2 * x] * d[0] + in[2 * x + 1] * d[1];
+            real_t im = in[2 * x + 1] * d[0] - in[2 * x] * d[1];
+            real_t pw = in[2 * x] * in[2 * x] + in[2 * x + 1] * in[2 * x + 1];
+            bool nan = (re != re) || (im != im);
+            sum_re[STS_LENGTH + x] = nan ? real_t(0) : re;
+            sum_im[STS_LENGTH + x] = nan ? real_t(0) : im;
+            sum_power[STS_LENGTH + x] = (pw != pw) ? real_t(0) : pw;
+        }
+        for(int k = 0; k < STS_LENGTH; k++)
+        {
+            history[k] = sum_re[count + k];
+            history[STS_LENGTH + k] = sum_im[count + k];
+            history[2 * STS_LENGTH + k] = sum_power[count + k];
+        }
+
+        // Step 2: sliding window sums by doubling
+        for(int a = 1; a < total; a++)
+        {
+            scratch_re[a] = sum_re[a] + sum_re[a - 1];
+            scratch_im[a] = sum_im[a] + sum_im[a - 1];
+            scratch_power[a] = sum_power[a] + sum_power[a - 1];
+        }
+        for(int a = 3; a < total; a++)
+        {
+            sum_re[a] = scratch_re[a] + scratch_re[a - 2];
+            sum_im[a] = scratch_im[a] + scratch_im[a - 2];
+            sum_power[a] = scratch_power[a] + scratch_power[a - 2];
+        }
+        for(int a = 7; a < total; a++)
+        {
+            scratch_re[a] = sum_re[a] + sum_re[a - 4];
+            scratch_im[a] = sum_im[a] + sum_im[a - 4];
+            scratch_power[a] = sum_power[a] + sum_power[a - 4];
+        }
+        for(int a = STS_LENGTH; a < total; a++)
+        {
+            sum_re[a] = scratch_re[a] + scratch_re[a - 8];
+            sum_im[a] = scratch_im[a] + scratch_im[a - 8];
+            sum_power[a] = scratch_power[a] + scratch_power[a - 8];
+        }
+
+        // Step 3: threshold the normalized correlation
+        for(int x = 0; x < count; x++)
+        {
+            real_t re = sum_re[STS_LENGTH + x];
+            real_t im = sum_im[STS_LENGTH + x];
+            real_t pw = sum_power[STS_LENGTH + x];
+            above_threshold[x] = (pw > 0) & (re * re + im * im > threshold2 * pw * pw);
+        }
+    }
+
+    //! SSE4.1 version of the detection kernel (the baseline compile flags).
+    static void detector_kernel_sse(const complex_t * input, const complex_t * carryover, int count,
+                                    real_t * history, real_t * sum_re, real_t * sum_im, real_t * sum_power,
+                                    real_t * scratch_re, real_t * scratch_im, real_t * scratch_power,
+                                    unsigned char * above_threshold)
+    {
+        detector_kernel_impl(input, carryover, count, history, sum_re, sum_im, sum_power,
+                             scratch_re, scratch_im, scratch_power, above_threshold);
+    }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    //! AVX2 version of the detection kernel.
+    __attribute__((target("avx2")))
+    static void detector_kernel_avx2(const complex_t * input, const complex_t * carryover, int count,
+                                     real_t * history, real_t * sum_re, real_t * sum_im, real_t * sum_power,
+                                     real_t * scratch_re, real_t * scratch_im, real_t * scratch_power,
+                                     unsigned char * above_threshold)
+    {
+        detector_kernel_impl(input, carryover, count, history, sum_re, sum_im, sum_power,
+                             scratch_re, scratch_im, scratch_power, above_threshold);
+    }
+#endif
+
     /*!
      * - Initializations:
-     *   + #m_power_acc      -> #STS_LENGTH (16 samples)
-     *   + #m_corr_acc       -> #STS_LENGTH (16 samples)
+     *   + #m_kernel         -> AVX2 kernel if the CPU supports it, SSE kernel otherwise
+     *   + #m_history        -> 0
      *   + #m_carryover      -> #STS_LENGTH (16 samples)
      *   + #m_plateau_length -> 0
      *   + #m_plateau_flag   -> false
+     *   + #m_plateau_sum    -> 0
+     *   + #m_min_plateau    -> 0 (every plateau is passed on)
+     *   + #m_gate_log       -> gate_log
+     *   + #m_gate_remaining -> 0 (i.e. closed)
+     *   + #m_recent         -> #GATE_LOOKBACK samples
+     *   + #m_feedback       -> feedback
      */
-    frame_detector::frame_detector() :
+    frame_detector::frame_detector(spsc_queue<gate_window> * gate_log, gate_feedback * feedback) :
         block("frame_detector"),
-        m_power_acc(STS_LENGTH),
-        m_corr_acc(STS_LENGTH),
-        m_carryover(STS_LENGTH, 0),
+        m_kernel(detector_kernel_sse),
         m_plateau_length(0),
-        m_plateau_flag(false)
+        m_plateau_flag(false),
+        m_plateau_sum(0),
+        m_min_plateau(0),
+        m_rejected(0),
+        m_carryover(STS_LENGTH, 0),
+        m_gate_log(gate_log),
+        m_gate_remaining(0),
+        m_closed_run(0),
+        m_recent(GATE_LOOKBACK, 0),
+        m_sample_count(0),
+        m_gated_count(0),
+        m_feedback(feedback),
+        m_unresolved(0),
+        m_window_end(0)
     {
+        for(int k = 0; k < 3 * STS_LENGTH; k++) m_history[k] = 0;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        if(__builtin_cpu_supports("avx2")) m_kernel = detector_kernel_avx2;
+#endif
     }
 
     /*!
      * This block uses auto-correlation to detect the short training sequence.
      * This autocorrelation is achieved through a moving window average
-     * using the circular accumulators to keep track of the current
-     * auto-correlation and input power of the input samples. The normalized
+     * of the current auto-correlation and input power of the input samples
+     * which is computed a whole block at a time by #m_kernel. The normalized
      * auto-correlation is then compared to a threshold to determine if
      * the current samples are part of the STS or not.
+     *
+     * The plateau state machine then only has to look at samples that are above the
+     * threshold or that are inside of a plateau, everything else is skipped over with memchr.
+     * Only for those samples is the normalized correlation itself worked out from the window
+     * sums, to get the plateau's mean level (detection_quality::plateau) onto its #STS_END tag.
+     * The tags it finds are collected in #m_tags and become the #output_tags. Since the samples
+     * themselves are passed through unchanged the input buffer simply becomes the output buffer
+     * (unless the block is gated, see gate_output()).
      */
     void frame_detector::work()
     {
-        if(input_buffer.size() == 0) return;
-        output_buffer.resize(input_buffer.size());
-
-        // Step through the samples
-        for(int x = 0; x < input_buffer.size(); x++)
+        if(input_buffer.size() == 0)
         {
-            output_buffer[x].tag = NONE;
-
-            // Get the delayed samples
-            std::complex<double> delayed;
-            if(x < STS_LENGTH) delayed = m_carryover[x];
-            else delayed = input_buffer[x-STS_LENGTH];
+            output_buffer.clear();
+            output_tags.clear();
+            return;
+        }
+        int count = input_buffer.size();
 
-            // Update the correlation accumulators
-            m_corr_acc.add(input_buffer[x] * std::conj(delayed));
+        m_sum_re.resize(count + STS_LENGTH);
+        m_sum_im.resize(count + STS_LENGTH);
+        m_sum_power.resize(count + STS_LENGTH);
+        m_scratch_re.resize(count + STS_LENGTH);
+        m_scratch_im.resize(count + STS_LENGTH);
+        m_scratch_power.resize(count + STS_LENGTH);
+        m_above_threshold.resize(count);
 
-            // Update the power accumulator
-            m_power_acc.add(std::norm(input_buffer[x]));
+        m_kernel(&input_buffer[0], &m_carryover[0], count, m_history,
+                 &m_sum_re[0], &m_sum_im[0], &m_sum_power[0],
+                 &m_scratch_re[0], &m_scratch_im[0], &m_scratch_power[0],
+                 &m_above_threshold[0]);
 
-            // Calculate the normalized correlations
-            double corr = std::abs(m_corr_acc.sum) / m_power_acc.sum;
+        // Step through the plateau state machine
+        m_tags.clear();
+        m_dropped.clear();
+        const unsigned char * above = &m_above_threshold[0];
+        const float min_plateau = m_min_plateau.load(std::memory_order_relaxed);
+        int x = 0;
+        while(x < count)
+        {
+            // Nothing can happen until the next sample above the threshold
+            if(m_plateau_length == 0 && !m_plateau_flag)
+            {
+                const void * next = memchr(above + x, 1, count - x);
+                if(next == NULL) break;
+                x = static_cast<const unsigned char *>(next) - above;
+            }
 
-            if(corr > PLATEAU_THRESHOLD)
+            if(above[x])
             {
+                real_t re = m_sum_re[STS_LENGTH + x];
+                real_t im = m_sum_im[STS_LENGTH + x];
+                m_plateau_sum += std::sqrt(re * re + im * im) / m_sum_power[STS_LENGTH + x];
                 m_plateau_length++;
                 if(m_plateau_length == STS_PLATEAU_LENGTH)
                 {
-                    output_buffer[x].tag = STS_START;
+                    m_tags.push_back(stream_tag(x, STS_START));
                     m_plateau_flag = true;
                 }
             }
@@ -75,22 +239,153 @@ namespace fun
             {
                 if(m_plateau_flag)
                 {
-                    output_buffer[x].tag = STS_END;
+                    detection_quality quality;
+                    quality.plateau = m_plateau_sum / m_plateau_length;
+                    if(quality.plateau >= min_plateau) m_tags.push_back(stream_tag(x, STS_END, quality));
+                    else
+                    {
+                        m_rejected.fetch_add(1, std::memory_order_relaxed);
+                        m_dropped.push_back(x);
+                    }
                     m_plateau_flag = false;
                 }
                 m_plateau_length = 0;
+                m_plateau_sum = 0;
+            }
+            x++;
+        }
+
+        if(m_gate_log != NULL) gate_output();
+
+        // Carryover the last 16 input samples
+        for(int k = 0; k < STS_LENGTH; k++)
+        {
+            if(k + count < STS_LENGTH) m_carryover[k] = m_carryover[k + count];
+            else m_carryover[k] = input_buffer[k + count - STS_LENGTH];
+        }
+
+        if(m_gate_log == NULL)
+        {
+            // Pass the samples straight through by swapping buffers, only the tags are new
+            output_buffer.swap(input_buffer);
+            output_tags.swap(m_tags);
+        }
+        m_sample_count += count;
+    }
+
+    /*!
+     * While the gate is closed the block skips straight to the next #STS_START tag. Opening the
+     * gate first outputs the (up to #GATE_LOOKBACK) samples before the tag that haven't been output
+     * yet, some of which may come from earlier calls (#m_recent). Every #STS_START inside the gate
+     * keeps it open for another #GATE_HOLD_LENGTH samples.
+     *
+     * With a gate_feedback the reports that have come back since the last call are applied first,
+     * the ones about detections in earlier windows are stale and skipped. A plateau rejected by
+     * set_min_plateau() resolves its detection right here.
+     */
+    void frame_detector::gate_output()
+    {
+        int count = input_buffer.size();
+        output_buffer.resize(0);
+        output_tags.clear();
+
+        if(m_feedback != NULL)
+        {
+            unsigned long long sts_end;
+            while(m_feedback->no_lts.pop(sts_end))
+            {
+                if(m_gate_remaining == 0 || sts_end < m_window.gated_start) continue;
+                resolve_detection(m_window.raw_start + (sts_end - m_window.gated_start), 0);
+            }
+            frame_span frame;
+            while(m_feedback->frames.pop(frame))
+            {
+                if(m_gate_remaining == 0 || frame.start < m_window.raw_start) continue;
+                resolve_detection(frame.end, 0);
             }
+        }
 
-            // Pass through the sample
-            output_buffer[x].sample = input_buffer[x];
+        int t = 0;
+        int d = 0;
+        int x = 0;
+        while(x < count)
+        {
+            if(m_gate_remaining == 0)
+            {
+                // Closed: find the next start of an STS
+                while(t < m_tags.size() && m_tags[t].tag != STS_START) t++;
+                if(t == m_tags.size())
+                {
+                    m_closed_run = std::min(m_closed_run + (count - x), GATE_LOOKBACK);
+                    break;
+                }
+                int start = m_tags[t].offset;
+                int lookback = std::min(m_closed_run + (start - x), GATE_LOOKBACK);
+
+                gate_window window;
+                window.gated_start = m_gated_count + output_buffer.size();
+                window.raw_start = m_sample_count + start - lookback;
+                m_gate_log->push(window);
+                m_window = window;
+                m_unresolved = 0;
+                m_window_end = 0;
+
+                for(int k = start - lookback; k < start; k++)
+                {
+                    output_buffer.push_back((k < 0) ? m_recent[GATE_LOOKBACK + k] : input_buffer[k]);
+                }
+                x = start;
+                m_gate_remaining = GATE_HOLD_LENGTH;
+                m_closed_run = 0;
+            }
+
+            // Open: pass the samples through until the gate closes
+            for(; x < count && m_gate_remaining > 0; x++)
+            {
+                if(t < m_tags.size() && m_tags[t].offset == x)
+                {
+                    output_tags.push_back(stream_tag(output_buffer.size(), m_tags[t].tag, m_tags[t].quality));
+                    if(m_tags[t].tag == STS_START)
+                    {
+                        m_gate_remaining = GATE_HOLD_LENGTH;
+                        m_unresolved++;
+                    }
+                    t++;
+                }
+                while(d < m_dropped.size() && m_dropped[d] < x) d++;
+                if(m_feedback != NULL && d < m_dropped.size() && m_dropped[d] == x)
+                {
+                    resolve_detection(m_sample_count + x, x);
+                    if(m_gate_remaining == 0) break;
+                }
+                output_buffer.push_back(input_buffer[x]);
+                m_gate_remaining--;
+            }
         }
+        m_gated_count += output_buffer.size();
 
-        // Carryover the last 16 output samples
-        memcpy(&m_carryover[0],
-               &input_buffer[input_buffer.size() - STS_LENGTH],
-               STS_LENGTH * sizeof(std::complex<double>));
+        // Keep the last input samples around for the lookback
+        for(int k = 0; k < GATE_LOOKBACK; k++)
+        {
+            if(k + count < GATE_LOOKBACK) m_recent[k] = m_recent[k + count];
+            else m_recent[k] = input_buffer[k + count - GATE_LOOKBACK];
+        }
     }
 
-}
+    /*!
+     * Once the last detection in the window is resolved the gate is only held open until
+     * #GATE_TAIL_LENGTH samples past the end of the latest one, closing it straight away
+     * if that has been passed already. It is never held open for longer than it already was.
+     */
+    void frame_detector::resolve_detection(unsigned long long end, int x)
+    {
+        if(m_unresolved == 0) return;
+        m_window_end = std::max(m_window_end, end);
+        if(--m_unresolved > 0) return;
 
+        long long remaining = static_cast<long long>(m_window_end + GATE_TAIL_LENGTH) -
+                              static_cast<long long>(m_sample_count + x);
+        m_gate_remaining = std::max(0LL, std::min(remaining, static_cast<long long>(m_gate_remaining)));
+    }
 
+}
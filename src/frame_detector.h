@@ -14,42 +14,175 @@
 
 #define STS_LENGTH 16
 
+/*! \def GATE_LOOKBACK
+ *  \brief Number of samples before each #STS_START that are kept when gating.
+ *
+ *  The #STS_START tag is set partway into the STS so this has to cover the start of the STS.
+ */
+#define GATE_LOOKBACK 320
+
+/*! \def GATE_HOLD_LENGTH
+ *  \brief Number of samples starting at each #STS_START that are kept when gating.
+ *
+ *  This covers a #MAX_FRAME_SIZE frame at the lowest rate (40640 samples including the preamble)
+ *  plus the 160 samples held back in the timing_sync block's carryover, which would otherwise
+ *  only come out with the next window.
+ */
+#define GATE_HOLD_LENGTH 41000
+
+/*! \def GATE_TAIL_LENGTH
+ *  \brief Number of samples kept after the end of a detection once the gate_feedback has resolved it.
+ *
+ *  Covers the 160 samples held back in the timing_sync block's carryover plus some slack for the
+ *  error in the frame's estimated start (tagged_vector::sample_index).
+ */
+#define GATE_TAIL_LENGTH 320
+
+/*! \def GATE_LOG_SIZE
+ *  \brief Capacity of the queue passing gate_windows from the frame_detector to the fft_symbols block.
+ */
+#define GATE_LOG_SIZE 64
+
 #include <complex>
+#include <utility>
+#include <atomic>
 
 #include "block.h"
 #include "tagged_vector.h"
-#include "circular_accumulator.h"
+#include "spsc_queue.h"
 
 namespace fun
 {
+    /*!
+     * \brief Signature of the vectorized detection kernels.
+     *
+     * See frame_detector.cpp for the SSE and AVX2 versions that are selected
+     * between at runtime.
+     */
+    typedef void (*detector_kernel)(const complex_t * input, const complex_t * carryover, int count,
+                                    real_t * history, real_t * sum_re, real_t * sum_im, real_t * sum_power,
+                                    real_t * scratch_re, real_t * scratch_im, real_t * scratch_power,
+                                    unsigned char * above_threshold);
+
+    /*!
+     * \brief The gate_window struct marks where a window of samples kept by a gated frame_detector starts.
+     *
+     * The frame_detector's output is a subsequence of its input when it is gated. Passing the start of
+     * each window downstream lets the fft_symbols block map the gated samples back to their index in the
+     * receiver_chain's input (see tagged_vector::sample_index).
+     */
+    struct gate_window
+    {
+        unsigned long long gated_start; //!< Index of the window's first sample in the frame_detector's output
+        unsigned long long raw_start;   //!< Index of the same sample in the frame_detector's input
+
+        gate_window() : gated_start(0), raw_start(0) {} //!< Constructor for the window starting at the first sample
+    };
+
+    /*!
+     * \brief The frame_span struct gives the extent of a frame in the frame_detector's input.
+     */
+    struct frame_span
+    {
+        unsigned long long start; //!< Index of the frame's first sample (see tagged_vector::sample_index)
+        unsigned long long end;   //!< Index just past the frame's last sample
+
+        frame_span() : start(0), end(0) {} //!< Constructor for an empty span
+    };
+
+    /*!
+     * \brief The gate_feedback struct passes what the blocks downstream of a gated frame_detector learn about
+     *  each detection back up to it.
+     *
+     * Without it the gate is held open for #GATE_HOLD_LENGTH samples after every #STS_START, false alarms
+     * included. With it the gate closes #GATE_TAIL_LENGTH samples after the end of the last detection in the
+     * window once every detection has been resolved, either by the timing_sync finding no LTS after its
+     * #STS_END or by the frame_decoder reading the frame's length from its SIGNAL field. A report that never
+     * arrives (a full queue, a frame lost in between) just leaves the gate open for the full hold.
+     */
+    struct gate_feedback
+    {
+        spsc_queue<unsigned long long> no_lts; //!< Output index of every #STS_END the timing_sync found no LTS after
+        spsc_queue<frame_span> frames;         //!< Every frame whose SIGNAL symbol reached the frame_decoder
+
+        gate_feedback() : no_lts(GATE_LOG_SIZE), frames(GATE_LOG_SIZE) {} //!< Constructor
+    };
+
     /*!
      * \brief The frame_detector block.
      *
      * Inputs complex doubles from USRP block.
-     * Outputs tagged samples to timing sync block.
+     * Outputs the samples & their #STS_START / #STS_END tags (see block::output_tags) to timing sync block.
      *
      * This block is in charge of detecting the beginning of a frame using the
      * short training sequence in the preamble.
+     *
+     * When gated the block only outputs the samples from #GATE_LOOKBACK samples before each
+     * #STS_START until #GATE_HOLD_LENGTH samples after the latest one, so the blocks downstream
+     * have nothing to do while the channel is idle.
      */
-    class frame_detector : public fun::block<std::complex<double>, tagged_sample>
+    class frame_detector : public fun::block<complex_t, complex_t>
     {
     public:
 
-        frame_detector(); //!< Constructor for frame_detector block.
+        /*!
+         * \brief Constructor for frame_detector block.
+         * \param gate_log [Optional] If set the block is gated and pushes a gate_window into the
+         *  queue every time it opens the gate. The queue's consumer must be the fft_symbols block.
+         * \param feedback [Optional] Lets a gated block close its gate early, the timing_sync and
+         *  frame_decoder blocks downstream must be given the same one.
+         */
+        frame_detector(spsc_queue<gate_window> * gate_log = NULL, gate_feedback * feedback = NULL);
 
         virtual void work(); //!< Signal processing happens here.
 
+        /*!
+         * \brief Sets the lowest detection_quality::plateau of a plateau that is passed on as a frame.
+         * \param level Plateaus whose mean normalized correlation is below it get no #STS_END tag, so the
+         *  timing_sync never searches for their LTS. 0 (the default) passes every plateau on.
+         *
+         * Can be called from any thread, it applies from the next call to work().
+         */
+        void set_min_plateau(float level) { m_min_plateau.store(level, std::memory_order_relaxed); }
+
+        /*!
+         * \brief Number of plateaus rejected because of set_min_plateau(). Can be called from any thread.
+         */
+        unsigned long long rejected() const { return m_rejected.load(std::memory_order_relaxed); }
+
     private:
 
         /*!
-         * \brief Circular accumulator for calculating correlation.
+         * \brief The kernel used to compute the normalized auto-correlation.
+         *
+         * Chosen in the constructor based on the instruction sets the CPU supports.
          */
-        circular_accumulator<std::complex<double> > m_corr_acc;
+        detector_kernel m_kernel;
 
         /*!
-         * \brief Circular accumulator for calculating correlation.
+         * \brief The last #STS_LENGTH per sample correlations (real parts, imaginary
+         * parts and then powers) carried over to the next call to #work() so the
+         * sliding windows can span calls.
          */
-        circular_accumulator<double> m_power_acc;
+        real_t m_history[3 * STS_LENGTH];
+
+        std::vector<real_t> m_sum_re; //!< Sliding window sum of the correlation (real part).
+
+        std::vector<real_t> m_sum_im; //!< Sliding window sum of the correlation (imaginary part).
+
+        std::vector<real_t> m_sum_power; //!< Sliding window sum of the input power.
+
+        std::vector<real_t> m_scratch_re; //!< Scratch space for computing #m_sum_re.
+
+        std::vector<real_t> m_scratch_im; //!< Scratch space for computing #m_sum_im.
+
+        std::vector<real_t> m_scratch_power; //!< Scratch space for computing #m_sum_power.
+
+        /*!
+         * \brief Flags marking which input samples have a normalized correlation
+         * above #PLATEAU_THRESHOLD.
+         */
+        std::vector<unsigned char> m_above_threshold;
 
         /*!
          * \brief Counter for keeping track of STS plateau length.
@@ -62,11 +195,56 @@ namespace fun
          */
         bool m_plateau_flag;
 
+        /*!
+         * \brief Sum of the normalized correlation over the current run of samples above the threshold.
+         */
+        double m_plateau_sum;
+
+        std::atomic<float> m_min_plateau; //!< See set_min_plateau()
+
+        std::atomic<unsigned long long> m_rejected; //!< See rejected()
+
         /*!
          * \brief Vector for storing the last 16 samples from the input_buffer
          * and carrying them over to the next call to #work()
          */
-        std::vector<std::complex<double> > m_carryover;
+        std::vector<complex_t > m_carryover;
+
+        /*!
+         * \brief Writes the input samples that are inside the gate to the output_buffer.
+         */
+        void gate_output();
+
+        /*!
+         * \brief Marks one of the detections in the current gate window as resolved.
+         * \param end Index (in the input) just past the end of the detection or its frame
+         * \param x The offset into the input_buffer the gate has got to
+         */
+        void resolve_detection(unsigned long long end, int x);
+
+        std::vector<stream_tag> m_tags; //!< The tags set by the current call to #work() (offsets into #input_buffer)
+
+        spsc_queue<gate_window> * m_gate_log; //!< Where the gate windows are pushed, NULL if the block isn't gated
+
+        int m_gate_remaining; //!< Number of samples left before the gate closes (0 if it is closed)
+
+        int m_closed_run; //!< Number of input samples (up to #GATE_LOOKBACK) since the gate last closed
+
+        std::vector<complex_t > m_recent; //!< The last #GATE_LOOKBACK input samples, for the lookback across calls
+
+        unsigned long long m_sample_count; //!< Number of samples input before the current call to #work()
+
+        unsigned long long m_gated_count; //!< Number of samples output before the current call to #work()
+
+        gate_feedback * m_feedback; //!< The reports from the blocks downstream (NULL if the gate only closes after the hold)
+
+        gate_window m_window; //!< The current (or last) gate window
+
+        int m_unresolved; //!< Number of detections in #m_window that haven't been reported on yet
+
+        unsigned long long m_window_end; //!< Index (in the input) just past the latest detection resolved in #m_window
+
+        std::vector<int> m_dropped; //!< Offsets into the input_buffer where set_min_plateau() rejected a plateau
     };
 }
 
@@ -0,0 +1,73 @@
+/*! \file freq_domain.cpp
+ *  \brief C++ file for the Frequency Domain block.
+ *
+ *  The Frequency Domain block fuses the fft_symbols, channel_est and phase_tracker blocks
+ *  into a single block so that each symbol goes through all three while it is still in cache.
+ */
+
+#include <algorithm>
+
+#include "freq_domain.h"
+
+namespace fun
+{
+    /*!
+     * - Initializations:
+     *   + #m_fft_symbols -> fft_symbols block using the gate_log, FFT backend and limit on the symbols per frame
+     *   + #m_channel_est -> channel_est block, smoothing its estimate if asked to
+     *   + #m_phase_tracker -> phase_tracker block
+     *
+     *  Only the stages' state and their process() functions are used, never their buffers.
+     */
+    freq_domain::freq_domain(spsc_queue<gate_window> * gate_log, bool smoothing, fft_backend backend, int max_symbols) :
+        block("freq_domain", 1, 80 /* one symbol per 80 samples */),
+        m_fft_symbols(new fft_symbols(gate_log, backend, max_symbols)),
+        m_channel_est(new channel_est(smoothing)),
+        m_phase_tracker(new phase_tracker())
+    {
+        m_symbols.reserve(FFT_BATCH_SIZE + 2);
+        m_equalized.reserve(FFT_BATCH_SIZE + 2);
+    }
+
+    freq_domain::~freq_domain()
+    {
+        delete m_fft_symbols;
+        delete m_channel_est;
+        delete m_phase_tracker;
+    }
+
+    /*!
+     * The input is cut into slices of #FUSED_SLICE_LENGTH samples. Each slice is turned into
+     * symbols, equalized and phase corrected before moving on to the next one, with the
+     * corrected symbols going straight into the output buffer. Since every stage keeps its
+     * state from one call to the next the output is the same as running the three blocks.
+     */
+    void freq_domain::work()
+    {
+        output_buffer.resize(0);
+        if(input_buffer.size() == 0) return;
+
+        int t = 0;
+        for(int start = 0; start < input_buffer.size(); start += FUSED_SLICE_LENGTH)
+        {
+            int count = std::min<int>(FUSED_SLICE_LENGTH, input_buffer.size() - start);
+
+            // Tags of this slice
+            m_slice_tags.clear();
+            for(; t < input_tags.size() && input_tags[t].offset < start + count; t++)
+            {
+                m_slice_tags.push_back(stream_tag(input_tags[t].offset - start, input_tags[t].tag, input_tags[t].quality));
+            }
+
+            m_symbols.clear();
+            m_fft_symbols->process(&input_buffer[start], count, m_slice_tags, m_symbols);
+            if(m_symbols.empty()) continue;
+
+            m_equalized.clear();
+            m_channel_est->process(&m_symbols[0], m_symbols.size(), m_equalized);
+            if(m_equalized.empty()) continue;
+
+            m_phase_tracker->process(&m_equalized[0], m_equalized.size(), output_buffer);
+        }
+    }
+}
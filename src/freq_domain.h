@@ -0,0 +1,77 @@
+/*! \file freq_domain.h
+ *  \brief Header file for the Frequency Domain block.
+ *
+ *  The Frequency Domain block fuses the fft_symbols, channel_est and phase_tracker blocks
+ *  into a single block so that each symbol goes through all three while it is still in cache.
+ */
+
+#ifndef FREQ_DOMAIN_H
+#define FREQ_DOMAIN_H
+
+/*! \def FUSED_SLICE_LENGTH
+ *  \brief Number of input samples the freq_domain block passes through all three stages at a time.
+ *
+ *  This is one #FFT_BATCH_SIZE batch of 80 sample symbols so the batched FFT still runs on full
+ *  batches while the symbols of a slice (about 16KB) stay in the L1 cache between the stages.
+ */
+#define FUSED_SLICE_LENGTH (FFT_BATCH_SIZE * 80)
+
+#include <vector>
+
+#include "block.h"
+#include "tagged_vector.h"
+#include "fft.h"
+#include "fft_symbols.h"
+#include "channel_est.h"
+#include "phase_tracker.h"
+
+namespace fun
+{
+    /*!
+     * \brief The freq_domain block.
+     *
+     * Inputs samples & their tags from timing_sync block (time domain samples).
+     * Outputs tagged_vector<48> to frame_decoder block.
+     *
+     * This block does exactly what the fft_symbols, channel_est and phase_tracker blocks do one
+     * after the other, but it runs all three on one slice of #FUSED_SLICE_LENGTH samples at a time
+     * instead of each block making a pass over the whole buffer. In the receiver_chain it takes the
+     * place of the three blocks (see receiver_chain_params::fused), which saves two threads, two
+     * buffer hand-offs per chunk and two round trips of every symbol through memory.
+     */
+    class freq_domain : public fun::block<complex_t, tagged_vector<48> >
+    {
+    public:
+
+        /*!
+         * \brief Constructor for freq_domain block.
+         * \param gate_log [Optional] The queue a gated frame_detector pushes its gate windows into
+         *  (see fft_symbols::fft_symbols()).
+         * \param smoothing [Optional] Whether to smooth the channel estimate (see channel_est::channel_est()).
+         * \param backend [Optional] Implementation of the forward FFT (see fft_backend).
+         * \param max_symbols [Optional] Most symbols per frame, 0 for every symbol (see fft_symbols::fft_symbols()).
+         */
+        freq_domain(spsc_queue<gate_window> * gate_log = NULL, bool smoothing = false, fft_backend backend = FFT_BACKEND_FFTW,
+                    int max_symbols = 0);
+
+        virtual ~freq_domain(); //!< Deletes the stages
+
+        virtual void work(); //!< Signal processing happens here.
+
+    private:
+
+        fft_symbols * m_fft_symbols;      //!< Forward FFT of symbols
+
+        channel_est * m_channel_est;      //!< Channel estimation and equalization in freq domain
+
+        phase_tracker * m_phase_tracker;  //!< Phase rotation tracking
+
+        std::vector<stream_tag> m_slice_tags; //!< The tags of the current slice (offsets relative to the slice)
+
+        std::vector<tagged_vector<64> > m_symbols; //!< The symbols of the current slice
+
+        std::vector<tagged_vector<64> > m_equalized; //!< The equalized symbols of the current slice
+    };
+}
+
+#endif // FREQ_DOMAIN_H
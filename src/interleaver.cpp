@@ -11,30 +11,112 @@
 
 namespace fun
 {
-    // Interleave some data
-    std::vector<unsigned char> interleaver::interleave(std::vector<unsigned char> data)
+    /*!
+     * \brief The permutation tables for one PHY rate.
+     */
+    struct interleave_table
+    {
+        int cbps;                          //!< Coded bits per symbol
+        unsigned short forward[288];       //!< Position of each coded bit after interleaving
+        unsigned short inverse[288];       //!< Position of each received bit after deinterleaving
+
+        /*!
+         * \brief Builds the tables for the given rate
+         * \param rate_params Parameters of the PHY rate
+         */
+        interleave_table(RateParams rate_params)
+        {
+            cbps = rate_params.cbps;
+#ifdef FUN_OFDM_LEGACY_INTERLEAVER
+            // Older builds permuted every rate in 48 bit blocks with the BPSK map
+            BitInterleave bi(48 /* data subcarriers */, 1);
+            for(int k = 0; k < cbps; k++)
+            {
+                int j = (k / 48) * 48 + bi.index(k % 48);
+                forward[k] = j;
+                inverse[j] = k;
+            }
+#else
+            BitInterleave bi(48 /* data subcarriers */, rate_params.bpsc);
+            for(int k = 0; k < cbps; k++)
+            {
+                forward[k] = bi.index(k);
+                inverse[bi.index(k)] = k;
+            }
+#endif
+        }
+    };
+
+    /*!
+     * The tables for all 11 rates are built the first time any of them are needed.
+     */
+    static const interleave_table & get_interleave_table(Rate rate)
     {
-        std::vector<unsigned int> interleave_map;
-        BitInterleave(48, 1).fill(interleave_map, false);
+        static const interleave_table tables[11] =
+        {
+            interleave_table(RateParams(RATE_1_2_BPSK)),
+            interleave_table(RateParams(RATE_2_3_BPSK)),
+            interleave_table(RateParams(RATE_3_4_BPSK)),
+            interleave_table(RateParams(RATE_1_2_QPSK)),
+            interleave_table(RateParams(RATE_2_3_QPSK)),
+            interleave_table(RateParams(RATE_3_4_QPSK)),
+            interleave_table(RateParams(RATE_1_2_QAM16)),
+            interleave_table(RateParams(RATE_2_3_QAM16)),
+            interleave_table(RateParams(RATE_3_4_QAM16)),
+            interleave_table(RateParams(RATE_2_3_QAM64)),
+            interleave_table(RateParams(RATE_3_4_QAM64)),
+        };
+        return tables[rate];
+    }
+
+    const unsigned short * interleaver::interleave_map(Rate rate)
+    {
+        return get_interleave_table(rate).forward;
+    }
+
+    const unsigned short * interleaver::deinterleave_map(Rate rate)
+    {
+        return get_interleave_table(rate).inverse;
+    }
 
+    /*!
+     * Interleaved bit j of each symbol is gathered from coded bit inverse[j], so the output
+     * is written sequentially and the loads are independent of each other.
+     */
+    void interleaver::interleave(const unsigned char * in, unsigned char * out, int count, Rate rate)
+    {
+        const interleave_table & table = get_interleave_table(rate);
+        assert(count % table.cbps == 0);
+        for(int x = 0; x < count; x += table.cbps)
+            for(int j = 0; j < table.cbps; j++)
+                out[x + j] = in[x + table.inverse[j]];
+    }
+
+    /*!
+     * Deinterleaved bit k of each symbol is gathered from received bit forward[k].
+     */
+    void interleaver::deinterleave(const unsigned char * in, unsigned char * out, int count, Rate rate)
+    {
+        const interleave_table & table = get_interleave_table(rate);
+        assert(count % table.cbps == 0);
+        for(int x = 0; x < count; x += table.cbps)
+            for(int k = 0; k < table.cbps; k++)
+                out[x + k] = in[x + table.forward[k]];
+    }
+
+    // Interleave some data
+    std::vector<unsigned char> interleaver::interleave(const std::vector<unsigned char> & data, Rate rate)
+    {
         std::vector<unsigned char> data_interleaved(data.size());
-        for(int x = 0; x < data.size(); x += interleave_map.size())
-            for(int y = 0; y < interleave_map.size(); y++)
-                data_interleaved[x + interleave_map[y]] = data[x + y];
+        interleave(data.data(), data_interleaved.data(), data.size(), rate);
         return data_interleaved;
     }
 
     // Deinterleave some data
-    std::vector<unsigned char> interleaver::deinterleave(std::vector<unsigned char> data)
+    std::vector<unsigned char> interleaver::deinterleave(const std::vector<unsigned char> & data, Rate rate)
     {
-        std::vector<unsigned int> deinterleave_map;
-        BitInterleave(48, 1).fill(deinterleave_map, true);
-
-        std::vector<unsigned char>data_deinterleaved(data.size());
-        for(int s = 0; s < data.size(); s += deinterleave_map.size())
-            for(int t = 0; t < deinterleave_map.size(); t++)
-                data_deinterleaved[s + deinterleave_map[t]] = data[s + t];
+        std::vector<unsigned char> data_deinterleaved(data.size());
+        deinterleave(data.data(), data_deinterleaved.data(), data.size(), rate);
         return data_deinterleaved;
     }
 }
-
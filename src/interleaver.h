@@ -6,6 +6,14 @@
  * interleave and deinterleave and thus doesn't need a constructor. However, it does
  * use the BitInterleave struct as a helper for these two functions.
  *
+ * The permutation for each PHY rate is only computed once by BitInterleave, after that
+ * interleaving is a straight table driven gather over the whole frame.
+ *
+ * \warning Older fun_ofdm builds interleaved every rate in 48 bit blocks with the BPSK
+ *  permutation. The QPSK, QAM16 and QAM64 rates now use the per rate permutation of
+ *  17.3.5.6, so their frames are not decodable by older builds (and vice versa). BPSK
+ *  frames, including every header, are unchanged. Define FUN_OFDM_LEGACY_INTERLEAVER
+ *  (the cmake option of the same name) to keep the old order.
  */
 
 #ifndef INTERLEAVER_H
@@ -27,6 +35,9 @@ namespace fun
      * the 802.11a-1999 standard. The Interleaver class contains two static functions:
      * interleave and deinterleave and thus doesn't need a constructor. However, it does
      * use the BitInterleave struct as a helper for these two functions.
+     *
+     * \warning The non-BPSK rates are not interoperable with older fun_ofdm builds unless
+     *  FUN_OFDM_LEGACY_INTERLEAVER is defined (see interleaver.h).
      */
     class interleaver
     {
@@ -35,16 +46,54 @@ namespace fun
         /*!
          * \brief interleaves the data
          * \param data Vector of data to be interleaved
+         * \param rate PHY rate of the data which determines the coded bits per symbol.
+         *  Defaults to RATE_1_2_BPSK (i.e. the header).
          * \return Vector of interleaved data
          */
-        static std::vector<unsigned char> interleave(std::vector<unsigned char> data);
+        static std::vector<unsigned char> interleave(const std::vector<unsigned char> & data, Rate rate = RATE_1_2_BPSK);
 
         /*!
          * \brief deinterleaves the data
          * \param data Vector of data to be deinterleaved
+         * \param rate PHY rate of the data which determines the coded bits per symbol
+         *  Defaults to RATE_1_2_BPSK (i.e. the header).
          * \return Vector of deinterleaved data
          */
-        static std::vector<unsigned char> deinterleave(std::vector<unsigned char> data);
+        static std::vector<unsigned char> deinterleave(const std::vector<unsigned char> & data, Rate rate = RATE_1_2_BPSK);
+
+        /*!
+         * \brief interleaves the data without allocating
+         * \param in The data to be interleaved
+         * \param out Output buffer of count interleaved bits (must not overlap in)
+         * \param count Number of bits, must be a multiple of the rate's coded bits per symbol
+         * \param rate PHY rate of the data
+         */
+        static void interleave(const unsigned char * in, unsigned char * out, int count, Rate rate);
+
+        /*!
+         * \brief deinterleaves the data without allocating
+         * \param in The data to be deinterleaved
+         * \param out Output buffer of count deinterleaved bits (must not overlap in)
+         * \param count Number of bits, must be a multiple of the rate's coded bits per symbol
+         * \param rate PHY rate of the data
+         */
+        static void deinterleave(const unsigned char * in, unsigned char * out, int count, Rate rate);
+
+        /*!
+         * \brief Gets the deinterleaving permutation for one OFDM symbol.
+         * \param rate PHY rate
+         * \return Table of the rate's coded bits per symbol entries. Entry t is the position
+         *  that the t'th received bit of a symbol is moved to by deinterleaving.
+         */
+        static const unsigned short * deinterleave_map(Rate rate);
+
+        /*!
+         * \brief Gets the interleaving permutation for one OFDM symbol.
+         * \param rate PHY rate
+         * \return Table of the rate's coded bits per symbol entries. Entry k is the position
+         *  that the k'th coded bit of a symbol is moved to by interleaving.
+         */
+        static const unsigned short * interleave_map(Rate rate);
 
     };
 
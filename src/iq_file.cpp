@@ -0,0 +1,307 @@
+/*! \file iq_file.cpp
+ *  \brief C++ file for the iq_file_source and iq_file_sink classes.
+ *
+ *  These classes read and write raw IQ captures (interleaved cf32, cf64 or sc16 samples,
+ *  optionally described by a SigMF metadata file) so that recorded samples can be replayed
+ *  through the receiver_chain and frames from the frame_builder can be recorded, without a USRP
+ *  and as fast as the CPU allows.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "iq_file.h"
+
+namespace fun
+{
+    //! SigMF datatype name of each iq_format
+    static const char * SIGMF_DATATYPES[3] = {"cf32_le", "cf64_le", "ci16_le"};
+
+    /*!
+     * \brief Checks whether a string ends with a suffix
+     */
+    static bool ends_with(const std::string & s, const std::string & suffix)
+    {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    /*!
+     * \brief Whether complex_t is laid out exactly like the samples of the format
+     */
+    static bool is_native(iq_format format)
+    {
+        return (format == IQ_CF32 && sizeof(real_t) == 4) || (format == IQ_CF64 && sizeof(real_t) == 8);
+    }
+
+    int iq_sample_size(iq_format format)
+    {
+        switch(format)
+        {
+            case IQ_CF32: return 8;
+            case IQ_CF64: return 16;
+            case IQ_SC16: return 4;
+        }
+        return 8;
+    }
+
+    /*!
+     * The whole file is mapped read only and the kernel is told it will be read sequentially
+     * so it reads ahead aggressively. A trailing partial sample is ignored.
+     */
+    iq_file_source::iq_file_source(std::string path, iq_format format) :
+        m_format(format),
+        m_sample_rate(0),
+        m_data(NULL),
+        m_bytes(0),
+        m_size(0),
+        m_position(0)
+    {
+        std::string data_path = path;
+        if(ends_with(path, ".sigmf-meta")) data_path = path.substr(0, path.size() - 4) + "data";
+        if(ends_with(data_path, ".sigmf-data")) read_sigmf(data_path.substr(0, data_path.size() - 4) + "meta");
+
+        int fd = open(data_path.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            std::cerr << "Unable to open IQ file " << data_path << ": " << strerror(errno) << std::endl;
+            return;
+        }
+
+        struct stat info;
+        if(fstat(fd, &info) != 0)
+        {
+            std::cerr << "Unable to stat IQ file " << data_path << ": " << strerror(errno) << std::endl;
+        }
+        else if(info.st_size == 0)
+        {
+            // An empty file is open but has no samples
+            m_data = reinterpret_cast<const unsigned char *>("");
+        }
+        else
+        {
+            void * data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(data == MAP_FAILED)
+            {
+                std::cerr << "Unable to map IQ file " << data_path << ": " << strerror(errno) << std::endl;
+            }
+            else
+            {
+                madvise(data, info.st_size, MADV_SEQUENTIAL);
+                m_data = static_cast<const unsigned char *>(data);
+                m_bytes = info.st_size;
+                m_size = m_bytes / iq_sample_size(m_format);
+            }
+        }
+        close(fd); // The mapping stays valid
+    }
+
+    iq_file_source::~iq_file_source()
+    {
+        if(m_bytes > 0) munmap(const_cast<unsigned char *>(m_data), m_bytes);
+    }
+
+    /*!
+     * Only the global core:datatype & core:sample_rate fields are used.
+     */
+    void iq_file_source::read_sigmf(std::string meta_path)
+    {
+        std::ifstream meta(meta_path.c_str());
+        if(!meta.is_open()) return;
+
+        boost::property_tree::ptree tree;
+        try
+        {
+            boost::property_tree::read_json(meta, tree);
+        }
+        catch(boost::property_tree::json_parser_error & error)
+        {
+            std::cerr << "Unable to parse SigMF metadata " << meta_path << ": " << error.what() << std::endl;
+            return;
+        }
+
+        std::string datatype = tree.get<std::string>("global.core:datatype", "");
+        bool known = false;
+        for(int f = 0; f < 3; f++)
+        {
+            if(datatype == SIGMF_DATATYPES[f])
+            {
+                m_format = iq_format(f);
+                known = true;
+            }
+        }
+        if(!known) std::cerr << "Unsupported SigMF datatype " << datatype << " in " << meta_path << std::endl;
+        m_sample_rate = tree.get<double>("global.core:sample_rate", 0);
+    }
+
+    bool iq_file_source::is_open() { return m_data != NULL; }
+
+    iq_format iq_file_source::format() { return m_format; }
+
+    double iq_file_source::sample_rate() { return m_sample_rate; }
+
+    unsigned long long iq_file_source::size() { return m_size; }
+
+    unsigned long long iq_file_source::position() { return m_position; }
+
+    void iq_file_source::seek(unsigned long long sample)
+    {
+        m_position = std::min(sample, m_size);
+    }
+
+    /*!
+     * The samples are converted straight from the mapping into the buffer.
+     */
+    int iq_file_source::read(std::vector<complex_t > & buffer, int count)
+    {
+        int n = std::min<unsigned long long>(count, m_size - m_position);
+        buffer.resize(n);
+        if(n == 0) return 0;
+        read_at(m_position, &buffer[0], n);
+        m_position += n;
+        return n;
+    }
+
+    int iq_file_source::read_at(unsigned long long position, complex_t * buffer, int count) const
+    {
+        if(position >= m_size) return 0;
+        int n = std::min<unsigned long long>(count, m_size - position);
+
+        const unsigned char * data = m_data + position * iq_sample_size(m_format);
+        if(is_native(m_format))
+        {
+            memcpy(buffer, data, n * sizeof(complex_t));
+        }
+        else if(m_format == IQ_CF32)
+        {
+            const float * in = reinterpret_cast<const float *>(data);
+            for(int x = 0; x < n; x++) buffer[x] = complex_t(in[2 * x], in[2 * x + 1]);
+        }
+        else if(m_format == IQ_CF64)
+        {
+            const double * in = reinterpret_cast<const double *>(data);
+            for(int x = 0; x < n; x++) buffer[x] = complex_t(in[2 * x], in[2 * x + 1]);
+        }
+        else
+        {
+            const short * in = reinterpret_cast<const short *>(data);
+            const real_t scale = real_t(1.0 / 32768.0);
+            for(int x = 0; x < n; x++) buffer[x] = complex_t(in[2 * x] * scale, in[2 * x + 1] * scale);
+        }
+        return n;
+    }
+
+    const complex_t * iq_file_source::samples()
+    {
+        if(!is_native(m_format) || m_bytes == 0) return NULL;
+        return reinterpret_cast<const complex_t *>(m_data);
+    }
+
+    iq_file_sink::iq_file_sink(std::string path, iq_format format, double sample_rate) :
+        m_format(format),
+        m_sample_rate(sample_rate),
+        m_size(0)
+    {
+        if(ends_with(path, ".sigmf-data")) m_meta_path = path.substr(0, path.size() - 4) + "meta";
+
+        m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(m_fd < 0) std::cerr << "Unable to open IQ file " << path << ": " << strerror(errno) << std::endl;
+    }
+
+    /*!
+     * The metadata is written by hand since boost's JSON writer quotes numbers.
+     */
+    iq_file_sink::~iq_file_sink()
+    {
+        if(m_fd < 0) return;
+        close(m_fd);
+
+        if(m_meta_path.empty()) return;
+        std::ofstream meta(m_meta_path.c_str());
+        meta.precision(17);
+        meta << "{" << std::endl
+             << "    \"global\": {" << std::endl
+             << "        \"core:datatype\": \"" << SIGMF_DATATYPES[m_format] << "\"," << std::endl;
+        if(m_sample_rate > 0) meta << "        \"core:sample_rate\": " << m_sample_rate << "," << std::endl;
+        meta << "        \"core:version\": \"1.0.0\"," << std::endl
+             << "        \"core:recorder\": \"fun_ofdm\"" << std::endl
+             << "    }," << std::endl
+             << "    \"captures\": [{\"core:sample_start\": 0}]," << std::endl
+             << "    \"annotations\": []" << std::endl
+             << "}" << std::endl;
+    }
+
+    bool iq_file_sink::is_open() { return m_fd >= 0; }
+
+    unsigned long long iq_file_sink::size() { return m_size; }
+
+    bool iq_file_sink::write(const std::vector<complex_t > & samples)
+    {
+        if(samples.empty()) return true;
+        return write(&samples[0], samples.size());
+    }
+
+    bool iq_file_sink::write(const complex_t * samples, int count)
+    {
+        if(m_fd < 0) return false;
+
+        const unsigned char * data = reinterpret_cast<const unsigned char *>(samples);
+        size_t bytes = size_t(count) * iq_sample_size(m_format);
+        if(!is_native(m_format))
+        {
+            m_buffer.resize(bytes);
+            data = &m_buffer[0];
+            if(m_format == IQ_CF32)
+            {
+                float * out = reinterpret_cast<float *>(&m_buffer[0]);
+                for(int x = 0; x < count; x++)
+                {
+                    out[2 * x] = samples[x].real();
+                    out[2 * x + 1] = samples[x].imag();
+                }
+            }
+            else if(m_format == IQ_CF64)
+            {
+                double * out = reinterpret_cast<double *>(&m_buffer[0]);
+                for(int x = 0; x < count; x++)
+                {
+                    out[2 * x] = samples[x].real();
+                    out[2 * x + 1] = samples[x].imag();
+                }
+            }
+            else
+            {
+                short * out = reinterpret_cast<short *>(&m_buffer[0]);
+                for(int x = 0; x < count; x++)
+                {
+                    out[2 * x] = short(std::max(-32768.0, std::min(32767.0, std::floor(samples[x].real() * 32768.0 + 0.5))));
+                    out[2 * x + 1] = short(std::max(-32768.0, std::min(32767.0, std::floor(samples[x].imag() * 32768.0 + 0.5))));
+                }
+            }
+        }
+
+        while(bytes > 0)
+        {
+            ssize_t written = ::write(m_fd, data, bytes);
+            if(written < 0)
+            {
+                if(errno == EINTR) continue;
+                std::cerr << "Unable to write IQ file: " << strerror(errno) << std::endl;
+                return false;
+            }
+            data += written;
+            bytes -= written;
+        }
+        m_size += count;
+        return true;
+    }
+}
@@ -0,0 +1,175 @@
+/*! \file iq_file.h
+ *  \brief Header file for the iq_file_source and iq_file_sink classes.
+ *
+ *  These classes read and write raw IQ captures (interleaved cf32, cf64 or sc16 samples,
+ *  optionally described by a SigMF metadata file) so that recorded samples can be replayed
+ *  through the receiver_chain and frames from the frame_builder can be recorded, without a USRP
+ *  and as fast as the CPU allows.
+ */
+
+#ifndef IQ_FILE_H
+#define IQ_FILE_H
+
+#include <string>
+#include <vector>
+
+#include "precision.h"
+
+namespace fun
+{
+    /*!
+     * \brief The sample formats of an IQ file. Every format is little endian.
+     */
+    enum iq_format
+    {
+        IQ_CF32 = 0,    //!< Interleaved 32 bit floats (SigMF cf32_le, UHD fc32)
+        IQ_CF64,        //!< Interleaved 64 bit doubles (SigMF cf64_le, UHD fc64)
+        IQ_SC16,        //!< Interleaved 16 bit integers scaled so that 32768 is 1.0 (SigMF ci16_le, UHD sc16)
+    };
+
+    /*!
+     * \brief Gets the size of one sample in bytes.
+     * \param format The sample format
+     */
+    int iq_sample_size(iq_format format);
+
+    /*!
+     * \brief The iq_file_source class reads a memory mapped IQ file.
+     *
+     *  Usage: Open the file then call read() repeatedly to get the samples a chunk at a time,
+     *  i.e. in exactly the way receiver_chain::process_buffer() takes them. The file is mapped
+     *  into memory instead of being read so the only copy of the samples is the one into the
+     *  chunk, which is also where they are converted to complex_t.
+     *
+     *  If the file is a SigMF recording (i.e. foo.sigmf-data next to foo.sigmf-meta, either name
+     *  can be given) the sample format and rate are taken from the metadata.
+     */
+    class iq_file_source
+    {
+    public:
+
+        /*!
+         * \brief Constructor for iq_file_source. Check is_open() to see if it succeeded.
+         * \param path The file to read
+         * \param format [Optional] The sample format if the file has no SigMF metadata. Defaults to #IQ_CF32.
+         */
+        iq_file_source(std::string path, iq_format format = IQ_CF32);
+
+        ~iq_file_source(); //!< Unmaps the file
+
+        bool is_open(); //!< Whether the file was opened & mapped successfully
+
+        iq_format format(); //!< The sample format
+
+        double sample_rate(); //!< The sample rate from the SigMF metadata, 0 if unknown
+
+        unsigned long long size(); //!< Number of samples in the file
+
+        unsigned long long position(); //!< Index of the next sample read() returns
+
+        /*!
+         * \brief Moves to a sample.
+         * \param sample Index of the next sample read() returns
+         */
+        void seek(unsigned long long sample);
+
+        /*!
+         * \brief Reads the next chunk of samples.
+         * \param buffer Resized to the number of samples read and filled with them.
+         * \param count Number of samples to read
+         * \return Number of samples read, less than count at the end of the file (0 once it has been read).
+         */
+        int read(std::vector<complex_t > & buffer, int count);
+
+        /*!
+         * \brief Reads samples from anywhere in the file without moving position().
+         *
+         * Since it leaves the source untouched any number of threads can read at once.
+         * \param position Index of the first sample to read
+         * \param buffer Filled with the samples, must hold at least count samples.
+         * \param count Number of samples to read
+         * \return Number of samples read, less than count past the end of the file.
+         */
+        int read_at(unsigned long long position, complex_t * buffer, int count) const;
+
+        /*!
+         * \brief Gets the mapped samples themselves.
+         * \return The first sample of the file if its format is the same as complex_t
+         *  (#IQ_CF64, or #IQ_CF32 with FUN_OFDM_SINGLE_PRECISION), NULL otherwise.
+         */
+        const complex_t * samples();
+
+    private:
+
+        iq_file_source(const iq_file_source &);              //!< Not copyable
+        iq_file_source & operator=(const iq_file_source &);  //!< Not copyable
+
+        /*!
+         * \brief Reads the datatype & sample rate from a SigMF metadata file
+         * \param meta_path The metadata file
+         */
+        void read_sigmf(std::string meta_path);
+
+        iq_format m_format;             //!< The sample format
+        double m_sample_rate;           //!< The sample rate, 0 if unknown
+        const unsigned char * m_data;   //!< The mapped file, NULL if it isn't open
+        size_t m_bytes;                 //!< Size of the mapping in bytes
+        unsigned long long m_size;      //!< Number of samples in the file
+        unsigned long long m_position;  //!< Index of the next sample to read
+    };
+
+    /*!
+     * \brief The iq_file_sink class writes samples to an IQ file.
+     *
+     *  Samples in the same format as complex_t are written straight from the caller's buffer,
+     *  anything else is converted through a reused buffer. If the path ends in .sigmf-data the
+     *  matching .sigmf-meta file is written as well when the sink is destroyed.
+     */
+    class iq_file_sink
+    {
+    public:
+
+        /*!
+         * \brief Constructor for iq_file_sink. Check is_open() to see if it succeeded.
+         * \param path The file to write (it is truncated)
+         * \param format [Optional] The sample format to write. Defaults to #IQ_CF32.
+         * \param sample_rate [Optional] The sample rate recorded in the SigMF metadata
+         */
+        iq_file_sink(std::string path, iq_format format = IQ_CF32, double sample_rate = 0);
+
+        ~iq_file_sink(); //!< Closes the file and writes the SigMF metadata if needed
+
+        bool is_open(); //!< Whether the file was opened successfully
+
+        /*!
+         * \brief Appends samples to the file. #IQ_SC16 samples are clipped to [-1, 1).
+         * \param samples The samples
+         * \param count Number of samples
+         * \return false if the write failed
+         */
+        bool write(const complex_t * samples, int count);
+
+        /*!
+         * \brief Appends samples to the file.
+         * \param samples The samples
+         * \return false if the write failed
+         */
+        bool write(const std::vector<complex_t > & samples);
+
+        unsigned long long size(); //!< Number of samples written so far
+
+    private:
+
+        iq_file_sink(const iq_file_sink &);              //!< Not copyable
+        iq_file_sink & operator=(const iq_file_sink &);  //!< Not copyable
+
+        std::string m_meta_path;            //!< The SigMF metadata file to write, empty if none
+        iq_format m_format;                 //!< The sample format
+        double m_sample_rate;               //!< The sample rate for the metadata
+        int m_fd;                           //!< The file, -1 if it isn't open
+        unsigned long long m_size;          //!< Number of samples written so far
+        std::vector<unsigned char> m_buffer; //!< Conversion buffer
+    };
+}
+
+#endif // IQ_FILE_H
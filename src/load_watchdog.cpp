@@ -0,0 +1,84 @@
+/*! \file load_watchdog.cpp
+ *  \brief C++ file for the load_watchdog class.
+ *
+ *  The load_watchdog tracks how much of the real time of the incoming samples the receiver_chain
+ *  spends processing them and switches the chain into a degraded mode once it can't keep up, so
+ *  that an overload sheds work in a predictable way instead of overflowing the USRP.
+ */
+
+#include <iostream>
+
+#include "load_watchdog.h"
+
+namespace fun
+{
+    /*!
+     * - Initializations:
+     *   + #m_degraded -> false
+     *   + #m_load -> 0
+     *   + #m_transitions -> 0
+     *   + #m_dropped_chunks -> 0
+     *   + #m_events -> Room for #OVERLOAD_EVENT_LOG_SIZE transitions
+     */
+    load_watchdog::load_watchdog(overload_params params, double sample_rate) :
+        m_params(params),
+        m_sample_rate(sample_rate),
+        m_degraded(false),
+        m_load(0),
+        m_transitions(0),
+        m_dropped_chunks(0)
+    {
+        if(m_params.window < 1) m_params.window = 1;
+        m_events.reserve(OVERLOAD_EVENT_LOG_SIZE);
+    }
+
+    /*!
+     * The load has to cross overload_params::enter_load to degrade the chain and then fall below
+     * overload_params::exit_load to bring it back, so a load sitting right at a threshold doesn't
+     * flap between the two states on every window.
+     */
+    bool load_watchdog::update(unsigned long long busy_ns, unsigned long long samples, unsigned long long chunk)
+    {
+        if(samples == 0) return false;
+        double load = busy_ns / (samples * 1e9 / m_sample_rate);
+        m_load.store(load, std::memory_order_relaxed);
+
+        bool degraded = m_degraded.load(std::memory_order_relaxed);
+        if(degraded ? (load >= m_params.exit_load) : (load <= m_params.enter_load)) return false;
+        degraded = !degraded;
+        m_degraded.store(degraded, std::memory_order_relaxed);
+        m_transitions.fetch_add(1, std::memory_order_relaxed);
+
+        std::cerr << "Receiver chain " << (degraded ? "overloaded" : "recovered") << " at chunk " << chunk
+                  << " (load " << load << ")" << std::endl;
+
+        overload_event event;
+        event.chunk = chunk;
+        event.load = load;
+        event.degraded = degraded;
+        std::lock_guard<std::mutex> lock(m_event_mutex);
+        if(m_events.size() == OVERLOAD_EVENT_LOG_SIZE) m_events.erase(m_events.begin());
+        m_events.push_back(event);
+        return true;
+    }
+
+    std::vector<overload_event> load_watchdog::get_events()
+    {
+        std::vector<overload_event> events;
+        events.reserve(OVERLOAD_EVENT_LOG_SIZE);
+        std::lock_guard<std::mutex> lock(m_event_mutex);
+        events.swap(m_events);
+        return events;
+    }
+
+    overload_stats load_watchdog::get_stats(unsigned long long skipped_frames)
+    {
+        overload_stats stats;
+        stats.degraded = m_degraded.load(std::memory_order_relaxed);
+        stats.load = m_load.load(std::memory_order_relaxed);
+        stats.transitions = m_transitions.load(std::memory_order_relaxed);
+        stats.dropped_chunks = m_dropped_chunks.load(std::memory_order_relaxed);
+        stats.skipped_frames = skipped_frames;
+        return stats;
+    }
+}
@@ -0,0 +1,174 @@
+/*! \file load_watchdog.h
+ *  \brief Header file for the load_watchdog class and the overload_params, overload_event & overload_stats structs.
+ *
+ *  The load_watchdog tracks how much of the real time of the incoming samples the receiver_chain
+ *  spends processing them and switches the chain into a degraded mode once it can't keep up, so
+ *  that an overload sheds work in a predictable way instead of overflowing the USRP.
+ */
+
+#ifndef LOAD_WATCHDOG_H
+#define LOAD_WATCHDOG_H
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+/*! \def OVERLOAD_EVENT_LOG_SIZE
+ *  \brief Most transitions a load_watchdog keeps for load_watchdog::get_events(), older ones are dropped.
+ */
+#define OVERLOAD_EVENT_LOG_SIZE 256
+
+namespace fun
+{
+    /*!
+     * \brief The shed_policy enum lists the ways a degraded receiver_chain sheds work.
+     *
+     * The values are bit flags so any of them can be combined in overload_params::policy.
+     */
+    enum shed_policy
+    {
+        SHED_NONE = 0,          //!< Only report the transitions
+        SHED_RATES = 1,         //!< Skip the payloads of frames whose header shows a rate not in overload_params::decode_rates
+        SHED_CHUNKS = 2,        //!< Drop whole chunks of samples while no frame is in flight (not in streaming mode)
+        SHED_LTS_SEARCH = 4     //!< Only pair the overload_params::lts_peaks strongest LTS correlation peaks in the timing_sync
+    };
+
+    /*!
+     * \brief The overload_params struct holds the configuration of a receiver_chain's load_watchdog.
+     */
+    struct overload_params
+    {
+        bool enabled;           //!< Whether the receiver_chain runs a load_watchdog at all
+
+        /*!
+         * \brief Load above which the chain becomes degraded.
+         *
+         * The load is the time spent processing a window of chunks divided by the time those
+         * samples last at receiver_chain_params::sample_rate. With a thread per block that is
+         * the busiest block's time, in low latency mode the time of every block added up.
+         */
+        double enter_load;
+
+        double exit_load;       //!< Load below which a degraded chain goes back to normal (below #enter_load for some hysteresis)
+
+        int window;             //!< Number of chunks the load is measured over
+
+        unsigned int policy;    //!< The shed_policy flags applied while degraded
+
+        unsigned int decode_rates; //!< Bit r set to keep decoding payloads at Rate r while degraded (see #SHED_RATES)
+
+        int lts_peaks;          //!< Number of LTS peaks the timing_sync pairs while degraded (see #SHED_LTS_SEARCH)
+
+        /*!
+         * \brief Constructor for overload_params.
+         * \param enabled -> #enabled
+         * \param enter_load -> #enter_load
+         * \param exit_load -> #exit_load
+         * \param window -> #window
+         * \param policy -> #policy
+         * \param decode_rates -> #decode_rates
+         * \param lts_peaks -> #lts_peaks
+         */
+        overload_params(bool enabled = false, double enter_load = 0.9, double exit_load = 0.7, int window = 8,
+                        unsigned int policy = SHED_NONE, unsigned int decode_rates = 0x7FF, int lts_peaks = 2) :
+            enabled(enabled),
+            enter_load(enter_load),
+            exit_load(exit_load),
+            window(window),
+            policy(policy),
+            decode_rates(decode_rates),
+            lts_peaks(lts_peaks)
+        {
+        }
+    };
+
+    /*!
+     * \brief The overload_event struct records one transition of a load_watchdog.
+     */
+    struct overload_event
+    {
+        unsigned long long chunk;   //!< Index of the chunk that ended the window
+        double load;                //!< The window's load
+        bool degraded;              //!< true if the chain became degraded, false if it went back to normal
+    };
+
+    /*!
+     * \brief The overload_stats struct is a snapshot of a load_watchdog's counters. See receiver_chain::get_overload_stats().
+     */
+    struct overload_stats
+    {
+        bool degraded;                      //!< Whether the chain is currently degraded
+        double load;                        //!< Load of the latest window
+        unsigned long long transitions;     //!< Number of transitions so far (either way)
+        unsigned long long dropped_chunks;  //!< Chunks dropped by #SHED_CHUNKS
+        unsigned long long skipped_frames;  //!< Frames whose payload wasn't decoded because of #SHED_RATES
+    };
+
+    /*!
+     * \brief The load_watchdog class.
+     *
+     *  Usage: Call update() once per window with the time spent processing it. update() returns
+     *  true on each transition, at which point the receiver_chain applies or lifts the overload
+     *  policy. The transitions are written to std::cerr and logged for get_events().
+     *
+     *  update() must always be called from the same thread, the getters can be called from any thread.
+     */
+    class load_watchdog
+    {
+    public:
+
+        /*!
+         * \brief Constructor for load_watchdog.
+         * \param params The thresholds
+         * \param sample_rate Sample rate of the samples in samples per second
+         */
+        load_watchdog(overload_params params, double sample_rate);
+
+        /*!
+         * \brief Measures the load of a window.
+         * \param busy_ns Time spent processing the window in nanoseconds
+         * \param samples Number of samples in the window
+         * \param chunk Index of the chunk that ended the window
+         * \return true if the watchdog changed state
+         */
+        bool update(unsigned long long busy_ns, unsigned long long samples, unsigned long long chunk);
+
+        bool degraded() const { return m_degraded.load(std::memory_order_relaxed); } //!< Whether the chain is degraded
+
+        overload_params get_params() const { return m_params; } //!< Get the thresholds & policy
+
+        void chunk_dropped() { m_dropped_chunks.fetch_add(1, std::memory_order_relaxed); } //!< Counts a chunk dropped by #SHED_CHUNKS
+
+        /*!
+         * \brief Takes the transitions logged since the previous call.
+         * \return The transitions, oldest first
+         */
+        std::vector<overload_event> get_events();
+
+        /*!
+         * \brief Gets the counters.
+         * \param skipped_frames -> overload_stats::skipped_frames (kept by the frame_decoder)
+         */
+        overload_stats get_stats(unsigned long long skipped_frames);
+
+    private:
+
+        overload_params m_params; //!< The thresholds & policy
+
+        double m_sample_rate; //!< Sample rate in samples per second
+
+        std::atomic<bool> m_degraded; //!< Whether the chain is degraded
+
+        std::atomic<double> m_load; //!< Load of the latest window
+
+        std::atomic<unsigned long long> m_transitions; //!< Number of transitions
+
+        std::atomic<unsigned long long> m_dropped_chunks; //!< Number of chunks dropped
+
+        std::vector<overload_event> m_events; //!< Transitions not yet taken by get_events() (at most #OVERLOAD_EVENT_LOG_SIZE)
+
+        std::mutex m_event_mutex; //!< Protects #m_events
+    };
+}
+
+#endif // LOAD_WATCHDOG_H
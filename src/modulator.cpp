@@ -17,86 +17,193 @@
 
 namespace fun
 {
-
     /*!
-     *  Modulates the input data vector using one of the following modulations
-     *  based on the given rate:
-     *  -BPSK
-     *  -QPSK
-     *  -16 QAM
-     *  -64 QAM
+     * \brief The constellation of one modulation indexed by the packed bits of a symbol.
+     *
+     * The first bit of a symbol is the most significant bit of its index. The points are
+     * made with QAM::encode() itself so the table can never disagree with it.
      */
-    std::vector<std::complex<double> > modulator::modulate(std::vector<unsigned char> data, Rate rate)
+    struct constellation
     {
-        // Modualate the data
-        int modulated_sample_count = data.size();
-        std::vector<double> data_mod_buffer;
-        switch(rate)
+        int bpsc;              //!< Coded bits per subcarrier (i.e. per symbol)
+        complex_t points[64];  //!< The symbol of each of the 2^#bpsc bit patterns
+
+        /*!
+         * \brief Builds the constellation
+         * \param bits_per_axis Bits per I or Q component (1, 2 or 3)
+         * \param quadrature false only for BPSK which carries no bits on Q
+         * \param power The power passed to the QAM class
+         */
+        constellation(int bits_per_axis, bool quadrature, double power)
         {
-            // BPSK
-            case RATE_1_2_BPSK: case RATE_2_3_BPSK: case RATE_3_4_BPSK:
+            bpsc = quadrature ? 2 * bits_per_axis : bits_per_axis;
+            for(int p = 0; p < (1 << bpsc); p++)
             {
-                QAM<1> bpsk(1.0);
-                data_mod_buffer = std::vector<double>(modulated_sample_count * 2, 0);
-                for(int x = 0; x < modulated_sample_count; x++)
+                char bits[6];
+                for(int b = 0; b < bpsc; b++) bits[b] = (p >> (bpsc - 1 - b)) & 1;
+                real_t sym[2] = {0, 0};
+                switch(bits_per_axis)
                 {
-                    bpsk.encode((const char *)&data[x], &data_mod_buffer[x*2]);
+                    case 1: { QAM<1> qam(power); qam.encode(&bits[0], &sym[0]); if(quadrature) qam.encode(&bits[1], &sym[1]); break; }
+                    case 2: { QAM<2> qam(power); qam.encode(&bits[0], &sym[0]); qam.encode(&bits[2], &sym[1]); break; }
+                    case 3: { QAM<3> qam(power); qam.encode(&bits[0], &sym[0]); qam.encode(&bits[3], &sym[1]); break; }
                 }
-
-                break;
+                points[p] = complex_t(sym[0], sym[1]);
             }
+        }
+    };
 
-            // QPSK
-            case RATE_1_2_QPSK: case RATE_2_3_QPSK: case RATE_3_4_QPSK:
-            {
-                QAM<1> qpsk(0.5);
-                modulated_sample_count /= 2;
-                data_mod_buffer = std::vector<double>(modulated_sample_count * 2, 0);
-                for(int x = 0; x < modulated_sample_count; x++)
-                {
-                    qpsk.encode((const char *)&data[x*2], &data_mod_buffer[x*2]);
-                    qpsk.encode((const char *)&data[x*2+1], &data_mod_buffer[x*2+1]);
-                }
+    /*!
+     * \brief Gets the constellation of the given rate's modulation.
+     */
+    static const constellation & get_constellation(Rate rate)
+    {
+        static const constellation constellations[4] =
+        {
+            constellation(1, false, 1.0), // BPSK
+            constellation(1, true, 0.5),  // QPSK
+            constellation(2, true, 0.5),  // QAM16
+            constellation(3, true, 0.5),  // QAM64
+        };
+        switch(rate)
+        {
+            case RATE_1_2_BPSK: case RATE_2_3_BPSK: case RATE_3_4_BPSK: return constellations[0];
+            case RATE_1_2_QPSK: case RATE_2_3_QPSK: case RATE_3_4_QPSK: return constellations[1];
+            case RATE_1_2_QAM16: case RATE_2_3_QAM16: case RATE_3_4_QAM16: return constellations[2];
+            default: return constellations[3];
+        }
+    }
 
-                break;
-            }
+    /*!
+     * \brief Maps the bits to symbols for one modulation.
+     *
+     * Bpsc is known at compile time so packing each symbol's bits into its index unrolls.
+     */
+    template<int Bpsc>
+    static void map_kernel(const unsigned char * bits, int count, const complex_t * points, complex_t * symbols)
+    {
+        for(int s = 0; s < count; s++)
+        {
+            int index = 0;
+            for(int b = 0; b < Bpsc; b++) index = (index << 1) | (bits[b] & 1);
+            symbols[s] = points[index];
+            bits += Bpsc;
+        }
+    }
 
-            // QAM16
-            case RATE_1_2_QAM16: case RATE_2_3_QAM16: case RATE_3_4_QAM16:
+    /*!
+     * \brief The soft slicer for one modulation.
+     *
+     * Computes exactly what QAM<NumBits>::decode() does for every I (and Q if Stride is 1)
+     * component but with the sign and clamp as selects instead of branches and multiplies so
+     * it vectorizes across the components. A Stride of 2 slices only the I components (BPSK).
+     * This is always inlined into the ISA specific wrappers below so the compiler generates a
+     * separate SSE and AVX2 version of it.
+     */
+    template<int NumBits, int Stride>
+    static inline __attribute__((always_inline))
+    void slicer_kernel_impl(const real_t * __restrict__ components, int count, double scale, int gain,
+                            unsigned char * __restrict__ soft_bits)
+    {
+        for(int c = 0; c < count; c++)
+        {
+            int pt = int(components[c * Stride] * scale);
+            int amp = (1 << (NumBits - 1)) << gain;
+            bool negate = false;
+            for(int i = 0; i < NumBits; i++)
             {
-                QAM<2> qam16(0.5);
-                modulated_sample_count /= 4;
-                data_mod_buffer = std::vector<double>(modulated_sample_count * 2, 0);
-                for(int x = 0; x < modulated_sample_count; x++)
-                {
-                    qam16.encode((const char *)&data[x*4], &data_mod_buffer[x*2]);
-                    qam16.encode((const char *)&data[x*4+2], &data_mod_buffer[x*2+1]);
-                }
-
-                break;
+                int v = (negate ? -pt : pt) + 128;
+                v = v < 0 ? 0 : v;
+                v = v > 255 ? 255 : v;
+                soft_bits[c * NumBits + i] = v;
+                negate = pt >= 0;
+                pt = negate ? pt - amp : pt + amp;
+                amp /= 2;
             }
+        }
+    }
 
-            // QAM64
-            case RATE_2_3_QAM64: case RATE_3_4_QAM64:
-            {
-                QAM<3> qam64(0.5);
-                modulated_sample_count /= 6;
-                data_mod_buffer = std::vector<double>(modulated_sample_count * 2, 0);
-                for(int x = 0; x < modulated_sample_count; x++)
-                {
-                    qam64.encode((const char *)&data[x*6], &data_mod_buffer[x*2]);
-                    qam64.encode((const char *)&data[x*6+3], &data_mod_buffer[x*2+1]);
-                }
+    /*!
+     * \brief Signature of the soft slicer kernels
+     */
+    typedef void slicer_kernel(const real_t * components, int count, double scale, int gain, unsigned char * soft_bits);
 
-                break;
+    //! SSE4.1 version of the soft slicer (the baseline compile flags).
+    template<int NumBits, int Stride>
+    static void slicer_kernel_sse(const real_t * components, int count, double scale, int gain, unsigned char * soft_bits)
+    {
+        slicer_kernel_impl<NumBits, Stride>(components, count, scale, gain, soft_bits);
+    }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    //! AVX2 version of the soft slicer.
+    template<int NumBits, int Stride>
+    __attribute__((target("avx2")))
+    static void slicer_kernel_avx2(const real_t * components, int count, double scale, int gain, unsigned char * soft_bits)
+    {
+        slicer_kernel_impl<NumBits, Stride>(components, count, scale, gain, soft_bits);
+    }
+#endif
+
+    /*!
+     * \brief The slicer of each modulation (BPSK, QPSK, QAM16, QAM64) for this CPU.
+     */
+    struct slicer_table
+    {
+        slicer_kernel * kernels[4]; //!< The kernel of each modulation
+
+        /*!
+         * \brief Picks the AVX2 kernels if the CPU supports it, the SSE kernels otherwise
+         */
+        slicer_table()
+        {
+            kernels[0] = slicer_kernel_sse<1, 2>;
+            kernels[1] = slicer_kernel_sse<1, 1>;
+            kernels[2] = slicer_kernel_sse<2, 1>;
+            kernels[3] = slicer_kernel_sse<3, 1>;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            if(__builtin_cpu_supports("avx2"))
+            {
+                kernels[0] = slicer_kernel_avx2<1, 2>;
+                kernels[1] = slicer_kernel_avx2<1, 1>;
+                kernels[2] = slicer_kernel_avx2<2, 1>;
+                kernels[3] = slicer_kernel_avx2<3, 1>;
             }
+#endif
         }
+    };
 
-        std::vector<std::complex<double> > modulated_data(data_mod_buffer.size() / 2);
-        memcpy(&modulated_data[0], &data_mod_buffer[0], modulated_data.size() * sizeof(std::complex<double>));
+    /*!
+     *  Modulates the input data vector using one of the following modulations
+     *  based on the given rate:
+     *  -BPSK
+     *  -QPSK
+     *  -16 QAM
+     *  -64 QAM
+     */
+    std::vector<complex_t > modulator::modulate(std::vector<unsigned char> data, Rate rate)
+    {
+        std::vector<complex_t > modulated_data(data.size() / get_constellation(rate).bpsc);
+        modulate(data.data(), data.size(), rate, modulated_data.data());
         return modulated_data;
     }
 
+    /*!
+     * Each symbol's bits are packed into an index into the rate's constellation table.
+     */
+    void modulator::modulate(const unsigned char * bits, int bit_count, Rate rate, complex_t * symbols)
+    {
+        const constellation & c = get_constellation(rate);
+        int count = bit_count / c.bpsc;
+        switch(c.bpsc)
+        {
+            case 1: map_kernel<1>(bits, count, c.points, symbols); break;
+            case 2: map_kernel<2>(bits, count, c.points, symbols); break;
+            case 4: map_kernel<4>(bits, count, c.points, symbols); break;
+            case 6: map_kernel<6>(bits, count, c.points, symbols); break;
+        }
+    }
+
     /*!
     *  Demodulates the input data vector using one of the following modulations
     *  based on the given rate:
@@ -105,21 +212,30 @@ namespace fun
     *  -16 QAM
     *  -64 QAM
     */
-    std::vector<unsigned char> modulator::demodulate(std::vector<std::complex<double> > data, Rate rate)
+    std::vector<unsigned char> modulator::demodulate(std::vector<complex_t > data, Rate rate)
     {
         RateParams rp = RateParams(rate);
+        std::vector<unsigned char> data_demodulated(data.size() * rp.bpsc, 0);
+        demodulate(data.data(), data.size(), rate, data_demodulated.data());
+        return data_demodulated;
+    }
 
-        // Demodulate the data
-        int coded_bit_count = data.size();
-        std::vector<unsigned char>data_demodulated(coded_bit_count * rp.bpsc, 0);
+    /*!
+     * The symbols are sliced as a flat array of real_t components. Every modulation but BPSK
+     * carries the same number of bits on I and Q, the I bits first, so the soft bits of
+     * consecutive components are simply consecutive in the output.
+     */
+    void modulator::demodulate(const complex_t * symbols, int count, Rate rate, unsigned char * soft_bits)
+    {
+        static const slicer_table slicers;
+        const real_t * components = reinterpret_cast<const real_t *>(symbols);
         switch(rate)
         {
             // BPSK
             case RATE_1_2_BPSK: case RATE_2_3_BPSK: case RATE_3_4_BPSK:
             {
                 QAM<1> bpsk(1.0);
-                for(int s = 0; s < coded_bit_count; s++)
-                    bpsk.decode(data[s].real(), &data_demodulated[s]);
+                slicers.kernels[0](components, count, bpsk.decode_scale(), bpsk.decode_gain(), soft_bits);
                 break;
             }
 
@@ -127,11 +243,7 @@ namespace fun
             case RATE_1_2_QPSK: case RATE_2_3_QPSK: case RATE_3_4_QPSK:
             {
                 QAM<1> qpsk(0.5);
-                for(int s = 0; s < coded_bit_count; s++)
-                {
-                    qpsk.decode(data[s].real(), &data_demodulated[s*2]);
-                    qpsk.decode(data[s].imag(), &data_demodulated[s*2+1]);
-                }
+                slicers.kernels[1](components, 2 * count, qpsk.decode_scale(), qpsk.decode_gain(), soft_bits);
                 break;
             }
 
@@ -139,11 +251,7 @@ namespace fun
             case RATE_1_2_QAM16: case RATE_2_3_QAM16: case RATE_3_4_QAM16:
             {
                 QAM<2> qam16(0.5);
-                for(int s = 0; s < coded_bit_count; s++)
-                {
-                    qam16.decode(data[s].real(), &data_demodulated[s*4]);
-                    qam16.decode(data[s].imag(), &data_demodulated[s*4+2]);
-                }
+                slicers.kernels[2](components, 2 * count, qam16.decode_scale(), qam16.decode_gain(), soft_bits);
                 break;
             }
 
@@ -151,16 +259,9 @@ namespace fun
             case RATE_2_3_QAM64: case RATE_3_4_QAM64:
             {
                 QAM<3> qam64(0.5);
-                for(int s = 0; s < coded_bit_count; s++)
-                {
-                    qam64.decode(data[s].real(), &data_demodulated[s*6]);
-                    qam64.decode(data[s].imag(), &data_demodulated[s*6+3]);
-                }
+                slicers.kernels[3](components, 2 * count, qam64.decode_scale(), qam64.decode_gain(), soft_bits);
                 break;
             }
         }
-
-        return data_demodulated;
     }
 }
-
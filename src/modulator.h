@@ -15,8 +15,10 @@
 #define MODULATOR_H
 
 #include <complex>
+#include <vector>
 
 #include "rates.h"
+#include "precision.h"
 
 namespace fun
 {
@@ -42,7 +44,16 @@ namespace fun
          * \param rate PHY transmission rate from which the type of modulation is extracted.
          * \return Vector of modulated data as complex doubles.
          */
-        static std::vector<std::complex<double> > modulate(std::vector<unsigned char> data, Rate rate);
+        static std::vector<complex_t > modulate(std::vector<unsigned char> data, Rate rate);
+
+        /*!
+         * \brief Modulates the data into a caller provided buffer.
+         * \param bits The coded bits to be modulated, one bit (0 or 1) per byte.
+         * \param bit_count Number of bits (a multiple of the rate's bits per subcarrier).
+         * \param rate PHY transmission rate from which the type of modulation is extracted.
+         * \param symbols Output buffer of at least bit_count / bpsc symbols.
+         */
+        static void modulate(const unsigned char * bits, int bit_count, Rate rate, complex_t * symbols);
 
         /*!
          * \brief Demodulates the data.
@@ -50,7 +61,17 @@ namespace fun
          * \param rate PHY transmission frate from which the type of modulation is extracted.
          * \return Vector of demodulated data in bytes.
          */
-        static std::vector<unsigned char> demodulate(std::vector<std::complex<double> > data, Rate rate);
+        static std::vector<unsigned char> demodulate(std::vector<complex_t > data, Rate rate);
+
+        /*!
+         * \brief Demodulates the data into a caller provided buffer.
+         * \param symbols The symbols to be demodulated.
+         * \param count Number of symbols.
+         * \param rate PHY transmission rate from which the type of modulation is extracted.
+         * \param soft_bits Output buffer of at least count * bpsc soft bits, each between 0
+         *  (surely a 0) and 255 (surely a 1) exactly as QAM::decode() computes them.
+         */
+        static void demodulate(const complex_t * symbols, int count, Rate rate, unsigned char * soft_bits);
     };
 }
 
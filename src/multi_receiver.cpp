@@ -0,0 +1,129 @@
+/*! \file multi_receiver.cpp
+ *  \brief C++ file for the multi_receiver class.
+ *
+ *  The multi_receiver class receives 802.11a OFDM frames on several RX channels of the same
+ *  USRP at once, running an independent receiver chain for each channel.
+ */
+
+#include "multi_receiver.h"
+
+namespace fun
+{
+
+    /*!
+     * \brief Returns a copy of params streaming the given number of RX channels
+     */
+    static usrp_params with_rx_channels(usrp_params params, int channels)
+    {
+        params.rx_channels = channels;
+        return params;
+    }
+
+    /*!
+     * -Initializations
+     *  + #m_usrp -> Streaming one RX channel per callback
+     *  + #m_chains -> One receiver_chain per channel
+     *  + #m_rings -> One #RX_RING_SIZE buffer capture ring per channel
+     */
+    multi_receiver::multi_receiver(std::vector<void(*)(std::vector<std::vector<unsigned char> > packets)> callbacks,
+                                   usrp_params params,
+                                   receiver_params rx_params) :
+        m_callbacks(callbacks),
+        m_usrp(with_rx_channels(params, callbacks.size())),
+        m_rx_params(rx_params)
+    {
+        m_rx_params.chain.sample_rate = params.rate;
+        m_rx_params.chain.chunk_size = m_rx_params.chunk_size;
+        for(int c = 0; c < m_callbacks.size(); c++)
+        {
+            m_chains.push_back(new receiver_chain(m_rx_params.chain));
+            m_rings.push_back(new rx_ring(RX_RING_SIZE, m_rx_params.chunk_size));
+        }
+
+        sem_init(&m_pause, 0, 1); //Initial value is 1 so that the capture_loop() will begin executing immediately
+        for(int c = 0; c < m_callbacks.size(); c++)
+        {
+            m_channel_threads.push_back(std::thread(&multi_receiver::channel_loop, this, c));
+        }
+        m_capture_thread = std::thread(&multi_receiver::capture_loop, this);
+    }
+
+    /*!
+     *  This function loops forever (unless it is paused) receiving the samples of every channel
+     *  with a single call to usrp::get_samples() straight into each channel's capture ring
+     *  (see rx_ring::capture()).
+     */
+    void multi_receiver::capture_loop()
+    {
+        rx_ring::capture(m_usrp, m_rings, m_rx_params.chunk_size, m_rx_params.chain.sample_rate,
+                         m_rx_params.capture_thread, &m_pause);
+    }
+
+    /*!
+     *  This function loops forever passing the channel's filled buffers through the channel's
+     *  receiver chain and passing any successfully decoded packets to the channel's callback.
+     */
+    void multi_receiver::channel_loop(int channel)
+    {
+        rx_ring * ring = m_rings[channel];
+        receiver_chain * chain = m_chains[channel];
+        std::vector<complex_t > buffer;
+        configure_thread("fun_rx_ch" + std::to_string(channel), m_rx_params.process_thread);
+        while(1)
+        {
+            double time;
+            ring->pop_filled(buffer, time);
+
+            std::vector<std::vector<unsigned char> > packets = chain->process_buffer(buffer, time);
+
+            if(buffer.capacity() < m_rx_params.chunk_size) buffer.reserve(m_rx_params.chunk_size);
+            ring->spare.push(buffer);
+
+            m_callbacks[channel](packets);
+        }
+    }
+
+    /*!
+     *  Uses an internal semaphore to block the capture loop until multi_receiver::resume() is called.
+     *  Samples that were already captured are still processed while the receiver is paused.
+     */
+    void multi_receiver::pause()
+    {
+        sem_wait(&m_pause);
+    }
+
+    void multi_receiver::resume()
+    {
+        sem_post(&m_pause);
+    }
+
+    int multi_receiver::get_channel_count()
+    {
+        return m_callbacks.size();
+    }
+
+    receiver_stats multi_receiver::get_stats(int channel)
+    {
+        return m_rings[channel]->snapshot();
+    }
+
+    std::vector<block_stats> multi_receiver::get_block_stats(int channel)
+    {
+        return m_chains[channel]->get_block_stats();
+    }
+
+    block_stats multi_receiver::get_latency_stats(int channel)
+    {
+        return m_chains[channel]->get_latency_stats();
+    }
+
+    overload_stats multi_receiver::get_overload_stats(int channel)
+    {
+        return m_chains[channel]->get_overload_stats();
+    }
+
+    detection_stats multi_receiver::get_detection_stats(int channel)
+    {
+        return m_chains[channel]->get_detection_stats();
+    }
+}
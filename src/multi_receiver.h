@@ -0,0 +1,127 @@
+/*! \file multi_receiver.h
+ *  \brief Header file for the multi_receiver class.
+ *
+ *  The multi_receiver class receives 802.11a OFDM frames on several RX channels of the same
+ *  USRP at once, running an independent receiver chain for each channel.
+ */
+
+#ifndef MULTI_RECEIVER_H
+#define MULTI_RECEIVER_H
+
+#include <semaphore.h>
+#include <vector>
+#include <thread>
+#include "receiver.h"
+
+namespace fun
+{
+
+    /*!
+     * \brief The multi_receiver class is the multi channel version of the receiver class.
+     *
+     *  Usage: Create a multi_receiver object passing it one callback function per RX channel.
+     *  Channel c of the USRP is then processed by its own receiver_chain and the packets it
+     *  receives are passed to callbacks[c].
+     *
+     *  A single capture thread receives the samples of every channel at once into a ring of
+     *  preallocated buffers per channel (see #RX_RING_SIZE & receiver_params::chunk_size). Each channel then has its own
+     *  processing thread passing its buffers through its receiver_chain and calling its callback,
+     *  so the channels are processed in parallel and a slow channel only drops its own samples.
+     */
+    class multi_receiver
+    {
+    public:
+
+        /*!
+         * \brief Constructor for the multi_receiver
+         * \param callbacks One callback function per RX channel. The number of callbacks sets the
+         *  number of RX channels (usrp_params::rx_channels is ignored).
+         * \param params [Optional] The usrp parameters you want to use for this receiver.
+         * \param rx_params [Optional] The configuration of every channel's receiver_chain and of the
+         *  threads. The receiver_params::process_thread applies to every channel's processing thread
+         *  and the receiver_chain_params::sample_rate is taken from params.
+         */
+        multi_receiver(std::vector<void(*)(std::vector<std::vector<unsigned char> > packets)> callbacks,
+                       usrp_params params = usrp_params(),
+                       receiver_params rx_params = receiver_params());
+
+        /*!
+         * \brief Pauses the capture thread (for every channel).
+         */
+        void pause();
+
+        /*!
+         * \brief Resumes the capture thread after it has been paused.
+         */
+        void resume();
+
+        /*!
+         * \brief Gets the number of RX channels.
+         */
+        int get_channel_count();
+
+        /*!
+         * \brief Gets the capture counters of one channel. Can be called from any thread.
+         * \param channel The RX channel
+         * \return A snapshot of the counters. The UHD error counts are shared by all channels.
+         */
+        receiver_stats get_stats(int channel);
+
+        /*!
+         * \brief Gets the timing statistics of one channel's receiver_chain blocks.
+         * \param channel The RX channel
+         * \return See receiver_chain::get_block_stats()
+         */
+        std::vector<block_stats> get_block_stats(int channel);
+
+        /*!
+         * \brief Gets the end to end latency statistics of one channel's received packets.
+         * \param channel The RX channel
+         * \return See receiver_chain::get_latency_stats()
+         */
+        block_stats get_latency_stats(int channel);
+
+        /*!
+         * \brief Gets the counters of one channel's load watchdog. Can be called from any thread.
+         * \param channel The RX channel
+         * \return See receiver_chain::get_overload_stats()
+         */
+        overload_stats get_overload_stats(int channel);
+
+        /*!
+         * \brief Gets the number of detected frames each stage of one channel's receiver_chain dropped. Can be called from any thread.
+         * \param channel The RX channel
+         * \return See receiver_chain::get_detection_stats()
+         */
+        detection_stats get_detection_stats(int channel);
+
+    private:
+
+        void capture_loop(); //!< Infinite while loop where the samples of every channel are received into the capture rings
+
+        /*!
+         * \brief Infinite while loop where one channel's samples are processed by its receiver_chain
+         * \param channel The RX channel
+         */
+        void channel_loop(int channel);
+
+        std::vector<void(*)(std::vector<std::vector<unsigned char> > packets)> m_callbacks; //!< Callback function pointer per channel
+
+        usrp m_usrp; //!< The usrp object streaming every RX channel
+
+        receiver_params m_rx_params; //!< The configuration of the receiver chains & threads
+
+        std::vector<receiver_chain *> m_chains; //!< The receiver chain per channel
+
+        std::vector<rx_ring *> m_rings; //!< The capture ring & counters per channel
+
+        std::vector<std::thread> m_channel_threads; //!< The processing thread per channel
+
+        std::thread m_capture_thread; //!< The thread that receives samples from the USRP
+
+        sem_t m_pause; //!< Semaphore used to pause the capture thread
+    };
+
+}
+
+#endif // MULTI_RECEIVER_H
@@ -0,0 +1,64 @@
+/*! \file packet_pool.cpp
+ *  \brief C++ file for the packet_pool class.
+ *
+ *  The packet_pool hands out packets (a decoded payload together with its packet_info
+ *  metadata) to the receiver_chain and takes them back once the user is done with them so
+ *  that delivering a packet doesn't copy the payload or allocate a new packet.
+ */
+
+#include "packet_pool.h"
+
+namespace fun
+{
+    packet_pool::packet_pool(int size)
+    {
+        m_free.reserve(size);
+        m_packets.reserve(size);
+        for(int x = 0; x < size; x++)
+        {
+            m_packets.push_back(new packet());
+            m_free.push_back(m_packets.back());
+        }
+    }
+
+    packet_pool::~packet_pool()
+    {
+        for(int x = 0; x < m_packets.size(); x++) delete m_packets[x];
+    }
+
+    /*!
+     * Growing instead of failing means a slow consumer only costs memory, packets are never lost.
+     */
+    packet * packet_pool::acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_free.empty())
+        {
+            m_packets.push_back(new packet());
+            m_free.reserve(m_packets.size());
+            return m_packets.back();
+        }
+        packet * p = m_free.back();
+        m_free.pop_back();
+        return p;
+    }
+
+    void packet_pool::release(packet * p)
+    {
+        p->payload.clear();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(p);
+    }
+
+    int packet_pool::size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_packets.size();
+    }
+
+    int packet_pool::available()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_free.size();
+    }
+}
@@ -0,0 +1,133 @@
+/*! \file packet_pool.h
+ *  \brief Header file for the packet_pool class and the packet & packet_info structs.
+ *
+ *  The packet_pool hands out packets (a decoded payload together with its packet_info
+ *  metadata) to the receiver_chain and takes them back once the user is done with them so
+ *  that delivering a packet doesn't copy the payload or allocate a new packet.
+ */
+
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <vector>
+#include <mutex>
+
+#include "rates.h"
+#include "tagged_vector.h"
+
+/*! \def PACKET_POOL_SIZE
+ *  \brief Default number of packets preallocated by a packet_pool.
+ */
+#define PACKET_POOL_SIZE 64
+
+namespace fun
+{
+    /*!
+     * \brief The packet_info struct holds the metadata of a received packet.
+     */
+    struct packet_info
+    {
+        Rate rate;                          //!< PHY rate from the frame's plcp_header
+        int length;                         //!< Payload length in bytes from the frame's plcp_header
+        float snr;                          //!< SNR (in dB) estimated from the frame's LTS symbols by the channel_est block
+        unsigned long long sample_index;    //!< Index of the frame's first sample in the stream of samples passed to the receiver_chain
+        double latency;                     //!< Seconds from the chunk that completed the frame entering the receiver_chain to the packet being returned, -1 if unknown
+        unsigned long long sequence;        //!< Index of the frame_decoder work() call that completed the frame (used to work out #latency)
+
+        /*!
+         * \brief Time the frame's first sample was on the air in seconds, -1 if unknown.
+         *
+         * In the time base of the chunks' timestamps (see receiver_chain::process_buffer()), i.e. the
+         * USRP's clock when received by a receiver. Chunks without a timestamp carry on from the
+         * previous chunk's at the sample rate, so without any it is the time since the first sample.
+         */
+        double air_start;
+
+        double air_end;                     //!< Time the frame's last sample was on the air (same time base as #air_start), -1 if unknown
+        double delivered;                   //!< Wall clock time (seconds since the epoch) the receiver_chain returned the packet
+        detection_quality quality;          //!< How clearly the frame was detected (see detection_quality)
+
+        /*!
+         * \brief Whether the payload passed its CRC check.
+         *
+         * Always true unless the frame_decoder keeps the payloads that fail it (see frame_decoder::set_keep_failed()),
+         * in which case the payload is still delivered with its bit errors.
+         */
+        bool crc_ok;
+
+        /*!
+         * \brief Constructor for packet_info
+         */
+        packet_info() :
+            rate(RATE_1_2_BPSK),
+            length(0),
+            snr(0),
+            sample_index(0),
+            latency(-1),
+            sequence(0),
+            air_start(-1),
+            air_end(-1),
+            delivered(0),
+            crc_ok(true)
+        {
+        }
+    };
+
+    /*!
+     * \brief The packet struct is a received payload and its metadata. Packets belong to a packet_pool.
+     */
+    struct packet
+    {
+        std::vector<unsigned char> payload; //!< The payload (MPDU)
+        packet_info info;                   //!< The payload's metadata
+    };
+
+    /*!
+     * \brief The packet_pool class recycles packets.
+     *
+     *  The receiver_chain acquires a packet for each decoded payload and swaps the payload into it.
+     *  The user then hands each packet back with release() once it is done with it, after which
+     *  the packet is reused for a later payload. Packets can be released from any thread and in
+     *  any order.
+     */
+    class packet_pool
+    {
+    public:
+
+        /*!
+         * \brief Constructor for packet_pool
+         * \param size Number of packets to preallocate
+         */
+        packet_pool(int size = PACKET_POOL_SIZE);
+
+        ~packet_pool(); //!< Deletes every packet, including the ones that haven't been released.
+
+        /*!
+         * \brief Takes a free packet out of the pool.
+         * \return The packet. If every packet is in use a new one is allocated and added to the pool.
+         */
+        packet * acquire();
+
+        /*!
+         * \brief Hands a packet back to the pool.
+         * \param p A packet previously returned by acquire()
+         */
+        void release(packet * p);
+
+        int size();         //!< Number of packets owned by the pool
+        int available();    //!< Number of packets not in use
+
+    private:
+
+        packet_pool(const packet_pool &);               //!< Not copyable
+        packet_pool & operator=(const packet_pool &);   //!< Not copyable
+
+        std::mutex m_mutex;             //!< Protects #m_free and #m_packets
+
+        std::vector<packet *> m_free;   //!< Packets not in use
+
+        std::vector<packet *> m_packets; //!< Every packet owned by the pool
+    };
+}
+
+#endif // PACKET_POOL_H
@@ -0,0 +1,161 @@
+/*! \file perf_counters.cpp
+ *  \brief C++ file for the perf_counters class.
+ *
+ *  The perf_counters class reads the hardware performance counters of the calling thread
+ *  (cycles, instructions, last level cache misses and branch misses) so the profiling build
+ *  can attribute them to each receiver_chain block and ppdu stage.
+ */
+
+#include <atomic>
+#include <iostream>
+
+#ifdef FUN_OFDM_PERF_COUNTERS
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perf_counters.h"
+
+namespace fun
+{
+    /*!
+     * \brief The live counters behind a perf_stage_stats snapshot.
+     */
+    struct perf_stage_counters
+    {
+        std::atomic<unsigned long long> calls;          //!< See perf_stage_stats::calls
+        std::atomic<unsigned long long> cycles;         //!< See perf_counts::cycles
+        std::atomic<unsigned long long> instructions;   //!< See perf_counts::instructions
+        std::atomic<unsigned long long> llc_misses;     //!< See perf_counts::llc_misses
+        std::atomic<unsigned long long> branch_misses;  //!< See perf_counts::branch_misses
+    };
+
+    static perf_stage_counters stage_counters[PERF_STAGE_COUNT]; //!< The counters of each ppdu stage (zero initialized)
+
+    static const char * const stage_names[PERF_STAGE_COUNT] = {"ppdu_encode", "ppdu_decode_header", "ppdu_decode_data"}; //!< Name of each perf_stage
+
+#ifdef FUN_OFDM_PERF_COUNTERS
+    /*!
+     * \brief The counter group of one thread.
+     *
+     *  The cycle counter leads the group so all four are scheduled onto the PMU together and a
+     *  single read() returns them all.
+     */
+    struct perf_group
+    {
+        int leader;           //!< File descriptor of the group leader, -1 if the counters couldn't be opened
+        bool opened;          //!< Whether opening the counters has been attempted
+        std::vector<int> fds; //!< Every counter's file descriptor, the leader first
+
+        perf_group() : leader(-1), opened(false) {}
+        ~perf_group() { close_all(); }
+
+        void close_all()
+        {
+            for(int x = 0; x < fds.size(); x++) close(fds[x]);
+            fds.clear();
+            leader = -1;
+        }
+
+        /*!
+         * \brief Opens one user space hardware counter of the calling thread in the group.
+         * \return false if the kernel refused
+         */
+        bool add(unsigned long long config)
+        {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            int fd = syscall(__NR_perf_event_open, &attr, 0 /* this thread */, -1 /* any cpu */, leader, 0);
+            if(fd < 0) return false;
+            if(leader < 0) leader = fd;
+            fds.push_back(fd);
+            return true;
+        }
+
+        void open()
+        {
+            opened = true;
+            if(add(PERF_COUNT_HW_CPU_CYCLES) && add(PERF_COUNT_HW_INSTRUCTIONS) &&
+               add(PERF_COUNT_HW_CACHE_MISSES) && add(PERF_COUNT_HW_BRANCH_MISSES)) return;
+
+            close_all();
+            static std::atomic<bool> warned(false);
+            if(!warned.exchange(true))
+            {
+                std::cerr << "perf_counters: perf_event_open failed (" << strerror(errno)
+                          << "), check /proc/sys/kernel/perf_event_paranoid" << std::endl;
+            }
+        }
+    };
+
+    /*!
+     * The counters of a thread are opened the first time it calls this function and stay
+     * open until the thread exits.
+     */
+    bool perf_counters::read(perf_counts & counts)
+    {
+        static thread_local perf_group group;
+        if(!group.opened) group.open();
+        if(group.leader < 0) return false;
+
+        unsigned long long values[5]; // Number of counters followed by each counter's value
+        if(::read(group.leader, values, sizeof(values)) != sizeof(values) || values[0] != 4) return false;
+        counts.cycles = values[1];
+        counts.instructions = values[2];
+        counts.llc_misses = values[3];
+        counts.branch_misses = values[4];
+        return true;
+    }
+#endif
+
+    /*!
+     * The stages can run on several threads at once (e.g. the frame_decoder's decode workers)
+     * so unlike the block counters these are updated with atomic adds.
+     */
+    void perf_counters::add_stage(perf_stage stage, const perf_counts & delta, bool call)
+    {
+        perf_stage_counters & counters = stage_counters[stage];
+        const std::memory_order relaxed = std::memory_order_relaxed;
+        if(call) counters.calls.fetch_add(1, relaxed);
+        counters.cycles.fetch_add(delta.cycles, relaxed);
+        counters.instructions.fetch_add(delta.instructions, relaxed);
+        counters.llc_misses.fetch_add(delta.llc_misses, relaxed);
+        counters.branch_misses.fetch_add(delta.branch_misses, relaxed);
+    }
+
+    std::vector<perf_stage_stats> perf_counters::get_stage_stats()
+    {
+        std::vector<perf_stage_stats> stats(PERF_STAGE_COUNT);
+        for(int x = 0; x < PERF_STAGE_COUNT; x++)
+        {
+            stats[x].name = stage_names[x];
+            stats[x].calls = stage_counters[x].calls;
+            stats[x].counts.cycles = stage_counters[x].cycles;
+            stats[x].counts.instructions = stage_counters[x].instructions;
+            stats[x].counts.llc_misses = stage_counters[x].llc_misses;
+            stats[x].counts.branch_misses = stage_counters[x].branch_misses;
+        }
+        return stats;
+    }
+
+    void perf_counters::reset_stage_stats()
+    {
+        for(int x = 0; x < PERF_STAGE_COUNT; x++)
+        {
+            stage_counters[x].calls = 0;
+            stage_counters[x].cycles = 0;
+            stage_counters[x].instructions = 0;
+            stage_counters[x].llc_misses = 0;
+            stage_counters[x].branch_misses = 0;
+        }
+    }
+}
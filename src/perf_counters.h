@@ -0,0 +1,140 @@
+/*! \file perf_counters.h
+ *  \brief Header file for the perf_counters class.
+ *
+ *  The perf_counters class reads the hardware performance counters of the calling thread
+ *  (cycles, instructions, last level cache misses and branch misses) so the profiling build
+ *  can attribute them to each receiver_chain block and ppdu stage.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <string>
+#include <vector>
+
+namespace fun
+{
+    /*!
+     * \brief The perf_counts struct holds a reading (or the difference of two readings) of the counters.
+     */
+    struct perf_counts
+    {
+        unsigned long long cycles;          //!< CPU cycles
+        unsigned long long instructions;    //!< Instructions retired
+        unsigned long long llc_misses;      //!< Last level cache misses
+        unsigned long long branch_misses;   //!< Mispredicted branches
+
+        perf_counts() : cycles(0), instructions(0), llc_misses(0), branch_misses(0) {} //!< Constructor for zeroed counts
+
+        /*!
+         * \brief Gets the counts accumulated between an earlier reading and this one.
+         * \param before The earlier reading
+         */
+        perf_counts operator-(const perf_counts & before) const
+        {
+            perf_counts delta;
+            delta.cycles = cycles - before.cycles;
+            delta.instructions = instructions - before.instructions;
+            delta.llc_misses = llc_misses - before.llc_misses;
+            delta.branch_misses = branch_misses - before.branch_misses;
+            return delta;
+        }
+
+        double ipc() const { return cycles ? double(instructions) / cycles : 0; } //!< Instructions per cycle
+    };
+
+    /*!
+     * \brief The ppdu stages the profiling build counts separately from the blocks.
+     */
+    enum perf_stage
+    {
+        PERF_PPDU_ENCODE = 0,       //!< ppdu::encode()
+        PERF_PPDU_DECODE_HEADER,    //!< ppdu::decode_header()
+        PERF_PPDU_DECODE_DATA,      //!< ppdu::decode_data() and the incremental payload decode (one call per payload either way)
+        PERF_STAGE_COUNT            //!< Number of stages
+    };
+
+    /*!
+     * \brief The perf_stage_stats struct is a snapshot of the counters of one ppdu stage.
+     */
+    struct perf_stage_stats
+    {
+        std::string name;           //!< The stage's name
+        unsigned long long calls;   //!< Number of calls counted (for #PERF_PPDU_DECODE_DATA, payloads)
+        perf_counts counts;         //!< The counters accumulated over those calls
+    };
+
+    /*!
+     * \brief The perf_counters class
+     *
+     *  Only does anything in the profiling build, i.e. with FUN_OFDM_PERF_COUNTERS defined (the CMake
+     *  option of the same name). Each thread opens its own group of counters with perf_event_open
+     *  the first time it reads them, counting user space only so the default perf_event_paranoid
+     *  setting allows it. Without the define read() is an inline no-op so the regular build
+     *  doesn't pay for any of it.
+     */
+    class perf_counters
+    {
+    public:
+
+        /*!
+         * \brief Reads the calling thread's counters.
+         * \param counts Set to the counters since the thread opened them
+         * \return false if the counters aren't compiled in or couldn't be opened
+         */
+#ifdef FUN_OFDM_PERF_COUNTERS
+        static bool read(perf_counts & counts);
+#else
+        static bool read(perf_counts &) { return false; }
+#endif
+
+        /*!
+         * \brief Adds the counts of one call of a ppdu stage. Can be called from any thread.
+         * \param stage The stage
+         * \param delta The counts of the call
+         * \param call Whether it counts as a call, false for part of a call that is counted elsewhere
+         */
+        static void add_stage(perf_stage stage, const perf_counts & delta, bool call = true);
+
+        static std::vector<perf_stage_stats> get_stage_stats(); //!< Gets a snapshot of every ppdu stage's counters
+
+        static void reset_stage_stats(); //!< Zeros every ppdu stage's counters
+    };
+
+    /*!
+     * \brief The perf_scope class counts the rest of the enclosing scope towards a ppdu stage.
+     */
+    class perf_scope
+    {
+    public:
+
+#ifdef FUN_OFDM_PERF_COUNTERS
+        /*!
+         * \brief Takes the reading at the start of the scope.
+         * \param stage The stage the scope is counted towards
+         * \param call Whether the scope counts as a call of the stage (see perf_counters::add_stage())
+         */
+        perf_scope(perf_stage stage, bool call = true) : m_stage(stage), m_call(call), m_counting(perf_counters::read(m_start)) {}
+
+        ~perf_scope() //!< Takes the reading at the end of the scope and adds the difference to the stage
+        {
+            perf_counts end;
+            if(m_counting && perf_counters::read(end)) perf_counters::add_stage(m_stage, end - m_start, m_call);
+        }
+
+    private:
+
+        perf_stage m_stage; //!< The stage the scope is counted towards
+
+        bool m_call; //!< Whether the scope counts as a call
+
+        perf_counts m_start; //!< The reading at the start of the scope
+
+        bool m_counting; //!< Whether #m_start is valid
+#else
+        perf_scope(perf_stage, bool = true) {} //!< Does nothing outside of the profiling build
+#endif
+    };
+}
+
+#endif // PERF_COUNTERS_H
@@ -9,6 +9,7 @@
  */
 
 #include <cstring>
+#include <cmath>
 #include <iostream>
 
 #include "phase_tracker.h"
@@ -34,7 +35,7 @@ namespace fun
     /*! \brief The index of each pilot in the 64 sample symbol and its
      * initial value before being multiplied by its corresponding polarity
      */
-    static int PILOTS[4][2] =
+    static const int PILOTS[4][2] =
     {
       { 11,  1 },
       { 25,  1 },
@@ -42,23 +43,108 @@ namespace fun
       { 53, -1 },
     };
 
-    /*! \brief The indicies of the 48 data subcarriers in the 64 sample symbol */
-    static int DATA_SUBCARRIERS[48] =
+    /*! \brief The 48 data subcarriers in the 64 sample symbol as runs of consecutive
+     * indices (first index, length) between the pilot and null subcarriers
+     */
+    static const int DATA_RUNS[6][2] =
     {
-       6,  7,  8,  9,  10,  /*11,*/ 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, /*25,*/ 26, 27, 28, 29, 30, 31,
-      /*32,*/ 33, 34, 35, 36, 37, 38, /*39,*/ 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, /*53*/ 54, 55, 56, 57, 58
+      {  6,  5 }, // 6 - 10
+      { 12, 13 }, // 12 - 24
+      { 26,  6 }, // 26 - 31
+      { 33,  6 }, // 33 - 38
+      { 40, 13 }, // 40 - 52
+      { 54,  5 }, // 54 - 58
     };
 
+    /*!
+     * \brief Corrects a batch of symbols.
+     *
+     * The work is split into passes over the whole batch that the compiler can vectorize:
+     *  1. The phase error of each symbol is the sum of its pilots multiplied by their expected
+     *     values (the initial values in #PILOTS times the symbol's #polarity).
+     *  2. The correction is the conjugate of the phase error normalized to unit length,
+     *     i.e. e^(-j*arg(error)) without any trigonometry.
+     *  3. The data subcarriers are rotated and compacted into the output in a single pass
+     *     over the runs of consecutive subcarriers (#DATA_RUNS).
+     *
+     * This is always inlined into the ISA specific wrappers below so the compiler
+     * generates a separate SSE and AVX2 version of it.
+     */
+    static inline __attribute__((always_inline))
+    void phase_kernel_impl(const tagged_vector<64> * __restrict__ input, tagged_vector<48> * __restrict__ output,
+                           const real_t * __restrict__ polarity, int count, real_t * __restrict__ rotation)
+    {
+        // Steps 1 & 2: phase correction of each symbol
+        for(int i = 0; i < count; i++)
+        {
+            const real_t * in = reinterpret_cast<const real_t *>(input[i].samples);
+            real_t re = 0;
+            real_t im = 0;
+            for(int p = 0; p < 4; p++)
+            {
+                re += PILOTS[p][1] * in[2 * PILOTS[p][0]];
+                im += PILOTS[p][1] * in[2 * PILOTS[p][0] + 1];
+            }
+            re *= polarity[i];
+            im *= polarity[i];
+
+            real_t magnitude = std::sqrt(re * re + im * im);
+            bool zero = !(magnitude > 0); // arg(0) is 0 so there is no correction
+            rotation[2 * i] = zero ? real_t(1) : re / (zero ? real_t(1) : magnitude);
+            rotation[2 * i + 1] = zero ? real_t(0) : -im / (zero ? real_t(1) : magnitude);
+        }
+
+        // Step 3: rotate & compact the data subcarriers
+        for(int i = 0; i < count; i++)
+        {
+            const real_t * in = reinterpret_cast<const real_t *>(input[i].samples);
+            real_t * out = reinterpret_cast<real_t *>(output[i].samples);
+            const real_t c = rotation[2 * i];
+            const real_t s = rotation[2 * i + 1];
+            int o = 0;
+            for(int r = 0; r < 6; r++)
+            {
+                const real_t * run = &in[2 * DATA_RUNS[r][0]];
+                for(int k = 0; k < DATA_RUNS[r][1]; k++)
+                {
+                    out[2 * (o + k)] = run[2 * k] * c - run[2 * k + 1] * s;
+                    out[2 * (o + k) + 1] = run[2 * k] * s + run[2 * k + 1] * c;
+                }
+                o += DATA_RUNS[r][1];
+            }
+        }
+    }
+
+    //! SSE4.1 version of the phase tracking kernel (the baseline compile flags).
+    static void phase_kernel_sse(const tagged_vector<64> * input, tagged_vector<48> * output,
+                                 const real_t * polarity, int count, real_t * rotation)
+    {
+        phase_kernel_impl(input, output, polarity, count, rotation);
+    }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    //! AVX2 version of the phase tracking kernel.
+    __attribute__((target("avx2")))
+    static void phase_kernel_avx2(const tagged_vector<64> * input, tagged_vector<48> * output,
+                                  const real_t * polarity, int count, real_t * rotation)
+    {
+        phase_kernel_impl(input, output, polarity, count, rotation);
+    }
+#endif
 
     /*!
      * - Initializations:
+     *   + #m_kernel -> AVX2 kernel if the CPU supports it, SSE kernel otherwise
      *   + #m_symbol_count -> 0
      */
     phase_tracker::phase_tracker() :
-        block("phase_tracker"),
+        block("phase_tracker", 80, 80),
+        m_kernel(phase_kernel_sse),
         m_symbol_count(0)
-
     {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        if(__builtin_cpu_supports("avx2")) m_kernel = phase_kernel_avx2;
+#endif
     }
 
     /*!
@@ -66,46 +152,42 @@ namespace fun
      * The phase rotation of each pilot symbol is calculated then averaged together. The inverse of this
      * rotation is the applied to each symbol. This is a fair assumption since the pilot symbols are evenly
      * dispersed throughout the symbol.
+     *
+     * Only the pilot polarity of each symbol depends on the symbols before it, so that is worked out
+     * first and then the whole buffer is corrected at once by #m_kernel.
      */
     void phase_tracker::work()
     {
+        output_buffer.resize(0);
         if(input_buffer.size() == 0) return;
-        output_buffer.resize(input_buffer.size());
-
-        for(int i = 0; i < input_buffer.size(); i++)
-        {
-            if(input_buffer[i].tag == START_OF_FRAME)
-            {
-                m_symbol_count = 0; // Reset the symbol count
-            }
 
-            // Calculate the phase error of this symbol based on the pilots
-            std::complex<double> phase_error = std::complex<double>(0,0);
-            for(int p = 0; p < 4; p++)
-            {
-                int pilot = PILOTS[p][1] * POLARITY[m_symbol_count % 127];
-                std::complex<double> ref_pilot_sample = std::complex<double>(pilot, 0);
-                std::complex<double> rec_pilot_sample = input_buffer[i].samples[PILOTS[p][0]];
-                phase_error += rec_pilot_sample * std::conj(ref_pilot_sample) / 4.0;
-            }
+        process(&input_buffer[0], input_buffer.size(), output_buffer);
+    }
 
-            double angle = std::arg(phase_error);
+    void phase_tracker::process(const tagged_vector<64> * input, int count, std::vector<tagged_vector<48> > & output)
+    {
+        int first = output.size();
+        output.resize(first + count);
+        tagged_vector<48> * out = &output[first];
 
-            // Apply the phase correction to the data samples
-            for(int s = 0; s < 48; s++)
+        m_polarity.resize(count);
+        m_rotation.resize(2 * count);
+        for(int i = 0; i < count; i++)
+        {
+            if(input[i].tag == START_OF_FRAME)
             {
-                int index = DATA_SUBCARRIERS[s];
-                output_buffer[i].samples[s] = input_buffer[i].samples[index] * std::complex<double>(std::cos(-angle), std::sin(-angle));
+                m_symbol_count = 0; // Reset the symbol count
             }
+            m_polarity[i] = POLARITY[m_symbol_count % 127];
 
-            output_buffer[i].tag = input_buffer[i].tag;
+            out[i].tag = input[i].tag;
+            out[i].snr = input[i].snr;
+            out[i].sample_index = input[i].sample_index;
+            out[i].quality = input[i].quality;
             m_symbol_count++; //Keep track of the current symbol number in the frame
         }
 
+        m_kernel(input, out, &m_polarity[0], count, &m_rotation[0]);
     }
 
 }
-
-
-
-
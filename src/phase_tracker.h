@@ -18,6 +18,15 @@
 
 namespace fun
 {
+    /*!
+     * \brief Signature of the vectorized phase tracking kernels.
+     *
+     * See phase_tracker.cpp for the SSE and AVX2 versions that are selected
+     * between at runtime.
+     */
+    typedef void (*phase_kernel)(const tagged_vector<64> * input, tagged_vector<48> * output,
+                                 const real_t * polarity, int count, real_t * rotation);
+
     /*!
      * \brief The phase_tracker block.
      *
@@ -37,8 +46,27 @@ namespace fun
 
         virtual void work(); //!< Signal processing happens here.
 
+        /*!
+         * \brief Does what work() does to the given symbols instead of the input_buffer.
+         * \param input The symbols
+         * \param count Number of symbols
+         * \param output The corrected data subcarriers of each symbol are appended to this vector
+         */
+        void process(const tagged_vector<64> * input, int count, std::vector<tagged_vector<48> > & output);
+
     private:
 
+        /*!
+         * \brief The kernel used to correct the symbols.
+         *
+         * Chosen in the constructor based on the instruction sets the CPU supports.
+         */
+        phase_kernel m_kernel;
+
+        std::vector<real_t> m_polarity; //!< The pilot polarity of each input symbol
+
+        std::vector<real_t> m_rotation; //!< The phase correction of each input symbol (real & imaginary parts)
+
         /*!
          * \brief Counter used to keep track of the symbol number in the frame so
          * as to know what pilot polarity to expect. This is reset at the beginning
@@ -8,15 +8,18 @@
  */
 
 #include <arpa/inet.h>
-#include <boost/crc.hpp>
 #include <iostream>
 
 #include "ppdu.h"
 #include "parity.h"
 #include "viterbi.h"
 #include "interleaver.h"
-#include "puncturer.h"
 #include "modulator.h"
+#include "soft_demapper.h"
+#include "scrambler.h"
+#include "crc32.h"
+#include "frame_arena.h"
+#include "perf_counters.h"
 
 namespace fun
 {
@@ -34,14 +37,20 @@ namespace fun
      */
     ppdu::ppdu(Rate rate, int length)
     {
-        RateParams rate_params = RateParams(rate);
-        int num_symbols = std::ceil(
-                double((16 /* service */ + 8 * (length + 4 /* CRC */) + 6 /* tail */)) /
-                double(rate_params.dbps));
+        int num_symbols = get_pipeline(rate).symbol_count(length);
         header = plcp_header(rate, length, num_symbols);
         payload.reserve(MAX_FRAME_SIZE);
     }
 
+    /*!
+     * The payload is emptied but keeps its capacity.
+     */
+    void ppdu::reset(Rate rate, int length)
+    {
+        int num_symbols = get_pipeline(rate).symbol_count(length);
+        header = plcp_header(rate, length, num_symbols);
+        payload.resize(0);
+    }
 
     /*!
      * This constructor creates a complete PPDU with header and payload.
@@ -49,11 +58,8 @@ namespace fun
     ppdu::ppdu(std::vector<unsigned char> payload, Rate rate) :
         payload(payload)
     {
-        RateParams rate_params = RateParams(rate);
         int length = payload.size();
-        int num_symbols = std::ceil(
-                double((16 /* service */ + 8 * (length + 4 /* CRC */) + 6 /* tail */)) /
-                double(rate_params.dbps));
+        int num_symbols = get_pipeline(rate).symbol_count(length);
 
         header = plcp_header(rate, length, num_symbols);
     }
@@ -62,13 +68,14 @@ namespace fun
      * Public wrapper for encoding the header & payload and concatenating them together into a
      * PHY frame.
      */
-    std::vector<std::complex<double> > ppdu::encode()
+    std::vector<complex_t > ppdu::encode()
     {
-        std::vector<std::complex<double> > header_samples = encoder_header();
-        std::vector<std::complex<double> > payload_samples = encode_data();
-        std::vector<std::complex<double> > ppdu_samples = std::vector<std::complex<double> >(header_samples.size() + payload_samples.size());
-        memcpy(&ppdu_samples[0], &header_samples[0], header_samples.size() * sizeof(std::complex<double>));
-        memcpy(&ppdu_samples[48], payload_samples.data(), payload_samples.size() * sizeof(std::complex<double>));
+        perf_scope scope(PERF_PPDU_ENCODE);
+        std::vector<complex_t > header_samples = encoder_header();
+        std::vector<complex_t > payload_samples = encode_data();
+        std::vector<complex_t > ppdu_samples = std::vector<complex_t >(header_samples.size() + payload_samples.size());
+        memcpy(&ppdu_samples[0], &header_samples[0], header_samples.size() * sizeof(complex_t));
+        memcpy(&ppdu_samples[48], payload_samples.data(), payload_samples.size() * sizeof(complex_t));
         return ppdu_samples;
     }
 
@@ -78,7 +85,7 @@ namespace fun
      * Codes the header using a 1/2 convolutional code. Interleaves the header. And finally
      * modulates the header using BPSK modulation.
      */
-    std::vector<std::complex<double> > ppdu::encoder_header()
+    std::vector<complex_t > ppdu::encoder_header()
     {
         // Build the header from the rate field and length
         RateParams rate_params = RateParams(header.rate);
@@ -96,31 +103,60 @@ namespace fun
 
         // Convolutionally encode the header
         std::vector<unsigned char> header_symbols(48 /* header is always a single 1/2 BPSK symbol */);
-        viterbi v;
-        v.conv_encode(header_bytes, &header_symbols[0], 18 /* header is always 18 data bits */);
+        viterbi::conv_encode(header_bytes, &header_symbols[0], 18 /* header is always 18 data bits */);
 
         // Interleave the header
         std::vector<unsigned char> interleaved = interleaver::interleave(header_symbols);
 
         // Modulate the header
-        std::vector<std::complex<double> > modulated = modulator::modulate(interleaved, RATE_1_2_BPSK);
+        std::vector<complex_t > modulated = modulator::modulate(interleaved, RATE_1_2_BPSK);
 
         return modulated;
 
     }
 
-    std::vector<std::complex<double> > ppdu::encode_data()
+    /*!
+     * Each rate's pipelines are instantiated from the same templates so the table is the
+     * only place the rate is switched on.
+     */
+    const ppdu::rate_pipeline & ppdu::get_pipeline(Rate rate)
     {
-        // Get the RateParams
-        RateParams rate_params = RateParams(header.rate);
+        static const rate_pipeline pipelines[11] =
+        {
+            {rate_traits<RATE_1_2_BPSK>::symbol_count, &ppdu::encode_data_rate<RATE_1_2_BPSK>, &ppdu::decode_data_rate<RATE_1_2_BPSK>},
+            {rate_traits<RATE_2_3_BPSK>::symbol_count, &ppdu::encode_data_rate<RATE_2_3_BPSK>, &ppdu::decode_data_rate<RATE_2_3_BPSK>},
+            {rate_traits<RATE_3_4_BPSK>::symbol_count, &ppdu::encode_data_rate<RATE_3_4_BPSK>, &ppdu::decode_data_rate<RATE_3_4_BPSK>},
+            {rate_traits<RATE_1_2_QPSK>::symbol_count, &ppdu::encode_data_rate<RATE_1_2_QPSK>, &ppdu::decode_data_rate<RATE_1_2_QPSK>},
+            {rate_traits<RATE_2_3_QPSK>::symbol_count, &ppdu::encode_data_rate<RATE_2_3_QPSK>, &ppdu::decode_data_rate<RATE_2_3_QPSK>},
+            {rate_traits<RATE_3_4_QPSK>::symbol_count, &ppdu::encode_data_rate<RATE_3_4_QPSK>, &ppdu::decode_data_rate<RATE_3_4_QPSK>},
+            {rate_traits<RATE_1_2_QAM16>::symbol_count, &ppdu::encode_data_rate<RATE_1_2_QAM16>, &ppdu::decode_data_rate<RATE_1_2_QAM16>},
+            {rate_traits<RATE_2_3_QAM16>::symbol_count, &ppdu::encode_data_rate<RATE_2_3_QAM16>, &ppdu::decode_data_rate<RATE_2_3_QAM16>},
+            {rate_traits<RATE_3_4_QAM16>::symbol_count, &ppdu::encode_data_rate<RATE_3_4_QAM16>, &ppdu::decode_data_rate<RATE_3_4_QAM16>},
+            {rate_traits<RATE_2_3_QAM64>::symbol_count, &ppdu::encode_data_rate<RATE_2_3_QAM64>, &ppdu::decode_data_rate<RATE_2_3_QAM64>},
+            {rate_traits<RATE_3_4_QAM64>::symbol_count, &ppdu::encode_data_rate<RATE_3_4_QAM64>, &ppdu::decode_data_rate<RATE_3_4_QAM64>},
+        };
+        return pipelines[rate];
+    }
+
+    std::vector<complex_t > ppdu::encode_data()
+    {
+        return (this->*get_pipeline(header.rate).encode_data)();
+    }
+
+    /*!
+     * All of the frame's sizes are derived from the compile time rate_traits and every stage
+     * writes straight into the buffer of the next one.
+     */
+    template<Rate R>
+    std::vector<complex_t > ppdu::encode_data_rate()
+    {
+        typedef rate_traits<R> traits;
 
         // Calculate the number of symbols
-        int num_symbols = std::ceil(
-                double((16 /* service */ + 8 * (payload.size() + 4 /* CRC */) + 6 /* tail */)) /
-                double(rate_params.dbps));
+        int num_symbols = traits::symbol_count(payload.size());
 
         // Calculate the number of data bits/bytes (including padding bits)
-        int num_data_bits = num_symbols * rate_params.dbps;
+        int num_data_bits = num_symbols * traits::dbps;
         int num_data_bytes = num_data_bits / 8;
 
         unsigned short service_field = 0;
@@ -131,54 +167,47 @@ namespace fun
         memcpy(&data[2], payload.data(), payload.size());
 
         // Calcualate and append the CRC
-        boost::crc_32_type crc;
-        crc.process_bytes(&data[0], 2 + payload.size());
-        unsigned int calculated_crc = crc.checksum();
+        unsigned int calculated_crc = crc32(&data[0], 2 + payload.size());
         memcpy(&data[2 + payload.size()], &calculated_crc, 4);
 
-        // Scramble the data
-        std::vector<unsigned char> scrambled(num_data_bytes+1, 0);
-        int state = 93, feedback = 0;
-        for(int x = 0; x < num_data_bytes; x++)
-        {
-           feedback = (!!(state & 64)) ^ (!!(state & 8));
-           scrambled[x] = feedback ^ data[x];
-           state = ((state << 1) & 0x7E) | feedback;
-        }
-        data.swap(scrambled);
+        // Scramble the data in place
+        scrambler::scramble(&data[0], num_data_bytes);
 
-        // Convolutionally encode the data
-        std::vector<unsigned char> data_encoded(num_data_bits * 2, 0);
-        viterbi v;
-        v.conv_encode(&data[0], data_encoded.data(), num_data_bits-6);
-
-        // Puncture the data
-        std::vector<unsigned char> data_punctured = puncturer::puncture(data_encoded, header.rate);
+        // Convolutionally encode & puncture the data
+        int coded_bits = num_symbols * traits::cbps;
+        std::vector<unsigned char> data_punctured(coded_bits);
+        viterbi::conv_encode(&data[0], data_punctured.data(), num_data_bits-6, R);
 
         // Interleave the data
-        std::vector<unsigned char> data_interleaved = interleaver::interleave(data_punctured);
+        std::vector<unsigned char> data_interleaved(coded_bits);
+        interleaver::interleave(data_punctured.data(), data_interleaved.data(), coded_bits, R);
 
         // Modulated the data
-        std::vector<std::complex<double> > data_modulated = modulator::modulate(data_interleaved, header.rate);
+        std::vector<complex_t > data_modulated(num_symbols * 48);
+        modulator::modulate(data_interleaved.data(), coded_bits, R, data_modulated.data());
 
         return data_modulated;
     }
 
     // Decode a PLCP header from 48 complex samples
-    bool ppdu::decode_header(std::vector<std::complex<double> > samples)
+    bool ppdu::decode_header(const std::vector<complex_t > & samples, viterbi * decoder)
     {
         assert(samples.size() == 48);
+        return decode_header(samples.data(), decoder);
+    }
 
-        // Demodulate the header
-        std::vector<unsigned char> demodulated = modulator::demodulate(samples, RATE_1_2_BPSK);
-
-        // Deinterleave the header
-        std::vector<unsigned char> deinterleaved = interleaver::deinterleave(demodulated);
+    bool ppdu::decode_header(const complex_t * samples, viterbi * decoder)
+    {
+        perf_scope scope(PERF_PPDU_DECODE_HEADER);
+        // Demodulate & deinterleave the header
+        unsigned char soft_bits[48];
+        soft_demapper::demap(samples, 48, RATE_1_2_BPSK, soft_bits);
 
-        // Convolutionally decode the header        
-        std::vector<unsigned char> header_bytes(4);
-        viterbi v;
-        v.conv_decode(deinterleaved.data(), header_bytes.data(), 18 /* header is always 18 data bits */);
+        // Convolutionally decode the header
+        unsigned char header_bytes[4] = {0, 0, 0, 0};
+        viterbi local_decoder;
+        viterbi & v = (decoder != NULL) ? *decoder : local_decoder;
+        v.conv_decode(soft_bits, header_bytes, 18 /* header is always 18 data bits */);
 
         // Verify header parity
         unsigned int header_field;
@@ -203,14 +232,12 @@ namespace fun
         }
 
         // Calculate the number of symbols
-        RateParams rate_params = RateParams::FromRateField(rate_field);
-        int num_symbols = std::ceil(
-                double((16 /* service */ + 8 * (length + 4 /* CRC */) + 6 /* tail */)) /
-                double(rate_params.dbps));
+        Rate rate = RateParams::FromRateField(rate_field).rate;
+        int num_symbols = get_pipeline(rate).symbol_count(length);
 
         // Populate the header fields
         header.length = length;
-        header.rate = RateParams::FromRateField(rate_field).rate;
+        header.rate = rate;
         header.num_symbols = num_symbols;
 
         // Indicate success
@@ -220,56 +247,97 @@ namespace fun
 
 
 
-    bool ppdu::decode_data(std::vector<std::complex<double> > samples)
+    /*!
+     * Without an arena every scratch buffer gets its own allocation, as if they were vectors.
+     */
+    bool ppdu::decode_data(const std::vector<complex_t > & samples, viterbi * decoder)
     {
-        // Get the RateParams
-        RateParams rate_params = RateParams(header.rate);
+        frame_arena arena(0);
+        return decode_data(samples.data(), samples.size(), decoder, &arena);
+    }
 
-        // Calculate the number of symbols
-        int num_symbols = std::ceil(
-                double((16 /* service */ + 8 * (header.length + 4 /* CRC */) + 6 /* tail */)) /
-                double(rate_params.dbps));
+    bool ppdu::decode_data(const complex_t * samples, int count, viterbi * decoder, frame_arena * arena)
+    {
+        perf_scope scope(PERF_PPDU_DECODE_DATA);
+        arena->reset();
+        return (this->*get_pipeline(header.rate).decode_data)(samples, count, decoder, arena);
+    }
 
-        // Calculate the number of data bits/bytes (including padding bits)
-        int num_data_bits = num_symbols * rate_params.dbps;
+    /*!
+     * The trellis is sized for the whole payload here so decode_symbol() never allocates.
+     */
+    void ppdu::begin_decode_data(viterbi * decoder)
+    {
+        reset(header.rate, header.length);
+        decoder->begin_decode(header.num_symbols * RateParams(header.rate).dbps - 6);
+    }
+
+    /*!
+     * A symbol holds a whole number of puncturing periods and interleaver blocks, so
+     * demapping the frame one symbol at a time gives the same soft bits as demapping it at once.
+     */
+    void ppdu::decode_symbol(const complex_t * samples, viterbi * decoder)
+    {
+        perf_scope scope(PERF_PPDU_DECODE_DATA, false); // The payload is counted as a call by end_decode_data()
+        unsigned char soft_bits[2 * 216 /* max dbps */];
+        soft_demapper::demap(samples, 48, header.rate, soft_bits);
+        decoder->update(soft_bits, soft_demapper::soft_bit_count(48, header.rate) / 2);
+    }
+
+    bool ppdu::end_decode_data(viterbi * decoder, frame_arena * arena)
+    {
+        perf_scope scope(PERF_PPDU_DECODE_DATA);
+        arena->reset();
+        int num_data_bits = header.num_symbols * RateParams(header.rate).dbps;
         int num_data_bytes = num_data_bits / 8;
+        unsigned char * decoded = arena->allocate<unsigned char>(num_data_bytes + 1);
+        memset(decoded, 0, num_data_bytes + 1);
+        decoder->end_decode(decoded, num_data_bits - 6);
+        return check_data(decoded, num_data_bytes);
+    }
 
-        // Demodulate the data
-        std::vector<unsigned char> demodulated = modulator::demodulate(samples, header.rate);
+    template<Rate R>
+    bool ppdu::decode_data_rate(const complex_t * samples, int count, viterbi * decoder, frame_arena * arena)
+    {
+        typedef rate_traits<R> traits;
 
-        // Deinterleave the data
-        std::vector<unsigned char> deinterleaved = interleaver::deinterleave(demodulated);
+        // Calculate the number of symbols
+        int num_symbols = traits::symbol_count(header.length);
+
+        // Calculate the number of data bits/bytes (including padding bits)
+        int num_data_bits = num_symbols * traits::dbps;
+        int num_data_bytes = num_data_bits / 8;
 
-        // Depuncture the data
-        std::vector<unsigned char> depunctured = puncturer::depuncture(deinterleaved, header.rate);
+        // Demodulate, deinterleave & depuncture the data in one pass
+        unsigned char * depunctured = arena->allocate<unsigned char>(soft_demapper::soft_bit_count(count, R));
+        soft_demapper::demap(samples, count, R, depunctured);
 
         // Convolutionally decode the data
-        int data_bits = 16 /* service */ + (header.length + 4 /* CRC */) * 8 + 6 /* tail bits */;
-        int data_bytes = data_bits / 8 + 1;
-        data_bits = num_data_bits - 6;
-        data_bytes = num_data_bytes;
-        std::vector<unsigned char> decoded(data_bytes);
-        viterbi v;
-        v.conv_decode(&depunctured[0], &decoded[0], data_bits);
-
-        // Descramble the data
-        std::vector<unsigned char> descrambled(num_data_bytes+1, 0);
-        int state = 93, feedback = 0;
-        for(int x = 0; x < num_data_bytes; x++)
-        {
-           feedback = (!!(state & 64)) ^ (!!(state & 8));
-           descrambled[x] = feedback ^ decoded[x];
-           state = ((state << 1) & 0x7E) | feedback;
-        }
-        decoded.swap(descrambled);
+        int data_bits = num_data_bits - 6;
+        unsigned char * decoded = arena->allocate<unsigned char>(num_data_bytes + 1);
+        memset(decoded, 0, num_data_bytes + 1);
+        viterbi local_decoder;
+        viterbi & v = (decoder != NULL) ? *decoder : local_decoder;
+        v.conv_decode(depunctured, decoded, data_bits);
+
+        return check_data(decoded, num_data_bytes);
+    }
+
+    bool ppdu::check_data(unsigned char * decoded, int num_data_bytes)
+    {
+        // Descramble the data in place
+        scrambler::scramble(&decoded[0], num_data_bytes);
 
         // Calculate the CRC
-        boost::crc_32_type crc;
-        crc.process_bytes(&decoded[0], 2 + header.length);
-        unsigned int calculated_crc = crc.checksum();
+        unsigned int calculated_crc = crc32(&decoded[0], 2 + header.length);
         unsigned int given_crc = 0;
         memcpy(&given_crc, &decoded[2 + header.length], 4);
 
+        // Copy the payload (even if it is corrupt so that bit errors can be counted)
+    //        std::vector<unsigned char> payload(length);
+        payload.resize(header.length);
+        memcpy(&payload[0], &decoded[2 /* skip the service field */], header.length);
+
         // Verify the CRC
         if(given_crc != calculated_crc)
         {
@@ -279,11 +347,6 @@ namespace fun
         }
         else
         {
-            // Copy the payload
-    //        std::vector<unsigned char> payload(length);
-            payload.resize(header.length);
-            memcpy(&payload[0], &decoded[2 /* skip the service field */], header.length);
-
             // Fill the output values
     //        data_out.rate = rate;
             memcpy(&header.service, &decoded[0], 2);
@@ -291,7 +354,6 @@ namespace fun
             // Indicate success
             return true;
         }
-
     }
 
 }
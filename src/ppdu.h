@@ -13,11 +13,15 @@
 #include <complex>
 #include <vector>
 #include "rates.h"
+#include "precision.h"
 
 #define MAX_FRAME_SIZE 2000
 
 namespace fun
 {
+    class viterbi;
+    class frame_arena;
+
     /*!
      * \brief The plcp_header struct is a container for PLCP Headers and their
      *  respective parameters.
@@ -109,6 +113,14 @@ namespace fun
          */
         ppdu(std::vector<unsigned char> payload, Rate rate);
 
+        /*!
+         * \brief Resets this ppdu to an empty payload with the given rate and length so that
+         *  one object (and its payload buffer) can be reused for every frame.
+         * \param rate PHY Rate for the next frame.
+         * \param length Length of the next frame's payload in bytes.
+         */
+        void reset(Rate rate, int length);
+
         /******************
          * Public Members *
          ******************/
@@ -117,27 +129,78 @@ namespace fun
          * \brief Public interface for encoding a ppdu
          * \return Modulated data as a vector of complex doubles
          */
-        std::vector<std::complex<double> > encode();
+        std::vector<complex_t > encode();
 
         /*!
          * \brief Public interface for decoding a plcp_header.
          * \param samples Complex samples representing the encoded header symbol.
+         * \param decoder Optional long-lived viterbi decoder to use. If left out a
+         *  temporary decoder is used.
          * \return boolean of whether decoding the header was successful or not
          *  based on checking/comparing the 1 bit parity field in the header.
          *  If successful the object's #header field is populated appropriately with
          *  the decoded fields.
          */
-        bool decode_header(std::vector<std::complex<double> > samples);
+        bool decode_header(const std::vector<complex_t > & samples, viterbi * decoder = NULL);
+
+        /*!
+         * \brief Decodes a plcp_header straight from a buffer of 48 complex samples.
+         * \param samples Complex samples representing the encoded header symbol.
+         * \param decoder Optional long-lived viterbi decoder to use.
+         * \return Same as decode_header(const std::vector<complex_t > &, viterbi *)
+         */
+        bool decode_header(const complex_t * samples, viterbi * decoder = NULL);
 
         /*!
          * \brief Public interface for decoding the PHY payload into a PPDU.
          * \param samples Complex samples representing the encoded payload symbols.
+         * \param decoder Optional long-lived viterbi decoder to use. If left out a
+         *  temporary decoder is used, which has to allocate its trellis.
          * \return boolean of whether decoding the payload was successful or not
          *  based on calculating and comparing the IEEE CRC-32 appended to the end
-         *  of the payload. If successful the object's #payload field is populated
-         *  with the decoded payload/MPDU.
+         *  of the payload. The object's #payload field is populated with the decoded
+         *  payload/MPDU either way, i.e. with bit errors if the CRC didn't match.
          */
-        bool decode_data(std::vector<std::complex<double> > samples);
+        bool decode_data(const std::vector<complex_t > & samples, viterbi * decoder = NULL);
+
+        /*!
+         * \brief Decodes the PHY payload with all of the scratch buffers taken from an arena.
+         * \param samples Complex samples representing the encoded payload symbols.
+         * \param count Number of samples.
+         * \param decoder Long-lived viterbi decoder to use, or NULL for a temporary one.
+         * \param arena Arena the soft bits and decoded bytes are allocated from. It is reset
+         *  before decoding, so anything allocated from it earlier is released.
+         * \return Same as decode_data(const std::vector<complex_t > &, viterbi *)
+         */
+        bool decode_data(const complex_t * samples, int count, viterbi * decoder, frame_arena * arena);
+
+        /*!
+         * \brief Starts decoding the PHY payload one OFDM symbol at a time.
+         * \param decoder Long-lived viterbi decoder the payload is decoded with. It can't be
+         *  used for anything else until end_decode_data().
+         *
+         * The rate & length are the ones of the header, i.e. decode_header() or reset() has to be
+         * called first. Then each of the get_num_symbols() data symbols is passed to
+         * decode_symbol() in turn and end_decode_data() returns the same as decode_data() would
+         * for the whole frame.
+         */
+        void begin_decode_data(viterbi * decoder);
+
+        /*!
+         * \brief Demodulates, deinterleaves & depunctures the next data symbol and runs the
+         *  trellis over it.
+         * \param samples The 48 data subcarrier samples of the symbol.
+         * \param decoder The decoder passed to begin_decode_data().
+         */
+        void decode_symbol(const complex_t * samples, viterbi * decoder);
+
+        /*!
+         * \brief Finishes decoding the payload with the chainback, descrambling & CRC check.
+         * \param decoder The decoder passed to begin_decode_data().
+         * \param arena Arena the decoded bytes are allocated from. It is reset first.
+         * \return Same as decode_data(const std::vector<complex_t > &, viterbi *)
+         */
+        bool end_decode_data(viterbi * decoder, frame_arena * arena);
 
 
         Rate get_rate(){return header.rate;}     //!< Get this PPDU's PHY tx rate
@@ -145,6 +208,12 @@ namespace fun
         int get_num_symbols(){return header.num_symbols;} //!< Get the number of OFDM symbols in this PPDU
         std::vector<unsigned char> get_payload(){return payload;} //!< Get the payload of this PPDU.
 
+        /*!
+         * \brief Swaps this PPDU's payload with buffer, i.e. takes the payload without copying it.
+         * \param buffer Receives the payload.
+         */
+        void swap_payload(std::vector<unsigned char> & buffer){payload.swap(buffer);}
+
     private:
 
         plcp_header header; //!< This PPDU's header parameters
@@ -155,14 +224,49 @@ namespace fun
          *  BPSK modulation and 1/2 rate convolutional code.
          * \return The modulated header symbol.
          */
-        std::vector<std::complex<double> > encoder_header();
+        std::vector<complex_t > encoder_header();
 
         /*!
          * \brief Encodes this PPDU's payload. The payload is encoded at the rate
          *  specified in the header.rate field.
          * \return The modulated data.
          */
-        std::vector<std::complex<double> > encode_data();
+        std::vector<complex_t > encode_data();
+
+        /*!
+         * \brief Descrambles the decoded data in place, copies out the payload and checks the CRC.
+         * \param decoded The decoded service field, payload, CRC & padding.
+         * \param num_data_bytes Number of bytes in decoded.
+         * \return Whether the CRC matched.
+         */
+        bool check_data(unsigned char * decoded, int num_data_bytes);
+
+        /*!
+         * \brief The encode & decode pipelines of one PHY rate.
+         */
+        struct rate_pipeline
+        {
+            int (*symbol_count)(int length);                                        //!< rate_traits::symbol_count() of the rate
+            std::vector<complex_t > (ppdu::*encode_data)();                          //!< encode_data_rate() of the rate
+            bool (ppdu::*decode_data)(const complex_t *, int, viterbi *, frame_arena *); //!< decode_data_rate() of the rate
+        };
+
+        /*!
+         * \brief Gets the pipelines of the given rate.
+         */
+        static const rate_pipeline & get_pipeline(Rate rate);
+
+        /*!
+         * \brief #encode_data() instantiated for one PHY rate.
+         */
+        template<Rate R>
+        std::vector<complex_t > encode_data_rate();
+
+        /*!
+         * \brief #decode_data() instantiated for one PHY rate.
+         */
+        template<Rate R>
+        bool decode_data_rate(const complex_t * samples, int count, viterbi * decoder, frame_arena * arena);
 
     };
 
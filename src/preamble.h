@@ -10,6 +10,8 @@
 
 #include <complex>
 
+#include "precision.h"
+
 namespace fun
 {
     /*! \brief Full 802.11a Preamble in time domain.
@@ -21,501 +23,501 @@ namespace fun
      * half of one LTS (32+64+64 = 160).
      *
      */
-    static std::complex<double> PREAMBLE_SAMPLES[320] =
+    static complex_t PREAMBLE_SAMPLES[320] =
     {
-        std::complex<double>(  0.0229993772561  ,  0.0229993772561  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>(  0.0919975090242  ,  0.0              ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>(  0.0              ,  0.0919975090242  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
+        complex_t(  0.0229993772561  ,  0.0229993772561  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t(  0.0919975090242  ,  0.0              ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t(  0.0              ,  0.0919975090242  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
 
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>(  0.0919975090242  ,  0.0              ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>(  0.0              ,  0.0919975090242  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t(  0.0919975090242  ,  0.0              ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t(  0.0              ,  0.0919975090242  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
 
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>(  0.0919975090242  ,  0.0              ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>(  0.0              ,  0.0919975090242  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t(  0.0919975090242  ,  0.0              ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t(  0.0              ,  0.0919975090242  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
 
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>(  0.0919975090242  ,  0.0              ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>(  0.0              ,  0.0919975090242  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t(  0.0919975090242  ,  0.0              ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t(  0.0              ,  0.0919975090242  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
 
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>(  0.0919975090242  ,  0.0              ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>(  0.0              ,  0.0919975090242  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t(  0.0919975090242  ,  0.0              ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t(  0.0              ,  0.0919975090242  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
 
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>(  0.0919975090242  ,  0.0              ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>(  0.0              ,  0.0919975090242  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t(  0.0919975090242  ,  0.0              ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t(  0.0              ,  0.0919975090242  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
 
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>(  0.0919975090242  ,  0.0              ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>(  0.0              ,  0.0919975090242  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t(  0.0919975090242  ,  0.0              ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t(  0.0              ,  0.0919975090242  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
 
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>(  0.0919975090242  ,  0.0              ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>(  0.0              ,  0.0919975090242  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t(  0.0919975090242  ,  0.0              ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t(  0.0              ,  0.0919975090242  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
 
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>(  0.0919975090242  ,  0.0              ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>(  0.0              ,  0.0919975090242  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t(  0.0919975090242  ,  0.0              ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t(  0.0              ,  0.0919975090242  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
 
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>(  0.0919975090242  ,  0.0              ),
-        std::complex<double>(  0.142755292821   , -0.0126511678539  ),
-        std::complex<double>( -0.0134727232705  , -0.0785247857538  ),
-        std::complex<double>( -0.132443716852   ,  0.00233959188499 ),
-        std::complex<double>(  0.0459987545121  ,  0.0459987545121  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>(  0.0              ,  0.0919975090242  ),
-        std::complex<double>( -0.0126511678539  ,  0.142755292821   ),
-        std::complex<double>( -0.0785247857538  , -0.0134727232705  ),
-        std::complex<double>(  0.00233959188499 , -0.132443716852   ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t(  0.0919975090242  ,  0.0              ),
+        complex_t(  0.142755292821   , -0.0126511678539  ),
+        complex_t( -0.0134727232705  , -0.0785247857538  ),
+        complex_t( -0.132443716852   ,  0.00233959188499 ),
+        complex_t(  0.0459987545121  ,  0.0459987545121  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t(  0.0              ,  0.0919975090242  ),
+        complex_t( -0.0126511678539  ,  0.142755292821   ),
+        complex_t( -0.0785247857538  , -0.0134727232705  ),
+        complex_t(  0.00233959188499 , -0.132443716852   ),
 
         //Long Training seque nce
-        std::complex<double>( -0.078            ,  0.0),
-        std::complex<double>(  0.0122845904586  , -0.0975995535921  ),
-        std::complex<double>(  0.0917165491224  , -0.105871659819   ),
-        std::complex<double>( -0.0918875552628  , -0.115128708911   ),
-        std::complex<double>( -0.00280594417349 , -0.0537742664765  ),
-        std::complex<double>(  0.0750736970682  ,  0.0740404189251  ),
-        std::complex<double>( -0.127324359908   ,  0.0205013799863  ),
-        std::complex<double>( -0.121887009061   ,  0.0165662181391  ),
-        std::complex<double>( -0.0350412607362  ,  0.150888347648   ),
-        std::complex<double>( -0.0564551284485  ,  0.0218039206074  ),
-        std::complex<double>( -0.0603101003162  , -0.0812861241157  ),
-        std::complex<double>(  0.0695568474069  , -0.0141219585906  ),
-        std::complex<double>(  0.0822183223031  , -0.0923565519537  ),
-        std::complex<double>( -0.131262608975   , -0.0652272290181  ),
-        std::complex<double>( -0.0572063458715  , -0.0392985881741  ),
-        std::complex<double>(  0.0369179420011  , -0.0983441502871  ),
-        std::complex<double>(  0.0625           ,  0.0625           ),
-        std::complex<double>(  0.11923908851    ,  0.0040955944148  ),
-        std::complex<double>( -0.0224832063078  , -0.160657332953   ),
-        std::complex<double>(  0.0586687671287  ,  0.0149389994507  ),
-        std::complex<double>(  0.0244758515211  ,  0.0585317956946  ),
-        std::complex<double>( -0.136804876816   ,  0.0473798113657  ),
-        std::complex<double>(  0.000988979708988,  0.115004643624   ),
-        std::complex<double>(  0.0533377343742  , -0.00407632648051 ),
-        std::complex<double>(  0.0975412607362  ,  0.0258883476483  ),
-        std::complex<double>( -0.0383159674744  ,  0.106170912615   ),
-        std::complex<double>( -0.115131214782   ,  0.0551804953744  ),
-        std::complex<double>(  0.059823844859   ,  0.0877067598357  ),
-        std::complex<double>(  0.0211117703493  , -0.0278859188282  ),
-        std::complex<double>(  0.0968318845911  , -0.0827979094878  ),
-        std::complex<double>(  0.0397496983535  ,  0.111157943051   ),
-        std::complex<double>( -0.00512125036042 ,  0.120325132674   ),
+        complex_t( -0.078            ,  0.0),
+        complex_t(  0.0122845904586  , -0.0975995535921  ),
+        complex_t(  0.0917165491224  , -0.105871659819   ),
+        complex_t( -0.0918875552628  , -0.115128708911   ),
+        complex_t( -0.00280594417349 , -0.0537742664765  ),
+        complex_t(  0.0750736970682  ,  0.0740404189251  ),
+        complex_t( -0.127324359908   ,  0.0205013799863  ),
+        complex_t( -0.121887009061   ,  0.0165662181391  ),
+        complex_t( -0.0350412607362  ,  0.150888347648   ),
+        complex_t( -0.0564551284485  ,  0.0218039206074  ),
+        complex_t( -0.0603101003162  , -0.0812861241157  ),
+        complex_t(  0.0695568474069  , -0.0141219585906  ),
+        complex_t(  0.0822183223031  , -0.0923565519537  ),
+        complex_t( -0.131262608975   , -0.0652272290181  ),
+        complex_t( -0.0572063458715  , -0.0392985881741  ),
+        complex_t(  0.0369179420011  , -0.0983441502871  ),
+        complex_t(  0.0625           ,  0.0625           ),
+        complex_t(  0.11923908851    ,  0.0040955944148  ),
+        complex_t( -0.0224832063078  , -0.160657332953   ),
+        complex_t(  0.0586687671287  ,  0.0149389994507  ),
+        complex_t(  0.0244758515211  ,  0.0585317956946  ),
+        complex_t( -0.136804876816   ,  0.0473798113657  ),
+        complex_t(  0.000988979708988,  0.115004643624   ),
+        complex_t(  0.0533377343742  , -0.00407632648051 ),
+        complex_t(  0.0975412607362  ,  0.0258883476483  ),
+        complex_t( -0.0383159674744  ,  0.106170912615   ),
+        complex_t( -0.115131214782   ,  0.0551804953744  ),
+        complex_t(  0.059823844859   ,  0.0877067598357  ),
+        complex_t(  0.0211117703493  , -0.0278859188282  ),
+        complex_t(  0.0968318845911  , -0.0827979094878  ),
+        complex_t(  0.0397496983535  ,  0.111157943051   ),
+        complex_t( -0.00512125036042 ,  0.120325132674   ),
 
-        std::complex<double>(  0.15625          ,  0.0              ),
-        std::complex<double>( -0.00512125036042 , -0.120325132674   ),
-        std::complex<double>(  0.0397496983535  , -0.111157943051   ),
-        std::complex<double>(  0.0968318845911  ,  0.0827979094878  ),
-        std::complex<double>(  0.0211117703493  ,  0.0278859188282  ),
-        std::complex<double>(  0.059823844859   , -0.0877067598357  ),
-        std::complex<double>( -0.115131214782   , -0.0551804953744  ),
-        std::complex<double>( -0.0383159674744  , -0.106170912615   ),
-        std::complex<double>(  0.0975412607362  , -0.0258883476483  ),
-        std::complex<double>(  0.0533377343742  ,  0.00407632648051 ),
-        std::complex<double>(  0.000988979708988, -0.115004643624   ),
-        std::complex<double>( -0.136804876816   , -0.0473798113657  ),
-        std::complex<double>(  0.0244758515211  , -0.0585317956946  ),
-        std::complex<double>(  0.0586687671287  , -0.0149389994507  ),
-        std::complex<double>( -0.0224832063078  ,  0.160657332953   ),
-        std::complex<double>(  0.11923908851    , -0.0040955944148  ),
-        std::complex<double>(  0.0625           , -0.0625           ),
-        std::complex<double>(  0.0369179420011  ,  0.0983441502871  ),
-        std::complex<double>( -0.0572063458715  ,  0.0392985881741  ),
-        std::complex<double>( -0.131262608975   ,  0.0652272290181  ),
-        std::complex<double>(  0.0822183223031  ,  0.0923565519537  ),
-        std::complex<double>(  0.0695568474069  ,  0.0141219585906  ),
-        std::complex<double>( -0.0603101003162  ,  0.0812861241157  ),
-        std::complex<double>( -0.0564551284485  , -0.0218039206074  ),
-        std::complex<double>( -0.0350412607362  , -0.150888347648   ) ,
-        std::complex<double>( -0.121887009061   , -0.0165662181391  ),
-        std::complex<double>( -0.127324359908   , -0.0205013799863  ),
-        std::complex<double>(  0.0750736970682  , -0.0740404189251  ),
-        std::complex<double>( -0.00280594417349 ,  0.0537742664765  ),
-        std::complex<double>( -0.0918875552628  ,  0.115128708911   ),
-        std::complex<double>(  0.0917165491224  ,  0.105871659819   ),
-        std::complex<double>(  0.0122845904586  ,  0.0975995535921  ),
-        std::complex<double>( -0.15625          ,  0.0              ),
-        std::complex<double>(  0.0122845904586  , -0.0975995535921  ),
-        std::complex<double>(  0.0917165491224  , -0.105871659819   ),
-        std::complex<double>( -0.0918875552628  , -0.115128708911   ),
-        std::complex<double>( -0.00280594417349 , -0.0537742664765  ),
-        std::complex<double>(  0.0750736970682  ,  0.0740404189251  ),
-        std::complex<double>( -0.127324359908   ,  0.0205013799863  ),
-        std::complex<double>( -0.121887009061   ,  0.0165662181391  ),
-        std::complex<double>( -0.0350412607362  ,  0.150888347648   ),
-        std::complex<double>( -0.0564551284485  ,  0.0218039206074  ),
-        std::complex<double>( -0.0603101003162  , -0.0812861241157  ),
-        std::complex<double>(  0.0695568474069  , -0.0141219585906  ),
-        std::complex<double>(  0.0822183223031  , -0.0923565519537  ),
-        std::complex<double>( -0.131262608975   , -0.0652272290181  ),
-        std::complex<double>( -0.0572063458715  , -0.0392985881741  ),
-        std::complex<double>(  0.0369179420011  , -0.0983441502871  ),
-        std::complex<double>(  0.0625           ,  0.0625           ),
-        std::complex<double>(  0.11923908851    ,  0.0040955944148  ),
-        std::complex<double>( -0.0224832063078  , -0.160657332953   ),
-        std::complex<double>(  0.0586687671287  ,  0.0149389994507  ),
-        std::complex<double>(  0.0244758515211  ,  0.0585317956946  ),
-        std::complex<double>( -0.136804876816   ,  0.0473798113657  ),
-        std::complex<double>(  0.000988979708988,  0.115004643624   ),
-        std::complex<double>(  0.0533377343742  , -0.00407632648051 ),
-        std::complex<double>(  0.0975412607362  ,  0.0258883476483  ),
-        std::complex<double>( -0.0383159674744  ,  0.106170912615   ),
-        std::complex<double>( -0.115131214782   ,  0.0551804953744  ),
-        std::complex<double>(  0.059823844859   ,  0.0877067598357  ),
-        std::complex<double>(  0.0211117703493  , -0.0278859188282  ),
-        std::complex<double>(  0.0968318845911  , -0.0827979094878  ),
-        std::complex<double>(  0.0397496983535  ,  0.111157943051   ),
-        std::complex<double>( -0.00512125036042 ,  0.120325132674   ),
+        complex_t(  0.15625          ,  0.0              ),
+        complex_t( -0.00512125036042 , -0.120325132674   ),
+        complex_t(  0.0397496983535  , -0.111157943051   ),
+        complex_t(  0.0968318845911  ,  0.0827979094878  ),
+        complex_t(  0.0211117703493  ,  0.0278859188282  ),
+        complex_t(  0.059823844859   , -0.0877067598357  ),
+        complex_t( -0.115131214782   , -0.0551804953744  ),
+        complex_t( -0.0383159674744  , -0.106170912615   ),
+        complex_t(  0.0975412607362  , -0.0258883476483  ),
+        complex_t(  0.0533377343742  ,  0.00407632648051 ),
+        complex_t(  0.000988979708988, -0.115004643624   ),
+        complex_t( -0.136804876816   , -0.0473798113657  ),
+        complex_t(  0.0244758515211  , -0.0585317956946  ),
+        complex_t(  0.0586687671287  , -0.0149389994507  ),
+        complex_t( -0.0224832063078  ,  0.160657332953   ),
+        complex_t(  0.11923908851    , -0.0040955944148  ),
+        complex_t(  0.0625           , -0.0625           ),
+        complex_t(  0.0369179420011  ,  0.0983441502871  ),
+        complex_t( -0.0572063458715  ,  0.0392985881741  ),
+        complex_t( -0.131262608975   ,  0.0652272290181  ),
+        complex_t(  0.0822183223031  ,  0.0923565519537  ),
+        complex_t(  0.0695568474069  ,  0.0141219585906  ),
+        complex_t( -0.0603101003162  ,  0.0812861241157  ),
+        complex_t( -0.0564551284485  , -0.0218039206074  ),
+        complex_t( -0.0350412607362  , -0.150888347648   ) ,
+        complex_t( -0.121887009061   , -0.0165662181391  ),
+        complex_t( -0.127324359908   , -0.0205013799863  ),
+        complex_t(  0.0750736970682  , -0.0740404189251  ),
+        complex_t( -0.00280594417349 ,  0.0537742664765  ),
+        complex_t( -0.0918875552628  ,  0.115128708911   ),
+        complex_t(  0.0917165491224  ,  0.105871659819   ),
+        complex_t(  0.0122845904586  ,  0.0975995535921  ),
+        complex_t( -0.15625          ,  0.0              ),
+        complex_t(  0.0122845904586  , -0.0975995535921  ),
+        complex_t(  0.0917165491224  , -0.105871659819   ),
+        complex_t( -0.0918875552628  , -0.115128708911   ),
+        complex_t( -0.00280594417349 , -0.0537742664765  ),
+        complex_t(  0.0750736970682  ,  0.0740404189251  ),
+        complex_t( -0.127324359908   ,  0.0205013799863  ),
+        complex_t( -0.121887009061   ,  0.0165662181391  ),
+        complex_t( -0.0350412607362  ,  0.150888347648   ),
+        complex_t( -0.0564551284485  ,  0.0218039206074  ),
+        complex_t( -0.0603101003162  , -0.0812861241157  ),
+        complex_t(  0.0695568474069  , -0.0141219585906  ),
+        complex_t(  0.0822183223031  , -0.0923565519537  ),
+        complex_t( -0.131262608975   , -0.0652272290181  ),
+        complex_t( -0.0572063458715  , -0.0392985881741  ),
+        complex_t(  0.0369179420011  , -0.0983441502871  ),
+        complex_t(  0.0625           ,  0.0625           ),
+        complex_t(  0.11923908851    ,  0.0040955944148  ),
+        complex_t( -0.0224832063078  , -0.160657332953   ),
+        complex_t(  0.0586687671287  ,  0.0149389994507  ),
+        complex_t(  0.0244758515211  ,  0.0585317956946  ),
+        complex_t( -0.136804876816   ,  0.0473798113657  ),
+        complex_t(  0.000988979708988,  0.115004643624   ),
+        complex_t(  0.0533377343742  , -0.00407632648051 ),
+        complex_t(  0.0975412607362  ,  0.0258883476483  ),
+        complex_t( -0.0383159674744  ,  0.106170912615   ),
+        complex_t( -0.115131214782   ,  0.0551804953744  ),
+        complex_t(  0.059823844859   ,  0.0877067598357  ),
+        complex_t(  0.0211117703493  , -0.0278859188282  ),
+        complex_t(  0.0968318845911  , -0.0827979094878  ),
+        complex_t(  0.0397496983535  ,  0.111157943051   ),
+        complex_t( -0.00512125036042 ,  0.120325132674   ),
 
-        std::complex<double>(  0.15625          ,  0.0              ),
-        std::complex<double>( -0.00512125036042 , -0.120325132674   ),
-        std::complex<double>(  0.0397496983535  , -0.111157943051   ),
-        std::complex<double>(  0.0968318845911  ,  0.0827979094878  ),
-        std::complex<double>(  0.0211117703493  ,  0.0278859188282  ),
-        std::complex<double>(  0.059823844859   , -0.0877067598357  ),
-        std::complex<double>( -0.115131214782   , -0.0551804953744  ),
-        std::complex<double>( -0.0383159674744  , -0.106170912615   ),
-        std::complex<double>(  0.0975412607362  , -0.0258883476483  ),
-        std::complex<double>(  0.0533377343742  ,  0.00407632648051 ),
-        std::complex<double>(  0.000988979708988, -0.115004643624   ),
-        std::complex<double>( -0.136804876816   , -0.0473798113657  ),
-        std::complex<double>(  0.0244758515211  , -0.0585317956946  ),
-        std::complex<double>(  0.0586687671287  , -0.0149389994507  ),
-        std::complex<double>( -0.0224832063078  ,  0.160657332953   ),
-        std::complex<double>(  0.11923908851    , -0.0040955944148  ),
-        std::complex<double>(  0.0625           , -0.0625           ),
-        std::complex<double>(  0.0369179420011  ,  0.0983441502871  ),
-        std::complex<double>( -0.0572063458715  ,  0.0392985881741  ),
-        std::complex<double>( -0.131262608975   ,  0.0652272290181  ),
-        std::complex<double>(  0.0822183223031  ,  0.0923565519537  ),
-        std::complex<double>(  0.0695568474069  ,  0.0141219585906  ),
-        std::complex<double>( -0.0603101003162  ,  0.0812861241157  ),
-        std::complex<double>( -0.0564551284485  , -0.0218039206074  ),
-        std::complex<double>( -0.0350412607362  , -0.150888347648   ),
-        std::complex<double>( -0.121887009061   , -0.0165662181391  ),
-        std::complex<double>( -0.127324359908   , -0.0205013799863  ),
-        std::complex<double>(  0.0750736970682  , -0.0740404189251  ),
-        std::complex<double>( -0.00280594417349 ,  0.0537742664765  ),
-        std::complex<double>( -0.0918875552628  ,  0.115128708911   ),
-        std::complex<double>(  0.0917165491224  ,  0.105871659819   ),
-        std::complex<double>(  0.0122845904586  ,  0.0975995535921  ),
-        std::complex<double>( -0.15625          ,  0.0              ),
-        std::complex<double>(  0.0122845904586  , -0.0975995535921  ),
-        std::complex<double>(  0.0917165491224  , -0.105871659819   ),
-        std::complex<double>( -0.0918875552628  , -0.115128708911   ),
-        std::complex<double>( -0.00280594417349 , -0.0537742664765  ),
-        std::complex<double>(  0.0750736970682  ,  0.0740404189251  ),
-        std::complex<double>( -0.127324359908   ,  0.0205013799863  ),
-        std::complex<double>( -0.121887009061   ,  0.0165662181391  ),
-        std::complex<double>( -0.0350412607362  ,  0.150888347648   ),
-        std::complex<double>( -0.0564551284485  ,  0.0218039206074  ),
-        std::complex<double>( -0.0603101003162  , -0.0812861241157  ),
-        std::complex<double>(  0.0695568474069  , -0.0141219585906  ),
-        std::complex<double>(  0.0822183223031  , -0.0923565519537  ),
-        std::complex<double>( -0.131262608975   , -0.0652272290181  ),
-        std::complex<double>( -0.0572063458715  , -0.0392985881741  ),
-        std::complex<double>(  0.0369179420011  , -0.0983441502871  ),
-        std::complex<double>(  0.0625           ,  0.0625           ),
-        std::complex<double>(  0.11923908851    ,  0.0040955944148  ),
-        std::complex<double>( -0.0224832063078  , -0.160657332953   ),
-        std::complex<double>(  0.0586687671287  ,  0.0149389994507  ),
-        std::complex<double>(  0.0244758515211  ,  0.0585317956946  ),
-        std::complex<double>( -0.136804876816   ,  0.0473798113657  ),
-        std::complex<double>(  0.000988979708988,  0.115004643624   ),
-        std::complex<double>(  0.0533377343742  , -0.00407632648051 ),
-        std::complex<double>(  0.0975412607362  ,  0.0258883476483  ),
-        std::complex<double>( -0.0383159674744  ,  0.106170912615   ),
-        std::complex<double>( -0.115131214782   ,  0.0551804953744  ),
-        std::complex<double>(  0.059823844859   ,  0.0877067598357  ),
-        std::complex<double>(  0.0211117703493  , -0.0278859188282  ),
-        std::complex<double>(  0.0968318845911  , -0.0827979094878  ),
-        std::complex<double>(  0.0397496983535  ,  0.111157943051   ),
-        std::complex<double>( -0.00512125036042 ,  0.120325132674   )
+        complex_t(  0.15625          ,  0.0              ),
+        complex_t( -0.00512125036042 , -0.120325132674   ),
+        complex_t(  0.0397496983535  , -0.111157943051   ),
+        complex_t(  0.0968318845911  ,  0.0827979094878  ),
+        complex_t(  0.0211117703493  ,  0.0278859188282  ),
+        complex_t(  0.059823844859   , -0.0877067598357  ),
+        complex_t( -0.115131214782   , -0.0551804953744  ),
+        complex_t( -0.0383159674744  , -0.106170912615   ),
+        complex_t(  0.0975412607362  , -0.0258883476483  ),
+        complex_t(  0.0533377343742  ,  0.00407632648051 ),
+        complex_t(  0.000988979708988, -0.115004643624   ),
+        complex_t( -0.136804876816   , -0.0473798113657  ),
+        complex_t(  0.0244758515211  , -0.0585317956946  ),
+        complex_t(  0.0586687671287  , -0.0149389994507  ),
+        complex_t( -0.0224832063078  ,  0.160657332953   ),
+        complex_t(  0.11923908851    , -0.0040955944148  ),
+        complex_t(  0.0625           , -0.0625           ),
+        complex_t(  0.0369179420011  ,  0.0983441502871  ),
+        complex_t( -0.0572063458715  ,  0.0392985881741  ),
+        complex_t( -0.131262608975   ,  0.0652272290181  ),
+        complex_t(  0.0822183223031  ,  0.0923565519537  ),
+        complex_t(  0.0695568474069  ,  0.0141219585906  ),
+        complex_t( -0.0603101003162  ,  0.0812861241157  ),
+        complex_t( -0.0564551284485  , -0.0218039206074  ),
+        complex_t( -0.0350412607362  , -0.150888347648   ),
+        complex_t( -0.121887009061   , -0.0165662181391  ),
+        complex_t( -0.127324359908   , -0.0205013799863  ),
+        complex_t(  0.0750736970682  , -0.0740404189251  ),
+        complex_t( -0.00280594417349 ,  0.0537742664765  ),
+        complex_t( -0.0918875552628  ,  0.115128708911   ),
+        complex_t(  0.0917165491224  ,  0.105871659819   ),
+        complex_t(  0.0122845904586  ,  0.0975995535921  ),
+        complex_t( -0.15625          ,  0.0              ),
+        complex_t(  0.0122845904586  , -0.0975995535921  ),
+        complex_t(  0.0917165491224  , -0.105871659819   ),
+        complex_t( -0.0918875552628  , -0.115128708911   ),
+        complex_t( -0.00280594417349 , -0.0537742664765  ),
+        complex_t(  0.0750736970682  ,  0.0740404189251  ),
+        complex_t( -0.127324359908   ,  0.0205013799863  ),
+        complex_t( -0.121887009061   ,  0.0165662181391  ),
+        complex_t( -0.0350412607362  ,  0.150888347648   ),
+        complex_t( -0.0564551284485  ,  0.0218039206074  ),
+        complex_t( -0.0603101003162  , -0.0812861241157  ),
+        complex_t(  0.0695568474069  , -0.0141219585906  ),
+        complex_t(  0.0822183223031  , -0.0923565519537  ),
+        complex_t( -0.131262608975   , -0.0652272290181  ),
+        complex_t( -0.0572063458715  , -0.0392985881741  ),
+        complex_t(  0.0369179420011  , -0.0983441502871  ),
+        complex_t(  0.0625           ,  0.0625           ),
+        complex_t(  0.11923908851    ,  0.0040955944148  ),
+        complex_t( -0.0224832063078  , -0.160657332953   ),
+        complex_t(  0.0586687671287  ,  0.0149389994507  ),
+        complex_t(  0.0244758515211  ,  0.0585317956946  ),
+        complex_t( -0.136804876816   ,  0.0473798113657  ),
+        complex_t(  0.000988979708988,  0.115004643624   ),
+        complex_t(  0.0533377343742  , -0.00407632648051 ),
+        complex_t(  0.0975412607362  ,  0.0258883476483  ),
+        complex_t( -0.0383159674744  ,  0.106170912615   ),
+        complex_t( -0.115131214782   ,  0.0551804953744  ),
+        complex_t(  0.059823844859   ,  0.0877067598357  ),
+        complex_t(  0.0211117703493  , -0.0278859188282  ),
+        complex_t(  0.0968318845911  , -0.0827979094878  ),
+        complex_t(  0.0397496983535  ,  0.111157943051   ),
+        complex_t( -0.00512125036042 ,  0.120325132674   )
     };
 
 
     /*! \brief Long Training Sequence in frequency domain. */
-    static std::complex<double> LTS_FREQ_DOMAIN[64] =
+    static complex_t LTS_FREQ_DOMAIN[64] =
     {
-        std::complex<double>( 0,  0 ),
-        std::complex<double>( 0,  0 ),
-        std::complex<double>( 0,  0 ),
-        std::complex<double>( 0,  0 ),
-        std::complex<double>( 0,  0 ),
-        std::complex<double>( 0,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 0,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>(-1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 1,  0 ),
-        std::complex<double>( 0,  0 ),
-        std::complex<double>( 0,  0 ),
-        std::complex<double>( 0,  0 ),
-        std::complex<double>( 0,  0 ),
-        std::complex<double>( 0,  0 )
+        complex_t( 0,  0 ),
+        complex_t( 0,  0 ),
+        complex_t( 0,  0 ),
+        complex_t( 0,  0 ),
+        complex_t( 0,  0 ),
+        complex_t( 0,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 0,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t(-1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 1,  0 ),
+        complex_t( 0,  0 ),
+        complex_t( 0,  0 ),
+        complex_t( 0,  0 ),
+        complex_t( 0,  0 ),
+        complex_t( 0,  0 )
     };
 
     /*! \brief Complex conjugate of Long Training Sequence in time domain. */
-    static std::complex<double> LTS_TIME_DOMAIN_CONJ[64] =
+    static complex_t LTS_TIME_DOMAIN_CONJ[64] =
     {
-        std::complex<double>( 0.15625          ,  0.0),
-        std::complex<double>(-0.00512125036042 ,  0.120325132674),
-        std::complex<double>( 0.0397496983535  ,  0.111157943051),
-        std::complex<double>( 0.0968318845911  , -0.0827979094878),
-        std::complex<double>( 0.0211117703493  , -0.0278859188282),
-        std::complex<double>( 0.059823844859   ,  0.0877067598357),
-        std::complex<double>(-0.115131214782   ,  0.0551804953744),
-        std::complex<double>(-0.0383159674744  ,  0.106170912615),
-        std::complex<double>( 0.0975412607362  ,  0.0258883476483),
-        std::complex<double>( 0.0533377343742  , -0.00407632648051),
-        std::complex<double>( 0.000988979708988,  0.115004643624),
-        std::complex<double>(-0.136804876816   ,  0.0473798113657),
-        std::complex<double>( 0.0244758515211  ,  0.0585317956946),
-        std::complex<double>( 0.0586687671287  ,  0.0149389994507),
-        std::complex<double>(-0.0224832063078  , -0.160657332953),
-        std::complex<double>( 0.11923908851    ,  0.0040955944148),
-        std::complex<double>( 0.0625           ,  0.0625),
-        std::complex<double>( 0.0369179420011  , -0.0983441502871),
-        std::complex<double>(-0.0572063458715  , -0.0392985881741),
-        std::complex<double>(-0.131262608975   , -0.0652272290181),
-        std::complex<double>( 0.0822183223031  , -0.0923565519537),
-        std::complex<double>( 0.0695568474069  , -0.0141219585906),
-        std::complex<double>(-0.0603101003162  , -0.0812861241157),
-        std::complex<double>(-0.0564551284485  ,  0.0218039206074),
-        std::complex<double>(-0.0350412607362  ,  0.150888347648),
-        std::complex<double>(-0.121887009061   ,  0.0165662181391),
-        std::complex<double>(-0.127324359908   ,  0.0205013799863),
-        std::complex<double>( 0.0750736970682  ,  0.0740404189251),
-        std::complex<double>(-0.00280594417349 , -0.0537742664765),
-        std::complex<double>(-0.0918875552628  , -0.115128708911),
-        std::complex<double>( 0.0917165491224  , -0.105871659819),
-        std::complex<double>( 0.0122845904586  , -0.0975995535921),
-        std::complex<double>(-0.15625          , -0.0),
-        std::complex<double>( 0.0122845904586  ,  0.0975995535921),
-        std::complex<double>( 0.0917165491224  ,  0.105871659819),
-        std::complex<double>(-0.0918875552628  ,  0.115128708911),
-        std::complex<double>(-0.00280594417349 ,  0.0537742664765),
-        std::complex<double>( 0.0750736970682  , -0.0740404189251),
-        std::complex<double>(-0.127324359908   , -0.0205013799863),
-        std::complex<double>(-0.121887009061   , -0.0165662181391),
-        std::complex<double>(-0.0350412607362  , -0.150888347648),
-        std::complex<double>(-0.0564551284485  , -0.0218039206074),
-        std::complex<double>(-0.0603101003162  ,  0.0812861241157),
-        std::complex<double>( 0.0695568474069  ,  0.0141219585906),
-        std::complex<double>( 0.0822183223031  ,  0.0923565519537),
-        std::complex<double>(-0.131262608975   ,  0.0652272290181),
-        std::complex<double>(-0.0572063458715  ,  0.0392985881741),
-        std::complex<double>( 0.0369179420011  ,  0.0983441502871),
-        std::complex<double>( 0.0625           , -0.0625),
-        std::complex<double>( 0.11923908851    , -0.0040955944148),
-        std::complex<double>(-0.0224832063078  ,  0.160657332953),
-        std::complex<double>( 0.0586687671287  , -0.0149389994507),
-        std::complex<double>( 0.0244758515211  , -0.0585317956946),
-        std::complex<double>(-0.136804876816   , -0.0473798113657),
-        std::complex<double>( 0.000988979708988, -0.115004643624),
-        std::complex<double>( 0.0533377343742  ,  0.00407632648051),
-        std::complex<double>( 0.0975412607362  , -0.0258883476483),
-        std::complex<double>(-0.0383159674744  , -0.106170912615),
-        std::complex<double>(-0.115131214782   , -0.0551804953744),
-        std::complex<double>( 0.059823844859   , -0.0877067598357),
-        std::complex<double>( 0.0211117703493  ,  0.0278859188282),
-        std::complex<double>( 0.0968318845911  ,  0.0827979094878),
-        std::complex<double>( 0.0397496983535  , -0.111157943051),
-        std::complex<double>(-0.00512125036042 , -0.120325132674)
+        complex_t( 0.15625          ,  0.0),
+        complex_t(-0.00512125036042 ,  0.120325132674),
+        complex_t( 0.0397496983535  ,  0.111157943051),
+        complex_t( 0.0968318845911  , -0.0827979094878),
+        complex_t( 0.0211117703493  , -0.0278859188282),
+        complex_t( 0.059823844859   ,  0.0877067598357),
+        complex_t(-0.115131214782   ,  0.0551804953744),
+        complex_t(-0.0383159674744  ,  0.106170912615),
+        complex_t( 0.0975412607362  ,  0.0258883476483),
+        complex_t( 0.0533377343742  , -0.00407632648051),
+        complex_t( 0.000988979708988,  0.115004643624),
+        complex_t(-0.136804876816   ,  0.0473798113657),
+        complex_t( 0.0244758515211  ,  0.0585317956946),
+        complex_t( 0.0586687671287  ,  0.0149389994507),
+        complex_t(-0.0224832063078  , -0.160657332953),
+        complex_t( 0.11923908851    ,  0.0040955944148),
+        complex_t( 0.0625           ,  0.0625),
+        complex_t( 0.0369179420011  , -0.0983441502871),
+        complex_t(-0.0572063458715  , -0.0392985881741),
+        complex_t(-0.131262608975   , -0.0652272290181),
+        complex_t( 0.0822183223031  , -0.0923565519537),
+        complex_t( 0.0695568474069  , -0.0141219585906),
+        complex_t(-0.0603101003162  , -0.0812861241157),
+        complex_t(-0.0564551284485  ,  0.0218039206074),
+        complex_t(-0.0350412607362  ,  0.150888347648),
+        complex_t(-0.121887009061   ,  0.0165662181391),
+        complex_t(-0.127324359908   ,  0.0205013799863),
+        complex_t( 0.0750736970682  ,  0.0740404189251),
+        complex_t(-0.00280594417349 , -0.0537742664765),
+        complex_t(-0.0918875552628  , -0.115128708911),
+        complex_t( 0.0917165491224  , -0.105871659819),
+        complex_t( 0.0122845904586  , -0.0975995535921),
+        complex_t(-0.15625          , -0.0),
+        complex_t( 0.0122845904586  ,  0.0975995535921),
+        complex_t( 0.0917165491224  ,  0.105871659819),
+        complex_t(-0.0918875552628  ,  0.115128708911),
+        complex_t(-0.00280594417349 ,  0.0537742664765),
+        complex_t( 0.0750736970682  , -0.0740404189251),
+        complex_t(-0.127324359908   , -0.0205013799863),
+        complex_t(-0.121887009061   , -0.0165662181391),
+        complex_t(-0.0350412607362  , -0.150888347648),
+        complex_t(-0.0564551284485  , -0.0218039206074),
+        complex_t(-0.0603101003162  ,  0.0812861241157),
+        complex_t( 0.0695568474069  ,  0.0141219585906),
+        complex_t( 0.0822183223031  ,  0.0923565519537),
+        complex_t(-0.131262608975   ,  0.0652272290181),
+        complex_t(-0.0572063458715  ,  0.0392985881741),
+        complex_t( 0.0369179420011  ,  0.0983441502871),
+        complex_t( 0.0625           , -0.0625),
+        complex_t( 0.11923908851    , -0.0040955944148),
+        complex_t(-0.0224832063078  ,  0.160657332953),
+        complex_t( 0.0586687671287  , -0.0149389994507),
+        complex_t( 0.0244758515211  , -0.0585317956946),
+        complex_t(-0.136804876816   , -0.0473798113657),
+        complex_t( 0.000988979708988, -0.115004643624),
+        complex_t( 0.0533377343742  ,  0.00407632648051),
+        complex_t( 0.0975412607362  , -0.0258883476483),
+        complex_t(-0.0383159674744  , -0.106170912615),
+        complex_t(-0.115131214782   , -0.0551804953744),
+        complex_t( 0.059823844859   , -0.0877067598357),
+        complex_t( 0.0211117703493  ,  0.0278859188282),
+        complex_t( 0.0968318845911  ,  0.0827979094878),
+        complex_t( 0.0397496983535  , -0.111157943051),
+        complex_t(-0.00512125036042 , -0.120325132674)
     };
 
     /*! \brief Short Training Sequence in time domain. */
-    static std::complex<double> STS_SAMPLES[16] =
+    static complex_t STS_SAMPLES[16] =
     {
-        std::complex<double>( 0.0459987545121 ,  0.0459987545121),
-        std::complex<double>(-0.132443716852  ,  0.00233959188499),
-        std::complex<double>(-0.0134727232705 , -0.0785247857538),
-        std::complex<double>( 0.142755292821  , -0.0126511678539),
-        std::complex<double>( 0.0919975090242 ,  0.0),
-        std::complex<double>( 0.142755292821  , -0.0126511678539),
-        std::complex<double>(-0.0134727232705 , -0.0785247857538),
-        std::complex<double>(-0.132443716852  ,  0.00233959188499),
-        std::complex<double>( 0.0459987545121 ,  0.0459987545121),
-        std::complex<double>( 0.00233959188499, -0.132443716852),
-        std::complex<double>(-0.0785247857538 , -0.0134727232705),
-        std::complex<double>(-0.0126511678539 ,  0.142755292821),
-        std::complex<double>( 0.0             ,  0.0919975090242),
-        std::complex<double>(-0.0126511678539 ,  0.142755292821),
-        std::complex<double>(-0.0785247857538 , -0.0134727232705),
-        std::complex<double>( 0.00233959188499, -0.132443716852),
+        complex_t( 0.0459987545121 ,  0.0459987545121),
+        complex_t(-0.132443716852  ,  0.00233959188499),
+        complex_t(-0.0134727232705 , -0.0785247857538),
+        complex_t( 0.142755292821  , -0.0126511678539),
+        complex_t( 0.0919975090242 ,  0.0),
+        complex_t( 0.142755292821  , -0.0126511678539),
+        complex_t(-0.0134727232705 , -0.0785247857538),
+        complex_t(-0.132443716852  ,  0.00233959188499),
+        complex_t( 0.0459987545121 ,  0.0459987545121),
+        complex_t( 0.00233959188499, -0.132443716852),
+        complex_t(-0.0785247857538 , -0.0134727232705),
+        complex_t(-0.0126511678539 ,  0.142755292821),
+        complex_t( 0.0             ,  0.0919975090242),
+        complex_t(-0.0126511678539 ,  0.142755292821),
+        complex_t(-0.0785247857538 , -0.0134727232705),
+        complex_t( 0.00233959188499, -0.132443716852),
     };
 
 }
@@ -0,0 +1,27 @@
+/*! \file precision.h
+ *  \brief Header file for the sample precision used throughout fun_ofdm.
+ *
+ *  By default every sample in the transmit and receive chains is a complex double.
+ *  Defining FUN_OFDM_SINGLE_PRECISION (see the cmake option of the same name) switches
+ *  the whole sample path over to complex floats. The fft class then uses the single
+ *  precision fftw3f library and the usrp class streams fc32 samples from UHD, which halves
+ *  the memory footprint of every buffer in the chains.
+ */
+
+#ifndef PRECISION_H
+#define PRECISION_H
+
+#include <complex>
+
+namespace fun
+{
+#ifdef FUN_OFDM_SINGLE_PRECISION
+    typedef float real_t;   //!< Real sample type (single precision build)
+#else
+    typedef double real_t;  //!< Real sample type (double precision build)
+#endif
+
+    typedef std::complex<real_t> complex_t; //!< Complex sample type used by every block
+}
+
+#endif // PRECISION_H
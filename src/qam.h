@@ -11,6 +11,8 @@
 
 #include <climits>
 
+#include "precision.h"
+
 namespace fun
 {
 
@@ -50,6 +52,16 @@ namespace fun
             d_scale_d = (1 << d_gain) / sf;
         }
 
+        /*!
+         * \brief Scale from a symbol to the fixed point value #decode() slices
+         */
+        double decode_scale() const { return d_scale_d; }
+
+        /*!
+         * \brief Gain of #decode()'s fixed point value (power of 2)
+         */
+        int decode_gain() const { return d_gain; }
+
         /*!
          * \brief sign
          * \param v
@@ -80,7 +92,7 @@ namespace fun
          * \param bits
          * \param sym
          */
-        inline void encode (const char* bits, double *sym)
+        inline void encode (const char* bits, real_t *sym)
         {
             int pt = 0; // constellation point
             int flip = 1; // +1 or -1 -- for gray coding
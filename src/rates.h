@@ -248,6 +248,46 @@ namespace fun
             }
         }
     };
+
+    /*! \brief The coding rates, i.e. which puncture pattern a #Rate uses */
+    enum CodingRate
+    {
+        CODING_1_2 = 0, //!< Rate 1/2 code : no puncturing
+        CODING_2_3 = 1, //!< Rate 2/3 code : 3 of every 4 coded bits kept
+        CODING_3_4 = 2  //!< Rate 3/4 code : 4 of every 6 coded bits kept
+    };
+
+    /*!
+     * \brief The rate_traits struct template
+     *
+     * The same parameters as #RateParams but as compile time constants so that code
+     * instantiated per #Rate (see ppdu) can have them folded into its loops.
+     */
+    template<Rate R>
+    struct rate_traits
+    {
+        //! Bits per subcarrier
+        static const int bpsc = (R <= RATE_3_4_BPSK) ? 1 : (R <= RATE_3_4_QPSK) ? 2 : (R <= RATE_3_4_QAM16) ? 4 : 6;
+
+        //! Coded bits per symbol
+        static const int cbps = 48 * bpsc;
+
+        //! The coding rate
+        static const CodingRate coding = (R == RATE_2_3_QAM64) ? CODING_2_3 :
+                                         (R == RATE_3_4_QAM64) ? CODING_3_4 : CodingRate(R % 3);
+
+        //! Data bits per symbol
+        static const int dbps = (coding == CODING_1_2) ? cbps / 2 : (coding == CODING_2_3) ? cbps * 2 / 3 : cbps * 3 / 4;
+
+        /*!
+         * \brief Number of data OFDM symbols of a frame
+         * \param length Payload length in bytes
+         */
+        static int symbol_count(int length)
+        {
+            return (16 /* service */ + 8 * (length + 4 /* CRC */) + 6 /* tail */ + dbps - 1) / dbps;
+        }
+    };
 }
 
 
@@ -5,6 +5,9 @@
  *  This is the easiest way to start receiving 802.11a OFDM frames out of the box.
  */
 
+#include <algorithm>
+#include <chrono>
+
 #include "receiver.h"
 
 namespace fun
@@ -18,48 +21,314 @@ namespace fun
     {
     }
 
+    /*!
+     * The ring holds size + 1 buffers in total so the capture thread always has a buffer to
+     * receive into even when size buffers are waiting to be processed.
+     */
+    rx_ring::rx_ring(int size, int chunk_size) :
+        filled(size + 1),
+        spare(size + 1),
+        filled_times(size + 1),
+        samples(0),
+        overflows(0),
+        timeouts(0),
+        late_commands(0),
+        other_errors(0),
+        dropped_buffers(0),
+        queued(0),
+        ring_high_water(0),
+        clock_offset(0),
+        clock_synced(false)
+    {
+        sem_init(&filled_count, 0, 0);
+        for(int x = 0; x < size + 1; x++)
+        {
+            std::vector<complex_t > buffer(chunk_size);
+            spare.push(buffer);
+        }
+    }
+
+    void rx_ring::record(int received, const rx_error_counts & errors)
+    {
+        samples.fetch_add(received, std::memory_order_relaxed);
+        overflows.store(errors.overflows, std::memory_order_relaxed);
+        timeouts.store(errors.timeouts, std::memory_order_relaxed);
+        late_commands.store(errors.late_commands, std::memory_order_relaxed);
+        other_errors.store(errors.other_errors, std::memory_order_relaxed);
+    }
+
+    /*!
+     * The offset is measured from the last sample received, which has just reached the host. Any
+     * delay on the way only makes the offset larger so the smallest one seen is the best estimate.
+     */
+    void rx_ring::sync_clock(double time, int received, double sample_rate)
+    {
+        if(time < 0 || received == 0) return;
+        double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        double offset = now - (time + (received - 1) / sample_rate);
+        if(clock_synced.load(std::memory_order_relaxed))
+        {
+            offset = std::min(offset, clock_offset.load(std::memory_order_relaxed) + RX_CLOCK_DRIFT);
+        }
+        clock_offset.store(offset, std::memory_order_relaxed);
+        clock_synced.store(true, std::memory_order_release);
+    }
+
+    /*!
+     * The ring holds one more buffer than #filled can ever need so the push can't fail.
+     * The time is pushed first so it is always there by the time the buffer is popped.
+     */
+    void rx_ring::push_filled(std::vector<complex_t > & buffer, double time)
+    {
+        filled_times.push(time);
+        filled.push(buffer);
+        buffer.clear();
+        int now_queued = queued.fetch_add(1) + 1;
+        if(now_queued > ring_high_water.load(std::memory_order_relaxed))
+            ring_high_water.store(now_queued, std::memory_order_relaxed);
+        sem_post(&filled_count);
+    }
+
+    void rx_ring::pop_filled(std::vector<complex_t > & buffer, double & time)
+    {
+        sem_wait(&filled_count);
+        filled_times.pop(time);
+        filled.pop(buffer);
+        queued.fetch_sub(1);
+    }
+
+    /*!
+     * Every channel is received straight into a spare buffer of its ring. A channel whose ring
+     * is full has its samples received into a scratch buffer and dropped without holding up the
+     * other channels, so that the USRP never overflows.
+     */
+    void rx_ring::capture(usrp & source, const std::vector<rx_ring *> & rings, int chunk_size, double sample_rate,
+                          const thread_params & thread, sem_t * pause)
+    {
+        int channels = rings.size();
+        std::vector<std::vector<complex_t > > buffers(channels);
+        std::vector<std::vector<complex_t > > scratch(channels, std::vector<complex_t >(chunk_size));
+        std::vector<complex_t *> targets(channels);
+        std::vector<bool> have_buffer(channels);
+        rx_error_counts errors;
+        configure_thread("fun_rx_capture", thread);
+        while(1)
+        {
+            sem_wait(pause); // Block if the receiver is paused
+
+            for(int c = 0; c < channels; c++)
+            {
+                have_buffer[c] = buffers[c].size() != 0 || rings[c]->spare.pop(buffers[c]);
+                if(have_buffer[c]) buffers[c].resize(chunk_size);
+                targets[c] = have_buffer[c] ? buffers[c].data() : scratch[c].data();
+            }
+
+            double time;
+            int received = source.get_samples(chunk_size, targets, &errors, &time);
+
+            for(int c = 0; c < channels; c++)
+            {
+                rings[c]->record(received, errors);
+                rings[c]->sync_clock(time, received, sample_rate);
+                if(!have_buffer[c])
+                {
+                    rings[c]->dropped_buffers.fetch_add(1, std::memory_order_relaxed);
+                }
+                else if(received > 0)
+                {
+                    buffers[c].resize(received);
+                    rings[c]->push_filled(buffers[c], time);
+                }
+            }
+
+            sem_post(pause); // Flags the end of this loop and wakes up any other threads waiting on this semaphore
+                             // i.e. a call to the pause() function in the main thread.
+        }
+    }
+
+    receiver_stats rx_ring::snapshot()
+    {
+        receiver_stats stats;
+        stats.samples = samples;
+        stats.overflows = overflows;
+        stats.timeouts = timeouts;
+        stats.late_commands = late_commands;
+        stats.other_errors = other_errors;
+        stats.dropped_buffers = dropped_buffers;
+        stats.ring_high_water = ring_high_water;
+        return stats;
+    }
+
+    /*!
+     * \brief Returns a copy of rx_params whose receiver chain runs at the given sample rate
+     *  (and chunk size)
+     */
+    static receiver_params with_sample_rate(receiver_params rx_params, double rate)
+    {
+        rx_params.chain.sample_rate = rate;
+        rx_params.chain.chunk_size = rx_params.chunk_size;
+        return rx_params;
+    }
+
     /*!
      * This constructor is for those who feel more comfortable using the usrp_params struct.
      */
-    receiver::receiver(void (*callback)(std::vector<std::vector<unsigned char> > packets), usrp_params params) :
+    receiver::receiver(void (*callback)(std::vector<std::vector<unsigned char> > packets), usrp_params params, receiver_params rx_params) :
+        receiver(callback, NULL, params, rx_params)
+    {
+    }
+
+    receiver::receiver(void (*callback)(const std::vector<packet *> & packets, packet_pool & pool), usrp_params params, receiver_params rx_params) :
+        receiver(NULL, callback, params, rx_params)
+    {
+    }
+
+    receiver::receiver(void (*callback)(std::vector<std::vector<unsigned char> > packets),
+                       void (*packet_callback)(const std::vector<packet *> & packets, packet_pool & pool),
+                       usrp_params params, receiver_params rx_params) :
         m_usrp(params),
-        m_samples(NUM_RX_SAMPLES),
+        m_rx_params(with_sample_rate(rx_params, params.rate)),
         m_callback(callback),
-        m_rec_chain()
+        m_packet_callback(packet_callback),
+        m_pool(new packet_pool()),
+        m_rec_chain(m_rx_params.chain),
+        m_capture(new rx_ring(RX_RING_SIZE, m_rx_params.chunk_size)),
+        m_output_ring(m_rx_params.output_ring.name.empty() ? NULL : new shm_ring(m_rx_params.output_ring)),
+        m_turnarounds(TURNAROUND_HISTORY),
+        m_turnaround_count(0),
+        m_turnaround_mutex(new std::mutex())
     {
-        sem_init(&m_pause, 0, 1); //Initial value is 1 so that the receiver_chain_loop() will begin executing immediately
+        sem_init(&m_pause, 0, 1); //Initial value is 1 so that the capture_loop() will begin executing immediately
+        m_capture_thread = std::thread(&receiver::capture_loop, this); //Initialize the capture thread
         m_rec_thread = std::thread(&receiver::receiver_chain_loop, this); //Initialize the main receiver thread
     }
 
     /*!
-     *  This function loops forever (unless it is paused) pulling samples from the USRP and passing them through the
-     *  receiver chain. It then passes any successfully decoded packets to the callback function for the user
-     *  to process further. This function can be paused by the user by calling the receiver::pause() function,
+     *  This function loops forever (unless it is paused) pulling samples from the USRP into the capture ring.
+     *  This function can be paused by the user by calling the receiver::pause() function,
      *  presumably so that the user can transmit packets over the air using the transmitter. Once the user is finished
      *  transmitting he/she can resume the receiver by called the receiver::resume() function. These two functions use
      *  an internal semaphore to block the receiver code execution while in the paused state.
+     *
+     *  If the receiver chain has fallen so far behind that every buffer is waiting to be processed the
+     *  newest samples are received into a scratch buffer and dropped so that the USRP never overflows
+     *  (see rx_ring::capture()).
+     */
+    void receiver::capture_loop()
+    {
+        rx_ring::capture(m_usrp, std::vector<rx_ring *>(1, m_capture), m_rx_params.chunk_size,
+                         m_rx_params.chain.sample_rate, m_rx_params.capture_thread, &m_pause);
+    }
+
+    /*!
+     *  This function loops forever passing the buffers filled by the capture thread through the
+     *  receiver chain. It then passes any successfully decoded packets to the callback function for the user
+     *  to process further (in pooled packets if the receiver was given a packet callback). The buffers are swapped into the receiver chain and the spent buffer it hands
+     *  back is returned to the capture thread to be refilled.
+     *
+     *  If there is an output ring the packets are published to it before the callback is called
+     *  so a slow callback doesn't hold up the other processes reading the ring.
      */
     void receiver::receiver_chain_loop()
     {
+        std::vector<complex_t > buffer;
+        std::vector<packet *> pooled;
+        configure_thread("fun_rx_chain", m_rx_params.process_thread);
         while(1)
         {
-            sem_wait(&m_pause); // Block if the receiver is paused
+            double time;
+            m_capture->pop_filled(buffer, time);
 
-            m_usrp.get_samples(NUM_RX_SAMPLES, m_samples);
+            std::vector<std::vector<unsigned char> > packets;
+            if(m_packet_callback) m_rec_chain.process_packets(buffer, *m_pool, pooled, time);
+            else packets = m_rec_chain.process_buffer(buffer, time);
+            record_turnarounds(m_rec_chain.get_packet_info());
 
-            std::vector<std::vector<unsigned char> > packets =
-                    m_rec_chain.process_samples(m_samples);
+            if(buffer.capacity() < m_rx_params.chunk_size) buffer.reserve(m_rx_params.chunk_size);
+            m_capture->spare.push(buffer);
 
-            m_callback(packets);
+            if(m_output_ring != NULL)
+            {
+                const std::vector<packet_info> & info = m_rec_chain.get_packet_info();
+                for(int x = 0; x < pooled.size(); x++) m_output_ring->publish(pooled[x]->payload.data(), pooled[x]->payload.size(), pooled[x]->info);
+                for(int x = 0; x < packets.size() && x < info.size(); x++) m_output_ring->publish(packets[x].data(), packets[x].size(), info[x]);
+            }
 
-            sem_post(&m_pause); // Flags the end of this loop and wakes up any other threads waiting on this semaphore
-                                // i.e. a call to the pause() function in the main thread.
+            if(m_packet_callback)
+            {
+                m_packet_callback(pooled, *m_pool);
+                pooled.clear();
+            }
+            else if(m_callback) m_callback(packets);
         }
     }
 
+    receiver_stats receiver::get_stats()
+    {
+        return m_capture->snapshot();
+    }
+
+    block_stats receiver::get_latency_stats()
+    {
+        return m_rec_chain.get_latency_stats();
+    }
+
+    overload_stats receiver::get_overload_stats()
+    {
+        return m_rec_chain.get_overload_stats();
+    }
+
+    detection_stats receiver::get_detection_stats()
+    {
+        return m_rec_chain.get_detection_stats();
+    }
+
+    /*!
+     * Packets without an on air time (or before the USRP's clock has been tied to the host's) aren't measured.
+     */
+    void receiver::record_turnarounds(const std::vector<packet_info> & info)
+    {
+        if(info.empty() || !m_capture->clock_synced.load(std::memory_order_acquire)) return;
+        double offset = m_capture->clock_offset.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(*m_turnaround_mutex);
+        for(int x = 0; x < info.size(); x++)
+        {
+            if(info[x].air_end < 0) continue;
+            m_turnarounds[m_turnaround_count % TURNAROUND_HISTORY] = info[x].delivered - (info[x].air_end + offset);
+            m_turnaround_count++;
+        }
+    }
+
+    shm_ring_stats receiver::get_ring_stats()
+    {
+        if(m_output_ring == NULL) return shm_ring_stats();
+        return m_output_ring->get_stats();
+    }
+
+    turnaround_stats receiver::get_turnaround_stats()
+    {
+        std::vector<double> turnarounds;
+        turnaround_stats stats = turnaround_stats();
+        {
+            std::lock_guard<std::mutex> lock(*m_turnaround_mutex);
+            stats.packets = m_turnaround_count;
+            turnarounds.assign(m_turnarounds.begin(), m_turnarounds.begin() + std::min<unsigned long long>(m_turnaround_count, TURNAROUND_HISTORY));
+        }
+        if(turnarounds.empty()) return stats;
+
+        std::sort(turnarounds.begin(), turnarounds.end());
+        int last = turnarounds.size() - 1;
+        stats.p50 = turnarounds[last * 50 / 100];
+        stats.p90 = turnarounds[last * 90 / 100];
+        stats.p99 = turnarounds[last * 99 / 100];
+        stats.max = turnarounds[last];
+        return stats;
+    }
+
     /*!
-     *  Uses an internal semaphore to block the execution of the receiver loop code effectively pausing
+     *  Uses an internal semaphore to block the execution of the capture loop code effectively pausing
      *  the receiver until the semaphore is posted to (cleared) by the receiver::resume() function.
+     *  Samples that were already captured are still processed while the receiver is paused.
      */
     void receiver::pause()
     {
@@ -67,7 +336,7 @@ namespace fun
     }
 
     /*!
-     *  This function posts to (clears) the internal semaphore that is blocking the receiver loop code execution
+     *  This function posts to (clears) the internal semaphore that is blocking the capture loop code execution
      *  due to a previous call to the receiver::pause() function, thus allowing the main receiver loop to begin
      *  executing again.
      */
@@ -10,23 +10,209 @@
 
 #include <semaphore.h>
 #include <vector>
+#include <atomic>
+#include <mutex>
 #include "receiver_chain.h"
+#include "packet_pool.h"
+#include "spsc_queue.h"
 #include "usrp.h"
+#include "shm_ring.h"
 
+/*! \def NUM_RX_SAMPLES
+ *  \brief Default number of samples received from the USRP and passed to the receiver_chain at a time.
+ *
+ *  See receiver_params::chunk_size.
+ */
 #define NUM_RX_SAMPLES 4096
 
+/*! \def RX_RING_SIZE
+ *  \brief Number of sample buffers (of receiver_params::chunk_size samples) in the receiver's capture ring.
+ *
+ *  This is how far (in buffers) the receiver chain can fall behind the USRP before the
+ *  capture thread has to start dropping samples.
+ */
+#define RX_RING_SIZE 16
+
+/*! \def RX_CLOCK_DRIFT
+ *  \brief Seconds per chunk that the estimate of the offset between the USRP's clock and the host's
+ *  wall clock is allowed to creep up by (see rx_ring::sync_clock()).
+ *
+ *  The estimate is the smallest offset seen, so it would otherwise never follow the clocks drifting
+ *  apart. 10 ns per 4096 sample chunk at 5 MS/s covers a drift of about 12 ppm.
+ */
+#define RX_CLOCK_DRIFT 1e-8
+
+/*! \def TURNAROUND_HISTORY
+ *  \brief Number of the most recent packets the receiver keeps the turnaround of for its percentiles.
+ */
+#define TURNAROUND_HISTORY 4096
+
 namespace fun
 {
 
+    /*!
+     * \brief The receiver_stats struct is a snapshot of the receiver's capture counters.
+     *  See receiver::get_stats().
+     */
+    struct receiver_stats
+    {
+        unsigned long long samples;         //!< Samples received from the USRP
+        unsigned long long overflows;       //!< Overflows reported by UHD (samples lost before reaching the host)
+        unsigned long long timeouts;        //!< Receive timeouts reported by UHD
+        unsigned long long late_commands;   //!< Late stream commands reported by UHD
+        unsigned long long other_errors;    //!< Any other receive errors reported by UHD
+        unsigned long long dropped_buffers; //!< Buffers dropped because the capture ring was full
+        int ring_high_water;                //!< Most buffers ever waiting in the capture ring at once
+    };
+
+    /*!
+     * \brief The turnaround_stats struct holds the percentiles of the time from each frame's last
+     *  sample being on the air to its packet being delivered. See receiver::get_turnaround_stats().
+     */
+    struct turnaround_stats
+    {
+        unsigned long long packets; //!< Number of packets measured so far (the percentiles cover the latest #TURNAROUND_HISTORY)
+        double p50;                 //!< Median turnaround in seconds
+        double p90;                 //!< 90th percentile turnaround in seconds
+        double p99;                 //!< 99th percentile turnaround in seconds
+        double max;                 //!< Longest turnaround in seconds
+    };
+
+    /*!
+     * \brief The receiver_params struct holds the configuration of the receiver's receiver_chain and threads.
+     */
+    struct receiver_params
+    {
+        receiver_chain_params chain;    //!< The receiver_chain configuration (the sample rate is taken from the usrp_params)
+        thread_params capture_thread;   //!< Scheduling configuration of the thread receiving samples from the USRP
+        thread_params process_thread;   //!< Scheduling configuration of the thread(s) feeding the receiver_chain & calling the callback
+
+        /*!
+         * \brief Number of samples received from the USRP and passed to the receiver_chain at a time.
+         *
+         * Smaller chunks lower the latency (especially with receiver_chain_params::low_latency)
+         * at the cost of more per chunk overhead.
+         */
+        int chunk_size;
+
+        /*!
+         * \brief Shared memory ring the receiver also publishes every packet to (see shm_ring).
+         *
+         * Lets other processes consume the packets at their own pace with an shm_ring_reader
+         * while the callback (which may then be a NULL function pointer) runs on the processing thread. No ring unless
+         * shm_ring_params::name is set. Only used by the receiver class.
+         */
+        shm_ring_params output_ring;
+
+        /*!
+         * \brief Constructor for receiver_params.
+         * \param chain -> #chain
+         * \param capture_thread -> #capture_thread
+         * \param process_thread -> #process_thread
+         * \param chunk_size -> #chunk_size
+         * \param output_ring -> #output_ring
+         */
+        receiver_params(receiver_chain_params chain = receiver_chain_params(),
+                        thread_params capture_thread = thread_params(),
+                        thread_params process_thread = thread_params(),
+                        int chunk_size = NUM_RX_SAMPLES,
+                        shm_ring_params output_ring = shm_ring_params()) :
+            chain(chain),
+            capture_thread(capture_thread),
+            process_thread(process_thread),
+            chunk_size(chunk_size),
+            output_ring(output_ring)
+        {
+        }
+    };
+
+    /*!
+     * \brief The rx_ring struct is the state shared by a receiver's capture & processing threads.
+     *
+     * Filled buffers are passed from the capture thread to the processing thread through
+     * #filled and handed back through #spare so that the samples are never copied.
+     */
+    struct rx_ring
+    {
+        spsc_queue<std::vector<complex_t > > filled;    //!< Buffers waiting to be processed
+        spsc_queue<std::vector<complex_t > > spare;     //!< Buffers waiting to be refilled
+        spsc_queue<double> filled_times;                //!< USRP time of the first sample of each buffer in #filled (-1 if unknown)
+        sem_t filled_count;                             //!< Number of buffers in #filled
+
+        std::atomic<unsigned long long> samples;        //!< See receiver_stats::samples
+        std::atomic<unsigned long long> overflows;      //!< See receiver_stats::overflows
+        std::atomic<unsigned long long> timeouts;       //!< See receiver_stats::timeouts
+        std::atomic<unsigned long long> late_commands;  //!< See receiver_stats::late_commands
+        std::atomic<unsigned long long> other_errors;   //!< See receiver_stats::other_errors
+        std::atomic<unsigned long long> dropped_buffers; //!< See receiver_stats::dropped_buffers
+        std::atomic<int> queued;                        //!< Number of buffers in #filled (readable from any thread)
+        std::atomic<int> ring_high_water;               //!< See receiver_stats::ring_high_water
+        std::atomic<double> clock_offset;               //!< Host wall clock time minus USRP time (see sync_clock())
+        std::atomic<bool> clock_synced;                 //!< Whether #clock_offset has been measured yet
+
+        /*!
+         * \brief Constructor for rx_ring
+         * \param size Number of sample buffers in the ring
+         * \param chunk_size Number of samples in each buffer
+         */
+        rx_ring(int size, int chunk_size);
+
+        /*!
+         * \brief Records the result of one receive by the capture thread.
+         * \param received Number of samples received
+         * \param errors The capture thread's running error counts
+         */
+        void record(int received, const rx_error_counts & errors);
+
+        /*!
+         * \brief Updates #clock_offset right after a receive. Must only be called by the capture thread.
+         * \param time USRP time of the first sample received (-1 if unknown)
+         * \param received Number of samples received
+         * \param sample_rate Sample rate in samples per second
+         */
+        void sync_clock(double time, int received, double sample_rate);
+
+        /*!
+         * \brief Queues a filled buffer for the processing thread. Must only be called by the capture thread.
+         * \param buffer The filled buffer, left empty on return.
+         * \param time USRP time of the buffer's first sample (-1 if unknown)
+         */
+        void push_filled(std::vector<complex_t > & buffer, double time);
+
+        /*!
+         * \brief Waits for & takes the next filled buffer. Must only be called by the processing thread.
+         * \param buffer Receives the filled buffer.
+         * \param time Receives the USRP time of the buffer's first sample (-1 if unknown)
+         */
+        void pop_filled(std::vector<complex_t > & buffer, double & time);
+
+        receiver_stats snapshot(); //!< Copies the counters into a receiver_stats
+
+        /*!
+         * \brief The capture thread's loop: receives the samples from the USRP into the rings forever.
+         * \param source The USRP, streaming one RX channel per ring
+         * \param rings The capture ring of each RX channel
+         * \param chunk_size Number of samples received per channel at a time
+         * \param sample_rate Sample rate of the stream in samples per second (see sync_clock())
+         * \param thread Scheduling configuration of the calling thread
+         * \param pause Held for every receive so the receive can be paused by waiting on it
+         */
+        static void capture(usrp & source, const std::vector<rx_ring *> & rings, int chunk_size, double sample_rate,
+                            const thread_params & thread, sem_t * pause);
+    };
+
     /*!
      * \brief The receiver class is the public interface for the fun_ofdm receiver.
      *  This is the easiest way to start receiving 802.11a OFDM frames out of the box.
      *
      *  Usage: To receive packets simply create a receiver object and pass it a callback
      *  function that takes a std::vector<std::vector<unsigned char> > as an input parameter.
-     *  The receiver object then automatically creates a separate thread that pulls samples
-     *  from the USRP and processes them with the receive chain. The received packets (if any)
-     *  are then passed into the callback function where the user is able to process them further.
+     *  The receiver object then automatically creates a capture thread that pulls samples from
+     *  the USRP into a ring of preallocated buffers and a processing thread that passes those
+     *  buffers through the receive chain. The received packets (if any) are then passed into the
+     *  callback function (on the processing thread) where the user is able to process them further.
+     *  Since the capture thread never waits on the receive chain or the callback a slow callback
+     *  doesn't cause the USRP to overflow until the whole ring has filled up.
      *
      *  If at any time the user wishes to pause the receiver (i.e. so that the user can transmit
      *  some packets) the user simply needs to call the receiver::pause() function on the receiver
@@ -61,6 +247,7 @@ namespace fun
          * \brief Constructor for the receiver that uses the usrp_params struct
          * \param callback Function pointer to the callback function where received packets are passed
          * \param params [Optional] The usrp parameters you want to use for this receiver.
+         * \param rx_params [Optional] The configuration of the receiver_chain and of the receiver's threads.
          *
          *  Defaults to:
          *  - center freq -> 5.72e9 (5.72 GHz)
@@ -70,7 +257,19 @@ namespace fun
          *  - device ip address -> "" (empty string will default to letting the UHD api
          *    automatically find an available USRP)
          */
-        receiver(void(*callback)(std::vector<std::vector<unsigned char> > packets), usrp_params params = usrp_params());
+        receiver(void(*callback)(std::vector<std::vector<unsigned char> > packets), usrp_params params = usrp_params(), receiver_params rx_params = receiver_params());
+
+        /*!
+         * \brief Constructor for the receiver that delivers the packets in pooled buffers along with their metadata
+         * \param callback Function pointer to the callback function where received packets are passed.
+         *  The callback must hand every packet back to the pool with packet_pool::release() once it is done
+         *  with it, which doesn't have to happen before the callback returns.
+         * \param params [Optional] The usrp parameters you want to use for this receiver.
+         * \param rx_params [Optional] The configuration of the receiver_chain and of the receiver's threads.
+         *
+         *  The payloads are never copied on their way to the callback (see receiver_chain::process_packets()).
+         */
+        receiver(void(*callback)(const std::vector<packet *> & packets, packet_pool & pool), usrp_params params = usrp_params(), receiver_params rx_params = receiver_params());
 
         /*!
          * \brief Pauses the receiver thread.
@@ -82,22 +281,94 @@ namespace fun
          */
         void resume();
 
+        /*!
+         * \brief Gets the capture counters. Can be called from any thread.
+         * \return A snapshot of the counters.
+         */
+        receiver_stats get_stats();
+
+        /*!
+         * \brief Gets the end to end latency statistics of the received packets. Can be called from any thread.
+         * \return See receiver_chain::get_latency_stats()
+         */
+        block_stats get_latency_stats();
+
+        /*!
+         * \brief Gets the counters of the receiver_chain's load watchdog. Can be called from any thread.
+         * \return See receiver_chain::get_overload_stats()
+         */
+        overload_stats get_overload_stats();
+
+        /*!
+         * \brief Gets the number of detected frames each stage of the receiver_chain dropped. Can be called from any thread.
+         * \return See receiver_chain::get_detection_stats()
+         */
+        detection_stats get_detection_stats();
+
+        /*!
+         * \brief Gets the percentiles of the time from each frame's last sample being on the air to its
+         *  packet being delivered to the callback. Can be called from any thread.
+         * \return The percentiles (all 0 before the first packet).
+         *
+         * The USRP's timestamps are converted to the host's wall clock with the smallest offset seen
+         * between the two, so the turnaround includes the time it took the samples to reach the host.
+         */
+        turnaround_stats get_turnaround_stats();
+
+        /*!
+         * \brief Gets the counters of the shared memory output ring (see receiver_params::output_ring).
+         *  Can be called from any thread.
+         * \return A snapshot of the counters (all 0 without a ring).
+         */
+        shm_ring_stats get_ring_stats();
+
     private:
 
-        void receiver_chain_loop(); //!< Infinite while loop where samples are received from USRP and processed by the receiver_chain
+        /*!
+         * \brief Constructor that the public constructors delegate to. Exactly one of the callbacks is set.
+         */
+        receiver(void(*callback)(std::vector<std::vector<unsigned char> > packets),
+                 void(*packet_callback)(const std::vector<packet *> & packets, packet_pool & pool),
+                 usrp_params params, receiver_params rx_params);
+
+        void capture_loop(); //!< Infinite while loop where samples are received from the USRP into the capture ring
+
+        void receiver_chain_loop(); //!< Infinite while loop where samples from the capture ring are processed by the receiver_chain
 
         void (*m_callback)(std::vector<std::vector<unsigned char> > packets); //!< Callback function pointer
 
+        void (*m_packet_callback)(const std::vector<packet *> & packets, packet_pool & pool); //!< Callback function pointer for pooled packets
+
+        packet_pool * m_pool; //!< The pool the packets passed to #m_packet_callback come from
+
         usrp m_usrp; //!< The usrp object used to receiver frames over the air
 
+        receiver_params m_rx_params; //!< The configuration of the receiver chain & threads
+
         receiver_chain m_rec_chain; //!< The receiver chain object used to detect & decode incoming frames
 
-        std::vector<std::complex<double> > m_samples; //!< Vector to hold the raw samples received from the USRP and passed into the receiver_chain
+        rx_ring * m_capture; //!< The capture ring & counters
+
+        shm_ring * m_output_ring; //!< The shared memory ring the packets are published to, NULL if there is none
+
+        std::thread m_capture_thread; //!< The thread that receives samples from the USRP
 
         std::thread m_rec_thread; //!< The thread that the receiver chain runs in
 
         sem_t m_pause; //!< Semaphore used to pause the receiver thread
 
+        /*!
+         * \brief Records the turnaround of each packet the receiver_chain just returned.
+         * \param info The packets' metadata (see receiver_chain::get_packet_info())
+         */
+        void record_turnarounds(const std::vector<packet_info> & info);
+
+        std::vector<double> m_turnarounds; //!< Turnaround of packet n at n % #TURNAROUND_HISTORY
+
+        unsigned long long m_turnaround_count; //!< Number of packets measured so far
+
+        std::mutex * m_turnaround_mutex; //!< Protects #m_turnarounds & #m_turnaround_count (allocated so the receiver stays movable)
+
 
 
 
@@ -8,13 +8,86 @@
  */
 
 #include <iostream>
+#include <algorithm>
 #include <functional>
-#include <boost/date_time/posix_time/posix_time.hpp>
+#include <chrono>
 
 #include "receiver_chain.h"
 
 namespace fun
 {
+    block_counters::block_counters(std::string _name) :
+        name(_name)
+    {
+        reset();
+    }
+
+    void block_counters::reset()
+    {
+        calls = 0;
+        items = 0;
+        samples = 0;
+        deadline_misses = 0;
+        total_ns = 0;
+        max_ns = 0;
+        for(int x = 0; x < LATENCY_HISTOGRAM_BUCKETS; x++) histogram[x] = 0;
+        cycles = 0;
+        instructions = 0;
+        llc_misses = 0;
+        branch_misses = 0;
+    }
+
+    /*!
+     * Only the thread running the block calls this function so each counter is updated with
+     * a relaxed load & store instead of a (much slower) atomic read-modify-write.
+     */
+    void block_counters::record(unsigned long long items_in, unsigned long long samples_in,
+                                unsigned long long elapsed_ns, double budget_ns)
+    {
+        const std::memory_order relaxed = std::memory_order_relaxed;
+        calls.store(calls.load(relaxed) + 1, relaxed);
+        items.store(items.load(relaxed) + items_in, relaxed);
+        samples.store(samples.load(relaxed) + samples_in, relaxed);
+        total_ns.store(total_ns.load(relaxed) + elapsed_ns, relaxed);
+        if(elapsed_ns > max_ns.load(relaxed)) max_ns.store(elapsed_ns, relaxed);
+        if(samples_in != 0 && elapsed_ns > budget_ns)
+        {
+            deadline_misses.store(deadline_misses.load(relaxed) + 1, relaxed);
+        }
+
+        // Bucket = number of bits in the elapsed microseconds
+        int bucket = 0;
+        for(unsigned long long us = elapsed_ns / 1000; us != 0 && bucket < LATENCY_HISTOGRAM_BUCKETS - 1; us >>= 1) bucket++;
+        histogram[bucket].store(histogram[bucket].load(relaxed) + 1, relaxed);
+    }
+
+    void block_counters::record_perf(const perf_counts & delta)
+    {
+        const std::memory_order relaxed = std::memory_order_relaxed;
+        cycles.store(cycles.load(relaxed) + delta.cycles, relaxed);
+        instructions.store(instructions.load(relaxed) + delta.instructions, relaxed);
+        llc_misses.store(llc_misses.load(relaxed) + delta.llc_misses, relaxed);
+        branch_misses.store(branch_misses.load(relaxed) + delta.branch_misses, relaxed);
+    }
+
+    block_stats block_counters::snapshot() const
+    {
+        block_stats stats;
+        stats.name = name;
+        stats.calls = calls;
+        stats.items = items;
+        stats.samples = samples;
+        stats.deadline_misses = deadline_misses;
+        stats.total_ns = total_ns;
+        stats.max_ns = max_ns;
+        for(int x = 0; x < LATENCY_HISTOGRAM_BUCKETS; x++) stats.histogram[x] = histogram[x];
+        stats.perf.cycles = cycles;
+        stats.perf.instructions = instructions;
+        stats.perf.llc_misses = llc_misses;
+        stats.perf.branch_misses = branch_misses;
+        return stats;
+    }
+
     /*!
      * -Initializes each receiver chain block:
      *  + frame_detector
@@ -24,16 +97,70 @@ namespace fun
      *  + phase_tracker
      *  + frame_decoder
      *
-     *  Adds each block to the receiver chain.
+     *  Reserves each block's buffers for receiver_chain_params::chunk_size samples and
+     *  adds each block to the receiver chain. In streaming mode the blocks are linked
+     *  together by stream_links instead of the wake & done semaphores.
      */
-    receiver_chain::receiver_chain()
+    receiver_chain::receiver_chain(receiver_chain_params params) :
+        m_params(params),
+        m_chunk_times(CHUNK_TIME_HISTORY),
+        m_chunk_anchors(CHUNK_TIME_HISTORY),
+        m_stream_samples(0),
+        m_chunk_count(0),
+        m_decoder_delay(0),
+        m_latency(new block_counters("end_to_end")),
+        m_watchdog(NULL),
+        m_window_samples(0),
+        m_window_chunks(0),
+        m_quiet_chunks(0),
+        m_chunk_samples(0),
+        m_stop(false),
+        m_gate_log(NULL),
+        m_gate_feedback(NULL),
+        m_task_group(NULL),
+        m_detector_link(NULL),
+        m_timing_link(NULL),
+        m_fft_link(NULL),
+        m_chan_link(NULL),
+        m_phase_link(NULL),
+        m_decoder_link(NULL),
+        m_payload_link(NULL),
+        m_info_link(NULL)
     {
-        m_frame_detector = new frame_detector();
-        m_timing_sync = new timing_sync();
-        m_fft_symbols = new fft_symbols();
-        m_channel_est = new channel_est();
-        m_phase_tracker = new phase_tracker();
-        m_frame_decoder = new frame_decoder();
+        if(m_params.overload.enabled) m_watchdog = new load_watchdog(m_params.overload, m_params.sample_rate);
+
+        if(m_params.gated)
+        {
+            m_gate_log = new spsc_queue<gate_window>(GATE_LOG_SIZE);
+            m_gate_feedback = new gate_feedback();
+        }
+        m_frame_detector = new frame_detector(m_gate_log, m_gate_feedback);
+        m_timing_sync = new timing_sync(m_gate_feedback);
+        int max_symbols = m_params.header_only && m_params.gate_data_symbols ? 3 /* LTS, LTS & SIGNAL */ : 0;
+        m_fft_symbols = m_params.fused ? NULL : new fft_symbols(m_gate_log, m_params.fft_impl, max_symbols);
+        m_channel_est = m_params.fused ? NULL : new channel_est(m_params.smooth_channel);
+        m_phase_tracker = m_params.fused ? NULL : new phase_tracker();
+        m_freq_domain = m_params.fused ? new freq_domain(m_gate_log, m_params.smooth_channel, m_params.fft_impl, max_symbols) : NULL;
+        m_frame_decoder = new frame_decoder(m_params.decode_threads, m_params.viterbi_threads, m_params.incremental_decode,
+                                            m_params.header_only, m_gate_feedback);
+        m_frame_detector->set_min_plateau(m_params.false_alarm.min_plateau);
+        m_timing_sync->set_min_lts_ratio(m_params.false_alarm.min_lts_ratio);
+        m_frame_decoder->set_max_header_evm(m_params.false_alarm.max_header_evm);
+        m_frame_decoder->set_keep_failed(m_params.keep_failed);
+
+        // Size every block's buffers for the chunk size
+        std::vector<fun::block_base *> blocks;
+        blocks.push_back(m_frame_detector);
+        blocks.push_back(m_timing_sync);
+        if(m_params.fused) blocks.push_back(m_freq_domain);
+        else
+        {
+            blocks.push_back(m_fft_symbols);
+            blocks.push_back(m_channel_est);
+            blocks.push_back(m_phase_tracker);
+        }
+        blocks.push_back(m_frame_decoder);
+        for(int x = 0; x < blocks.size(); x++) blocks[x]->reserve_buffers(m_params.chunk_size);
 
         // We use semaphore references, so we don't
         // want them to move to a different memory location
@@ -41,27 +168,141 @@ namespace fun
         m_wake_sems.reserve(100);
         m_done_sems.reserve(100);
 
+        if(m_params.streaming)
+        {
+            // Link the blocks together
+            int depth = m_params.queue_depth;
+            m_detector_link = new stream_link<complex_t >(depth);
+            m_timing_link = new stream_link<complex_t >(depth);
+            m_fft_link = new stream_link<complex_t >(depth);
+            m_chan_link = new stream_link<tagged_vector<64> >(depth);
+            m_phase_link = new stream_link<tagged_vector<64> >(depth);
+            m_decoder_link = new stream_link<tagged_vector<48> >(depth);
+            m_payload_link = new stream_link<std::vector<unsigned char> >(depth);
+            m_info_link = new stream_link<packet_info>(depth);
+
+            // Add the blocks to the receiver chain
+            add_stream_block(m_frame_detector, m_detector_link, m_timing_link);
+            add_stream_block(m_timing_sync, m_timing_link, m_fft_link);
+            if(m_params.fused)
+            {
+                add_stream_block(m_freq_domain, m_fft_link, m_decoder_link);
+            }
+            else
+            {
+                add_stream_block(m_fft_symbols, m_fft_link, m_chan_link);
+                add_stream_block(m_channel_est, m_chan_link, m_phase_link);
+                add_stream_block(m_phase_tracker, m_phase_link, m_decoder_link);
+            }
+            add_stream_block(m_frame_decoder, m_decoder_link, m_payload_link);
+            return;
+        }
+
+        if(m_params.low_latency)
+        {
+            // The blocks run on the calling thread so they only need counters
+            add_counters(m_frame_detector);
+            add_counters(m_timing_sync);
+            if(m_params.fused)
+            {
+                add_counters(m_freq_domain);
+            }
+            else
+            {
+                add_counters(m_fft_symbols);
+                add_counters(m_channel_est);
+                add_counters(m_phase_tracker);
+            }
+            add_counters(m_frame_decoder);
+            return;
+        }
+
         // Add the blocks to the receiver chain
         add_block(m_frame_detector);
         add_block(m_timing_sync);
-        add_block(m_fft_symbols);
-        add_block(m_channel_est);
-        add_block(m_phase_tracker);
+        if(m_params.fused)
+        {
+            add_block(m_freq_domain);
+        }
+        else
+        {
+            add_block(m_fft_symbols);
+            add_block(m_channel_est);
+            add_block(m_phase_tracker);
+        }
         add_block(m_frame_decoder);
+
+        // The frame_decoder works on the chunk passed in 5 (or if fused 3) calls earlier
+        m_decoder_delay = m_counters.size() - 1;
+    }
+
+    /*!
+     * The block threads are told to stop and woken up: in lockstep mode each one is waiting on
+     * its wake semaphore, in streaming mode each one notices the flag the next time a link is
+     * empty or full. The frame_decoder stops its own decode & viterbi workers when it is deleted.
+     * Anything still queued between the blocks is dropped.
+     */
+    receiver_chain::~receiver_chain()
+    {
+        m_stop.store(true, std::memory_order_release);
+        for(int x = 0; x < m_wake_sems.size(); x++) sem_post(&m_wake_sems[x]);
+        for(int x = 0; x < m_threads.size(); x++) m_threads[x].join();
+        for(int x = 0; x < m_wake_sems.size(); x++)
+        {
+            sem_destroy(&m_wake_sems[x]);
+            sem_destroy(&m_done_sems[x]);
+        }
+
+        delete m_frame_detector;
+        delete m_timing_sync;
+        delete m_fft_symbols;
+        delete m_channel_est;
+        delete m_phase_tracker;
+        delete m_freq_domain;
+        delete m_frame_decoder;
+        delete m_gate_log;
+        delete m_gate_feedback;
+
+        delete m_detector_link;
+        delete m_timing_link;
+        delete m_fft_link;
+        delete m_chan_link;
+        delete m_phase_link;
+        delete m_decoder_link;
+        delete m_payload_link;
+        delete m_info_link;
+
+        for(int x = 0; x < m_counters.size(); x++) delete m_counters[x];
+        delete m_latency;
+        delete m_watchdog;
+        delete m_task_group;
     }
 
     /*!
      * The #add_block function creates a wake & done semaphore for each block.
      * It then creates a new thread for the block to run in and adds that thread
      * to the thread vector for reference.
+     *
+     * With a receiver_chain_params::scheduler the block only gets a task instead.
      */
     void receiver_chain::add_block(fun::block_base * block)
     {
+        if(m_params.scheduler != NULL)
+        {
+            if(m_task_group == NULL) m_task_group = new task_group();
+            m_blocks.push_back(block);
+            m_tasks.push_back(scheduler_task());
+            m_tasks.back().function = &receiver_chain::scheduled_work;
+            m_tasks.back().index = m_blocks.size() - 1;
+            add_counters(block);
+            return;
+        }
         m_wake_sems.push_back(sem_t());
         m_done_sems.push_back(sem_t());
         int index = m_wake_sems.size() - 1;
         sem_init(&m_wake_sems[index], 0, 0);
         sem_init(&m_done_sems[index], 0, 0);
+        add_counters(block);
         m_threads.push_back(std::thread(&receiver_chain::run_block, this, index, block));
     }
 
@@ -73,25 +314,371 @@ namespace fun
      * function. Then once, the work() function returns run_block posts to the done sempahore
      * that the block has finished processing everything in the input_buffer. At this point
      * it loops back around and waits for the block to be "woken up" again when the next set
-     * of input data is ready.
+     * of input data is ready. A wake up with #m_stop set ends the thread instead.
+     *
+     * Each call to work() is timed and recorded in the block's counters, along with the
+     * hardware counters in the profiling build.
      */
     void receiver_chain::run_block(int index, fun::block_base * block)
     {
+        configure_block_thread(index, block);
         while(1)
         {
             sem_wait(&m_wake_sems[index]);
+            if(m_stop.load(std::memory_order_acquire)) return;
+            timed_work(index, block);
+            sem_post(&m_done_sems[index]);
+        }
+    }
+
+    void receiver_chain::scheduled_work(void * chain, int index)
+    {
+        receiver_chain * self = static_cast<receiver_chain *>(chain);
+        self->timed_work(index, self->m_blocks[index]);
+    }
+
+    void receiver_chain::timed_work(int index, fun::block_base * block)
+    {
+        unsigned long long items = block->input_size();
+        unsigned long long samples = m_chunk_samples.load(std::memory_order_relaxed);
+        perf_counts perf_start, perf_end;
+        bool counting = perf_counters::read(perf_start);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        block->work();
+        std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+        m_counters[index]->record(items, samples, elapsed.count(), samples * 1e9 / m_params.sample_rate);
+        if(counting && perf_counters::read(perf_end)) m_counters[index]->record_perf(perf_end - perf_start);
+    }
+
+    /*!
+     * The buffers are shifted exactly as in lockstep mode except that each block's output is
+     * handed to the next block right after it was produced instead of on the next call.
+     */
+    void receiver_chain::run_inline(std::vector<complex_t > & samples)
+    {
+        m_frame_detector->input_buffer.swap(samples);
+        timed_work(0, m_frame_detector);
+        note_detections();
+        shift(m_frame_detector, m_timing_sync);
+        timed_work(1, m_timing_sync);
+        shift_frequency_domain(true);
+        timed_work(m_counters.size() - 1, m_frame_decoder);
+    }
+
+    void receiver_chain::shift_frequency_domain(bool inline_work)
+    {
+        if(m_params.fused)
+        {
+            shift(m_timing_sync, m_freq_domain);
+            if(inline_work) timed_work(2, m_freq_domain);
+            shift(m_freq_domain, m_frame_decoder);
+            return;
+        }
+        shift(m_timing_sync, m_fft_symbols);
+        if(inline_work) timed_work(2, m_fft_symbols);
+        shift(m_fft_symbols, m_channel_est);
+        if(inline_work) timed_work(3, m_channel_est);
+        shift(m_channel_est, m_phase_tracker);
+        if(inline_work) timed_work(4, m_phase_tracker);
+        shift(m_phase_tracker, m_frame_decoder);
+    }
+
+    /*!
+     * A chunk without a time of its own carries on from the previous chunk's time at the sample rate.
+     */
+    void receiver_chain::stamp_chunk(unsigned long long count, double time)
+    {
+        m_chunk_times[m_chunk_count % CHUNK_TIME_HISTORY] = std::chrono::steady_clock::now();
+        chunk_anchor & anchor = m_chunk_anchors[m_chunk_count % CHUNK_TIME_HISTORY];
+        anchor.first_sample = m_stream_samples;
+        if(time >= 0) anchor.time = time;
+        else if(m_chunk_count == 0) anchor.time = 0;
+        else
+        {
+            const chunk_anchor & previous = m_chunk_anchors[(m_chunk_count - 1) % CHUNK_TIME_HISTORY];
+            anchor.time = previous.time + (m_stream_samples - previous.first_sample) / m_params.sample_rate;
+        }
+        m_stream_samples += count;
+        m_chunk_count++;
+    }
+
+    /*!
+     * The frame started in the newest chunk whose first sample isn't past packet_info::sample_index.
+     * Frames only ever start a few chunks back so the search from the newest chunk is short. The
+     * frame lasts for the preamble, the SIGNAL symbol and the data symbols holding the service
+     * field, the payload, the CRC and the tail bits.
+     */
+    void receiver_chain::place_on_air(packet_info & info)
+    {
+        info.air_start = -1;
+        info.air_end = -1;
+        for(unsigned long long back = 1; back <= m_chunk_count && back <= CHUNK_TIME_HISTORY; back++)
+        {
+            const chunk_anchor & anchor = m_chunk_anchors[(m_chunk_count - back) % CHUNK_TIME_HISTORY];
+            if(anchor.first_sample > info.sample_index) continue;
+
+            int symbols = (16 + 8 * (info.length + 4) + 6 + RateParams(info.rate).dbps - 1) / RateParams(info.rate).dbps;
+            info.air_start = anchor.time + (info.sample_index - anchor.first_sample) / m_params.sample_rate;
+            info.air_end = info.air_start + (320 + 80 + 80 * symbols - 1) / m_params.sample_rate;
+            return;
+        }
+    }
+
+    /*!
+     * The frame_decoder's n-th call to work() consumes data from chunk n - #m_decoder_delay
+     * since every block produces exactly one output buffer per input buffer.
+     */
+    void receiver_chain::measure_latencies(packet_info * info, int count)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double delivered = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        for(int x = 0; x < count; x++)
+        {
+            place_on_air(info[x]);
+            info[x].delivered = delivered;
+
+            double latency = -1;
+            if(info[x].sequence >= m_decoder_delay)
+            {
+                unsigned long long chunk = info[x].sequence - m_decoder_delay;
+                if(chunk < m_chunk_count && m_chunk_count - chunk <= CHUNK_TIME_HISTORY)
+                {
+                    std::chrono::nanoseconds elapsed = now - m_chunk_times[chunk % CHUNK_TIME_HISTORY];
+                    latency = elapsed.count() / 1e9;
+                    m_latency->record(1, 0, elapsed.count(), 0);
+                }
+            }
+            info[x].latency = latency;
+            m_packet_latencies.push_back(latency);
+        }
+    }
+
+    void receiver_chain::configure_block_thread(int index, fun::block_base * block)
+    {
+        thread_params params;
+        if(index < m_params.block_threads.size()) params = m_params.block_threads[index];
+        configure_thread(block->name, params);
+    }
+
+    /*!
+     * The counters are created before the block's thread is started and are never moved so
+     * the thread can hold on to a pointer to them.
+     */
+    block_counters * receiver_chain::add_counters(fun::block_base * block)
+    {
+        m_counters.push_back(new block_counters(block->name));
+        return m_counters.back();
+    }
+
+    std::vector<block_stats> receiver_chain::get_block_stats()
+    {
+        std::vector<block_stats> stats;
+        for(int x = 0; x < m_counters.size(); x++) stats.push_back(m_counters[x]->snapshot());
+        return stats;
+    }
 
-            boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+    /*!
+     * The counters are reset from the calling thread while the blocks may still be running,
+     * so a call to work() that is in progress may still be recorded afterwards.
+     */
+    void receiver_chain::reset_block_stats()
+    {
+        for(int x = 0; x < m_counters.size(); x++) m_counters[x]->reset();
+        m_latency->reset();
+    }
+
+    std::vector<double> receiver_chain::get_packet_latencies()
+    {
+        return m_packet_latencies;
+    }
+
+    block_stats receiver_chain::get_latency_stats()
+    {
+        return m_latency->snapshot();
+    }
+
+    overload_stats receiver_chain::get_overload_stats()
+    {
+        if(m_watchdog == NULL) return overload_stats();
+        return m_watchdog->get_stats(m_frame_decoder->skipped_frames());
+    }
+
+    detection_stats receiver_chain::get_detection_stats()
+    {
+        detection_stats stats;
+        stats.plateau_rejected = m_frame_detector->rejected();
+        stats.lts_rejected = m_timing_sync->rejected();
+        stats.header_rejected = m_frame_decoder->rejected_headers();
+        stats.header_failed = m_frame_decoder->failed_headers();
+        return stats;
+    }
+
+    std::vector<overload_event> receiver_chain::get_overload_events()
+    {
+        if(m_watchdog == NULL) return std::vector<overload_event>();
+        return m_watchdog->get_events();
+    }
+
+    /*!
+     * The time spent in each block over the window comes from the blocks' counters. With a thread
+     * per block (or a scheduler) the blocks run side by side so the chain keeps up as long as its
+     * busiest block does, in low latency mode they run one after the other so their times add up.
+     * A reset_block_stats() partway through a window just shortens that window's busy time.
+     */
+    void receiver_chain::watch_load(unsigned long long samples)
+    {
+        if(m_watchdog == NULL) return;
+        m_window_samples += samples;
+        if(++m_window_chunks < m_params.overload.window) return;
+
+        bool serial = m_params.low_latency && !m_params.streaming;
+        m_busy_ns.resize(m_counters.size(), 0);
+        unsigned long long busy = 0;
+        for(int x = 0; x < m_counters.size(); x++)
+        {
+            unsigned long long total = m_counters[x]->total_ns.load(std::memory_order_relaxed);
+            unsigned long long delta = (total >= m_busy_ns[x]) ? total - m_busy_ns[x] : total;
+            m_busy_ns[x] = total;
+            busy = serial ? busy + delta : std::max(busy, delta);
+        }
+
+        if(m_watchdog->update(busy, m_window_samples, m_chunk_count)) apply_overload_policy(m_watchdog->degraded());
+        m_window_samples = 0;
+        m_window_chunks = 0;
+    }
+
+    void receiver_chain::apply_overload_policy(bool degraded)
+    {
+        unsigned int policy = m_params.overload.policy;
+        if(policy & SHED_RATES) m_frame_decoder->set_decode_rates(degraded ? m_params.overload.decode_rates : ~0u);
+        if(policy & SHED_LTS_SEARCH) m_timing_sync->set_peak_count(degraded ? m_params.overload.lts_peaks : LTS_PEAK_COUNT);
+    }
+
+    /*!
+     * A frame's #STS_START can be carried over into the chunk after the one it arrived in, so the
+     * frame_detector has to stay quiet for one chunk longer than the frame_decoder lags behind it.
+     */
+    bool receiver_chain::drop_chunk()
+    {
+        if(m_watchdog == NULL || !(m_params.overload.policy & SHED_CHUNKS) || !m_watchdog->degraded()) return false;
+        return m_quiet_chunks > m_decoder_delay + 1 && m_frame_decoder->idle();
+    }
+
+    void receiver_chain::note_detections()
+    {
+        if(m_frame_detector->output_tags.empty()) m_quiet_chunks++;
+        else m_quiet_chunks = 0;
+    }
+
+    /*!
+     * Backs off after a failed push or pop on a stream_link. The caller first spins
+     * for a few tries, then yields its time slice, and finally sleeps briefly so an
+     * idle chain doesn't burn a whole core per block.
+     */
+    static void stream_backoff(int & idle_count)
+    {
+        idle_count++;
+        if(idle_count < 64) return;
+        if(idle_count < 128) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    /*!
+     * The #add_stream_block function creates a new thread for the block to run in
+     * and adds that thread to the thread vector for reference.
+     */
+    template<typename I, typename O>
+    void receiver_chain::add_stream_block(fun::block<I, O> * block, stream_link<I> * in, stream_link<O> * out)
+    {
+        add_counters(block);
+        int index = m_counters.size() - 1;
+        m_threads.push_back(std::thread(&receiver_chain::stream_block<I, O>, this, block, in, out, index));
+    }
+
+    /*!
+     * The #stream_block function is the main thread for a block in streaming mode. It is a
+     * forever loop that pops the next input buffer from the upstream link as soon as one is
+     * available, runs the block's work() function on it and pushes the output buffer to
+     * the downstream link. The consumed input buffer is handed back to the upstream block and
+     * a spare buffer from the downstream block (if any) becomes the new output buffer, so that
+     * in steady state no buffers are allocated.
+     *
+     * Only the call to work() is timed, time spent waiting on the links isn't counted. The size
+     * of the chunk each input buffer came from is passed on with the output so the block's
+     * deadline is worked out from its own chunk rather than the one most recently queued.
+     * The thread exits once #m_stop is set, checked whenever it has to wait on a link.
+     */
+    template<typename I, typename O>
+    void receiver_chain::stream_block(fun::block<I, O> * block, stream_link<I> * in, stream_link<O> * out, int index)
+    {
+        configure_block_thread(index, block);
+        block_counters * counters = m_counters[index];
+        std::vector<I> buffer;
+        std::vector<stream_tag> tags;
+        unsigned long long samples = 0;
+        int idle_count = 0;
+        while(1)
+        {
+            if(!in->pop(buffer, tags, samples))
+            {
+                if(m_stop.load(std::memory_order_acquire)) return;
+                stream_backoff(idle_count);
+                continue;
+            }
+            idle_count = 0;
+
+            // Take the new input and hand the old one back upstream
+            block->input_buffer.swap(buffer);
+            block->input_tags.swap(tags);
+            buffer.clear();
+            tags.clear();
+            in->spares.push(buffer);
+            in->tag_spares.push(tags);
+
+            // Some blocks leave the output untouched when they have no input
+            clear_output(block);
+            unsigned long long items = block->input_buffer.size();
+            perf_counts perf_start, perf_end;
+            bool counting = perf_counters::read(perf_start);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
             block->work();
-            boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::local_time() - start;
+            std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+            counters->record(items, samples, elapsed.count(), samples * 1e9 / m_params.sample_rate);
+            if(counting && perf_counters::read(perf_end)) counters->record_perf(perf_end - perf_start);
 
-            if(elapsed.total_microseconds() > (2000 / 5e6 * 1e6))
+            // Pass the output downstream and pick up a spare to write into next time
+            forward_extras(block);
+            while(!out->push(block->output_buffer, block->output_tags, samples))
             {
-                //std::cout << "! - " <<  block->name << std::endl;
+                if(m_stop.load(std::memory_order_acquire)) return;
+                stream_backoff(idle_count);
             }
+            idle_count = 0;
+            if(!out->spares.pop(block->output_buffer)) block->output_buffer.clear();
+            if(!out->tag_spares.pop(block->output_tags)) block->output_tags.clear();
+        }
+    }
 
-            sem_post(&m_done_sems[index]);
+    void receiver_chain::clear_output(fun::block<tagged_vector<48>, std::vector<unsigned char> > * block)
+    {
+        m_frame_decoder->output_buffer.clear();
+        m_frame_decoder->output_tags.clear();
+        m_frame_decoder->output_info.clear();
+    }
+
+    /*!
+     * The metadata is queued before the payloads it belongs to so that it is always
+     * available by the time process_samples() pops the payloads.
+     */
+    void receiver_chain::forward_extras(fun::block<tagged_vector<48>, std::vector<unsigned char> > * block)
+    {
+        int idle_count = 0;
+        while(!m_info_link->data.push(m_frame_decoder->output_info))
+        {
+            if(m_stop.load(std::memory_order_acquire)) return;
+            stream_backoff(idle_count);
         }
+        if(!m_info_link->spares.pop(m_frame_decoder->output_info)) m_frame_decoder->output_info.clear();
     }
 
     /*!
@@ -103,26 +690,143 @@ namespace fun
      * buffer of the next block in the chain and returns the contents of the Frame Decoder's
      * output buffer.
      */
-    std::vector<std::vector<unsigned char> > receiver_chain::process_samples(std::vector<std::complex<double> > samples)
+    std::vector<std::vector<unsigned char> > receiver_chain::process_samples(std::vector<complex_t > samples)
     {
-        // samples -> sync short in
-        m_frame_detector->input_buffer.swap(samples);
+        return process_buffer(samples);
+    }
 
-        // Unlock the threads
-        for(int x = 0; x < m_wake_sems.size(); x++) sem_post(&m_wake_sems[x]);
+    /*!
+     * The payloads are swapped out of the chain so they are never copied.
+     */
+    std::vector<std::vector<unsigned char> > receiver_chain::process_buffer(std::vector<complex_t > & samples, double time)
+    {
+        run_chunk(samples, time);
+        std::vector<std::vector<unsigned char> > packets;
+        packets.swap(m_payloads);
+        return packets;
+    }
+
+    /*!
+     * Each payload is swapped into its packet so it is never copied. The packets' old payload
+     * buffers are left in #m_payloads for the next run_chunk() to hand back to the Frame Decoder.
+     */
+    void receiver_chain::process_packets(std::vector<complex_t > & samples, packet_pool & pool, std::vector<packet *> & packets, double time)
+    {
+        run_chunk(samples, time);
+        for(int x = 0; x < m_payloads.size(); x++)
+        {
+            packet * p = pool.acquire();
+            p->payload.swap(m_payloads[x]);
+            p->info = m_payload_info[x];
+            packets.push_back(p);
+        }
+    }
+
+    /*!
+     * In lockstep mode the spent buffer is the Frame Detector's previous input buffer, in
+     * streaming mode it is a spare buffer handed back by the Frame Detector (if there is one).
+     *
+     * The Frame Decoder's output is swapped into #m_payloads & #m_payload_info (leaving it
+     * empty) so that a payload is only ever returned once. Whatever buffers are left in
+     * #m_payloads from the previous chunk are handed back to the Frame Decoder to decode
+     * later payloads into, except in streaming mode where its block thread never stops.
+     *
+     * While the load watchdog has the chain degraded with #SHED_CHUNKS the samples may be dropped
+     * instead, in which case they are left in place and no payloads are returned.
+     */
+    void receiver_chain::run_chunk(std::vector<complex_t > & samples, double time)
+    {
+        unsigned long long chunk_samples = samples.size();
+        m_packet_latencies.clear();
+        m_payload_info.clear();
+        if(m_params.streaming)
+        {
+            m_payloads.clear();
+            stream_samples(samples, time);
+            watch_load(chunk_samples);
+            return;
+        }
+        m_frame_decoder->recycle_payloads(m_payloads);
+
+        // A dropped chunk never reaches the blocks so it doesn't count as a chunk for the packet latencies
+        if(drop_chunk())
+        {
+            m_watchdog->chunk_dropped();
+            watch_load(chunk_samples);
+            return;
+        }
 
-        // Wait for the threads to finish
-        for(int x = 0; x < m_done_sems.size(); x++) sem_wait(&m_done_sems[x]);
+        stamp_chunk(samples.size(), time);
+        m_chunk_samples.store(samples.size(), std::memory_order_relaxed);
 
-        // Update the buffers
-        m_timing_sync->input_buffer.swap(m_frame_detector->output_buffer);
-        m_fft_symbols->input_buffer.swap(m_timing_sync->output_buffer);
-        m_channel_est->input_buffer.swap(m_fft_symbols->output_buffer);
-        m_phase_tracker->input_buffer.swap(m_channel_est->output_buffer);
-        m_frame_decoder->input_buffer.swap(m_phase_tracker->output_buffer);
+        if(m_params.low_latency)
+        {
+            run_inline(samples);
+        }
+        else
+        {
+            // samples -> sync short in
+            m_frame_detector->input_buffer.swap(samples);
+
+            if(m_params.scheduler != NULL)
+            {
+                // Every block's input is ready so they all run at once
+                for(int x = 0; x < m_tasks.size(); x++) m_tasks[x].context = this;
+                m_params.scheduler->run(m_tasks.data(), m_tasks.size(), *m_task_group);
+            }
+            else
+            {
+                // Unlock the threads
+                for(int x = 0; x < m_wake_sems.size(); x++) sem_post(&m_wake_sems[x]);
 
-        // Return any completed packets
-        return m_frame_decoder->output_buffer;
+                // Wait for the threads to finish
+                for(int x = 0; x < m_done_sems.size(); x++) sem_wait(&m_done_sems[x]);
+            }
+
+            // Update the buffers
+            note_detections();
+            shift(m_frame_detector, m_timing_sync);
+            shift_frequency_domain(false);
+        }
+
+        // Take any completed packets
+        m_payloads.swap(m_frame_decoder->output_buffer);
+        m_payload_info.swap(m_frame_decoder->output_info);
+        measure_latencies(m_payload_info.data(), m_payload_info.size());
+        watch_load(chunk_samples);
+    }
+
+    /*!
+     * In streaming mode the samples are simply queued for the Frame Detector block.
+     * If the queue is full this function blocks until the Frame Detector catches up.
+     * It then collects every payload that the Frame Decoder block has finished since the
+     * last call without waiting for the samples that were just queued to be processed.
+     */
+    void receiver_chain::stream_samples(std::vector<complex_t > & samples, double time)
+    {
+        // samples -> sync short in
+        stamp_chunk(samples.size(), time);
+        std::vector<stream_tag> tags; // The raw samples have no tags
+        unsigned long long chunk_samples = samples.size();
+        int idle_count = 0;
+        while(!m_detector_link->push(samples, tags, chunk_samples)) stream_backoff(idle_count);
+        if(!m_detector_link->spares.pop(samples)) samples.clear();
+
+        // Take any completed packets
+        std::vector<std::vector<unsigned char> > decoded;
+        std::vector<packet_info> info;
+        while(m_payload_link->pop(decoded, tags, chunk_samples))
+        {
+            for(int x = 0; x < decoded.size(); x++) m_payloads.push_back(std::move(decoded[x]));
+            decoded.clear();
+            m_payload_link->spares.push(decoded);
+
+            m_info_link->data.pop(info);
+            m_payload_info.insert(m_payload_info.end(), info.begin(), info.end());
+            info.clear();
+            m_info_link->spares.push(info);
+        }
+        measure_latencies(m_payload_info.data(), m_payload_info.size());
     }
 
 }
@@ -11,6 +11,9 @@
 #define RECEIVER_CHAIN_H
 
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
 #include <semaphore.h>
 
 #include "fft_symbols.h"
@@ -21,9 +24,399 @@
 #include "tagged_vector.h"
 #include "frame_detector.h"
 #include "timing_sync.h"
+#include "freq_domain.h"
+#include "spsc_queue.h"
+#include "thread_config.h"
+#include "packet_pool.h"
+#include "block_scheduler.h"
+#include "load_watchdog.h"
+#include "perf_counters.h"
+
+/*! \def LATENCY_HISTOGRAM_BUCKETS
+ *  \brief Number of buckets in each block's work() latency histogram.
+ *
+ *  Bucket 0 counts calls that took less than 1 microsecond and bucket i counts calls that
+ *  took [2^(i-1), 2^i) microseconds. The last bucket also counts anything slower.
+ */
+#define LATENCY_HISTOGRAM_BUCKETS 24
+
+/*! \def CHUNK_TIME_HISTORY
+ *  \brief Number of recent chunk arrival times the receiver_chain keeps to measure packet latency.
+ *
+ *  Packets completed by a chunk older than this (i.e. stuck behind a very deep decode queue)
+ *  are returned without a latency measurement.
+ */
+#define CHUNK_TIME_HISTORY 1024
 
 namespace fun
 {
+    /*!
+     * \brief The block_stats struct is a snapshot of the timing statistics of one block in
+     *  the receiver_chain. See receiver_chain::get_block_stats().
+     */
+    struct block_stats
+    {
+        std::string name;                       //!< The block's name
+        unsigned long long calls;               //!< Number of calls to the block's work() function
+        unsigned long long items;               //!< Number of input items (samples or symbols) consumed
+        unsigned long long samples;             //!< Number of raw baseband samples those items came from
+        unsigned long long deadline_misses;     //!< Number of calls that took longer than their samples last in real time
+        unsigned long long total_ns;            //!< Total time spent in work() in nanoseconds
+        unsigned long long max_ns;              //!< Longest single call to work() in nanoseconds
+        unsigned long long histogram[LATENCY_HISTOGRAM_BUCKETS]; //!< work() latency histogram (see #LATENCY_HISTOGRAM_BUCKETS)
+        perf_counts perf;                       //!< Hardware counters over the calls to work(), all 0 outside of the profiling build (see perf_counters)
+
+        double cycles_per_sample() const { return samples ? double(perf.cycles) / samples : 0; } //!< CPU cycles per raw baseband sample
+    };
+
+    /*!
+     * \brief The block_counters struct holds the live counters behind a block_stats snapshot.
+     *
+     * Each block's counters are only written by the thread running that block so relaxed
+     * atomic updates are enough, they only need to be atomic so they can be read at any time.
+     */
+    struct block_counters
+    {
+        std::string name;                                   //!< The block's name
+        std::atomic<unsigned long long> calls;              //!< See block_stats::calls
+        std::atomic<unsigned long long> items;              //!< See block_stats::items
+        std::atomic<unsigned long long> samples;            //!< See block_stats::samples
+        std::atomic<unsigned long long> deadline_misses;    //!< See block_stats::deadline_misses
+        std::atomic<unsigned long long> total_ns;           //!< See block_stats::total_ns
+        std::atomic<unsigned long long> max_ns;             //!< See block_stats::max_ns
+        std::atomic<unsigned long long> histogram[LATENCY_HISTOGRAM_BUCKETS]; //!< See block_stats::histogram
+        std::atomic<unsigned long long> cycles;             //!< See perf_counts::cycles
+        std::atomic<unsigned long long> instructions;       //!< See perf_counts::instructions
+        std::atomic<unsigned long long> llc_misses;         //!< See perf_counts::llc_misses
+        std::atomic<unsigned long long> branch_misses;      //!< See perf_counts::branch_misses
+
+        /*!
+         * \brief Constructor for block_counters
+         * \param _name the block's name
+         */
+        block_counters(std::string _name);
+
+        void reset(); //!< Zeros all of the counters
+
+        /*!
+         * \brief Records one call to the block's work() function.
+         * \param items_in Number of input items consumed
+         * \param samples_in Number of raw samples those items came from
+         * \param elapsed_ns Time spent in work()
+         * \param budget_ns The real time budget for those samples
+         */
+        void record(unsigned long long items_in, unsigned long long samples_in,
+                    unsigned long long elapsed_ns, double budget_ns);
+
+        /*!
+         * \brief Records the hardware counters of one call to the block's work() function.
+         * \param delta The counts of the call
+         */
+        void record_perf(const perf_counts & delta);
+
+        block_stats snapshot() const; //!< Copies the counters into a block_stats
+    };
+
+    /*!
+     * \brief The chunk_anchor struct ties a chunk of samples to the time its first sample was on the air.
+     */
+    struct chunk_anchor
+    {
+        unsigned long long first_sample;    //!< Index of the chunk's first sample in the stream of samples passed to the blocks
+        double time;                        //!< Time of that sample in seconds (see packet_info::air_start)
+    };
+
+    /*!
+     * \brief The false_alarm_params struct holds the thresholds a detected frame has to pass at each stage of
+     *  the receiver_chain (see detection_quality). A frame that misses one is dropped by that stage, so
+     *  noise triggering the STS detection costs as little of the later stages as possible.
+     *
+     * Every threshold is off (0) by default.
+     */
+    struct false_alarm_params
+    {
+        float min_plateau;      //!< Lowest mean STS plateau correlation passed on to the LTS search (see frame_detector::set_min_plateau())
+        float min_lts_ratio;    //!< Lowest LTS peak to mean correlation ratio made into symbols (see timing_sync::set_min_lts_ratio())
+        float max_header_evm;   //!< Highest SIGNAL symbol EVM whose header is decoded (see frame_decoder::set_max_header_evm())
+
+        /*!
+         * \brief Constructor for false_alarm_params.
+         * \param min_plateau -> #min_plateau
+         * \param min_lts_ratio -> #min_lts_ratio
+         * \param max_header_evm -> #max_header_evm
+         */
+        false_alarm_params(float min_plateau = 0, float min_lts_ratio = 0, float max_header_evm = 0) :
+            min_plateau(min_plateau),
+            min_lts_ratio(min_lts_ratio),
+            max_header_evm(max_header_evm)
+        {
+        }
+    };
+
+    /*!
+     * \brief The detection_stats struct counts the detected frames each stage dropped. See receiver_chain::get_detection_stats().
+     */
+    struct detection_stats
+    {
+        unsigned long long plateau_rejected;    //!< STS plateaus below false_alarm_params::min_plateau
+        unsigned long long lts_rejected;        //!< Paired LTS peaks below false_alarm_params::min_lts_ratio
+        unsigned long long header_rejected;     //!< SIGNAL symbols above false_alarm_params::max_header_evm
+        unsigned long long header_failed;       //!< Headers that went through the viterbi decoder but failed their parity or rate check
+    };
+
+    /*!
+     * \brief The receiver_chain_params struct which holds the configuration of the
+     *  receiver_chain such as how the blocks are scheduled.
+     */
+    struct receiver_chain_params
+    {
+        /*!
+         * \brief Scheduling mode of the blocks.
+         *
+         * - false: Lockstep mode. Every call to receiver_chain::process_samples() wakes every
+         *   block, waits for all of them to finish and then shifts the buffers down the chain.
+         * - true: Streaming mode. The blocks are linked by bounded lock-free queues and each
+         *   block runs as soon as its input is ready. receiver_chain::process_samples() only
+         *   queues the samples and returns whatever payloads have been decoded so far.
+         */
+        bool streaming;
+
+        int queue_depth; //!< Number of buffers each queue between two blocks can hold in streaming mode
+
+        /*!
+         * \brief Number of worker threads the frame_decoder hands completed frames to.
+         *
+         * With 0 the payloads are decoded inline on the frame_decoder's thread. Otherwise
+         * the payloads are still returned in the order they were received but may be
+         * returned by a later call to receiver_chain::process_samples().
+         */
+        int decode_threads;
+
+        /*!
+         * \brief Number of worker threads the frame_decoder's viterbi decoder splits each long
+         *  payload across (see viterbi::viterbi()).
+         *
+         * Unlike #decode_threads this lowers the latency of each frame since a frame is still
+         * decoded as soon as it is received, just on several cores.
+         */
+        int viterbi_threads;
+
+        /*!
+         * \brief Sample rate of the incoming samples in samples per second.
+         *
+         * Sets the real time budget each block has to process a chunk of samples in before
+         * it counts as a deadline miss (see receiver_chain::get_block_stats()).
+         */
+        double sample_rate;
+
+        /*!
+         * \brief Low latency mode (ignored in streaming mode).
+         *
+         * Instead of running every block in its own thread on a different chunk of samples each
+         * block is run in turn on the calling thread during receiver_chain::process_samples()
+         * so a chunk passes through the whole chain in a single call. This trades the pipelined
+         * throughput of lockstep mode for a latency of one chunk instead of six.
+         */
+        bool low_latency;
+
+        /*!
+         * \brief Idle channel gating.
+         *
+         * The frame_detector only passes on the samples around each detected STS (see
+         * #GATE_LOOKBACK & #GATE_HOLD_LENGTH) so the rest of the chain does nothing while the
+         * channel is idle and the CPU use scales with the traffic instead of the sample rate.
+         * The gate closes early once the timing_sync finds no LTS or the frame_decoder has read
+         * the frame's length (see gate_feedback).
+         */
+        bool gated;
+
+        /*!
+         * \brief Fused frequency domain processing.
+         *
+         * A single freq_domain block takes the place of the fft_symbols, channel_est and
+         * phase_tracker blocks so there are 4 blocks in the chain instead of 6.
+         */
+        bool fused;
+
+        /*!
+         * \brief Smooth the channel estimate of each frame across subcarriers (see channel_est::channel_est()).
+         */
+        bool smooth_channel;
+
+        /*!
+         * \brief Scheduling configuration of each block's thread.
+         *
+         * Entry i applies to the i-th block in the chain (frame_detector, timing_sync, fft_symbols,
+         * channel_est, phase_tracker, frame_decoder or if #fused frame_detector, timing_sync,
+         * freq_domain, frame_decoder). Blocks without an entry use the default
+         * scheduling. Each thread is named after its block either way.
+         */
+        std::vector<thread_params> block_threads;
+
+        /*!
+         * \brief Expected number of samples passed to the receiver chain at a time.
+         *
+         * Each block's buffers are sized for this many samples (see block::reserve_buffers()).
+         * Larger chunks still work, the buffers just grow the first time. The receiver & multi_receiver
+         * set this from receiver_params::chunk_size.
+         */
+        int chunk_size;
+
+        /*!
+         * \brief Shared scheduler to run the blocks on in lockstep mode (ignored in streaming & low latency mode).
+         *
+         * Instead of a thread of its own for each block the blocks are run as tasks on the
+         * block_scheduler's workers, which any number of receiver chains can share so the number of
+         * threads follows the number of cores rather than the number of chains. #block_threads
+         * doesn't apply since the blocks have no threads of their own. NULL (the default) for one
+         * thread per block. The scheduler must outlive the receiver_chain.
+         */
+        block_scheduler * scheduler;
+
+        /*!
+         * \brief Real time budget watchdog (see load_watchdog).
+         *
+         * Once the chain can't keep up with #sample_rate it sheds work according to
+         * overload_params::policy until the load comes back down. Disabled by default.
+         */
+        overload_params overload;
+
+        fft_backend fft_impl; //!< Implementation of the forward FFTs in the fft_symbols or freq_domain block (see fft_backend)
+
+        /*!
+         * \brief Decode each payload incrementally as its symbols arrive (see frame_decoder::frame_decoder()).
+         *
+         * Only the viterbi chainback, descrambling and CRC check are left for the chunk holding the
+         * last symbol of a frame. #decode_threads and #viterbi_threads are ignored.
+         */
+        bool incremental_decode;
+
+        /*!
+         * \brief Only decode the frame headers (see frame_decoder::frame_decoder()).
+         *
+         * Every frame whose header passes its parity check comes out as an empty payload whose
+         * packet_info holds the header's rate & length along with the frame's SNR and timing,
+         * i.e. how long the frame kept the channel busy. The payloads are never decoded.
+         */
+        bool header_only;
+
+        /*!
+         * \brief With #header_only, stop transforming & equalizing each frame's symbols after its
+         *  SIGNAL symbol (see fft_symbols::fft_symbols()).
+         *
+         * The fft_symbols, channel_est & phase_tracker blocks (or the freq_domain block) then only
+         * ever see the three symbols of each frame they need, so the cost of the chain after the
+         * timing_sync follows the number of frames instead of the airtime they take up.
+         */
+        bool gate_data_symbols;
+
+        false_alarm_params false_alarm; //!< Thresholds for dropping false detections early (see false_alarm_params)
+
+        /*!
+         * \brief Also return the payloads that fail their CRC check, with their bit errors & packet_info::crc_ok
+         *  cleared (see frame_decoder::set_keep_failed()). For measuring the bit error rate.
+         */
+        bool keep_failed;
+
+        /*!
+         * \brief Constructor for receiver_chain_params.
+         *
+         * Every setting starts out at its default and is changed by assigning the member, i.e.
+         * `params.low_latency = true;`:
+         *  - #streaming, #low_latency, #gated, #fused, #smooth_channel, #incremental_decode, #header_only,
+         *    #gate_data_symbols & #keep_failed -> false
+         *  - #queue_depth -> 16
+         *  - #decode_threads & #viterbi_threads -> 0
+         *  - #sample_rate -> 5e6 (5 MHz)
+         *  - #block_threads -> none (default scheduling)
+         *  - #chunk_size -> 4096
+         *  - #scheduler -> NULL
+         *  - #overload -> disabled
+         *  - #fft_impl -> #FFT_BACKEND_FFTW
+         *  - #false_alarm -> every threshold off
+         */
+        receiver_chain_params() :
+            streaming(false),
+            queue_depth(16),
+            decode_threads(0),
+            viterbi_threads(0),
+            sample_rate(5e6),
+            low_latency(false),
+            gated(false),
+            fused(false),
+            smooth_channel(false),
+            chunk_size(4096),
+            scheduler(NULL),
+            fft_impl(FFT_BACKEND_FFTW),
+            incremental_decode(false),
+            header_only(false),
+            gate_data_symbols(false),
+            keep_failed(false)
+        {
+        }
+    };
+
+    /*!
+     * \brief The stream_link struct connects two blocks in streaming mode.
+     *
+     * Filled buffers travel downstream through #data along with their tags (see block::output_tags)
+     * through #tags. Once the downstream block has consumed a buffer it hands the (now empty) buffer
+     * and tags back upstream through #spares & #tag_spares so the upstream block can reuse their
+     * memory instead of allocating new ones.
+     */
+    template<typename T>
+    struct stream_link
+    {
+        spsc_queue<std::vector<T> > data;   //!< Buffers waiting to be consumed by the downstream block
+        spsc_queue<std::vector<T> > spares; //!< Consumed buffers waiting to be reused by the upstream block
+        spsc_queue<std::vector<stream_tag> > tags;       //!< The tags of the buffers in #data
+        spsc_queue<std::vector<stream_tag> > tag_spares; //!< Consumed tags waiting to be reused by the upstream block
+        spsc_queue<unsigned long long> chunk_samples;   //!< Number of raw samples in the chunk each buffer in #data came from
+
+        /*!
+         * \brief Constructor for stream_link
+         * \param depth number of buffers each queue can hold
+         */
+        stream_link(int depth) :
+            data(depth),
+            spares(depth),
+            tags(depth),
+            tag_spares(depth),
+            chunk_samples(depth)
+        {
+        }
+
+        /*!
+         * \brief Pushes a buffer, its tags & its chunk's size into #data, #tags & #chunk_samples.
+         *  Must only be called by the upstream block.
+         *
+         * The tags & size are pushed first so they are always there by the time the buffer is popped.
+         * That also means #tags and #chunk_samples never hold fewer items than #data, so once the tags
+         * are in neither the size nor the buffer can fail to go in.
+         *
+         * \return false if the link is full
+         */
+        bool push(std::vector<T> & buffer, std::vector<stream_tag> & buffer_tags, unsigned long long samples)
+        {
+            if(!tags.push(buffer_tags)) return false;
+            chunk_samples.push(samples);
+            data.push(buffer);
+            return true;
+        }
+
+        /*!
+         * \brief Pops a buffer, its tags & its chunk's size from #data, #tags & #chunk_samples.
+         *  Must only be called by the downstream block.
+         * \return false if the link is empty
+         */
+        bool pop(std::vector<T> & buffer, std::vector<stream_tag> & buffer_tags, unsigned long long & samples)
+        {
+            if(!data.pop(buffer)) return false;
+            tags.pop(buffer_tags);
+            chunk_samples.pop(samples);
+            return true;
+        }
+    };
 
     /*! \brief The Receiver Chain class.
      *
@@ -43,20 +436,117 @@ namespace fun
 
         /*!
          * \brief Constructor for receiver_chain
+         * \param params [Optional] The configuration for this receiver chain. Defaults to lockstep mode.
          */
-        receiver_chain();
+        receiver_chain(receiver_chain_params params = receiver_chain_params());
+
+        /*!
+         * \brief Destructor for receiver_chain. Stops & joins the block threads, then deletes the blocks,
+         *  the links between them & the counters.
+         *
+         * Must not be called while another thread is inside process_samples(), process_buffer() or process_packets().
+         */
+        ~receiver_chain();
 
         /*!
          * \brief Processes the raw time domain samples.
          * \param samples A vector of received time-domain samples from the usrp block to pass to
          *  the receive chain for signal processing.
          * \return A vector of correctly received payloads where each payload is its own vector
-         *  of unsigned chars.
+         *  of unsigned chars. In streaming mode these are the payloads that have finished decoding
+         *  since the previous call, which may belong to samples passed in by earlier calls.
+         */
+        std::vector<std::vector<unsigned char> > process_samples(std::vector<complex_t > samples);
+
+        /*!
+         * \brief Same as process_samples() except that the samples are swapped into the chain
+         *  instead of being passed by value.
+         * \param samples The new samples. On return it holds a spent sample buffer which can be
+         *  refilled by the caller so that feeding the chain never copies or allocates.
+         * \param time [Optional] Time in seconds the first of the samples was on the air (e.g. the
+         *  USRP timestamp, see usrp::get_samples()) or -1 to carry on from the previous chunk's time.
+         *  Used to work out packet_info::air_start & packet_info::air_end.
+         * \return The payloads decoded (see process_samples()).
+         */
+        std::vector<std::vector<unsigned char> > process_buffer(std::vector<complex_t > & samples, double time = -1);
+
+        /*!
+         * \brief Same as process_buffer() except that the payloads are delivered in packets
+         *  taken from a packet_pool along with their metadata.
+         * \param samples The new samples (see process_buffer()).
+         * \param pool The pool the packets are taken from.
+         * \param packets The packets decoded (see process_samples()) are appended to this vector.
+         *  The caller hands each packet back to the pool with packet_pool::release() once it is done with it.
+         * \param time [Optional] Time the first of the samples was on the air (see process_buffer()).
+         *
+         * Unlike returning the payloads by value this never copies a payload or allocates a packet
+         * once the pool is big enough.
+         */
+        void process_packets(std::vector<complex_t > & samples, packet_pool & pool, std::vector<packet *> & packets, double time = -1);
+
+        /*!
+         * \brief Gets the timing statistics of each block.
+         * \return One block_stats per block in the order the samples flow through them.
+         *
+         * A deadline miss is a call to a block's work() function that took longer than the
+         * samples it was processing last at #receiver_chain_params::sample_rate, i.e. a block
+         * that can't keep up with the samples coming in. Can be called from any thread.
+         */
+        std::vector<block_stats> get_block_stats();
+
+        void reset_block_stats(); //!< Zeros the timing statistics of every block and the packet latency statistics.
+
+        /*!
+         * \brief Gets the end to end latency of each packet returned by the most recent call
+         *  to process_samples(), process_buffer() or process_packets().
+         * \return One latency in seconds per returned packet (in the same order). The latency is
+         *  measured from the time the chunk of samples that completed the packet's frame was passed
+         *  to the receiver_chain until the packet was returned, or -1 if it is unknown.
          */
-        std::vector<std::vector<unsigned char> > process_samples(std::vector<std::complex<double> > samples);
+        std::vector<double> get_packet_latencies();
+
+        /*!
+         * \brief Gets the metadata of each packet returned by the most recent call to process_samples(),
+         *  process_buffer() or process_packets() (in the same order).
+         * \return The metadata, valid until the next call to one of those.
+         */
+        const std::vector<packet_info> & get_packet_info() { return m_payload_info; }
+
+        /*!
+         * \brief Gets the statistics of the packet latencies (see get_packet_latencies()).
+         * \return The latencies in the same form as the block timing statistics (block_stats::calls
+         *  is the number of packets and the histogram holds the packet latencies). Can be called from any thread.
+         */
+        block_stats get_latency_stats();
+
+        /*!
+         * \brief Gets the counters of the load watchdog (see receiver_chain_params::overload).
+         * \return The counters, all 0 if the watchdog isn't enabled. Can be called from any thread.
+         */
+        overload_stats get_overload_stats();
+
+        /*!
+         * \brief Gets the number of detected frames each stage dropped.
+         * \return The counters. Can be called from any thread.
+         *
+         * Along with the metrics in each packet's packet_info::quality this is what to tune the
+         * receiver_chain_params::false_alarm thresholds by.
+         */
+        detection_stats get_detection_stats();
+
+        /*!
+         * \brief Takes the load watchdog's transitions since the previous call (see load_watchdog::get_events()).
+         * \return The transitions, oldest first (none if the watchdog isn't enabled). Can be called from any thread.
+         */
+        std::vector<overload_event> get_overload_events();
 
     private:
 
+        receiver_chain(const receiver_chain &);               //!< Not copyable since it owns the blocks & threads
+        receiver_chain & operator=(const receiver_chain &);   //!< Not copyable since it owns the blocks & threads
+
+        receiver_chain_params m_params; //!< The configuration of this receiver chain
+
         /**********
          * Blocks *
          **********/
@@ -66,6 +556,7 @@ namespace fun
         fft_symbols    * m_fft_symbols;        //!< Forward FFT of symbols
         channel_est    * m_channel_est;        //!< Channel estimation and equalization in freq domain
         phase_tracker  * m_phase_tracker;      //!< Phase rotation tracking
+        freq_domain    * m_freq_domain;        //!< Fused fft_symbols, channel_est & phase_tracker (NULL unless fused, the three are NULL if it is)
         frame_decoder  * m_frame_decoder;      //!< Frame decoding
 
         /***********************************
@@ -85,14 +576,244 @@ namespace fun
          */
         void run_block(int index, fun::block_base * block);
 
+        /*!
+         * \brief Runs one block as a block_scheduler task (see receiver_chain_params::scheduler)
+         * \param chain The receiver_chain
+         * \param index The block's index in #m_blocks
+         */
+        static void scheduled_work(void * chain, int index);
+
+        /*!
+         * \brief Calls the block's work function recording the time it took in the block's counters
+         * \param index the block's index
+         * \param block The block
+         */
+        void timed_work(int index, fun::block_base * block);
+
+        /*!
+         * \brief Runs every block in turn on the calling thread (see receiver_chain_params::low_latency)
+         * \param samples The new samples, swapped with the Frame Detector's previous input
+         */
+        void run_inline(std::vector<complex_t > & samples);
+
+        /*!
+         * \brief Shifts the buffers from the timing_sync down to the frame_decoder in lockstep mode
+         *  running each block in between in turn if inline (see receiver_chain_params::low_latency)
+         * \param inline_work Whether to run the blocks as the buffers are shifted
+         */
+        void shift_frequency_domain(bool inline_work);
+
+        /*!
+         * \brief Swaps a block's output buffer & tags into the next block's input buffer & tags
+         * \param from The upstream block
+         * \param to The downstream block
+         */
+        template<typename A, typename B, typename C>
+        void shift(fun::block<A, B> * from, fun::block<B, C> * to)
+        {
+            to->input_buffer.swap(from->output_buffer);
+            to->input_tags.swap(from->output_tags);
+        }
+
+        /*!
+         * \brief Records the arrival time and the on air time of the next chunk of samples
+         * \param count Number of samples in the chunk
+         * \param time Time the chunk's first sample was on the air or -1 (see process_buffer())
+         */
+        void stamp_chunk(unsigned long long count, double time);
+
+        /*!
+         * \brief Passes the samples through the chain leaving the completed payloads in #m_payloads.
+         * \param samples The new samples (see process_buffer())
+         * \param time Time the first of the samples was on the air or -1 (see process_buffer())
+         */
+        void run_chunk(std::vector<complex_t > & samples, double time);
+
+        std::vector<std::vector<unsigned char> > m_payloads; //!< Payloads completed by the latest chunk
+
+        std::vector<packet_info> m_payload_info; //!< Metadata of each of #m_payloads
+
+        /*!
+         * \brief Works out the latency of each packet the frame_decoder completed.
+         * \param info The metadata of each packet (from frame_decoder::output_info), packet_info::latency, the on air
+         *  times & packet_info::delivered are filled in
+         * \param count Number of packets
+         */
+        void measure_latencies(packet_info * info, int count);
+
+        std::vector<std::chrono::steady_clock::time_point> m_chunk_times; //!< Arrival time of chunk n at n % #CHUNK_TIME_HISTORY
+
+        std::vector<chunk_anchor> m_chunk_anchors; //!< On air time of chunk n at n % #CHUNK_TIME_HISTORY
+
+        unsigned long long m_stream_samples; //!< Number of samples passed to the blocks so far
+
+        /*!
+         * \brief Works out when a frame was on the air from the chunk it started in.
+         * \param info The frame's metadata, packet_info::air_start & packet_info::air_end are filled in
+         */
+        void place_on_air(packet_info & info);
+
+        unsigned long long m_chunk_count; //!< Number of chunks passed to the receiver chain so far
+
+        unsigned long long m_decoder_delay; //!< How many chunks behind the frame_decoder's input is
+
+        std::vector<double> m_packet_latencies; //!< See get_packet_latencies()
+
+        block_counters * m_latency; //!< Packet latency statistics
+
+        /*!
+         * \brief Creates the counters for the block about to be added to the chain
+         * \param block The block
+         * \return The block's counters
+         */
+        block_counters * add_counters(fun::block_base * block);
+
+        std::vector<block_counters *> m_counters; //!< Timing statistics of each block
+
+        /*********************
+         * Overload Watchdog *
+         *********************/
+
+        load_watchdog * m_watchdog; //!< Tracks the load (NULL unless receiver_chain_params::overload is enabled)
+
+        std::vector<unsigned long long> m_busy_ns; //!< Each block's block_stats::total_ns at the start of the current window
+
+        unsigned long long m_window_samples; //!< Number of samples passed to the chain so far in the current window
+
+        int m_window_chunks; //!< Number of chunks passed to the chain so far in the current window
+
+        unsigned long long m_quiet_chunks; //!< Number of chunks in a row the frame_detector has output no tags for
+
+        /*!
+         * \brief Counts a chunk towards the load watchdog's window, updating the watchdog at the end of the window.
+         * \param samples Number of samples in the chunk
+         */
+        void watch_load(unsigned long long samples);
+
+        /*!
+         * \brief Applies or lifts the overload policy on the blocks.
+         * \param degraded Whether the chain just became degraded
+         */
+        void apply_overload_policy(bool degraded);
+
+        /*!
+         * \brief Whether the next chunk should be dropped (see #SHED_CHUNKS).
+         *
+         * Only while degraded and no frame is in flight anywhere in the chain: the frame_detector
+         * hasn't tagged anything for long enough for any frame to have reached the frame_decoder,
+         * and the frame_decoder isn't in the middle of a frame.
+         */
+        bool drop_chunk();
+
+        void note_detections(); //!< Updates #m_quiet_chunks after the frame_detector has run
+
+        /*!
+         * \brief Number of raw samples in the chunk currently being processed.
+         *
+         * In lockstep mode every block is working on data from the same chunk size. In
+         * streaming mode each buffer carries the size of its own chunk through the
+         * stream_links instead, since the blocks are working on different chunks.
+         */
+        std::atomic<unsigned long long> m_chunk_samples;
+
+        /*!
+         * \brief Processes the raw time domain samples in streaming mode.
+         * \param samples The received samples, moved into the Frame Detector's input queue.
+         * \param time Time the first of the samples was on the air or -1 (see process_buffer())
+         *
+         * The payloads decoded since the previous call are left in #m_payloads.
+         */
+        void stream_samples(std::vector<complex_t > & samples, double time);
+
 
         std::vector<std::thread> m_threads; //!< Vector of threads - one for each block
 
+        std::atomic<bool> m_stop; //!< Tells the block threads to exit (see ~receiver_chain())
+
+        spsc_queue<gate_window> * m_gate_log; //!< The gate windows shared by the gated blocks (NULL unless receiver_chain_params::gated)
+
+        gate_feedback * m_gate_feedback; //!< The reports letting the gate close early (NULL unless receiver_chain_params::gated)
+
 
         std::vector<sem_t> m_wake_sems; //!< Vector of semaphores used to "wake up" each block
 
 
         std::vector<sem_t> m_done_sems; //!< Vector of semaphores used to determine when the blocks are done
+
+
+        std::vector<fun::block_base *> m_blocks; //!< The blocks run on receiver_chain_params::scheduler (empty without one)
+
+
+        std::vector<scheduler_task> m_tasks; //!< One task for each of #m_blocks
+
+
+        task_group * m_task_group; //!< Tracks #m_tasks while they run
+
+        /*********************************
+         * Streaming Variables & Methods *
+         *********************************/
+
+        /*!
+         * \brief Adds block to the receiver chain in streaming mode
+         * \param block A pointer to the block so that its work function can be called
+         * \param in The link the block consumes its input buffers from
+         * \param out The link the block produces its output buffers into
+         */
+        template<typename I, typename O>
+        void add_stream_block(fun::block<I, O> * block, stream_link<I> * in, stream_link<O> * out);
+
+        /*!
+         * \brief Runs the block in streaming mode by calling its work function whenever
+         *  a new input buffer is available.
+         * \param block A pointer to the block used as a handle to access its work() function.
+         * \param in The link the block consumes its input buffers from
+         * \param out The link the block produces its output buffers into
+         * \param index The index of the block in the chain
+         */
+        template<typename I, typename O>
+        void stream_block(fun::block<I, O> * block, stream_link<I> * in, stream_link<O> * out, int index);
+
+        /*!
+         * \brief Clears the block's output before its work function is called in streaming mode
+         * \param block The block
+         */
+        template<typename I, typename O>
+        void clear_output(fun::block<I, O> * block) { block->output_buffer.clear(); block->output_tags.clear(); }
+
+        /*!
+         * \brief Clears the frame_decoder's output & output metadata.
+         * \param block The frame_decoder
+         */
+        void clear_output(fun::block<tagged_vector<48>, std::vector<unsigned char> > * block);
+
+        /*!
+         * \brief Passes anything besides the output buffer downstream in streaming mode (nothing for most blocks)
+         * \param block The block
+         */
+        template<typename I, typename O>
+        void forward_extras(fun::block<I, O> * block) {}
+
+        /*!
+         * \brief Passes the frame_decoder's output metadata to #m_info_link
+         * \param block The frame_decoder
+         */
+        void forward_extras(fun::block<tagged_vector<48>, std::vector<unsigned char> > * block);
+
+        /*!
+         * \brief Names the calling block thread and applies its receiver_chain_params::block_threads entry.
+         * \param index The index of the block in the chain
+         * \param block The block
+         */
+        void configure_block_thread(int index, fun::block_base * block);
+
+        stream_link<complex_t > * m_detector_link;  //!< process_samples() -> frame_detector
+        stream_link<complex_t >             * m_timing_link;    //!< frame_detector -> timing_sync
+        stream_link<complex_t >             * m_fft_link;       //!< timing_sync -> fft_symbols
+        stream_link<tagged_vector<64> >     * m_chan_link;      //!< fft_symbols -> channel_est
+        stream_link<tagged_vector<64> >     * m_phase_link;     //!< channel_est -> phase_tracker
+        stream_link<tagged_vector<48> >     * m_decoder_link;   //!< phase_tracker -> frame_decoder
+        stream_link<std::vector<unsigned char> > * m_payload_link; //!< frame_decoder -> process_samples()
+        stream_link<packet_info>            * m_info_link;      //!< frame_decoder::output_info -> process_samples()
     };
 
 }
@@ -0,0 +1,59 @@
+/*! \file scrambler.cpp
+ *  \brief C++ file for the scrambler class.
+ *
+ *  The scrambler whitens the data of every frame with the output of a 7 bit LFSR
+ *  (x^7 + x^4 + 1). Scrambling and descrambling are the same operation.
+ */
+
+#include <algorithm>
+
+#include "scrambler.h"
+
+namespace fun
+{
+    /*!
+     * \brief The scrambler sequence & the offset of each seed into it.
+     *
+     * The sequence is stored twice over so that #SCRAMBLER_PERIOD consecutive values can be
+     * read starting from any offset.
+     */
+    struct scrambler_sequence
+    {
+        unsigned char sequence[2 * SCRAMBLER_PERIOD]; //!< The feedback bit of every step, two periods
+        unsigned char offset[128];                    //!< Index into #sequence of the first step from each seed
+
+        //! Steps the LFSR through a whole period
+        scrambler_sequence()
+        {
+            int state = 1;
+            for(int x = 0; x < SCRAMBLER_PERIOD; x++)
+            {
+                offset[state] = x;
+                int feedback = (!!(state & 64)) ^ (!!(state & 8));
+                sequence[x] = feedback;
+                sequence[x + SCRAMBLER_PERIOD] = feedback;
+                state = ((state << 1) & 0x7E) | feedback;
+            }
+            offset[0] = 0;
+        }
+    };
+
+    /*!
+     * Each period of the data is XORed with the same #SCRAMBLER_PERIOD long window of the
+     * sequence, which the compiler turns into 16 (or 32) byte wide XORs.
+     */
+    void scrambler::scramble(unsigned char * data, int length, int seed)
+    {
+        static const scrambler_sequence s;
+        seed &= 0x7F;
+        if(seed == 0) return; // The LFSR is stuck at 0
+
+        const unsigned char * sequence = s.sequence + s.offset[seed];
+        for(int x = 0; x < length; x += SCRAMBLER_PERIOD)
+        {
+            int n = std::min(SCRAMBLER_PERIOD, length - x);
+            unsigned char * d = data + x;
+            for(int k = 0; k < n; k++) d[k] ^= sequence[k];
+        }
+    }
+}
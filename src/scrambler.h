@@ -0,0 +1,46 @@
+/*! \file scrambler.h
+ *  \brief Header file for the scrambler class.
+ *
+ *  The scrambler whitens the data of every frame with the output of a 7 bit LFSR
+ *  (x^7 + x^4 + 1). Scrambling and descrambling are the same operation.
+ */
+
+#ifndef SCRAMBLER_H
+#define SCRAMBLER_H
+
+/*! \def SCRAMBLER_PERIOD
+ *  \brief Period of the scrambler's sequence (the LFSR is maximal length).
+ */
+#define SCRAMBLER_PERIOD 127
+
+/*! \def SCRAMBLER_SEED
+ *  \brief The LFSR state the ppdu starts scrambling every frame from.
+ */
+#define SCRAMBLER_SEED 93
+
+namespace fun
+{
+    /*!
+     * \brief The scrambler class
+     *
+     *  The LFSR is stepped once per byte and its feedback bit is XORed into the byte, exactly
+     *  as the ppdu has always done it so frames stay compatible. Since every nonzero state of
+     *  a maximal length LFSR lies on the same cycle the sequence from any seed is just an offset
+     *  into one #SCRAMBLER_PERIOD long sequence, which is precomputed once along with the
+     *  offset of every seed. Scrambling then is plain XORs of the data with the sequence.
+     */
+    class scrambler
+    {
+    public:
+
+        /*!
+         * \brief Scrambles (or descrambles) the data in place.
+         * \param data The data
+         * \param length Number of bytes
+         * \param seed Initial LFSR state (only the low 7 bits are used, 0 leaves the data as is)
+         */
+        static void scramble(unsigned char * data, int length, int seed = SCRAMBLER_SEED);
+    };
+}
+
+#endif // SCRAMBLER_H
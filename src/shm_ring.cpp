@@ -0,0 +1,317 @@
+/*! \file shm_ring.cpp
+ *  \brief C++ file for the shm_ring & shm_ring_reader classes.
+ *
+ *  The shm_ring publishes received packets (payload & packet_info) into a lock-free ring in
+ *  POSIX shared memory so that other processes can consume them at their own pace with the
+ *  shm_ring_reader, without the packets passing through sockets or holding up the receiver.
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <iostream>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm_ring.h"
+
+/*! \def SHM_RING_MAGIC
+ *  \brief Marks a fully initialized ring (written last by the shm_ring).
+ */
+#define SHM_RING_MAGIC 0x46554e52 /* "FUNR" */
+
+/*! \def SHM_RING_VERSION
+ *  \brief Version of the shared memory layout, bumped whenever it changes.
+ */
+#define SHM_RING_VERSION 3
+
+/*! \def SHM_SLOT_WRITING
+ *  \brief shm_slot::sequence of a slot that is being written.
+ */
+#define SHM_SLOT_WRITING (~uint64_t(0))
+
+/*! \def SHM_READER_DETACHED
+ *  \brief shm_reader_cursor::next of a cursor that no reader has attached to.
+ */
+#define SHM_READER_DETACHED (~uint64_t(0))
+
+namespace fun
+{
+    /*!
+     * \brief The cursor of one reader in the shared memory.
+     */
+    struct shm_reader_cursor
+    {
+        std::atomic<uint32_t> pid;  //!< Process id of the attached reader, 0 if the cursor is free
+        std::atomic<uint64_t> next; //!< Sequence number of the next packet the reader will read
+    };
+
+    /*!
+     * \brief The start of the shared memory, followed by the slots.
+     */
+    struct shm_ring_header
+    {
+        std::atomic<uint32_t> magic;        //!< #SHM_RING_MAGIC once the ring is initialized
+        uint32_t version;                   //!< #SHM_RING_VERSION
+        uint32_t slots;                     //!< Number of slots
+        uint32_t slot_size;                 //!< Largest payload a slot holds
+        uint32_t slot_stride;               //!< Bytes from one slot to the next
+        uint32_t policy;                    //!< The shm_overrun_policy
+        std::atomic<uint64_t> write_seq;    //!< Number of packets published, i.e. the sequence number of the next one
+        std::atomic<uint64_t> dropped;      //!< See shm_ring_stats::dropped
+        std::atomic<uint64_t> oversized;    //!< See shm_ring_stats::oversized
+        shm_reader_cursor readers[SHM_RING_READERS]; //!< The readers' cursors
+    };
+
+    /*!
+     * \brief One packet in the shared memory, followed by its payload.
+     */
+    struct shm_slot
+    {
+        std::atomic<uint64_t> sequence; //!< Sequence number of the packet plus 1, 0 if never written or #SHM_SLOT_WRITING
+        packet_info info;               //!< The packet's metadata
+        uint32_t length;                //!< Payload length in bytes
+    };
+
+    /*!
+     * \brief Rounds up to a whole number of cache lines so neither the header nor any slot shares one.
+     */
+    static size_t cache_align(size_t bytes)
+    {
+        return (bytes + 63) & ~size_t(63);
+    }
+
+    static shm_slot * slot_at(shm_ring_header * header, uint64_t sequence)
+    {
+        char * base = reinterpret_cast<char *>(header) + cache_align(sizeof(shm_ring_header));
+        return reinterpret_cast<shm_slot *>(base + (sequence % header->slots) * header->slot_stride);
+    }
+
+    static unsigned char * slot_payload(shm_slot * slot)
+    {
+        return reinterpret_cast<unsigned char *>(slot) + sizeof(shm_slot);
+    }
+
+    /*!
+     * - Initializations:
+     *   + #m_params -> params
+     *   + #m_header -> A fresh shared memory object named params.name (NULL if that fails)
+     *
+     * Any left over object of the same name (e.g. from a writer that crashed) is replaced. The
+     * magic number is written last so a reader never attaches to a half initialized ring.
+     */
+    shm_ring::shm_ring(shm_ring_params params) :
+        m_params(params),
+        m_header(NULL),
+        m_size(0),
+        m_oversized(0)
+    {
+        if(m_params.name.empty() || m_params.slots < 1 || m_params.slot_size < 0) return;
+
+        size_t stride = cache_align(sizeof(shm_slot) + m_params.slot_size);
+        m_size = cache_align(sizeof(shm_ring_header)) + stride * m_params.slots;
+
+        shm_unlink(m_params.name.c_str());
+        int fd = shm_open(m_params.name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+        if(fd < 0 || ftruncate(fd, m_size) != 0)
+        {
+            std::cerr << "shm_ring: couldn't create " << m_params.name << " (" << strerror(errno) << ")" << std::endl;
+            if(fd >= 0) close(fd);
+            return;
+        }
+        void * memory = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(memory == MAP_FAILED)
+        {
+            shm_unlink(m_params.name.c_str());
+            return;
+        }
+
+        // The object starts out zeroed, i.e. every slot never written
+        m_header = static_cast<shm_ring_header *>(memory);
+        m_header->version = SHM_RING_VERSION;
+        m_header->slots = m_params.slots;
+        m_header->slot_size = m_params.slot_size;
+        m_header->slot_stride = stride;
+        m_header->policy = m_params.policy;
+        for(int r = 0; r < SHM_RING_READERS; r++) m_header->readers[r].next.store(SHM_READER_DETACHED, std::memory_order_relaxed);
+        m_header->magic.store(SHM_RING_MAGIC, std::memory_order_release);
+    }
+
+    /*!
+     * Readers that are still attached keep their mapping, they just never see another packet.
+     */
+    shm_ring::~shm_ring()
+    {
+        if(m_header == NULL) return;
+        munmap(m_header, m_size);
+        shm_unlink(m_params.name.c_str());
+    }
+
+    /*!
+     * The slot is marked as being written before anything in it changes and only stamped with
+     * the packet's sequence number once it is complete, so a reader that copies the slot while
+     * it changes sees a different sequence number before & after (see shm_ring_reader::read()).
+     */
+    bool shm_ring::publish(const unsigned char * payload, int length, const packet_info & info)
+    {
+        if(m_header == NULL) return false;
+        if(length > m_params.slot_size)
+        {
+            m_header->oversized.store(++m_oversized, std::memory_order_relaxed);
+            return false;
+        }
+
+        uint64_t sequence = m_header->write_seq.load(std::memory_order_relaxed);
+        if(m_params.policy == SHM_DROP_NEWEST && !readers_caught_up(sequence))
+        {
+            m_header->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        shm_slot * slot = slot_at(m_header, sequence);
+        slot->sequence.store(SHM_SLOT_WRITING, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot->info = info;
+        slot->length = length;
+        if(length > 0) memcpy(slot_payload(slot), payload, length);
+        slot->sequence.store(sequence + 1, std::memory_order_release);
+        m_header->write_seq.store(sequence + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * A reader whose process has exited without detaching would otherwise hold the ring up for
+     * good, so before a packet is dropped because of a reader its process is checked for.
+     */
+    bool shm_ring::readers_caught_up(uint64_t sequence)
+    {
+        for(int r = 0; r < SHM_RING_READERS; r++)
+        {
+            shm_reader_cursor & cursor = m_header->readers[r];
+            uint32_t pid = cursor.pid.load(std::memory_order_acquire);
+            uint64_t next = cursor.next.load(std::memory_order_acquire);
+            if(pid == 0 || next == SHM_READER_DETACHED || next > sequence || sequence - next < m_params.slots) continue;
+
+            if(kill(pid, 0) != 0 && errno == ESRCH)
+            {
+                cursor.next.store(SHM_READER_DETACHED, std::memory_order_relaxed);
+                cursor.pid.compare_exchange_strong(pid, 0, std::memory_order_release);
+                continue;
+            }
+            return false;
+        }
+        return true;
+    }
+
+    shm_ring_stats shm_ring::get_stats() const
+    {
+        shm_ring_stats stats = shm_ring_stats();
+        if(m_header == NULL) return stats;
+        stats.published = m_header->write_seq.load(std::memory_order_relaxed);
+        stats.dropped = m_header->dropped.load(std::memory_order_relaxed);
+        stats.oversized = m_header->oversized.load(std::memory_order_relaxed);
+        for(int r = 0; r < SHM_RING_READERS; r++) if(m_header->readers[r].pid.load(std::memory_order_relaxed) != 0) stats.readers++;
+        return stats;
+    }
+
+    /*!
+     * - Initializations:
+     *   + #m_header -> The ring named name (NULL if it doesn't exist, isn't initialized or has no free reader cursor)
+     *   + #m_reader -> The first free reader cursor
+     *   + #m_next -> The sequence number of the next packet to be published
+     */
+    shm_ring_reader::shm_ring_reader(std::string name) :
+        m_header(NULL),
+        m_size(0),
+        m_reader(-1),
+        m_next(0),
+        m_lost(0)
+    {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if(fd < 0) return;
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size < sizeof(shm_ring_header))
+        {
+            close(fd);
+            return;
+        }
+        m_size = st.st_size;
+        void * memory = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(memory == MAP_FAILED) return;
+
+        shm_ring_header * header = static_cast<shm_ring_header *>(memory);
+        if(header->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC || header->version != SHM_RING_VERSION ||
+           m_size < cache_align(sizeof(shm_ring_header)) + size_t(header->slot_stride) * header->slots)
+        {
+            munmap(memory, m_size);
+            return;
+        }
+
+        for(int r = 0; r < SHM_RING_READERS && m_reader < 0; r++)
+        {
+            uint32_t free_pid = 0;
+            if(header->readers[r].pid.compare_exchange_strong(free_pid, getpid())) m_reader = r;
+        }
+        if(m_reader < 0)
+        {
+            munmap(memory, m_size);
+            return;
+        }
+
+        m_header = header;
+        m_next = m_header->write_seq.load(std::memory_order_acquire);
+        m_header->readers[m_reader].next.store(m_next, std::memory_order_release);
+    }
+
+    shm_ring_reader::~shm_ring_reader()
+    {
+        if(m_header == NULL) return;
+        m_header->readers[m_reader].next.store(SHM_READER_DETACHED, std::memory_order_relaxed);
+        m_header->readers[m_reader].pid.store(0, std::memory_order_release);
+        munmap(m_header, m_size);
+    }
+
+    /*!
+     * The slot is copied out optimistically and only kept if its sequence number was the packet's
+     * both before and after the copy, i.e. the writer didn't start overwriting it in between.
+     */
+    bool shm_ring_reader::read(std::vector<unsigned char> & payload, packet_info & info)
+    {
+        if(m_header == NULL) return false;
+        while(1)
+        {
+            uint64_t written = m_header->write_seq.load(std::memory_order_acquire);
+            if(m_next >= written) return false;
+
+            // Skip the packets that have already been overwritten
+            if(written - m_next > m_header->slots)
+            {
+                m_lost += written - m_header->slots - m_next;
+                m_next = written - m_header->slots;
+            }
+
+            shm_slot * slot = slot_at(m_header, m_next);
+            uint64_t before = slot->sequence.load(std::memory_order_acquire);
+            bool valid = (before == m_next + 1);
+            if(valid)
+            {
+                info = slot->info;
+                int length = std::min<uint32_t>(slot->length, m_header->slot_size);
+                payload.resize(length);
+                if(length > 0) memcpy(payload.data(), slot_payload(slot), length);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                valid = (slot->sequence.load(std::memory_order_relaxed) == before);
+            }
+
+            m_next++;
+            m_header->readers[m_reader].next.store(m_next, std::memory_order_release);
+            if(valid) return true;
+            m_lost++;
+        }
+    }
+}
@@ -0,0 +1,196 @@
+/*! \file shm_ring.h
+ *  \brief Header file for the shm_ring & shm_ring_reader classes.
+ *
+ *  The shm_ring publishes received packets (payload & packet_info) into a lock-free ring in
+ *  POSIX shared memory so that other processes can consume them at their own pace with the
+ *  shm_ring_reader, without the packets passing through sockets or holding up the receiver.
+ */
+
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+
+#include "packet_pool.h"
+#include "ppdu.h"
+
+/*! \def SHM_RING_SLOTS
+ *  \brief Default number of packets an shm_ring holds.
+ */
+#define SHM_RING_SLOTS 256
+
+/*! \def SHM_RING_READERS
+ *  \brief Most readers that can be attached to an shm_ring at once.
+ */
+#define SHM_RING_READERS 8
+
+namespace fun
+{
+    /*!
+     * \brief What an shm_ring does with a new packet when a reader hasn't caught up with the whole ring.
+     */
+    enum shm_overrun_policy
+    {
+        SHM_OVERWRITE_OLDEST,   //!< Overwrite the oldest packet anyway, the lagging readers skip ahead & count what they lost
+        SHM_DROP_NEWEST         //!< Drop the new packet, so the slowest attached reader sets the pace
+    };
+
+    /*!
+     * \brief The shm_ring_params struct holds the configuration of an shm_ring.
+     */
+    struct shm_ring_params
+    {
+        /*!
+         * \brief Name of the shared memory object (e.g. "/fun_ofdm_rx"), see shm_open().
+         *
+         * Empty (the default) for no ring.
+         */
+        std::string name;
+
+        int slots; //!< Number of packets the ring holds
+
+        int slot_size; //!< Largest payload in bytes a slot holds, longer payloads are dropped
+
+        shm_overrun_policy policy; //!< See shm_overrun_policy
+
+        /*!
+         * \brief Constructor for shm_ring_params.
+         * \param name -> #name
+         * \param slots -> #slots
+         * \param slot_size -> #slot_size
+         * \param policy -> #policy
+         */
+        shm_ring_params(std::string name = "", int slots = SHM_RING_SLOTS, int slot_size = MAX_FRAME_SIZE,
+                        shm_overrun_policy policy = SHM_OVERWRITE_OLDEST) :
+            name(name),
+            slots(slots),
+            slot_size(slot_size),
+            policy(policy)
+        {
+        }
+    };
+
+    /*!
+     * \brief The shm_ring_stats struct is a snapshot of an shm_ring's counters. See shm_ring::get_stats().
+     */
+    struct shm_ring_stats
+    {
+        unsigned long long published;   //!< Packets written to the ring
+        unsigned long long dropped;     //!< Packets dropped because of #SHM_DROP_NEWEST
+        unsigned long long oversized;   //!< Packets dropped because they didn't fit in a slot
+        int readers;                    //!< Readers currently attached
+    };
+
+    struct shm_ring_header;
+
+    /*!
+     * \brief The shm_ring class is the writing end of a shared memory packet ring.
+     *
+     *  Creates the shared memory object (replacing any left over one of the same name) and
+     *  removes it again when destroyed. There must only be one writer but any number of
+     *  shm_ring_readers (up to #SHM_RING_READERS) in any process can read every packet
+     *  independently of each other.
+     *
+     *  Each slot is guarded by a sequence number in the style of a seqlock: it is marked as
+     *  being written, the packet is copied in and then the slot is stamped with the packet's
+     *  sequence number. Neither side ever waits on the other, a reader whose slot changed
+     *  while it was copying it just finds out the packet was overwritten.
+     */
+    class shm_ring
+    {
+    public:
+
+        /*!
+         * \brief Constructor for shm_ring.
+         * \param params The name, size & overrun policy of the ring
+         */
+        shm_ring(shm_ring_params params);
+
+        ~shm_ring(); //!< Unmaps & unlinks the shared memory object
+
+        bool is_open() const { return m_header != NULL; } //!< Whether the shared memory object was created
+
+        /*!
+         * \brief Publishes one packet. Must only be called by one thread at a time.
+         * \param payload The payload
+         * \param length Payload length in bytes
+         * \param info The payload's metadata
+         * \return false if the packet was dropped (see shm_overrun_policy & shm_ring_params::slot_size)
+         */
+        bool publish(const unsigned char * payload, int length, const packet_info & info);
+
+        shm_ring_stats get_stats() const; //!< Gets a snapshot of the counters. Can be called from any thread.
+
+    private:
+
+        shm_ring(const shm_ring &);               //!< Not copyable since it owns the mapping
+        shm_ring & operator=(const shm_ring &);   //!< Not copyable since it owns the mapping
+
+        /*!
+         * \brief Whether a new packet fits without overtaking a reader, detaching readers whose process is gone.
+         * \param sequence Sequence number of the new packet
+         */
+        bool readers_caught_up(uint64_t sequence);
+
+        shm_ring_params m_params; //!< The configuration of the ring
+
+        shm_ring_header * m_header; //!< The mapped ring, NULL if it couldn't be created
+
+        size_t m_size; //!< Size of the mapping in bytes
+
+        uint64_t m_oversized; //!< See shm_ring_stats::oversized (only the writer touches it)
+    };
+
+    /*!
+     * \brief The shm_ring_reader class is a reading end of a shared memory packet ring.
+     *
+     *  Attaches to a ring created by an shm_ring, usually in another process, and reads the packets
+     *  published after it attached in order. Reading never blocks the writer or the other readers.
+     */
+    class shm_ring_reader
+    {
+    public:
+
+        /*!
+         * \brief Constructor for shm_ring_reader.
+         * \param name Name of the ring's shared memory object
+         */
+        shm_ring_reader(std::string name);
+
+        ~shm_ring_reader(); //!< Detaches from the ring & unmaps it
+
+        bool is_open() const { return m_header != NULL; } //!< Whether the reader is attached to a ring
+
+        /*!
+         * \brief Reads the next packet if there is one.
+         * \param payload Receives the payload (keeps its capacity between calls)
+         * \param info Receives the payload's metadata
+         * \return false if there is no new packet yet
+         *
+         * If the writer overwrote packets this reader hadn't read yet they are skipped and counted in lost().
+         */
+        bool read(std::vector<unsigned char> & payload, packet_info & info);
+
+        unsigned long long lost() const { return m_lost; } //!< Number of packets overwritten before this reader got to them
+
+    private:
+
+        shm_ring_reader(const shm_ring_reader &);               //!< Not copyable since it owns the mapping
+        shm_ring_reader & operator=(const shm_ring_reader &);   //!< Not copyable since it owns the mapping
+
+        shm_ring_header * m_header; //!< The mapped ring, NULL if it couldn't be opened
+
+        size_t m_size; //!< Size of the mapping in bytes
+
+        int m_reader; //!< Index of the reader's cursor in the ring
+
+        uint64_t m_next; //!< Sequence number of the next packet to read
+
+        unsigned long long m_lost; //!< See lost()
+    };
+}
+
+#endif // SHM_RING_H
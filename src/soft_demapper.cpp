@@ -0,0 +1,136 @@
+/*! \file soft_demapper.cpp
+ *  \brief C++ file for the soft_demapper class.
+ *
+ *  The soft_demapper fuses demodulation, deinterleaving and depuncturing into a
+ *  single pass that writes the soft bits straight into the viterbi decoder's input.
+ */
+
+#include "soft_demapper.h"
+#include "interleaver.h"
+#include "modulator.h"
+
+namespace fun
+{
+    /*!
+     * \brief Per rate table mapping each demodulated soft bit of an OFDM symbol
+     *  to its position in the depunctured output for that symbol.
+     */
+    struct demap_table
+    {
+        int cbps;                   //!< Coded (punctured) bits per OFDM symbol
+        int out_bits;               //!< Depunctured bits per OFDM symbol
+        unsigned short position[288]; //!< Output position of each of the #cbps demodulated bits
+        unsigned short holes[144];  //!< Output positions of the puncture holes
+        int hole_count;             //!< Number of puncture holes per OFDM symbol
+
+        /*!
+         * \brief Builds the table for the given rate
+         * \param rate_params Parameters of the PHY rate
+         */
+        demap_table(RateParams rate_params)
+        {
+            cbps = rate_params.cbps;
+
+            // Puncture pattern: which depunctured positions of each group carry a bit
+            int group_in = 1, group_out = 1;
+            int kept[4] = {0, 0, 0, 0};
+            switch(rate_params.rate)
+            {
+                case RATE_1_2_BPSK: case RATE_1_2_QPSK: case RATE_1_2_QAM16:
+                    break;
+                case RATE_3_4_BPSK: case RATE_3_4_QPSK: case RATE_3_4_QAM16: case RATE_3_4_QAM64:
+                    group_in = 4; group_out = 6;
+                    kept[0] = 0; kept[1] = 1; kept[2] = 3; kept[3] = 5;
+                    break;
+                case RATE_2_3_BPSK: case RATE_2_3_QPSK: case RATE_2_3_QAM16: case RATE_2_3_QAM64:
+                    group_in = 3; group_out = 4;
+                    kept[0] = 0; kept[1] = 2; kept[2] = 3;
+                    break;
+            }
+            out_bits = cbps / group_in * group_out;
+
+            const unsigned short * deinterleave_map = interleaver::deinterleave_map(rate_params.rate);
+
+            std::vector<bool> used(out_bits, false);
+            for(int t = 0; t < cbps; t++)
+            {
+                int d = deinterleave_map[t];
+                int p = (d / group_in) * group_out + kept[d % group_in];
+                position[t] = p;
+                used[p] = true;
+            }
+
+            hole_count = 0;
+            for(int p = 0; p < out_bits; p++)
+            {
+                if(!used[p]) holes[hole_count++] = p;
+            }
+        }
+    };
+
+    /*!
+     * \brief Gets the (lazily built) table for the given rate.
+     */
+    static const demap_table & get_demap_table(Rate rate)
+    {
+        static const demap_table tables[11] =
+        {
+            demap_table(RateParams(RATE_1_2_BPSK)),
+            demap_table(RateParams(RATE_2_3_BPSK)),
+            demap_table(RateParams(RATE_3_4_BPSK)),
+            demap_table(RateParams(RATE_1_2_QPSK)),
+            demap_table(RateParams(RATE_2_3_QPSK)),
+            demap_table(RateParams(RATE_3_4_QPSK)),
+            demap_table(RateParams(RATE_1_2_QAM16)),
+            demap_table(RateParams(RATE_2_3_QAM16)),
+            demap_table(RateParams(RATE_3_4_QAM16)),
+            demap_table(RateParams(RATE_2_3_QAM64)),
+            demap_table(RateParams(RATE_3_4_QAM64)),
+        };
+        return tables[rate];
+    }
+
+    int soft_demapper::soft_bit_count(int sample_count, Rate rate)
+    {
+        return (sample_count / 48) * get_demap_table(rate).out_bits;
+    }
+
+    /*!
+     * \brief soft_demapper::demap() instantiated for one PHY rate.
+     *
+     * Each OFDM symbol is sliced by the modulator's vectorized soft slicer into a small
+     * scratch buffer (which stays in L1) and its soft bits are then scattered to their
+     * deinterleaved and depunctured positions. The number of bits per symbol is a compile
+     * time constant so the scatter loop is fully unrolled.
+     */
+    template<Rate R>
+    static void demap_rate(const complex_t * samples, int sample_count, unsigned char * soft_bits)
+    {
+        typedef rate_traits<R> traits;
+        const demap_table & table = get_demap_table(R);
+        const int samples_per_symbol = 48;
+        unsigned char bits[traits::cbps];
+
+        for(int s = 0; s < sample_count; s += samples_per_symbol)
+        {
+            unsigned char * out = soft_bits + (s / samples_per_symbol) * table.out_bits;
+            for(int h = 0; h < table.hole_count; h++) out[table.holes[h]] = 127;
+
+            modulator::demodulate(samples + s, samples_per_symbol, R, bits);
+            for(int t = 0; t < traits::cbps; t++) out[table.position[t]] = bits[t];
+        }
+    }
+
+    void soft_demapper::demap(const complex_t * samples, int sample_count, Rate rate, unsigned char * soft_bits)
+    {
+        typedef void demap_function(const complex_t * samples, int sample_count, unsigned char * soft_bits);
+        static demap_function * const demappers[11] =
+        {
+            demap_rate<RATE_1_2_BPSK>, demap_rate<RATE_2_3_BPSK>, demap_rate<RATE_3_4_BPSK>,
+            demap_rate<RATE_1_2_QPSK>, demap_rate<RATE_2_3_QPSK>, demap_rate<RATE_3_4_QPSK>,
+            demap_rate<RATE_1_2_QAM16>, demap_rate<RATE_2_3_QAM16>, demap_rate<RATE_3_4_QAM16>,
+            demap_rate<RATE_2_3_QAM64>, demap_rate<RATE_3_4_QAM64>,
+        };
+        demappers[rate](samples, sample_count, soft_bits);
+    }
+}
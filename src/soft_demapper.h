@@ -0,0 +1,51 @@
+/*! \file soft_demapper.h
+ *  \brief Header file for the soft_demapper class.
+ *
+ *  The soft_demapper fuses demodulation, deinterleaving and depuncturing into a
+ *  single pass that writes the soft bits straight into the viterbi decoder's input.
+ */
+
+#ifndef SOFT_DEMAPPER_H
+#define SOFT_DEMAPPER_H
+
+#include <complex>
+
+#include "rates.h"
+#include "precision.h"
+
+namespace fun
+{
+    /*!
+     * \brief The soft_demapper class
+     *
+     *  Equivalent to running modulator::demodulate, interleaver::deinterleave and
+     *  then puncturer::depuncture on the data but without any intermediate buffers.
+     *  Each demodulated soft bit is written directly to its final (deinterleaved and
+     *  depunctured) position using a table built once per PHY rate, and the puncture
+     *  holes are filled with 127 (i.e. no confidence either way).
+     */
+    class soft_demapper
+    {
+    public:
+
+        /*!
+         * \brief Number of soft bits written by #demap() for a given number of samples.
+         * \param sample_count Number of data subcarrier samples (a multiple of 48).
+         * \param rate The PHY rate of the samples.
+         * \return The number of depunctured soft bits (i.e. rate 1/2 coded bits).
+         */
+        static int soft_bit_count(int sample_count, Rate rate);
+
+        /*!
+         * \brief Demodulates, deinterleaves and depunctures the samples in one pass.
+         * \param samples The data subcarrier samples, 48 per OFDM symbol.
+         * \param sample_count Number of samples (a multiple of 48).
+         * \param rate The PHY rate of the samples.
+         * \param soft_bits Output buffer of at least #soft_bit_count() soft bits
+         *  ready to be passed to viterbi::conv_decode().
+         */
+        static void demap(const complex_t * samples, int sample_count, Rate rate, unsigned char * soft_bits);
+    };
+}
+
+#endif // SOFT_DEMAPPER_H
@@ -0,0 +1,98 @@
+/*! \file spsc_queue.h
+ *  \brief Template for a bounded lock-free single producer single consumer queue.
+ *
+ *  This queue is used to link the blocks of the receiver chain together when it
+ *  is running in streaming mode. Exactly one thread may push into the queue and
+ *  exactly one (other) thread may pop from it. Neither side ever takes a lock.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/*! \def CACHE_LINE_SIZE
+ *  \brief Size of a cache line in bytes.
+ *
+ *  Used to pad the producer and consumer indices onto separate cache lines
+ *  so that the two threads don't fight over the same line.
+ */
+#define CACHE_LINE_SIZE 64
+
+namespace fun
+{
+    /*!
+     * \brief The spsc_queue template.
+     *
+     * A bounded ring buffer of items of type T. The capacity is rounded up to the
+     * next power of 2 so the indices can be wrapped with a mask. The producer owns
+     * #m_tail and the consumer owns #m_head; each side only reads the other side's
+     * index with acquire semantics and publishes its own with release semantics.
+     */
+    template<typename T>
+    class spsc_queue
+    {
+    public:
+
+        /*!
+         * \brief Constructor for spsc_queue
+         * \param capacity The minimum number of items the queue can hold at once.
+         */
+        spsc_queue(size_t capacity) :
+            m_head(0),
+            m_tail(0)
+        {
+            size_t size = 1;
+            while(size < capacity) size <<= 1;
+            m_items.resize(size);
+            m_mask = size - 1;
+        }
+
+        /*!
+         * \brief Pushes an item into the queue. Must only be called by the producer.
+         * \param item The item to push. It is moved into the queue on success and
+         *  left untouched on failure.
+         * \return false if the queue is full.
+         */
+        bool push(T & item)
+        {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            if(tail - m_head.load(std::memory_order_acquire) > m_mask) return false;
+            m_items[tail & m_mask] = std::move(item);
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /*!
+         * \brief Pops an item from the queue. Must only be called by the consumer.
+         * \param item The popped item is moved into this parameter on success.
+         * \return false if the queue is empty.
+         */
+        bool pop(T & item)
+        {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            if(head == m_tail.load(std::memory_order_acquire)) return false;
+            item = std::move(m_items[head & m_mask]);
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+
+        std::vector<T> m_items; //!< Storage for the items in the queue
+
+        size_t m_mask; //!< Capacity - 1, used to wrap the indices
+
+        char m_pad0[CACHE_LINE_SIZE]; //!< Keeps #m_head off the cache line holding #m_items and #m_mask
+
+        std::atomic<size_t> m_head; //!< Index of the next item to pop (owned by the consumer)
+
+        char m_pad1[CACHE_LINE_SIZE]; //!< Keeps #m_tail off the cache line holding #m_head
+
+        std::atomic<size_t> m_tail; //!< Index of the next free slot (owned by the producer)
+    };
+}
+
+#endif // SPSC_QUEUE_H
@@ -35,7 +35,7 @@ namespace fun
      *  If the number of symbols is longer than 127 then the sequence just wraps back around to the
      *  beginning. The modulus (%) operator is very useful for achieving this effect.
      */
-    const double symbol_mapper::POLARITY[127] =
+    const real_t symbol_mapper::POLARITY[127] =
     {
              1, 1, 1, 1,-1,-1,-1, 1,-1,-1,-1,-1, 1, 1,-1, 1,
             -1,-1, 1, 1,-1, 1, 1,-1, 1, 1, 1, 1, 1, 1,-1, 1,
@@ -52,7 +52,7 @@ namespace fun
      * (1 + 0j) or (-1 + 0j).
      * Also, the first three pilots are always the same with the 4th pilot being inverted.
      */
-    const std::complex<double> symbol_mapper::PILOTS[4] =
+    const complex_t symbol_mapper::PILOTS[4] =
     {
         { 1, 0},
         { 1, 0},
@@ -78,14 +78,14 @@ namespace fun
      *  null subcarriers. The output is a vector of samples with each set of 64 samples constituting
      *  one symbol.
      */
-    std::vector<std::complex<double> > symbol_mapper::map(std::vector<std::complex<double> > data_samples)
+    std::vector<complex_t > symbol_mapper::map(std::vector<complex_t > data_samples)
     {
         assert(data_samples.size() % m_data_subcarrier_count == 0);
 
-        std::complex<double> pilot_value = std::complex<double>(1, 0);
-        std::complex<double> null_value = std::complex<double>(0, 0);
+        complex_t pilot_value = complex_t(1, 0);
+        complex_t null_value = complex_t(0, 0);
 
-        std::vector<std::complex<double> > samples(data_samples.size() * m_active_map.size() / m_data_subcarrier_count);
+        std::vector<complex_t > samples(data_samples.size() * m_active_map.size() / m_data_subcarrier_count);
         int out_index = 0, in_index = 0;
         int symbol_count = 0;
 
@@ -125,11 +125,11 @@ namespace fun
      *  so that we do not have partial symbols which wouldn't make sense. The output is simply a stream
      *  of received data however it will be an integer multiple of 48.
      */
-    std::vector<std::complex<double> > symbol_mapper::demap(std::vector<std::complex<double> > samples)
+    std::vector<complex_t > symbol_mapper::demap(std::vector<complex_t > samples)
     {
         assert(samples.size() % m_active_map.size() == 0);
 
-        std::vector<std::complex<double> > data_samples(samples.size() * m_data_subcarrier_count / m_active_map.size());
+        std::vector<complex_t > data_samples(samples.size() * m_data_subcarrier_count / m_active_map.size());
         int out_index = 0;
         for(int x = 0; x < samples.size(); x++)
         {
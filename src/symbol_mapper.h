@@ -12,6 +12,8 @@
 #include <vector>
 #include <complex>
 
+#include "precision.h"
+
 namespace fun
 {
     /*!
@@ -36,14 +38,14 @@ namespace fun
          * \param data_samples Vector of modulated data to be mapped into symbols
          * \return Vector of symbols with data, pilots, and nulls
          */
-        std::vector<std::complex<double> > map(std::vector<std::complex<double> > data_samples);
+        std::vector<complex_t > map(std::vector<complex_t > data_samples);
 
         /*!
          * \brief Extracts the data from the symbols throwing out the nulls and pilots
          * \param samples Vector of symbols to extract data from
          * \return Vector of data samples
          */
-        std::vector<std::complex<double> > demap(std::vector<std::complex<double> > samples);
+        std::vector<complex_t > demap(std::vector<complex_t > samples);
 
         /*!
          * \brief Gets the current active map of data, pilots, and nulls.
@@ -55,9 +57,9 @@ namespace fun
 
         static const std::vector<unsigned char> m_active_map; //!< The current map of data, pilots, and nulls.
 
-        static const double POLARITY[127]; //!< The Pilot Polarity Sequence
+        static const real_t POLARITY[127]; //!< The Pilot Polarity Sequence
 
-        static const std::complex<double> PILOTS[4]; //!< The 4 Pilot symbols
+        static const complex_t PILOTS[4]; //!< The 4 Pilot symbols
 
         int m_data_subcarrier_count; //!< Number of data subcarriers.
 
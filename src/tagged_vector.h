@@ -2,7 +2,7 @@
  *  \brief Header file for the tagged_vector template.
  *
  * This file contains the template classes for tagged vectors
- * and tagged samples that are used in the receiver chain's
+ * and the tags of sample streams that are used in the receiver chain's
  * input and output buffers.
  *
  */
@@ -14,6 +14,8 @@
 #include <complex>
 #include <assert.h>
 
+#include "precision.h"
+
 namespace fun
 {
     /*!
@@ -33,29 +35,82 @@ namespace fun
         START_OF_FRAME, //!< Estimated beginning of frame i.e. Signal symbol (64 samples after LTS2)
     };
 
+    /*!
+     * \brief The detection_quality struct holds how much a detected frame looks like a real one, measured
+     *  by each block on the way from the frame_detector to the frame_decoder.
+     *
+     * Each block fills in its own metric and passes the rest on along with the frame's tags, so the
+     * blocks further down see everything measured before them. 0 for a metric not measured (yet).
+     */
+    struct detection_quality
+    {
+        /*!
+         * \brief Mean normalized auto-correlation of the STS plateau (frame_detector), between
+         *  #PLATEAU_THRESHOLD & 1. Noise that just scrapes past the threshold stays near its bottom.
+         */
+        float plateau;
+
+        /*!
+         * \brief The weaker of the two paired LTS correlation peaks divided by the mean correlation over
+         *  the whole LTS search window (timing_sync). A real LTS stands well clear of its surroundings,
+         *  noise peaks hardly do.
+         */
+        float lts_ratio;
+
+        /*!
+         * \brief RMS error vector magnitude of the equalized SIGNAL symbol relative to the unit BPSK
+         *  constellation (frame_decoder). Noise equalized by a channel estimate made from noise comes
+         *  out around 1 or more, a decodable header well below.
+         */
+        float evm;
+
+        detection_quality() : plateau(0), lts_ratio(0), evm(0) {} //!< Constructor for an unmeasured frame
+    };
+
     /*! \brief tagged_vector struct
      *
      * An array of N complex doubles with a meta-data tag
      * Note: tagged_vector's are not meant to be resized
      *
+     * The struct is aligned so that its size is a whole number of samples. This
+     * lets a std::vector of tagged_vectors be treated as strided sample arrays
+     * (see fft::forward_batch()).
      */
     template<int N>
-    struct tagged_vector
+    struct alignas(16) tagged_vector
     {
 
-        std::complex<double> samples[N]; //!< The array of N complex doubles
+        complex_t samples[N]; //!< The array of N complex doubles
         vector_tag tag;                  //!< The array's tag
 
+        /*!
+         * \brief Signal to noise ratio (in dB) estimated from the frame's training symbols.
+         *  Only valid on the #START_OF_FRAME vector.
+         *
+         * This and #sample_index fit in the padding after #tag so they don't make the
+         * tagged_vector any bigger.
+         */
+        float snr;
+
+        /*!
+         * \brief Index of the frame's first sample (i.e. the start of the STS) in the stream of
+         *  samples passed to the receiver_chain. Only valid on the #LTS_START & #START_OF_FRAME vectors.
+         */
+        unsigned long long sample_index;
+
+        detection_quality quality; //!< The frame's detection metrics. Only valid on the #LTS_START & #START_OF_FRAME vectors.
+
         /*!
          * \brief Non-initializing constructor for tagged_vector.
          *
          * Does not initialize the elements of #samples to anything.
          * Initializes #tag to _tag defaulting to #NONE if left out.
+         * Initializes #snr & #sample_index to 0.
          *
          * \param _tag optional initial #tag value. Default is #NONE if left out.
          * Default is NONE if left out
          */
-        tagged_vector(vector_tag _tag = NONE) { tag = _tag; }
+        tagged_vector(vector_tag _tag = NONE) : snr(0), sample_index(0) { tag = _tag; }
 
         /*!
          * \brief Initializing constructor for tagged_vector
@@ -66,31 +121,45 @@ namespace fun
          * \param _samples initial samples to populate the elements of #samples with
          * \param _tag optional initial #tag value. Default is #NONE if left out.
          */
-        tagged_vector(std::vector<std::complex<double> > _samples, vector_tag _tag = NONE)
+        tagged_vector(std::vector<complex_t > _samples, vector_tag _tag = NONE) :
+            snr(0),
+            sample_index(0)
         {
             assert(_samples.size() == N);
-            memcpy(&samples[0], &_samples[0], _samples.size() * sizeof(std::complex<double>));
+            memcpy(&samples[0], &_samples[0], _samples.size() * sizeof(complex_t));
             tag = _tag;
         }
     };
 
     /*!
-     * \brief The tagged_sample struct
+     * \brief The stream_tag struct
      *
-     * A single complex double with a meta-data tag
+     * A tag on a single sample of a stream of samples. The blocks working on individual
+     * samples pass plain (contiguous) sample buffers and keep the tags, almost all of which
+     * would be #NONE, in a separate sparse list sorted by #offset (see block::input_tags).
      */
-    struct tagged_sample
+    struct stream_tag
     {
-        std::complex<double> sample; //!< The complex sample
-        vector_tag tag;              //!< The sample's tag
+        int offset;      //!< Index of the tagged sample in its buffer
+        vector_tag tag;  //!< The sample's tag
+
+        detection_quality quality; //!< The frame's detection metrics so far. Only valid on #STS_END & #LTS1 tags.
 
         /*!
-         * \brief Constructor for tagged_sample
-         *
-         * Does not initialize the sample to anything
-         * Initializes the tag to #NONE
+         * \brief Constructor for stream_tag
+         * \param _offset Index of the tagged sample in its buffer
+         * \param _tag The sample's tag
+         */
+        stream_tag(int _offset = 0, vector_tag _tag = NONE) : offset(_offset), tag(_tag) {}
+
+        /*!
+         * \brief Constructor for a stream_tag carrying detection metrics
+         * \param _offset Index of the tagged sample in its buffer
+         * \param _tag The sample's tag
+         * \param _quality The frame's detection metrics
          */
-        tagged_sample() { tag = NONE; }
+        stream_tag(int _offset, vector_tag _tag, const detection_quality & _quality) :
+            offset(_offset), tag(_tag), quality(_quality) {}
     };
 }
 
@@ -0,0 +1,62 @@
+/*! \file thread_config.cpp
+ *  \brief C++ file for the thread configuration helpers.
+ *
+ *  The thread_params struct describes how one of the library's threads should be scheduled
+ *  (which cores it may run on and whether it should use real time scheduling) and the
+ *  configure_thread() function applies that configuration to the calling thread.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+
+#include "thread_config.h"
+
+namespace fun
+{
+    /*!
+     * Thread names, affinity and SCHED_FIFO are Linux specific so on other platforms the
+     * name & cores are ignored. A failure to apply the affinity or priority is not fatal,
+     * the thread simply keeps running with the default scheduling.
+     */
+    bool configure_thread(std::string name, const thread_params & params)
+    {
+        bool success = true;
+
+#ifdef __linux__
+        // Name the thread (the kernel limit is 16 characters including the terminator)
+        pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+
+        // Pin the thread to its cores
+        if(!params.cpus.empty())
+        {
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            for(int x = 0; x < params.cpus.size(); x++) CPU_SET(params.cpus[x], &cpu_set);
+            int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+            if(error != 0)
+            {
+                std::cerr << "Unable to set the CPU affinity of thread " << name << ": " << strerror(error) << std::endl;
+                success = false;
+            }
+        }
+#endif
+
+        // Request real time scheduling
+        if(params.priority > 0)
+        {
+            sched_param sched;
+            memset(&sched, 0, sizeof(sched));
+            sched.sched_priority = params.priority;
+            int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sched);
+            if(error != 0)
+            {
+                std::cerr << "Unable to set SCHED_FIFO priority " << params.priority << " for thread " << name << ": " << strerror(error) << std::endl;
+                success = false;
+            }
+        }
+
+        return success;
+    }
+}
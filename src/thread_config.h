@@ -0,0 +1,55 @@
+/*! \file thread_config.h
+ *  \brief Header file for the thread configuration helpers.
+ *
+ *  The thread_params struct describes how one of the library's threads should be scheduled
+ *  (which cores it may run on and whether it should use real time scheduling) and the
+ *  configure_thread() function applies that configuration to the calling thread.
+ */
+
+#ifndef THREAD_CONFIG_H
+#define THREAD_CONFIG_H
+
+#include <string>
+#include <vector>
+
+namespace fun
+{
+    /*!
+     * \brief The thread_params struct holds the scheduling configuration of a single thread.
+     */
+    struct thread_params
+    {
+        /*!
+         * \brief The cores the thread may run on. Empty lets the OS schedule the thread anywhere.
+         */
+        std::vector<int> cpus;
+
+        /*!
+         * \brief SCHED_FIFO priority (1-99) for the thread. 0 keeps the default scheduling policy.
+         *
+         * Requesting real time scheduling usually requires root or the CAP_SYS_NICE capability.
+         */
+        int priority;
+
+        /*!
+         * \brief Constructor for thread_params.
+         * \param cpus -> #cpus
+         * \param priority -> #priority
+         */
+        thread_params(std::vector<int> cpus = std::vector<int>(), int priority = 0) :
+            cpus(cpus),
+            priority(priority)
+        {
+        }
+    };
+
+    /*!
+     * \brief Names the calling thread and applies the given scheduling configuration to it.
+     * \param name The thread's name as shown by profilers, top, gdb, etc. Truncated to 15 characters.
+     * \param params The scheduling configuration.
+     * \return false (after printing a warning) if the affinity or priority couldn't be applied.
+     */
+    bool configure_thread(std::string name, const thread_params & params = thread_params());
+}
+
+#endif // THREAD_CONFIG_H
@@ -14,24 +14,173 @@
 #include <iostream>
 
 #include "preamble.h"
+#include "frame_detector.h"
 
 namespace fun
 {
     /*!
      * - Initializations:
-     *   + #m_phase_acc -> 0.0
+     *   + #m_phasor -> (1+0j)
      *   + #m_phase_offset -> 0.0
-     *   + #m_carryover -> 160 blank tagged samples
+     *   + #m_peak_count -> #LTS_PEAK_COUNT
+     *   + #m_min_lts_ratio -> 0 (every paired LTS is passed on)
+     *   + #m_input -> 160 blank carried over samples
+     *   + #m_feedback -> feedback
      */
-    timing_sync::timing_sync() :
+    timing_sync::timing_sync(gate_feedback * feedback) :
         block("timing_sync"),
-        m_phase_acc(0),
+        m_peak_count(LTS_PEAK_COUNT),
+        m_min_lts_ratio(0),
+        m_rejected(0),
         m_phase_offset(0),
-        m_carryover(CARRYOVER_LENGTH, tagged_sample())
-    {}
+        m_input(CARRYOVER_LENGTH, complex_t(0, 0)),
+        m_feedback(feedback),
+        m_sample_count(0)
+    {
+        set_correction(0, 0);
+        for(int s = 0; s < LTS_LENGTH; s++)
+        {
+            m_lts_re[s] = LTS_TIME_DOMAIN_CONJ[s].real();
+            m_lts_im[s] = LTS_TIME_DOMAIN_CONJ[s].imag();
+        }
+    }
 
     int lts_count = 0;
 
+    /*!
+     * The count is clamped to the range that can be paired.
+     */
+    void timing_sync::set_peak_count(int count)
+    {
+        m_peak_count.store(std::max(2, std::min(count, LTS_PEAK_COUNT)), std::memory_order_relaxed);
+    }
+
+    /*!
+     * The correlation and power at every offset are accumulated tap by tap
+     * across all #LTS_SEARCH_LENGTH offsets at once so the inner loops vectorize
+     * (each offset still sums its taps in the same order). The peaks are then kept
+     * in a small sorted array instead of sorting every offset above the threshold.
+     */
+    int timing_sync::find_lts_peaks(const complex_t * window, std::pair<double, int> * peaks, int max_peaks, double & mean)
+    {
+        for(int p = 0; p < CARRYOVER_LENGTH; p++)
+        {
+            m_window_re[p] = window[p].real();
+            m_window_im[p] = window[p].imag();
+        }
+
+        real_t corr_re[LTS_SEARCH_LENGTH] = {0};
+        real_t corr_im[LTS_SEARCH_LENGTH] = {0};
+        real_t power[LTS_SEARCH_LENGTH] = {0};
+        for(int s = 0; s < LTS_LENGTH; s++)
+        {
+            const real_t lts_re = m_lts_re[s];
+            const real_t lts_im = m_lts_im[s];
+            const real_t * w_re = &m_window_re[s];
+            const real_t * w_im = &m_window_im[s];
+            for(int p = 0; p < LTS_SEARCH_LENGTH; p++)
+            {
+                corr_re[p] += w_re[p] * lts_re - w_im[p] * lts_im;
+                corr_im[p] += w_re[p] * lts_im + w_im[p] * lts_re;
+                power[p] += w_re[p] * w_re[p] + w_im[p] * w_im[p];
+            }
+        }
+
+        // Keep the strongest peaks, ties go to the later offset
+        int count = 0;
+        mean = 0;
+        for(int p = 0; p < LTS_SEARCH_LENGTH; p++)
+        {
+            double corr_norm = std::abs(complex_t(corr_re[p], corr_im[p])) / power[p];
+            if(corr_norm == corr_norm) mean += corr_norm / LTS_SEARCH_LENGTH;
+            if(!(corr_norm > LTS_CORR_THRESHOLD)) continue;
+
+            std::pair<double, int> peak(corr_norm, p);
+            if(count == max_peaks && !(peak > peaks[count - 1])) continue;
+            int k = (count < max_peaks) ? count++ : count - 1;
+            while(k > 0 && peak > peaks[k - 1])
+            {
+                peaks[k] = peaks[k - 1];
+                k--;
+            }
+            peaks[k] = peak;
+        }
+        return count;
+    }
+
+    /*!
+     * The steps within a block are computed directly so the only error that can build up is
+     * in the phasor carried from block to block, which is renormalized after every block.
+     */
+    void timing_sync::set_correction(double phase, double offset)
+    {
+        m_phase_offset = offset;
+        m_phasor = std::complex<double>(std::cos(phase), std::sin(phase));
+        for(int k = 0; k < NCO_BLOCK_LENGTH; k++)
+        {
+            m_step_re[k] = std::cos((k + 1) * offset);
+            m_step_im[k] = std::sin((k + 1) * offset);
+        }
+    }
+
+    /*!
+     * Instead of accumulating the phase and calling cos & sin for every sample the NCO's phasor
+     * is multiplied by the precomputed steps to get the correction for each of the next
+     * #NCO_BLOCK_LENGTH samples at once. Both loops are straight line complex multiplies over
+     * split arrays so they vectorize. The phasor is kept in double precision (even in the single
+     * precision build) so the frequency stays accurate over the longest frames.
+     */
+    void timing_sync::rotate(const complex_t * input, complex_t * output, int count)
+    {
+        const real_t * in = reinterpret_cast<const real_t *>(input);
+        real_t * out = reinterpret_cast<real_t *>(output);
+        for(int x = 0; x < count; x += NCO_BLOCK_LENGTH)
+        {
+            int n = std::min(NCO_BLOCK_LENGTH, count - x);
+            const double p_re = m_phasor.real();
+            const double p_im = m_phasor.imag();
+
+            real_t phase_re[NCO_BLOCK_LENGTH];
+            real_t phase_im[NCO_BLOCK_LENGTH];
+            for(int k = 0; k < NCO_BLOCK_LENGTH; k++)
+            {
+                phase_re[k] = p_re * m_step_re[k] - p_im * m_step_im[k];
+                phase_im[k] = p_re * m_step_im[k] + p_im * m_step_re[k];
+            }
+
+            const real_t * block_in = &in[2 * x];
+            real_t * block_out = &out[2 * x];
+            for(int k = 0; k < n; k++)
+            {
+                real_t re = block_in[2 * k];
+                real_t im = block_in[2 * k + 1];
+                block_out[2 * k] = re * phase_re[k] - im * phase_im[k];
+                block_out[2 * k + 1] = re * phase_im[k] + im * phase_re[k];
+            }
+
+            // Advance past the block & renormalize
+            m_phasor *= std::complex<double>(m_step_re[n - 1], m_step_im[n - 1]);
+            m_phasor /= std::abs(m_phasor);
+        }
+    }
+
+    /*!
+     * The tags are kept sorted and there are only ever a few of them so a linear search is fine.
+     */
+    void timing_sync::set_tag(int offset, vector_tag tag, int & current, const detection_quality & quality)
+    {
+        int t = 0;
+        while(t < m_input_tags.size() && m_input_tags[t].offset < offset) t++;
+        if(t < m_input_tags.size() && m_input_tags[t].offset == offset)
+        {
+            m_input_tags[t].tag = tag;
+            m_input_tags[t].quality = quality;
+            return;
+        }
+        m_input_tags.insert(m_input_tags.begin() + t, stream_tag(offset, tag, quality));
+        if(t <= current) current++;
+    }
+
     /*!
      * Once this block detects the #STS_END flag in the input samples it begins
      * correlating the input with the known #LTS_TIME_DOMAIN_CONJ samples to find
@@ -43,99 +192,117 @@ namespace fun
      * DFT it still works. This also aids in reliability in case the estimate of the
      * beginning of each symbol is slightly off.
      *
+     * The pair's detection_quality::lts_ratio is added to the metrics the #STS_END tag brought
+     * along and passed on with the #LTS1 tag, unless it is below the minimum in which case the
+     * frame is dropped right here as if no pair had been found.
+     *
      * This block also uses the two LTS symbols to calculate an intial frequency offset.
      * It then applies the offset correction to all subsequent samples until the next
      * frame is detected and a new estimation is calculated.
      *
+     * The output is delayed by #CARRYOVER_LENGTH samples so that the LTS search after an
+     * #STS_END near the end of the input can see the samples that follow it. Only the tags
+     * need to be looked at to find the #STS_END flags, the samples in between them are
+     * corrected straight into the output buffer.
      */
     void timing_sync::work()
     {
+        output_tags.clear();
+        if(input_buffer.size() == 0)
+        {
+            output_buffer.clear();
+            return;
+        }
+        int count = input_buffer.size();
+        output_buffer.resize(count);
 
-        if(input_buffer.size() == 0) return;
-        assert(input_buffer.size() > CARRYOVER_LENGTH);
-        output_buffer.resize(input_buffer.size());
-
-        std::vector<tagged_sample> input(input_buffer.size() + CARRYOVER_LENGTH);
+        // Append the input to the carried over samples & tags
+        m_input.insert(m_input.end(), input_buffer.begin(), input_buffer.end());
+        for(int t = 0; t < input_tags.size(); t++)
+        {
+            m_input_tags.push_back(stream_tag(input_tags[t].offset + CARRYOVER_LENGTH, input_tags[t].tag, input_tags[t].quality));
+        }
 
-        memcpy(&input[0],
-               &m_carryover[0],
-               CARRYOVER_LENGTH*sizeof(tagged_sample));
+        const int max_peaks = m_peak_count.load(std::memory_order_relaxed);
+        const float min_lts_ratio = m_min_lts_ratio.load(std::memory_order_relaxed);
+        int x = 0;
+        for(int t = 0; x < count; t++)
+        {
+            // Correct the samples up to the next STS_END (or the end of the output)
+            int end = count;
+            while(t < m_input_tags.size() && m_input_tags[t].tag != STS_END) t++;
+            if(t < m_input_tags.size()) end = std::min(m_input_tags[t].offset, count);
 
-        memcpy(&input[CARRYOVER_LENGTH],
-               &input_buffer[0],
-               input_buffer.size() * sizeof(tagged_sample));
+            if(end > x) rotate(&m_input[x], &output_buffer[x], end - x);
+            x = end;
+            if(x == count) break;
 
-        for(int x = 0; x < input.size() - CARRYOVER_LENGTH; x++)
-        {
             // End of STS found: Look for LTS peaks
-            if(input[x].tag == STS_END)
+            // Cross correlate against the LTS
+            std::pair<double, int> peaks[LTS_PEAK_COUNT];
+            double mean_corr;
+            int peak_count = find_lts_peaks(&m_input[x], peaks, max_peaks, mean_corr);
+            for(int k = 0; k < peak_count; k++) peaks[k].second += x;
+
+            // Look for two peaks, 64 samples apart
+            bool found = false;
+            bool tagged = false;
+            int jump = 5;
+            for(int s = 0; s < std::min(peak_count, 3) && !found; s+=jump)
             {
-                // Cross correlate against the LTS
-                std::vector<std::pair<double, int> > peaks;
-                for(int p = x; p < x + CARRYOVER_LENGTH - LTS_LENGTH; p++)
+                for(int u = s; u < std::min(peak_count, s+jump) && !found; u++)
                 {
-                    std::complex<double> corr(0, 0);
-                    double power = 0;
-                    for(int s = 0; s < 64; s++)
+                    if(std::abs(peaks[s].second - peaks[u].second) == 64)
                     {
-                        corr += input[p+s].sample * LTS_TIME_DOMAIN_CONJ[s] /* complex conjugate of LTS */;
-                        power += std::norm(input[p+s].sample);
-                    }
-                    double corr_norm = std::abs(corr) / power;
-                    if(corr_norm > LTS_CORR_THRESHOLD) peaks.push_back(std::pair<double, int>(corr_norm, p));
-                }
+                        // Determine the LTS offset
+                        found = true;
+                        int lts_offset = std::min(peaks[s].second, peaks[u].second) - 32; // Start of the LTS CP
+                        if(lts_offset < 0) break;
 
-                std::sort(peaks.begin(), peaks.end());
-                std::reverse(peaks.begin(), peaks.end());
+                        // Drop the frames whose LTS hardly stands out
+                        detection_quality quality = m_input_tags[t].quality;
+                        quality.lts_ratio = std::min(peaks[s].first, peaks[u].first) / std::max(mean_corr, 1e-30);
+                        if(quality.lts_ratio < min_lts_ratio)
+                        {
+                            m_rejected.fetch_add(1, std::memory_order_relaxed);
+                            break;
+                        }
 
-                // Look for two peaks, 64 samples apart
-                bool found = false;
-                int jump = 5;
-                for(int s = 0; s < std::min((int)peaks.size(), 3) && !found; s+=jump)
-                {
-                    for(int t = s; t < std::min((int)peaks.size(), s+jump) && !found; t++)
-                    {
-                        if(std::abs(peaks[s].second - peaks[t].second) == 64)
+                        set_tag(lts_offset+24, LTS1, t, quality); // First sample in the LTS
+                        set_tag(lts_offset+24+64, LTS2, t); // First sample in the LTS
+                        tagged = true;
+
+                        complex_t auto_corr_acc(0.0, 0.0);
+                        for(int k = LTS1; k < LTS1; k++)
                         {
-                            // Determine the LTS offset
-                            found = true;
-                            int lts_offset = std::min(peaks[s].second, peaks[t].second) - 32; // Start of the LTS CP
-                            if(lts_offset < 0) break;
-
-                            input[lts_offset+24].tag = LTS1; // First sample in the LTS
-                            input[lts_offset+24+64].tag = LTS2; // First sample in the LTS
-
-                            std::complex<double> auto_corr_acc(0.0, 0.0);
-                            for(int k = LTS1; k < LTS1; k++)
-                            {
-                                auto_corr_acc += input[k].sample * std::conj(input[k+LTS_LENGTH].sample);
-                            }
-
-                            m_phase_offset = std::arg(auto_corr_acc) / 64.0;
-                            m_phase_acc = std::arg(input[lts_offset + 32 + LTS_LENGTH*2 -1].sample * LTS_TIME_DOMAIN_CONJ[63]);
+                            auto_corr_acc += m_input[k] * std::conj(m_input[k+LTS_LENGTH]);
                         }
+
+                        set_correction(std::arg(m_input[lts_offset + 32 + LTS_LENGTH*2 -1] * LTS_TIME_DOMAIN_CONJ[63]),
+                                       std::arg(auto_corr_acc) / 64.0);
                     }
                 }
             }
 
-            m_phase_acc += m_phase_offset;
-            while(m_phase_acc > 2.0*M_PI) m_phase_acc -= 2.0*M_PI;
-            while(m_phase_acc < -2.0*M_PI) m_phase_acc += 2.0*M_PI;
-            std::complex<double> phase_correction(std::cos(m_phase_acc), std::sin(m_phase_acc));
-            input[x].sample *= phase_correction;
+            // Let a gated frame_detector close its gate early when there's no frame here
+            if(!tagged && m_feedback != NULL)
+            {
+                unsigned long long sts_end = m_sample_count + x - CARRYOVER_LENGTH;
+                m_feedback->no_lts.push(sts_end);
+            }
 
+            // The STS_END sample itself is corrected with the new estimate
+            rotate(&m_input[x], &output_buffer[x], 1);
+            x++;
         }
 
-        // Copy working samples to output
-        memcpy(&output_buffer[0],
-               &input[0],
-               input_buffer.size() * sizeof(tagged_sample));
-
-        // Carryover last 160 samples from input buffer
-        memcpy(&m_carryover[0],
-               &input[input_buffer.size()],
-               CARRYOVER_LENGTH * sizeof(tagged_sample));
-
+        // Output the tags on the corrected samples & carry the rest over with the last 160 samples
+        int t = 0;
+        for(; t < m_input_tags.size() && m_input_tags[t].offset < count; t++) output_tags.push_back(m_input_tags[t]);
+        m_input_tags.erase(m_input_tags.begin(), m_input_tags.begin() + t);
+        for(t = 0; t < m_input_tags.size(); t++) m_input_tags[t].offset -= count;
+        m_input.erase(m_input.begin(), m_input.begin() + count);
+        m_sample_count += count;
     }
 
 
@@ -12,43 +12,143 @@
 #define LTS_CORR_THRESHOLD 0.9
 #define CARRYOVER_LENGTH 160
 #define LTS_LENGTH 64
+#define LTS_SEARCH_LENGTH (CARRYOVER_LENGTH - LTS_LENGTH) //!< Number of offsets searched for the LTS after each STS_END
+#define LTS_PEAK_COUNT 5 //!< Number of strongest LTS correlation peaks considered when pairing peaks
+#define NCO_BLOCK_LENGTH 16 //!< Number of samples the frequency correction NCO advances by between renormalizations
 
 #include <complex>
+#include <utility>
+#include <atomic>
 
 #include "block.h"
 #include "tagged_vector.h"
 
 namespace fun
 {
+    struct gate_feedback;
+
     /*!
      * \brief The timing_sync block.
      *
-     * Inputs tagged samples from the frame_detector block.
-     * Outputs tagged samples to the fft_symbols block.
+     * Inputs samples & their tags from the frame_detector block.
+     * Outputs samples & their #LTS1 / #LTS2 tags (along with the input tags) to the fft_symbols block.
      *
      * The timing sync block is in charge of using the two LTS symbols to align the received frame in time.
      * It also uses the two LTS symbols to perform an initial frequency offset estimation and
      * applying the necessary correction.
      */
-    class timing_sync : public fun::block<tagged_sample, tagged_sample>
+    class timing_sync : public fun::block<complex_t, complex_t>
     {
     public:
 
-        timing_sync(); //!< Constructor for timing_sync block.
+        /*!
+         * \brief Constructor for timing_sync block.
+         * \param feedback [Optional] The gate_feedback of the gated frame_detector upstream, every
+         *  #STS_END no LTS is found after is reported to it.
+         */
+        timing_sync(gate_feedback * feedback = NULL);
 
         virtual void work(); //!< Signal processing happens here.
 
+        /*!
+         * \brief Sets how many of the strongest LTS correlation peaks are paired after each #STS_END.
+         * \param count Number of peaks, between 2 and #LTS_PEAK_COUNT (the default)
+         *
+         * Fewer peaks make each LTS search cheaper at the cost of missing the LTS when a stronger
+         * spurious peak crowds it out. Can be called from any thread, it applies from the next call to work().
+         */
+        void set_peak_count(int count);
+
+        /*!
+         * \brief Sets the lowest detection_quality::lts_ratio of an LTS that is passed on as a frame.
+         * \param ratio Frames whose paired LTS peaks are below it get no #LTS1 / #LTS2 tags, so no symbols
+         *  are ever made of them. 0 (the default) passes every paired LTS on.
+         *
+         * Can be called from any thread, it applies from the next call to work().
+         */
+        void set_min_lts_ratio(float ratio) { m_min_lts_ratio.store(ratio, std::memory_order_relaxed); }
+
+        /*!
+         * \brief Number of frames rejected because of set_min_lts_ratio(). Can be called from any thread.
+         */
+        unsigned long long rejected() const { return m_rejected.load(std::memory_order_relaxed); }
+
     private:
 
-        double m_phase_offset; //!< The phase rotation from symbol to symbol
+        /*!
+         * \brief Cross correlates the samples following an #STS_END tag with the LTS.
+         * \param window The first of the #CARRYOVER_LENGTH samples to search.
+         * \param peaks Output array of at least #LTS_PEAK_COUNT (correlation, offset) pairs.
+         * \param max_peaks Most peaks to keep (at most #LTS_PEAK_COUNT).
+         * \param mean Set to the mean normalized correlation over all #LTS_SEARCH_LENGTH offsets.
+         * \return The number of peaks found (at most max_peaks).
+         *
+         * Only the max_peaks strongest peaks above #LTS_CORR_THRESHOLD are kept
+         * sorted from strongest to weakest; offsets are relative to window.
+         */
+        int find_lts_peaks(const complex_t * window, std::pair<double, int> * peaks, int max_peaks, double & mean);
+
+        /*!
+         * \brief Tags a sample of #m_input, replacing any tag it already has.
+         * \param offset Index of the sample in #m_input
+         * \param tag The tag
+         * \param current Index of a tag in #m_input_tags, updated so it still refers to the same tag
+         * \param quality The frame's detection metrics carried by the tag
+         */
+        void set_tag(int offset, vector_tag tag, int & current, const detection_quality & quality = detection_quality());
+
+        std::atomic<int> m_peak_count; //!< Number of LTS peaks paired (see set_peak_count())
+
+        std::atomic<float> m_min_lts_ratio; //!< See set_min_lts_ratio()
 
-        double m_phase_acc; //!< The total phase rotation for the current symbol
+        std::atomic<unsigned long long> m_rejected; //!< See rejected()
+
+        real_t m_lts_re[LTS_LENGTH]; //!< Real parts of #LTS_TIME_DOMAIN_CONJ
+
+        real_t m_lts_im[LTS_LENGTH]; //!< Imaginary parts of #LTS_TIME_DOMAIN_CONJ
+
+        real_t m_window_re[CARRYOVER_LENGTH]; //!< Real parts of the samples being searched for the LTS
+
+        real_t m_window_im[CARRYOVER_LENGTH]; //!< Imaginary parts of the samples being searched for the LTS
+
+        /*!
+         * \brief Applies the frequency correction to the samples and advances the NCO past them.
+         * \param input The samples to correct
+         * \param output Where the corrected samples are written (may be input)
+         * \param count Number of samples
+         */
+        void rotate(const complex_t * input, complex_t * output, int count);
 
         /*!
-         * \brief Vector for storing the last 160 samples from the input_buffer
-         * and carrying them over to the next call to #work()
+         * \brief Sets the phase of the NCO and the phase rotation from sample to sample.
+         * \param phase The phase of the correction applied to the sample before the next one
+         * \param offset The phase rotation from sample to sample
          */
-        std::vector<tagged_sample> m_carryover;
+        void set_correction(double phase, double offset);
+
+        double m_phase_offset; //!< The phase rotation from sample to sample
+
+        std::complex<double> m_phasor; //!< The NCO: the unit phasor of the correction applied to the last sample
+
+        double m_step_re[NCO_BLOCK_LENGTH]; //!< cos((k + 1) * #m_phase_offset), the NCO's steps within a block
+
+        double m_step_im[NCO_BLOCK_LENGTH]; //!< sin((k + 1) * #m_phase_offset), the NCO's steps within a block
+
+        /*!
+         * \brief The samples being worked on: the last 160 samples from the previous
+         * call to #work() followed by the input_buffer.
+         */
+        std::vector<complex_t > m_input;
+
+        /*!
+         * \brief The tags on #m_input, the first ones being the tags carried over
+         * with the last 160 samples.
+         */
+        std::vector<stream_tag> m_input_tags;
+
+        gate_feedback * m_feedback; //!< Where the #STS_ENDs without an LTS are reported (or NULL)
+
+        unsigned long long m_sample_count; //!< Number of samples input before the current call to #work()
     };
 }
 
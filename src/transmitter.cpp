@@ -6,6 +6,8 @@
  */
 
 #include "transmitter.h"
+#include "ppdu.h"
+#include "thread_config.h"
 
 namespace fun {
 
@@ -13,27 +15,250 @@ namespace fun {
      *  This constructor shows exactly what parameters need to be set for the transmitter
      */
     transmitter::transmitter(double freq, double samp_rate, double tx_gain, double tx_amp, std::string device_addr) :
-        m_usrp(usrp_params(freq, samp_rate, tx_gain, 20, tx_amp, device_addr)),
-        m_frame_builder()
+        transmitter(usrp_params(freq, samp_rate, tx_gain, 20, tx_amp, device_addr))
     {
     }
 
     /*!
      * This construct is for those who feel more comfortable using the usrp_params struct
+     *
+     * The asynchronous transmit queue is left empty until the first frame is queued (see start_async()).
      */
-    transmitter::transmitter(usrp_params params) :
+    transmitter::transmitter(usrp_params params, transmitter_params tx_params) :
+        m_tx_params(tx_params),
+        m_tx_amp(params.tx_amp),
+        m_queue(new tx_queue()),
+        m_async_builder(tx_params.frame_cache, 0, tx_params.fft_impl),
         m_usrp(params),
-        m_frame_builder()
+        m_frame_builder(tx_params.frame_cache, 0, tx_params.fft_impl)
     {
+        m_frame.reserve(frame_builder::frame_length(MAX_FRAME_SIZE, RATE_1_2_BPSK));
+        m_frame.resize(PREAMBLE_LENGTH);
+        frame_builder::write_preamble(m_frame.data());
+
+        m_queue->in_flight = 0;
+        m_queue->dropped = 0;
+        m_queue->stop = false;
+        m_queue->started = false;
+    }
+
+    transmitter::~transmitter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_queue->mutex);
+            m_queue->stop = true;
+        }
+        m_queue->cond.notify_all();
+        if(m_queue->builder_thread.joinable()) m_queue->builder_thread.join();
+        if(m_queue->sender_thread.joinable()) m_queue->sender_thread.join();
+
+        for(int x = 0; x < m_queue->free_buffers.size(); x++) delete m_queue->free_buffers[x];
+        for(int x = 0; x < m_queue->ready_buffers.size(); x++) delete m_queue->ready_buffers[x];
+        delete m_queue;
     }
 
     /*!
      *  Transmits a single frame, blocking until the frame is sent.
+     *  The frame is built in #m_frame which never shrinks below the preamble so the
+     *  preamble only has to be written once. Any frames queued by send_frame_async()
+     *  are sent first so frames always go out in order.
      */
     void transmitter::send_frame(std::vector<unsigned char> payload, Rate phy_rate)
     {
-        std::vector<std::complex<double> > samples = m_frame_builder.build_frame(payload, phy_rate);
-        m_usrp.send_burst_sync(samples);
+        flush();
+        m_frame.resize(frame_builder::frame_length(payload.size(), phy_rate));
+        m_frame_builder.build_frame(payload.data(), payload.size(), phy_rate, m_frame.data(), true);
+        m_usrp.send_burst_sync(m_frame);
+    }
+
+    /*!
+     * The payload is swapped into a spare job so that in steady state queueing a frame
+     * doesn't allocate.
+     */
+    bool transmitter::send_frame_async(std::vector<unsigned char> payload, Rate phy_rate)
+    {
+        std::unique_lock<std::mutex> lock(m_queue->mutex);
+        if(!m_queue->started) start_async();
+        bool queued = queue_job(lock, payload, phy_rate);
+        lock.unlock();
+
+        if(queued) m_queue->cond.notify_all();
+        return queued;
+    }
+
+    /*!
+     * The whole batch is queued under one lock and the builder thread is only woken once,
+     * so a burst of small packets costs one handoff instead of one per packet.
+     */
+    int transmitter::send_frames_async(std::vector<std::vector<unsigned char> > & payloads, Rate phy_rate)
+    {
+        int queued = 0;
+        std::unique_lock<std::mutex> lock(m_queue->mutex);
+        if(!m_queue->started) start_async();
+        for(int x = 0; x < payloads.size(); x++)
+        {
+            if(queue_job(lock, payloads[x], phy_rate)) queued++;
+        }
+        lock.unlock();
+
+        if(queued) m_queue->cond.notify_all();
+        return queued;
+    }
+
+    /*!
+     * Applies the queue policy if the queue is full. With #TX_QUEUE_BLOCK this waits on the
+     * lock, waking the builder thread first so it can make room for the rest of a batch.
+     */
+    bool transmitter::queue_job(std::unique_lock<std::mutex> & lock, std::vector<unsigned char> & payload, Rate phy_rate)
+    {
+        int depth = std::max(m_tx_params.queue_depth, 1);
+        if(m_queue->jobs.size() >= depth)
+        {
+            switch(m_tx_params.policy)
+            {
+                case TX_QUEUE_BLOCK:
+                    m_queue->cond.notify_all();
+                    while(m_queue->jobs.size() >= depth) m_queue->cond.wait(lock);
+                    break;
+
+                case TX_QUEUE_DROP_NEWEST:
+                    m_queue->dropped++;
+                    return false;
+
+                case TX_QUEUE_DROP_OLDEST:
+                    m_queue->spare_jobs.push_back(tx_job());
+                    m_queue->spare_jobs.back().payload.swap(m_queue->jobs.front().payload);
+                    m_queue->jobs.pop_front();
+                    m_queue->in_flight--;
+                    m_queue->dropped++;
+                    break;
+            }
+        }
+
+        m_queue->jobs.push_back(tx_job());
+        if(!m_queue->spare_jobs.empty())
+        {
+            m_queue->jobs.back().payload.swap(m_queue->spare_jobs.back().payload);
+            m_queue->spare_jobs.pop_back();
+        }
+        m_queue->jobs.back().payload.swap(payload);
+        m_queue->jobs.back().rate = phy_rate;
+        m_queue->in_flight++;
+        return true;
+    }
+
+    /*!
+     * Allocates the #TX_BUFFER_COUNT frame buffers (with the preamble already written unless
+     * the frames have to be scaled in place, and room for the longest frame in sc16 if the
+     * USRP takes sc16). The threads wait on the lock the caller holds before they touch the queue.
+     */
+    void transmitter::start_async()
+    {
+        for(int x = 0; x < TX_BUFFER_COUNT; x++)
+        {
+            tx_buffer * buffer = new tx_buffer();
+            buffer->frame.reserve(m_frame.capacity());
+            buffer->frame.resize(PREAMBLE_LENGTH);
+            frame_builder::write_preamble(buffer->frame.data());
+            if(m_usrp.tx_sc16()) buffer->wire.reserve(m_frame.capacity());
+            m_queue->free_buffers.push_back(buffer);
+        }
+
+        m_queue->builder_thread = std::thread(&transmitter::builder_loop, this);
+        m_queue->sender_thread = std::thread(&transmitter::sender_loop, this);
+        m_queue->started = true;
+    }
+
+    void transmitter::flush()
+    {
+        std::unique_lock<std::mutex> lock(m_queue->mutex);
+        while(m_queue->in_flight > 0) m_queue->cond.wait(lock);
+    }
+
+    unsigned long long transmitter::get_dropped_frames()
+    {
+        std::lock_guard<std::mutex> lock(m_queue->mutex);
+        return m_queue->dropped;
+    }
+
+    /*!
+     * Waits for both a queued payload and a free frame buffer, then builds the frame outside
+     * of the lock so the sender thread can keep sending the previous frame in the meantime.
+     * Frames are scaled by the usrp's tx_amp here since the sender sends them as is. If the
+     * USRP takes sc16 the scaling is folded into the conversion to sc16 instead, which leaves
+     * the frame (and its preamble) untouched.
+     */
+    void transmitter::builder_loop()
+    {
+        configure_thread("fun_tx_build");
+        tx_job job;
+        while(true)
+        {
+            tx_buffer * buffer;
+            {
+                std::unique_lock<std::mutex> lock(m_queue->mutex);
+                while(!m_queue->stop && (m_queue->jobs.empty() || m_queue->free_buffers.empty())) m_queue->cond.wait(lock);
+                if(m_queue->stop) return;
+                job.payload.swap(m_queue->jobs.front().payload);
+                job.rate = m_queue->jobs.front().rate;
+                m_queue->jobs.pop_front();
+                buffer = m_queue->free_buffers.back();
+                m_queue->free_buffers.pop_back();
+            }
+            m_queue->cond.notify_all(); // There is room in the queue again
+
+            std::vector<complex_t > & frame = buffer->frame;
+            bool scale_in_place = m_tx_amp != 1.0 && !m_usrp.tx_sc16();
+            frame.resize(frame_builder::frame_length(job.payload.size(), job.rate));
+            m_async_builder.build_frame(job.payload.data(), job.payload.size(), job.rate, frame.data(), !scale_in_place);
+            if(m_usrp.tx_sc16())
+            {
+                buffer->wire.resize(frame.size());
+                usrp::to_sc16(frame.data(), frame.size(), m_tx_amp, buffer->wire.data());
+            }
+            else if(scale_in_place)
+            {
+                for(int x = 0; x < frame.size(); x++) frame[x] *= m_tx_amp;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_queue->mutex);
+                m_queue->ready_buffers.push_back(buffer);
+                m_queue->spare_jobs.push_back(tx_job());
+                m_queue->spare_jobs.back().payload.swap(job.payload);
+            }
+            m_queue->cond.notify_all();
+        }
+    }
+
+    /*!
+     * Sends the built frames in order straight from their frame buffers and hands each buffer
+     * back to the builder thread once the USRP has accepted the samples.
+     */
+    void transmitter::sender_loop()
+    {
+        configure_thread("fun_tx_send");
+        while(true)
+        {
+            tx_buffer * buffer;
+            {
+                std::unique_lock<std::mutex> lock(m_queue->mutex);
+                while(!m_queue->stop && m_queue->ready_buffers.empty()) m_queue->cond.wait(lock);
+                if(m_queue->stop) return;
+                buffer = m_queue->ready_buffers.front();
+                m_queue->ready_buffers.pop_front();
+            }
+
+            if(m_usrp.tx_sc16()) m_usrp.send_burst(buffer->wire.data(), buffer->wire.size());
+            else m_usrp.send_burst(buffer->frame.data(), buffer->frame.size());
+
+            {
+                std::lock_guard<std::mutex> lock(m_queue->mutex);
+                m_queue->free_buffers.push_back(buffer);
+                m_queue->in_flight--;
+            }
+            m_queue->cond.notify_all();
+        }
     }
 
 }
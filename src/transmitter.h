@@ -10,12 +10,75 @@
 #define TRANSMITTER_H
 
 #include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "usrp.h"
 #include "rates.h"
 #include "frame_builder.h"
 
+/*! \def TX_BUFFER_COUNT
+ *  \brief Number of frame buffers shared by the transmitter's builder and sender threads.
+ *
+ *  With 2 buffers the builder thread builds the next frame while the previous one is sent.
+ */
+#define TX_BUFFER_COUNT 2
+
 namespace fun {
 
+    /*!
+     * \brief What transmitter::send_frame_async() does when the transmit queue is full.
+     */
+    enum tx_queue_policy
+    {
+        TX_QUEUE_BLOCK = 0,         //!< Wait for room in the queue (back pressure on the caller)
+        TX_QUEUE_DROP_NEWEST,       //!< Drop the new frame
+        TX_QUEUE_DROP_OLDEST,       //!< Drop the oldest frame that hasn't been built yet
+    };
+
+    /*!
+     * \brief The transmitter_params struct holds the configuration of the transmitter's
+     *  asynchronous transmit queue.
+     */
+    struct transmitter_params
+    {
+        /*!
+         * \brief Maximum number of payloads waiting to be built into frames by
+         *  transmitter::send_frame_async(). Frames that are built and waiting to be sent
+         *  (up to #TX_BUFFER_COUNT) are not counted.
+         */
+        int queue_depth;
+
+        tx_queue_policy policy; //!< What to do with a new frame when the queue is full
+
+        fft_backend fft_impl; //!< Implementation of the IFFT in the frame builders (see fft_backend)
+
+        /*!
+         * \brief Number of encoded frames each frame builder keeps in its frame cache (see frame_builder()).
+         *
+         * 0 turns the cache off, set it (i.e. to #FRAME_CACHE_SIZE) when the same payloads such as
+         * beacons or ACKs are sent over and over.
+         */
+        int frame_cache;
+
+        /*!
+         * \brief Constructor for transmitter_params.
+         * \param queue_depth -> #queue_depth
+         * \param policy -> #policy
+         * \param fft_impl -> #fft_impl
+         * \param frame_cache -> #frame_cache
+         */
+        transmitter_params(int queue_depth = 16, tx_queue_policy policy = TX_QUEUE_BLOCK, fft_backend fft_impl = FFT_BACKEND_FFTW,
+                           int frame_cache = 0) :
+            queue_depth(queue_depth),
+            policy(policy),
+            fft_impl(fft_impl),
+            frame_cache(frame_cache)
+        {
+        }
+    };
+
     /*!
      * \brief The transmitter class is the public interface for the fun_ofdm transmit chain.
      *  This is the easiest way to start transmitting 802.11a OFDM frames out of the box.
@@ -24,6 +87,10 @@ namespace fun {
      *  sample rate, transmitter gain, and amplitude). Then to send a packet simply call
      *  the transmitter::send_frame() function passing it the desired packet to be transmitted
      *  and the desired Physical Layer rate (PHY Rate) to transmit it.
+     *
+     *  For bulk transfers use transmitter::send_frame_async() instead which queues the packet
+     *  and returns immediately. A builder thread builds the queued frames ahead of time while
+     *  a sender thread streams the finished frames to the USRP back to back.
      */
     class transmitter
     {
@@ -51,6 +118,7 @@ namespace fun {
         /*!
          * \brief Constructor for the transmitter that uses the usrp_params struct
          * \param params [Optional] The usrp parameters you want to use for this transmitter
+         * \param tx_params [Optional] The configuration of the asynchronous transmit queue
          *
          *  Defaults to:
          *  - center freq -> 5.72e9 (5.72 GHz)
@@ -60,7 +128,12 @@ namespace fun {
          *  - device ip address -> "" (empty string will default to letting the UHD api
          *    automatically find an available USRP)
          */
-        transmitter(usrp_params params = usrp_params());
+        transmitter(usrp_params params = usrp_params(), transmitter_params tx_params = transmitter_params());
+
+        /*!
+         * \brief Destructor for the transmitter. Frames still in the transmit queue are discarded.
+         */
+        ~transmitter();
 
         /*!
          * \brief Send a single PHY frame at the given PHY Rate
@@ -72,12 +145,117 @@ namespace fun {
          */
         void send_frame(std::vector<unsigned char> payload, Rate phy_rate = RATE_1_2_BPSK);
 
+        /*!
+         * \brief Queue a single PHY frame to be sent at the given PHY Rate
+         * \param payload The data to be transmitted (i.e. the MPDU)
+         * \param phy_rate [Optional] The PHY data rate to transmit at - defaults to 1/2 BPSK
+         * \return false if the frame was dropped because the queue was full and the
+         *  queue policy is #TX_QUEUE_DROP_NEWEST, true otherwise.
+         *
+         *  This function returns as soon as the frame is queued (see transmitter_params for
+         *  what happens when the queue is full). Frames are sent in the order they are queued.
+         */
+        bool send_frame_async(std::vector<unsigned char> payload, Rate phy_rate = RATE_1_2_BPSK);
+
+        /*!
+         * \brief Queue a batch of PHY frames to be sent at the given PHY Rate
+         * \param payloads The data to be transmitted, one MPDU per frame. Each payload is swapped
+         *  with an empty buffer from the queue's spares so the caller can reuse the buffers
+         *  for the next batch without allocating.
+         * \param phy_rate [Optional] The PHY data rate to transmit at - defaults to 1/2 BPSK
+         * \return The number of frames queued, i.e. all of them except those dropped by the
+         *  #TX_QUEUE_DROP_NEWEST policy.
+         *
+         *  Same as calling send_frame_async() for every payload but takes the queue's lock once
+         *  for the whole batch (see transmitter_params for what happens when the queue is full).
+         */
+        int send_frames_async(std::vector<std::vector<unsigned char> > & payloads, Rate phy_rate = RATE_1_2_BPSK);
+
+        /*!
+         * \brief Blocks until every frame queued by send_frame_async() has been sent.
+         */
+        void flush();
+
+        /*!
+         * \brief Gets the number of frames dropped because the transmit queue was full.
+         */
+        unsigned long long get_dropped_frames();
+
     private:
 
+        /*!
+         * \brief A payload waiting to be built into a frame.
+         */
+        struct tx_job
+        {
+            std::vector<unsigned char> payload; //!< The payload
+            Rate rate;                          //!< The PHY rate
+        };
+
+        /*!
+         * \brief A frame buffer of the asynchronous transmit queue.
+         */
+        struct tx_buffer
+        {
+            std::vector<complex_t > frame;              //!< The built frame (with the preamble already written unless it is scaled in place)
+            std::vector<std::complex<short> > wire;     //!< The frame converted to sc16 & scaled (only for usrp_params::tx_sc16)
+        };
+
+        /*!
+         * \brief The state of the asynchronous transmit queue, shared by the builder and sender threads.
+         *
+         * Every queue is protected by #mutex. A frame buffer is always either in #free_buffers,
+         * being built, in #ready_buffers or being sent.
+         */
+        struct tx_queue
+        {
+            std::mutex mutex;                                   //!< Protects everything below
+            std::condition_variable cond;                       //!< Signalled whenever anything below changes
+            std::deque<tx_job> jobs;                            //!< Payloads waiting to be built
+            std::vector<tx_job> spare_jobs;                     //!< Used jobs whose payload buffers can be reused
+            std::vector<tx_buffer *> free_buffers;              //!< Frame buffers ready to be built into
+            std::deque<tx_buffer *> ready_buffers;              //!< Built frames waiting to be sent
+            int in_flight;                                      //!< Frames queued but not yet sent
+            unsigned long long dropped;                         //!< Frames dropped because the queue was full
+            bool stop;                                          //!< Tells the threads to exit
+            bool started;                                       //!< Whether start_async() has been called
+            std::thread builder_thread;                         //!< Runs builder_loop()
+            std::thread sender_thread;                          //!< Runs sender_loop()
+        };
+
+        /*!
+         * \brief Queues one payload according to the queue policy. The caller holds the queue's lock.
+         * \param lock The held lock on tx_queue::mutex (waited on with #TX_QUEUE_BLOCK)
+         * \param payload The payload, swapped with a spare buffer
+         * \param phy_rate The PHY rate
+         * \return false if the payload was dropped
+         */
+        bool queue_job(std::unique_lock<std::mutex> & lock, std::vector<unsigned char> & payload, Rate phy_rate);
+
+        /*!
+         * \brief Allocates the frame buffers and starts the builder & sender threads the first time
+         *  a frame is queued, so a transmitter that only calls send_frame() never starts them.
+         *  The caller holds the queue's lock.
+         */
+        void start_async();
+
+        void builder_loop(); //!< Builds queued payloads into frames
+        void sender_loop(); //!< Sends built frames to the USRP
+
+        transmitter_params m_tx_params; //!< The configuration of the asynchronous transmit queue
+
+        double m_tx_amp; //!< Scale factor applied to the frames built by the builder thread
+
+        tx_queue * m_queue; //!< The asynchronous transmit queue
+
+        frame_builder m_async_builder; //!< The frame builder used by the builder thread
+
         usrp m_usrp; //!< The usrp object used to send the generated frames over the air
 
         frame_builder m_frame_builder; //!< The frame builder object used to generate the frames
 
+        std::vector<complex_t > m_frame; //!< Frame buffer reused for every frame, the preamble is written once
+
     };
 
 }
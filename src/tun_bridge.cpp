@@ -0,0 +1,234 @@
+/*! \file tun_bridge.cpp
+ *  \brief C++ file for the tun_bridge class.
+ *
+ *  The tun_bridge connects a TUN/TAP network interface to fun_ofdm: packets the kernel routes
+ *  to the interface are read in batches and queued on a transmitter, and packets from a
+ *  receiver are written back to the interface from a bounded queue.
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+
+#include "tun_bridge.h"
+
+/*! \def TUN_POLL_TIMEOUT_MS
+ *  \brief How often in milliseconds the reader thread checks whether the bridge is stopping while the interface is idle.
+ */
+#define TUN_POLL_TIMEOUT_MS 100
+
+namespace fun
+{
+    /*!
+     * - Initializations:
+     *   + #m_tx -> tx
+     *   + #m_params -> params
+     *   + #m_fd -> The interface opened non-blocking without the packet information header (-1 if that fails)
+     *
+     * The threads are only started if the interface could be opened.
+     */
+    tun_bridge::tun_bridge(transmitter * tx, tun_bridge_params params) :
+        m_tx(tx),
+        m_params(params),
+        m_fd(-1),
+        m_stats(tun_bridge_stats()),
+        m_stop(false)
+    {
+        int fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+        if(fd < 0)
+        {
+            std::cerr << "tun_bridge: couldn't open /dev/net/tun (" << strerror(errno) << ")" << std::endl;
+            return;
+        }
+
+        struct ifreq ifr;
+        memset(&ifr, 0, sizeof(ifr));
+        ifr.ifr_flags = (m_params.tap ? IFF_TAP : IFF_TUN) | IFF_NO_PI;
+        strncpy(ifr.ifr_name, m_params.name.c_str(), IFNAMSIZ - 1);
+        if(ioctl(fd, TUNSETIFF, &ifr) != 0)
+        {
+            std::cerr << "tun_bridge: couldn't attach to " << m_params.name << " (" << strerror(errno) << ")" << std::endl;
+            close(fd);
+            return;
+        }
+
+        m_fd = fd;
+        m_name = ifr.ifr_name;
+        m_reader_thread = std::thread(&tun_bridge::reader_loop, this);
+        m_writer_thread = std::thread(&tun_bridge::writer_loop, this);
+    }
+
+    tun_bridge::~tun_bridge()
+    {
+        if(m_fd < 0) return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        m_reader_thread.join();
+        m_writer_thread.join();
+
+        for(int x = 0; x < m_rx_queue.size(); x++) m_rx_queue[x].pool->release(m_rx_queue[x].pkt);
+        close(m_fd);
+    }
+
+    int tun_bridge::write_packets(const std::vector<packet *> & packets, packet_pool & pool)
+    {
+        int queued = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            int depth = std::max(m_params.queue_depth, 1);
+            for(int x = 0; x < packets.size(); x++)
+            {
+                if(m_fd < 0 || m_rx_queue.size() >= depth)
+                {
+                    pool.release(packets[x]);
+                    m_stats.rx_dropped++;
+                    continue;
+                }
+                rx_entry entry = {packets[x], &pool};
+                m_rx_queue.push_back(entry);
+                queued++;
+            }
+        }
+        if(queued) m_cond.notify_all();
+        return queued;
+    }
+
+    tun_bridge_stats tun_bridge::get_stats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    /*!
+     * A TUN/TAP file descriptor returns exactly one packet per read(), so a batch is gathered
+     * by reading until the interface runs dry (EAGAIN) or the batch is full. Each buffer leaves
+     * room for one byte more than a frame holds so a packet that is too long (i.e. the
+     * interface's MTU is set too high) is noticed rather than silently truncated.
+     *
+     * The packets are read into reusable buffers and swapped into a batch of just the packets
+     * read. transmitter::send_frames_async() hands back its spare payload buffers in place of
+     * the queued ones, which are swapped back so the buffers keep their capacity from one
+     * round to the next.
+     *
+     * The loop gives up (after queuing whatever it had read) if the interface goes away or
+     * reading from it fails for any reason besides it being drained or the read being interrupted,
+     * rather than spinning on an error that won't clear.
+     */
+    void tun_bridge::reader_loop()
+    {
+        configure_thread("fun_tun_read", m_params.io_threads);
+        int batch_size = std::max(m_params.batch_size, 1);
+        std::vector<std::vector<unsigned char> > buffers(batch_size);
+        std::vector<std::vector<unsigned char> > batch;
+        batch.reserve(batch_size);
+        struct pollfd pfd;
+        pfd.fd = m_fd;
+        pfd.events = POLLIN;
+
+        while(true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if(m_stop) return;
+            }
+            int ready = poll(&pfd, 1, TUN_POLL_TIMEOUT_MS);
+            if(ready < 0 && errno != EINTR)
+            {
+                std::cerr << "tun_bridge: polling " << m_params.name << " failed (" << strerror(errno) << ")" << std::endl;
+                return;
+            }
+            if(ready <= 0) continue;
+            if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+            {
+                std::cerr << "tun_bridge: " << m_params.name << " was closed or failed, no longer reading from it" << std::endl;
+                return;
+            }
+
+            int count = 0;
+            unsigned long long oversized = 0;
+            int read_error = 0;
+            while(count < batch_size)
+            {
+                std::vector<unsigned char> & payload = buffers[count];
+                payload.resize(MAX_FRAME_SIZE + 1);
+                ssize_t length = read(m_fd, payload.data(), payload.size());
+                if(length < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) read_error = errno;
+                if(length <= 0) break; // EAGAIN, i.e. the interface is drained
+                if(length > MAX_FRAME_SIZE)
+                {
+                    oversized++;
+                    continue;
+                }
+                payload.resize(length);
+                count++;
+            }
+
+            int queued = 0;
+            if(count > 0)
+            {
+                batch.resize(count);
+                for(int x = 0; x < count; x++) batch[x].swap(buffers[x]);
+                queued = m_tx->send_frames_async(batch, m_params.phy_rate);
+                for(int x = 0; x < count; x++) batch[x].swap(buffers[x]);
+                batch.clear();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stats.tx_packets += queued;
+                m_stats.tx_dropped += count - queued + oversized;
+                if(count > 0) m_stats.tx_batches++;
+            }
+
+            if(read_error != 0)
+            {
+                std::cerr << "tun_bridge: reading from " << m_params.name << " failed (" << strerror(read_error) << ")" << std::endl;
+                return;
+            }
+        }
+    }
+
+    /*!
+     * Takes the whole write queue at once so the receiver only contends for the lock once per
+     * batch, then writes the packets outside of the lock in the order they were received.
+     * The interface's send queue is only full if the kernel can't keep up, in which case the
+     * packet is dropped like it would be on any other network interface.
+     */
+    void tun_bridge::writer_loop()
+    {
+        configure_thread("fun_tun_write", m_params.io_threads);
+        std::deque<rx_entry> batch;
+        while(true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while(!m_stop && m_rx_queue.empty()) m_cond.wait(lock);
+                if(m_stop) return;
+                batch.swap(m_rx_queue);
+            }
+
+            unsigned long long written = 0;
+            for(int x = 0; x < batch.size(); x++)
+            {
+                std::vector<unsigned char> & payload = batch[x].pkt->payload;
+                if(write(m_fd, payload.data(), payload.size()) == payload.size()) written++;
+                batch[x].pool->release(batch[x].pkt);
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.rx_packets += written;
+            m_stats.rx_dropped += batch.size() - written;
+            batch.clear();
+        }
+    }
+}
@@ -0,0 +1,191 @@
+/*! \file tun_bridge.h
+ *  \brief Header file for the tun_bridge class.
+ *
+ *  The tun_bridge connects a TUN/TAP network interface to fun_ofdm: packets the kernel routes
+ *  to the interface are read in batches and queued on a transmitter, and packets from a
+ *  receiver are written back to the interface from a bounded queue.
+ */
+
+#ifndef TUN_BRIDGE_H
+#define TUN_BRIDGE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "transmitter.h"
+#include "ppdu.h"
+#include "packet_pool.h"
+#include "thread_config.h"
+
+/*! \def TUN_BATCH_SIZE
+ *  \brief Default number of packets the tun_bridge reads from the interface before queueing them on the transmitter.
+ */
+#define TUN_BATCH_SIZE 32
+
+/*! \def TUN_QUEUE_DEPTH
+ *  \brief Default number of received packets waiting to be written to the interface.
+ */
+#define TUN_QUEUE_DEPTH 256
+
+namespace fun
+{
+    /*!
+     * \brief The tun_bridge_params struct holds the configuration of a tun_bridge.
+     */
+    struct tun_bridge_params
+    {
+        /*!
+         * \brief Name of the interface (e.g. "fun0"). An existing persistent interface of that
+         *  name is attached to, otherwise the kernel creates one (which needs CAP_NET_ADMIN).
+         */
+        std::string name;
+
+        /*!
+         * \brief Whether the interface is a TAP (Ethernet frames) instead of a TUN (IP packets) interface.
+         *
+         * Either way the bytes are passed through as the MPDU unchanged.
+         */
+        bool tap;
+
+        Rate phy_rate; //!< The PHY rate the packets read from the interface are sent at
+
+        int batch_size; //!< Most packets read from the interface per transmitter::send_frames_async() call
+
+        /*!
+         * \brief Most received packets waiting to be written to the interface. Packets that
+         *  arrive while the queue is full are dropped (see tun_bridge_stats::rx_dropped).
+         */
+        int queue_depth;
+
+        thread_params io_threads; //!< Scheduling configuration of the reader & writer threads
+
+        /*!
+         * \brief Constructor for tun_bridge_params.
+         * \param name -> #name
+         * \param tap -> #tap
+         * \param phy_rate -> #phy_rate
+         * \param batch_size -> #batch_size
+         * \param queue_depth -> #queue_depth
+         * \param io_threads -> #io_threads
+         */
+        tun_bridge_params(std::string name = "fun0", bool tap = false, Rate phy_rate = RATE_1_2_BPSK,
+                          int batch_size = TUN_BATCH_SIZE, int queue_depth = TUN_QUEUE_DEPTH,
+                          thread_params io_threads = thread_params()) :
+            name(name),
+            tap(tap),
+            phy_rate(phy_rate),
+            batch_size(batch_size),
+            queue_depth(queue_depth),
+            io_threads(io_threads)
+        {
+        }
+    };
+
+    /*!
+     * \brief The tun_bridge_stats struct is a snapshot of a tun_bridge's counters. See tun_bridge::get_stats().
+     */
+    struct tun_bridge_stats
+    {
+        unsigned long long tx_packets;  //!< Packets read from the interface & queued on the transmitter
+        unsigned long long tx_dropped;  //!< Packets read from the interface but dropped by the transmit queue or too long for a frame
+        unsigned long long tx_batches;  //!< Batches queued on the transmitter (tx_packets / tx_batches is the average batch)
+        unsigned long long rx_packets;  //!< Received packets written to the interface
+        unsigned long long rx_dropped;  //!< Received packets dropped because the write queue was full or the write failed
+    };
+
+    /*!
+     * \brief The tun_bridge class bridges a TUN/TAP interface and the fun_ofdm PHY.
+     *
+     *  Usage: Create a transmitter, then a tun_bridge on top of it. Create a receiver with the
+     *  pooled packet callback and hand the packets to write_packets() from it. Everything the
+     *  kernel routes to the interface is then sent over the air and everything received comes
+     *  out of the interface.
+     *
+     *  Each direction runs on its own thread. The reader thread waits for the interface to become
+     *  readable and then drains it without blocking, up to tun_bridge_params::batch_size packets,
+     *  before queueing the whole batch on the transmitter at once. The writer thread takes every
+     *  packet waiting in the write queue at once and writes them back to back, so the receiver's
+     *  processing thread never waits on the interface. Both directions reuse their buffers so the
+     *  steady state doesn't allocate.
+     */
+    class tun_bridge
+    {
+    public:
+
+        /*!
+         * \brief Constructor for tun_bridge. Opens the interface & starts the threads.
+         * \param tx The transmitter the packets read from the interface are queued on. Must outlive the bridge.
+         * \param params The interface, batching & queueing configuration
+         */
+        tun_bridge(transmitter * tx, tun_bridge_params params = tun_bridge_params());
+
+        /*!
+         * \brief Destructor for tun_bridge. Stops the threads, releases the packets still waiting to be
+         *  written & closes the interface.
+         */
+        ~tun_bridge();
+
+        bool is_open() const { return m_fd >= 0; } //!< Whether the interface was opened
+
+        std::string name() const { return m_name; } //!< Name of the interface the kernel assigned
+
+        /*!
+         * \brief Queues received packets to be written to the interface.
+         * \param packets The packets (e.g. from the receiver's pooled packet callback)
+         * \param pool The pool the packets came from. Every packet is released back to it once it has been
+         *  written or dropped, so the pool must outlive the bridge.
+         * \return The number of packets queued, the rest were dropped because the queue was full
+         *
+         *  Never blocks on the interface. Can be called from any thread.
+         */
+        int write_packets(const std::vector<packet *> & packets, packet_pool & pool);
+
+        tun_bridge_stats get_stats(); //!< Gets a snapshot of the counters. Can be called from any thread.
+
+    private:
+
+        tun_bridge(const tun_bridge &);               //!< Not copyable since it owns the interface & threads
+        tun_bridge & operator=(const tun_bridge &);   //!< Not copyable since it owns the interface & threads
+
+        /*!
+         * \brief A received packet waiting to be written.
+         */
+        struct rx_entry
+        {
+            packet * pkt;       //!< The packet
+            packet_pool * pool; //!< The pool it goes back to
+        };
+
+        void reader_loop(); //!< Reads batches of packets from the interface & queues them on the transmitter
+
+        void writer_loop(); //!< Writes the queued received packets to the interface
+
+        transmitter * m_tx; //!< The transmitter the packets read from the interface are queued on
+
+        tun_bridge_params m_params; //!< The configuration
+
+        int m_fd; //!< File descriptor of the interface, -1 if it couldn't be opened
+
+        std::string m_name; //!< Name of the interface
+
+        std::mutex m_mutex; //!< Protects #m_rx_queue, #m_stats & #m_stop
+
+        std::condition_variable m_cond; //!< Signalled when a packet is queued or the bridge stops
+
+        std::deque<rx_entry> m_rx_queue; //!< Received packets waiting to be written
+
+        tun_bridge_stats m_stats; //!< The counters
+
+        bool m_stop; //!< Tells the threads to exit
+
+        std::thread m_reader_thread; //!< Runs reader_loop()
+
+        std::thread m_writer_thread; //!< Runs writer_loop()
+    };
+}
+
+#endif // TUN_BRIDGE_H
@@ -8,10 +8,63 @@
  *  such as center frequency, sample rate, tx/rx gain, etc..
  */
 
+#include <cassert>
+#include <cmath>
+
 #include "usrp.h"
 
 namespace fun
 {
+    /*!
+     * \brief Converts & scales samples to sc16.
+     *
+     * Works on the flat array of real_t components with the clamp and rounding written as
+     * selects and floor so it vectorizes. This is always inlined into the ISA specific wrappers
+     * below so the compiler generates a separate SSE and AVX2 version of it.
+     */
+    static inline __attribute__((always_inline))
+    void sc16_kernel_impl(const real_t * __restrict__ components, int count, real_t scale, short * __restrict__ wire)
+    {
+        for(int c = 0; c < count; c++)
+        {
+            real_t v = components[c] * scale;
+            v = v < -32768 ? -32768 : v;
+            v = v > 32767 ? 32767 : v;
+            wire[c] = short(std::floor(v + real_t(0.5)));
+        }
+    }
+
+    /*!
+     * \brief Signature of the sc16 conversion kernels
+     */
+    typedef void sc16_kernel(const real_t * components, int count, real_t scale, short * wire);
+
+    //! SSE4.1 version of the sc16 conversion (the baseline compile flags).
+    static void sc16_kernel_sse(const real_t * components, int count, real_t scale, short * wire)
+    {
+        sc16_kernel_impl(components, count, scale, wire);
+    }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    //! AVX2 version of the sc16 conversion.
+    __attribute__((target("avx2")))
+    static void sc16_kernel_avx2(const real_t * components, int count, real_t scale, short * wire)
+    {
+        sc16_kernel_impl(components, count, scale, wire);
+    }
+#endif
+
+    /*!
+     * \brief Picks the AVX2 sc16 conversion if the CPU supports it, the SSE one otherwise.
+     */
+    static sc16_kernel * pick_sc16_kernel()
+    {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        if(__builtin_cpu_supports("avx2")) return sc16_kernel_avx2;
+#endif
+        return sc16_kernel_sse;
+    }
+
     /*!
      * -Initializations
      *  + #m_params -> Previously initialized usrp_params object containing the desired parameters
@@ -24,9 +77,11 @@ namespace fun
         m_usrp = uhd::usrp::multi_usrp::make(uhd::device_addr_t(m_params.device_addr));
         m_device = m_usrp->get_device();
 
+        if(m_params.rx_channels < 1) m_params.rx_channels = 1;
+
         // Set the center frequency
         m_usrp->set_tx_freq(uhd::tune_request_t(m_params.freq));
-        m_usrp->set_rx_freq(uhd::tune_request_t(m_params.freq));
+        for(int c = 0; c < m_params.rx_channels; c++) m_usrp->set_rx_freq(uhd::tune_request_t(m_params.freq), c);
 
         // Set the sample rate
         m_usrp->set_tx_rate(m_params.rate);
@@ -34,19 +89,32 @@ namespace fun
 
         // Set the gains
         m_usrp->set_tx_gain(m_params.tx_gain);
-        m_usrp->set_rx_gain(m_params.rx_gain);
+        for(int c = 0; c < m_params.rx_channels; c++) m_usrp->set_rx_gain(m_params.rx_gain, c);
 
         // Set the RX antenna
         //m_usrp->set_rx_antenna("RX2");
 
         // Get the TX and RX stream handles
-        m_tx_streamer = m_usrp->get_tx_stream(uhd::stream_args_t("fc64"));
-        m_rx_streamer = m_usrp->get_rx_stream(uhd::stream_args_t("fc64"));
+        uhd::stream_args_t rx_args(USRP_CPU_FORMAT, USRP_OTW_FORMAT);
+        for(int c = 0; c < m_params.rx_channels; c++) rx_args.channels.push_back(c);
+        m_tx_streamer = m_usrp->get_tx_stream(uhd::stream_args_t(m_params.tx_sc16 ? "sc16" : USRP_CPU_FORMAT, USRP_OTW_FORMAT));
+        m_rx_streamer = m_usrp->get_rx_stream(rx_args);
+        m_rx_buffs.resize(m_params.rx_channels);
+        m_single_buff.resize(1);
 
-        // Start the RX stream
+        // Start the RX stream. Multiple channels are started at the same (future) time so
+        // that their samples line up.
         uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
-        stream_cmd.stream_now = true;
-        m_usrp->issue_stream_cmd(stream_cmd);
+        stream_cmd.stream_now = (m_params.rx_channels == 1);
+        if(m_params.rx_channels == 1)
+        {
+            m_usrp->issue_stream_cmd(stream_cmd);
+        }
+        else
+        {
+            stream_cmd.time_spec = m_usrp->get_time_now() + uhd::time_spec_t(0.1);
+            m_rx_streamer->issue_stream_cmd(stream_cmd);
+        }
 
         sem_init(&m_tx_sem, 0, 0);
         sem_post(&m_tx_sem);
@@ -63,16 +131,27 @@ namespace fun
      * See <a href="http://files.ettus.com/manual/page_general.html#general_ounotes"> link to ettus' website</a>
      * for more details.
      */
-    void usrp::send_burst(std::vector<std::complex<double> > samples)
+    void usrp::send_burst(const std::vector<complex_t > & samples)
     {
-        sem_wait(&m_tx_sem);
+        send_burst(samples.data(), samples.size());
+    }
 
-        uhd::tx_metadata_t tx_metadata;
-        tx_metadata.start_of_burst = true;
-        tx_metadata.end_of_burst = true;
-        tx_metadata.has_time_spec = false;
-        m_tx_streamer->send(&samples[0], samples.size(), tx_metadata);
+    /*!
+     * Same as the vector version of send_burst() except that the samples are sent straight
+     * from the caller's buffer (unless they have to be converted to sc16).
+     */
+    void usrp::send_burst(const complex_t * samples, int count)
+    {
+        sem_wait(&m_tx_sem);
+        send_samples(tx_samples(samples, count, 1), count);
+        sem_post(&m_tx_sem);
+    }
 
+    void usrp::send_burst(const std::complex<short> * samples, int count)
+    {
+        assert(m_params.tx_sc16);
+        sem_wait(&m_tx_sem);
+        send_samples(samples, count);
         sem_post(&m_tx_sem);
     }
 
@@ -87,20 +166,16 @@ namespace fun
      * If the user does not call this fast enough an underrun may occur.
      * See <a href="http://files.ettus.com/manual/page_general.html#general_ounotes"> link to ettus' website</a>
      * for more details.
+     *
+     * The scaling by usrp_params::tx_amp happens while the samples are copied into the reused
+     * scaling buffer, or while they are converted for an sc16 TX stream.
      */
-    void usrp::send_burst_sync(std::vector<std::complex<double> > samples)
+    void usrp::send_burst_sync(const std::vector<complex_t > & samples)
     {
-        // Scale the samples by m_amp
-        if(m_params.tx_amp != 1.0)
-            for(int x = 0; x < samples.size(); x++)
-                samples[x] *= m_params.tx_amp;
-
-        // Send the samples
-        uhd::tx_metadata_t tx_metadata;
-        tx_metadata.start_of_burst = true;
-        tx_metadata.end_of_burst = true;
-        tx_metadata.has_time_spec = false;
-        m_tx_streamer->send(&samples[0], samples.size(), tx_metadata);
+        // Scale (and convert) the samples and send them
+        sem_wait(&m_tx_sem);
+        send_samples(tx_samples(samples.data(), samples.size(), m_params.tx_amp), samples.size());
+        sem_post(&m_tx_sem);
 
         // Wait for the end of burst ACK followed by an underflow
         bool got_ack = false;
@@ -113,6 +188,42 @@ namespace fun
         }
     }
 
+    /*!
+     * The conversion kernel is picked once for the CPU the first time it is needed.
+     */
+    void usrp::to_sc16(const complex_t * samples, int count, real_t amp, std::complex<short> * wire)
+    {
+        static sc16_kernel * const kernel = pick_sc16_kernel();
+        kernel(reinterpret_cast<const real_t *>(samples), 2 * count, amp * USRP_SC16_SCALE, reinterpret_cast<short *>(wire));
+    }
+
+    /*!
+     * The buffers only ever grow, so once they have held the longest frame nothing is allocated.
+     */
+    const void * usrp::tx_samples(const complex_t * samples, int count, real_t amp)
+    {
+        if(m_params.tx_sc16)
+        {
+            if(m_tx_wire.size() < count) m_tx_wire.resize(count);
+            to_sc16(samples, count, amp, m_tx_wire.data());
+            return m_tx_wire.data();
+        }
+        if(amp == 1) return samples;
+
+        if(m_tx_scaled.size() < count) m_tx_scaled.resize(count);
+        for(int x = 0; x < count; x++) m_tx_scaled[x] = samples[x] * amp;
+        return m_tx_scaled.data();
+    }
+
+    void usrp::send_samples(const void * samples, int count)
+    {
+        uhd::tx_metadata_t tx_metadata;
+        tx_metadata.start_of_burst = true;
+        tx_metadata.end_of_burst = true;
+        tx_metadata.has_time_spec = false;
+        m_tx_streamer->send(samples, count, tx_metadata);
+    }
+
     /*!
      * Gets num_samples from the USRP and places them in the buffer parameter. If this function
      * is not called "fast enough" the USRP will get upset because the computer is not consuming
@@ -121,12 +232,78 @@ namespace fun
      * See <a href="http://files.ettus.com/manual/page_general.html#general_ounotes"> link to ettus' website</a>
      * for more details.
      *
+     * UHD returns early when it reports an error so this function keeps receiving until the
+     * buffer is full, counting each error in errors. An overflow means samples were lost
+     * between two calls but the samples that do arrive are still good. Only a timeout returns
+     * early since it means no more samples are coming.
      */
-    void usrp::get_samples(int num_samples, std::vector<std::complex<double> > & buffer)
+    int usrp::get_samples(int num_samples, std::vector<complex_t > & buffer, rx_error_counts * errors, double * time)
     {
+        assert(m_params.rx_channels == 1);
+        m_single_buff[0] = buffer.data();
+        return get_samples(num_samples, m_single_buff, errors, time);
+    }
+
+    /*!
+     * Works exactly like the single channel get_samples() except that UHD fills every channel's
+     * buffer in lock step so the same number of samples is received on each channel.
+     *
+     * The time is taken from the metadata of the first recv() only. If samples are lost to an
+     * overflow partway through, the later samples are on the air later than the time implies.
+     */
+    int usrp::get_samples(int num_samples, const std::vector<complex_t *> & buffers, rx_error_counts * errors, double * time)
+    {
+        assert(buffers.size() == m_params.rx_channels);
+
+        rx_error_counts local_errors;
+        if(errors == NULL) errors = &local_errors;
+        if(time != NULL) *time = -1;
+
         // Get some samples
-        uhd::rx_metadata_t rx_meta;
-        m_rx_streamer->recv(&buffer[0], num_samples, rx_meta);
+        int received = 0;
+        int timeouts = 0;
+        while(received < num_samples)
+        {
+            for(int c = 0; c < buffers.size(); c++) m_rx_buffs[c] = buffers[c] + received;
+
+            uhd::rx_metadata_t rx_meta;
+            bool first = received == 0;
+            received += m_rx_streamer->recv(m_rx_buffs, num_samples - received, rx_meta);
+            if(first && time != NULL && rx_meta.has_time_spec) *time = rx_meta.time_spec.get_real_secs();
+
+            switch(rx_meta.error_code)
+            {
+                case uhd::rx_metadata_t::ERROR_CODE_NONE:
+                    timeouts = 0;
+                    break;
+
+                // The stream carries on after these so just keep receiving
+                case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
+                    errors->overflows++;
+                    timeouts = 0;
+                    break;
+
+                case uhd::rx_metadata_t::ERROR_CODE_TIMEOUT:
+                    errors->timeouts++;
+                    if(++timeouts >= RX_TIMEOUT_RETRIES) return received;
+                    break;
+
+                // Anything else may not clear by itself, hand back what was received so the caller can see it
+                case uhd::rx_metadata_t::ERROR_CODE_LATE_COMMAND:
+                    errors->late_commands++;
+                    return received;
+
+                default:
+                    errors->other_errors++;
+                    return received;
+            }
+        }
+        return received;
+    }
+
+    int usrp::get_rx_channels()
+    {
+        return m_params.rx_channels;
     }
 
 }
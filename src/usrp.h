@@ -16,6 +16,33 @@
 #include <uhd/stream.hpp>
 #include <semaphore.h>
 
+#include "precision.h"
+
+/*! \def USRP_CPU_FORMAT
+ *  \brief UHD host side sample format matching fun::complex_t.
+ */
+#ifdef FUN_OFDM_SINGLE_PRECISION
+#define USRP_CPU_FORMAT "fc32"
+#else
+#define USRP_CPU_FORMAT "fc64"
+#endif
+
+/*! \def USRP_OTW_FORMAT
+ *  \brief Over the wire sample format between the host and the USRP.
+ */
+#define USRP_OTW_FORMAT "sc16"
+
+/*! \def USRP_SC16_SCALE
+ *  \brief The sc16 value of a sample of 1.0, the same scale UHD's own float to sc16 conversion uses.
+ */
+#define USRP_SC16_SCALE 32767
+
+/*! \def RX_TIMEOUT_RETRIES
+ *  \brief Number of receive timeouts in a row after which usrp::get_samples() gives up and
+ *  returns the samples it has, so a stalled stream can't block the capture thread forever.
+ */
+#define RX_TIMEOUT_RETRIES 10
+
 namespace fun
 {
     /*!
@@ -30,6 +57,15 @@ namespace fun
         double rx_gain;             //!< Receive Gain  (0-35 for USRP N210)
         double tx_amp;              //!< Transmit Amplitude - scales all tx samples before sending to USRP
         std::string device_addr;    //!< IP Address of USRP as a string - i.e. "192.168.10.2" or "" to find automatically
+        int rx_channels;            //!< Number of RX channels to stream (channels 0 to rx_channels - 1)
+
+        /*!
+         * \brief Whether the TX stream takes sc16 samples from the host instead of #USRP_CPU_FORMAT.
+         *
+         * The samples are then converted (and scaled by #tx_amp) with usrp::to_sc16() before they
+         * are sent, which leaves UHD nothing to convert and hands it a quarter of the bytes of fc64.
+         */
+        bool tx_sc16;
 
         /*!
          * \brief Constructor for usrp_params. Simply initializes member fields to be looked up later.
@@ -39,14 +75,42 @@ namespace fun
          * \param rx_gain -> #rx_gain
          * \param tx_amp -> #tx_amp
          * \param device_addr -> #device_addr
+         * \param rx_channels -> #rx_channels
+         * \param tx_sc16 -> #tx_sc16
          */
-        usrp_params(double freq = 5.72e9, double rate = 5e6, double tx_gain=20, double rx_gain=20, double tx_amp=1.0, std::string device_addr="") :
+        usrp_params(double freq = 5.72e9, double rate = 5e6, double tx_gain=20, double rx_gain=20, double tx_amp=1.0, std::string device_addr="", int rx_channels=1,
+                    bool tx_sc16=false) :
             freq(freq),
             rate(rate),
             tx_gain(tx_gain),
             rx_gain(rx_gain),
             tx_amp(tx_amp),
-            device_addr(device_addr)
+            device_addr(device_addr),
+            rx_channels(rx_channels),
+            tx_sc16(tx_sc16)
+        {
+        }
+    };
+
+    /*!
+     * \brief The rx_error_counts struct counts the errors reported by UHD in the metadata
+     *  of received samples. See usrp::get_samples().
+     */
+    struct rx_error_counts
+    {
+        unsigned long long overflows;       //!< Samples were dropped because the host didn't receive them fast enough
+        unsigned long long timeouts;        //!< No samples arrived within the receive timeout
+        unsigned long long late_commands;   //!< A stream command was issued too late
+        unsigned long long other_errors;    //!< Broken chain, alignment & bad packet errors
+
+        /*!
+         * \brief Constructor for rx_error_counts, all counts start at 0.
+         */
+        rx_error_counts() :
+            overflows(0),
+            timeouts(0),
+            late_commands(0),
+            other_errors(0)
         {
         }
     };
@@ -71,26 +135,87 @@ namespace fun
 
         // Send a burst of samples, and block until the burst has finished
         /*!
-         * \brief Sends a burst of samples and block until the burst has finished.
+         * \brief Sends a burst of samples scaled by usrp_params::tx_amp and block until the burst has finished.
          * \param samples A vector of complex doubles representing the base band time domain signal
          *  to be up-converted and transmitted by the USRP.
          */
-        void send_burst_sync(std::vector<std::complex<double> > samples);
+        void send_burst_sync(const std::vector<complex_t > & samples);
 
         /*!
          * \brief Sends a burst of samples but does not block until the burst has finished.
          * \param samples A vector of complex doubles representing the base band time domain signal
          *  to be up-converted and transmitted by the USRP.
          */
-        void send_burst(std::vector<std::complex<double> > samples);
+        void send_burst(const std::vector<complex_t > & samples);
+
+        /*!
+         * \brief Sends count samples as a single burst without scaling them and without waiting
+         *  for the burst to finish.
+         * \param samples The base band time domain signal to be up-converted and transmitted.
+         *  Any scaling by usrp_params::tx_amp must already be applied.
+         * \param count The number of samples.
+         *
+         * The samples are sent straight from samples unless usrp_params::tx_sc16 is set, in
+         * which case they are converted into a reused sc16 buffer first.
+         */
+        void send_burst(const complex_t * samples, int count);
+
+        /*!
+         * \brief Sends count sc16 samples as a single burst straight from the caller's buffer
+         *  without waiting for the burst to finish. Requires usrp_params::tx_sc16.
+         * \param samples The samples, already converted (and scaled) with to_sc16().
+         * \param count The number of samples.
+         */
+        void send_burst(const std::complex<short> * samples, int count);
+
+        /*!
+         * \brief Whether the TX stream takes sc16 samples (see usrp_params::tx_sc16).
+         */
+        bool tx_sc16() const { return m_params.tx_sc16; }
+
+        /*!
+         * \brief Converts samples to sc16 and scales them in one pass.
+         * \param samples The samples to convert
+         * \param count The number of samples
+         * \param amp Scale applied on the way (i.e. usrp_params::tx_amp)
+         * \param wire Output buffer with room for count samples
+         *
+         * A sample of 1.0 becomes #USRP_SC16_SCALE, anything beyond that saturates.
+         */
+        static void to_sc16(const complex_t * samples, int count, real_t amp, std::complex<short> * wire);
 
         // Get some samples from the USRP
         /*!
          * \brief Gets num_samples samples and places them in the first num_samples of buffer.
          * \param num_samples The number of samples to retrieve from USRP.
          * \param buffer The buffer to place the retrieved samples in.
+         * \param errors [Optional] Incremented for every error UHD reports while receiving.
+         * \param time [Optional] Set to the USRP time in seconds of the first sample received, or -1 if
+         *  UHD didn't report one.
+         * \return The number of samples received, less than num_samples only after #RX_TIMEOUT_RETRIES
+         *  timeouts in a row or an error besides an overflow or a timeout (see errors).
+         *
+         * Only for a usrp streaming a single RX channel.
          */
-        void get_samples(int num_samples, std::vector<std::complex<double> > & buffer);
+        int get_samples(int num_samples, std::vector<complex_t > & buffer, rx_error_counts * errors = NULL, double * time = NULL);
+
+        /*!
+         * \brief Gets num_samples samples from every RX channel at once.
+         * \param num_samples The number of samples to retrieve from each channel.
+         * \param buffers One buffer per RX channel (see usrp_params::rx_channels) each with room
+         *  for num_samples samples. The samples of channel c are placed in buffers[c].
+         * \param errors [Optional] Incremented for every error UHD reports while receiving.
+         * \param time [Optional] Set to the USRP time in seconds of the first sample received (on every
+         *  channel), or -1 if UHD didn't report one.
+         * \return The number of samples received per channel, less than num_samples only after
+         *  #RX_TIMEOUT_RETRIES timeouts in a row or an error besides an overflow or a timeout (see errors).
+         */
+        int get_samples(int num_samples, const std::vector<complex_t *> & buffers, rx_error_counts * errors = NULL, double * time = NULL);
+
+        /*!
+         * \brief Gets the number of RX channels being streamed.
+         */
+        int get_rx_channels();
 
 
     private:
@@ -104,6 +229,29 @@ namespace fun
         uhd::tx_streamer::sptr m_tx_streamer;            //!<  RX (input) streamer
 
         sem_t m_tx_sem;                                  //!< Sempahore used to block for #send_burst_sync
+
+        std::vector<void *> m_rx_buffs;                  //!< Per channel receive pointers reused by get_samples()
+
+        std::vector<complex_t *> m_single_buff;          //!< Buffer list reused by the single channel get_samples()
+
+        std::vector<complex_t > m_tx_scaled;             //!< Buffer the samples are scaled into by send_burst_sync() (if not usrp_params::tx_sc16)
+
+        std::vector<std::complex<short> > m_tx_wire;     //!< Buffer the samples are converted into for an sc16 TX stream
+
+        /*!
+         * \brief Prepares samples for the TX stream.
+         * \param samples The samples
+         * \param count The number of samples
+         * \param amp Scale to apply
+         * \return samples itself if nothing has to be done, otherwise #m_tx_wire or #m_tx_scaled
+         *  holding the converted or scaled samples
+         */
+        const void * tx_samples(const complex_t * samples, int count, real_t amp);
+
+        /*!
+         * \brief Sends count samples in the TX stream's host format as a single burst.
+         */
+        void send_samples(const void * samples, int count);
     };
 
 }
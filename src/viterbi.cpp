@@ -5,6 +5,12 @@
 *  using the viterbi algorithm.
 */
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
 #include "viterbi.h"
 
 #include <stdio.h>
@@ -17,48 +23,409 @@
 #include <emmintrin.h>
 #include <xmmintrin.h>
 #include <mmintrin.h>
+#include <immintrin.h>
 
 #include <unistd.h>
 
 #include "parity.h"
+#include "thread_config.h"
 
 namespace fun
 {
+    struct viterbi::segment_state
+    {
+        struct v * vp;                  //!< Decision trellis of the window, NULL until the first segment
+        int max_bits;                   //!< Number of trellis steps #vp can hold
+        std::vector<unsigned char> out; //!< The decoded bits of the whole window
+    };
+
+    /*!
+     * Everything but #next_segment and the frame itself is protected by #mutex.
+     */
+    struct viterbi::segment_pool
+    {
+        std::mutex mutex;                       //!< Protects everything below
+        std::condition_variable frame_cond;     //!< Signalled when a frame is handed out or on #stop
+        std::condition_variable done_cond;      //!< Signalled when a worker runs out of segments to decode
+        std::vector<segment_state> states;      //!< One segment_state per worker plus one for the calling thread (the last)
+        std::vector<std::thread> workers;       //!< The segment worker threads
+        const COMPUTETYPE * symbols;            //!< The symbols of the current frame
+        unsigned char * data;                   //!< The output of the current frame
+        int data_bits;                          //!< Number of data bits in the current frame
+        int segment_bits;                       //!< Number of data bits in each segment but the last
+        int segments;                           //!< Number of segments in the current frame
+        std::atomic<int> next_segment;          //!< Index of the next segment of the frame to decode
+        unsigned long long frame_count;         //!< Number of frames handed out so far
+        int busy_workers;                       //!< Number of workers still decoding the frame
+        bool stop;                              //!< Tells the workers to exit
+    };
+
+    /*!
+     * - Initializations:
+     *   + #Branchtab -> Built from the polynomials in #POLYS
+     *   + #m_vp -> Trellis for max_data_bits or NULL if max_data_bits is 0
+     *   + #m_use_avx2 -> true if the CPU supports AVX2
+     *   + #m_pool -> segment_threads segment worker threads or NULL if segment_threads is 0
+     */
+    viterbi::viterbi(int max_data_bits, int segment_threads) :
+        m_vp(NULL),
+        m_max_bits(0),
+        m_steps(0),
+        m_use_avx2(false),
+        m_pool(NULL)
+    {
+        int polys[RATE] = POLYS;
+        for (int state=0;state < NUMSTATES/2;state++) {
+          for (int i=0; i<RATE; i++) {
+            Branchtab[i*NUMSTATES/2+state] = (polys[i] < 0) ^ parity((2*state) & abs(polys[i])) ? 255 : 0;
+          }
+        }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        m_use_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+        if(max_data_bits > 0)
+        {
+            m_vp = viterbi_alloc(max_data_bits);
+            if(m_vp != NULL) m_max_bits = max_data_bits;
+        }
+        if(segment_threads <= 0) return;
+
+        m_pool = new segment_pool();
+        m_pool->symbols = NULL;
+        m_pool->data = NULL;
+        m_pool->data_bits = 0;
+        m_pool->segment_bits = 0;
+        m_pool->segments = 0;
+        m_pool->next_segment = 0;
+        m_pool->frame_count = 0;
+        m_pool->busy_workers = 0;
+        m_pool->stop = false;
+        m_pool->states.resize(segment_threads + 1);
+        for(int x = 0; x < m_pool->states.size(); x++)
+        {
+            m_pool->states[x].vp = NULL;
+            m_pool->states[x].max_bits = 0;
+        }
+        for(int x = 0; x < segment_threads; x++)
+        {
+            m_pool->workers.push_back(std::thread(&viterbi::segment_worker, this, &m_pool->states[x]));
+        }
+    }
+
+    viterbi::~viterbi()
+    {
+        viterbi_free(m_vp);
+        if(m_pool == NULL) return;
+        {
+            std::lock_guard<std::mutex> lock(m_pool->mutex);
+            m_pool->stop = true;
+        }
+        m_pool->frame_cond.notify_all();
+        for(int x = 0; x < m_pool->workers.size(); x++) m_pool->workers[x].join();
+        for(int x = 0; x < m_pool->states.size(); x++) viterbi_free(m_pool->states[x].vp);
+        delete m_pool;
+    }
 
     /*!
-     *  Main decode function.
+     *  Main decode function. The trellis is only reallocated if the frame is larger
+     *  than any frame decoded by this object so far.
      */
     void viterbi::conv_decode(unsigned char * symbols, unsigned char * data, int data_bits)
     {
-      struct v * vp = viterbi_alloc(data_bits);
-      viterbi_init(vp, 0);
-      viterbi_decode(vp, &symbols[0], &data[0], data_bits);
-      viterbi_free(vp);
+      if(m_pool != NULL)
+      {
+        int segments = std::min<int>(m_pool->states.size(), data_bits / VITERBI_MIN_SEGMENT_BITS);
+        if(segments >= 2)
+        {
+          decode_segments(symbols, data, data_bits, segments);
+          return;
+        }
+      }
+      if(!reserve_trellis(data_bits)) return;
+      viterbi_decode(m_vp, &symbols[0], &data[0], data_bits);
     }
 
-    void viterbi::conv_encode(unsigned char * data, unsigned char * symbols, int data_bits)
+    bool viterbi::reserve_trellis(int data_bits)
     {
-        int symbol_count = RATE * (data_bits + 6);
-        memset(symbols, 0, symbol_count);
+      if(data_bits > m_max_bits)
+      {
+        viterbi_free(m_vp);
+        m_vp = viterbi_alloc(data_bits);
+        m_max_bits = (m_vp != NULL) ? data_bits : 0;
+      }
+      return m_vp != NULL;
+    }
 
-        int polys[RATE] = POLYS;
-        int sr = 0;
+    /*!
+     *  The trellis is sized for the whole frame up front so update() never allocates.
+     */
+    void viterbi::begin_decode(int data_bits)
+    {
+      m_steps = 0;
+      if(!reserve_trellis(data_bits)) return;
+      viterbi_init(m_vp, 0);
+    }
 
-        int index = 0;
-        for(int i = 0; i < data_bits+(K-1); i++) {
+    /*!
+     *  The trellis update works on two steps at a time and leaves the path metrics in
+     *  v::old_metrics after an even number of steps, so consecutive calls pick up exactly
+     *  where the previous one left off and the decisions are the same as a single pass.
+     */
+    void viterbi::update(const unsigned char * symbols, int steps)
+    {
+      if(m_vp == NULL || m_steps + steps > m_max_bits + (K-1)) return;
+      unsigned char * d = m_vp->decisions[m_steps].t;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+      if (m_use_avx2)
+        FULL_SPIRAL_AVX2(steps, m_vp->new_metrics->t, m_vp->old_metrics->t, symbols, d, Branchtab);
+      else
+#endif
+        FULL_SPIRAL(steps, m_vp->new_metrics->t, m_vp->old_metrics->t, symbols, d, Branchtab);
+      m_steps += steps;
+    }
 
-            int b = data[i/8];
-            int j = i % 8;
-            int bit = (b >> (7 - j)) & 1;
+    void viterbi::end_decode(unsigned char * data, int data_bits)
+    {
+      if(m_vp == NULL || data_bits > m_max_bits) return;
+      viterbi_chainback(m_vp, data, data_bits, 0);
+    }
 
-            sr = (sr << 1) | bit;
-            for(int k = 0; k < RATE; k++)
+    /*!
+     * The segments are handed out one at a time through segment_pool::next_segment and the
+     * calling thread decodes segments alongside the workers. Every segment is a whole number
+     * of bytes (except maybe the last) so each thread writes its own bytes of the output.
+     */
+    void viterbi::decode_segments(const COMPUTETYPE *symbols, unsigned char *data, int data_bits, int segments)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_pool->mutex);
+            m_pool->symbols = symbols;
+            m_pool->data = data;
+            m_pool->data_bits = data_bits;
+            m_pool->segment_bits = ((data_bits + segments - 1) / segments + 7) & ~7;
+            m_pool->segments = segments;
+            m_pool->next_segment = 0;
+            m_pool->busy_workers = m_pool->workers.size();
+            m_pool->frame_count++;
+        }
+        m_pool->frame_cond.notify_all();
+
+        decode_pending_segments(&m_pool->states.back());
+
+        std::unique_lock<std::mutex> lock(m_pool->mutex);
+        while(m_pool->busy_workers > 0) m_pool->done_cond.wait(lock);
+    }
+
+    void viterbi::decode_pending_segments(segment_state * state)
+    {
+        while(true)
+        {
+            int segment = m_pool->next_segment++;
+            if(segment >= m_pool->segments) return;
+            decode_segment(state, segment);
+        }
+    }
+
+    /*!
+     * The window starts #VITERBI_WINDOW_MARGIN steps before the segment with every state equally
+     * likely (except the first window which starts in the known state 0) and ends
+     * #VITERBI_WINDOW_MARGIN steps past the segment where the chainback starts from the state
+     * with the best path metric. A window that would reach the end of the frame runs through the
+     * tail bits instead and starts the chainback from the known state 0, exactly like a decode
+     * in one pass.
+     */
+    void viterbi::decode_segment(segment_state * state, int segment)
+    {
+        int data_bits = m_pool->data_bits;
+        int first = segment * m_pool->segment_bits;
+        int last = std::min(data_bits, first + m_pool->segment_bits);
+        if(first >= last) return;
+
+        int start = std::max(0, first - VITERBI_WINDOW_MARGIN);
+        bool to_tail = (last + VITERBI_WINDOW_MARGIN >= data_bits);
+        int end = to_tail ? data_bits + (K - 1) : last + VITERBI_WINDOW_MARGIN + (K - 1);
+        int steps = end - start;
+
+        if(steps > state->max_bits)
+        {
+            viterbi_free(state->vp);
+            state->vp = viterbi_alloc(steps);
+            state->max_bits = (state->vp != NULL) ? steps : 0;
+            if(state->vp == NULL) return;
+            state->out.resize(steps / 8 + 1);
+        }
+        struct v * vp = state->vp;
+
+        viterbi_init(vp, 0);
+        if(start > 0) memset(vp->old_metrics->t, 0, NUMSTATES);
+        viterbi_update_blk_SPIRAL(vp, m_pool->symbols + RATE * start, steps);
+
+        int endstate = 0;
+        if(!to_tail)
+        {
+            // Windows that don't reach the tail always have an even number of steps so the
+            // final metrics are back in old_metrics
+            const COMPUTETYPE * metrics = vp->old_metrics->t;
+            for(int x = 1; x < NUMSTATES; x++) if(metrics[x] < metrics[endstate]) endstate = x;
+        }
+        viterbi_chainback(vp, state->out.data(), steps - (K - 1), endstate);
+
+        // Keep the bytes of the segment
+        int first_byte = (first - start) / 8;
+        int byte_count = (last - first + 7) / 8;
+        memcpy(m_pool->data + first / 8, state->out.data() + first_byte, byte_count);
+    }
+
+    /*!
+     * Each worker owns its own trellis so the workers never share any state besides the
+     * current frame, and each byte of the output is only ever written by one thread.
+     */
+    void viterbi::segment_worker(segment_state * state)
+    {
+        configure_thread("fun_viterbi");
+        unsigned long long frames = 0;
+        while(true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_pool->mutex);
+                while(m_pool->frame_count == frames && !m_pool->stop) m_pool->frame_cond.wait(lock);
+                if(m_pool->stop) return;
+                frames = m_pool->frame_count;
+            }
+
+            decode_pending_segments(state);
+
+            {
+                std::lock_guard<std::mutex> lock(m_pool->mutex);
+                m_pool->busy_workers--;
+            }
+            m_pool->done_cond.notify_all();
+        }
+    }
+
+    /*!
+     * \brief The tables of the byte at a time convolutional encoder.
+     *
+     * The encoder's state is the last K-1 = 6 input bits, so the 16 coded bits of an input
+     * byte only depend on the state and the byte, and the state after the byte is simply
+     * its low 6 bits.
+     */
+    struct conv_encoder_tables
+    {
+        /*!
+         * \brief The 16 coded bits (first coded bit most significant) of each byte from each state.
+         */
+        unsigned short coded[NUMSTATES][256];
+
+        /*!
+         * \brief A puncture pattern and which of the 16 coded bits of a byte it keeps at each phase.
+         */
+        struct puncture_pattern
+        {
+            int period;                //!< Length of the pattern in coded bits
+            unsigned char kept[6][16]; //!< The kept coded bit positions (0 = first) for a byte starting at each phase
+            int kept_count[6];         //!< Number of kept bits for a byte starting at each phase
+        };
+
+        puncture_pattern patterns[3]; //!< The 1/2, 2/3 and 3/4 patterns
+
+        //! Builds the tables
+        conv_encoder_tables()
+        {
+            int polys[RATE] = POLYS;
+            for(int state = 0; state < NUMSTATES; state++)
+            {
+                for(int b = 0; b < 256; b++)
+                {
+                    int sr = state;
+                    unsigned int out = 0;
+                    for(int j = 0; j < 8; j++)
+                    {
+                        sr = (sr << 1) | ((b >> (7 - j)) & 1);
+                        for(int k = 0; k < RATE; k++) out = (out << 1) | parity(sr & polys[k]);
+                    }
+                    coded[state][b] = out;
+                }
+            }
+
+            // Which coded bits of each period are kept (see puncturer::puncture)
+            const bool keep_1_2[2] = {true, true};
+            const bool keep_2_3[4] = {true, false, true, true};
+            const bool keep_3_4[6] = {true, true, false, true, false, true};
+            const bool * keep[3] = {keep_1_2, keep_2_3, keep_3_4};
+            const int periods[3] = {2, 4, 6};
+            for(int p = 0; p < 3; p++)
+            {
+                patterns[p].period = periods[p];
+                for(int phase = 0; phase < periods[p]; phase++)
+                {
+                    int count = 0;
+                    for(int c = 0; c < 16; c++)
+                    {
+                        if(keep[p][(phase + c) % periods[p]]) patterns[p].kept[phase][count++] = c;
+                    }
+                    patterns[p].kept_count[phase] = count;
+                }
+            }
+        }
+    };
+
+    /*!
+     * \brief Gets the (lazily built) encoder tables.
+     */
+    static const conv_encoder_tables & get_conv_encoder_tables()
+    {
+        static const conv_encoder_tables tables;
+        return tables;
+    }
+
+    void viterbi::conv_encode(unsigned char * data, unsigned char * symbols, int data_bits)
+    {
+        conv_encode(data, symbols, data_bits, RATE_1_2_BPSK);
+    }
+
+    /*!
+     * The input is encoded a byte at a time with one table lookup and the kept coded bits of
+     * each byte are written straight to the output. The last byte may be partial in which case
+     * only the coded bits of its first bits are written.
+     */
+    int viterbi::conv_encode(const unsigned char * data, unsigned char * symbols, int data_bits, Rate rate)
+    {
+        const conv_encoder_tables & tables = get_conv_encoder_tables();
+        int p = 0;
+        switch(rate)
+        {
+            case RATE_1_2_BPSK: case RATE_1_2_QPSK: case RATE_1_2_QAM16: p = 0; break;
+            case RATE_2_3_BPSK: case RATE_2_3_QPSK: case RATE_2_3_QAM16: case RATE_2_3_QAM64: p = 1; break;
+            case RATE_3_4_BPSK: case RATE_3_4_QPSK: case RATE_3_4_QAM16: case RATE_3_4_QAM64: p = 2; break;
+        }
+        const conv_encoder_tables::puncture_pattern & pattern = tables.patterns[p];
+
+        int input_bits = data_bits + (K - 1);
+        int state = 0;
+        int phase = 0;
+        int index = 0;
+        for(int i = 0; i < input_bits; i += 8)
+        {
+            int b = data[i / 8];
+            unsigned int coded = tables.coded[state][b];
+            state = b & (NUMSTATES - 1);
+
+            const unsigned char * kept = pattern.kept[phase];
+            int count = pattern.kept_count[phase];
+            if(input_bits - i < 8)
             {
-              int m = sr & polys[k];
-              int par = parity(sr & polys[k]);
-              symbols[index++] = par;
+                // Only the coded bits of the remaining input bits
+                int limit = RATE * (input_bits - i);
+                while(count > 0 && kept[count - 1] >= limit) count--;
             }
+            for(int c = 0; c < count; c++) symbols[index + c] = (coded >> (15 - kept[c])) & 1;
+            index += count;
+            phase = (phase + 16) % pattern.period;
         }
+        return index;
     }
 
     /* Initialize Viterbi decoder for start of new frame */
@@ -80,16 +447,6 @@ namespace fun
     /* Create a new instance of a Viterbi decoder */
     struct v * viterbi::viterbi_alloc(int len) {
       struct v *vp;
-      static int Init = 0;
-
-        int state, i;
-        int polys[RATE] = POLYS;
-        for (state=0;state < NUMSTATES/2;state++) {
-          for (i=0; i<RATE; i++) {
-            Branchtab[i*NUMSTATES/2+state] = (polys[i] < 0) ^ parity((2*state) & abs(polys[i])) ? 255 : 0;
-          }
-        }
-        Init++;
 
       if (posix_memalign((void**)&vp, 16,sizeof(struct v)))
         return NULL;
@@ -190,12 +547,100 @@ namespace fun
     void viterbi::viterbi_update_blk_SPIRAL(struct v *vp, const COMPUTETYPE *syms, int nbits) {
       decision_t *d = (decision_t *)vp->decisions;
 
-      for (int s = 0; s < nbits; s++)
-        memset(d+s, 0, sizeof(decision_t));
+      // The trellis is updated two bits at a time so the last decision of an odd
+      // length block is never written, every other decision is fully overwritten
+      if (nbits & 1)
+        memset(d+nbits-1, 0, sizeof(decision_t));
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+      if (m_use_avx2)
+      {
+        FULL_SPIRAL_AVX2(nbits, vp->new_metrics->t, vp->old_metrics->t, syms, d->t, Branchtab);
+        return;
+      }
+#endif
       FULL_SPIRAL(nbits, vp->new_metrics->t, vp->old_metrics->t, syms, d->t, Branchtab);
     }
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    /*!
+     * \brief One bit of the trellis update for all 64 states in two AVX2 registers.
+     * \param X Old path metrics
+     * \param Y New path metrics
+     * \param sym0 First coded symbol for this bit
+     * \param sym1 Second coded symbol for this bit
+     * \param dec Decisions for this bit (4 shorts)
+     * \param Branchtab The branch table
+     *
+     * Each 128 bit lane does the same butterflies as one of the two halves of a
+     * #FULL_SPIRAL bit, the lanes are then permuted back into state order before
+     * they are stored.
+     */
+    __attribute__((target("avx2"), always_inline))
+    static inline void spiral_bit_avx2(const unsigned char *X, unsigned char *Y, unsigned char sym0, unsigned char sym1,
+                                       short *dec, const unsigned char *Branchtab)
+    {
+        const __m256i max_metric = _mm256_set1_epi8(63);
+
+        __m256i lo = _mm256_loadu_si256((const __m256i *) X);          // states 0-15 | 16-31
+        __m256i hi = _mm256_loadu_si256((const __m256i *) (X + 32));   // states 32-47 | 48-63
+        __m256i b0 = _mm256_xor_si256(_mm256_set1_epi8(sym0), _mm256_loadu_si256((const __m256i *) Branchtab));
+        __m256i b1 = _mm256_xor_si256(_mm256_set1_epi8(sym1), _mm256_loadu_si256((const __m256i *) (Branchtab + 32)));
+        __m256i t = _mm256_and_si256(_mm256_srli_epi16(_mm256_avg_epu8(b0, b1), 2), max_metric);
+        __m256i u = _mm256_subs_epu8(max_metric, t);
+
+        __m256i m0 = _mm256_adds_epu8(lo, t);
+        __m256i m1 = _mm256_adds_epu8(hi, u);
+        __m256i m2 = _mm256_adds_epu8(lo, u);
+        __m256i m3 = _mm256_adds_epu8(hi, t);
+        __m256i survivor0 = _mm256_min_epu8(m1, m0);
+        __m256i decision0 = _mm256_cmpeq_epi8(survivor0, m1);
+        __m256i survivor1 = _mm256_min_epu8(m3, m2);
+        __m256i decision1 = _mm256_cmpeq_epi8(survivor1, m3);
+
+        __m256i d_lo = _mm256_unpacklo_epi8(decision0, decision1);
+        __m256i d_hi = _mm256_unpackhi_epi8(decision0, decision1);
+        unsigned int dec01 = _mm256_movemask_epi8(_mm256_permute2x128_si256(d_lo, d_hi, 0x20));
+        unsigned int dec23 = _mm256_movemask_epi8(_mm256_permute2x128_si256(d_lo, d_hi, 0x31));
+        memcpy(dec, &dec01, 4);
+        memcpy(dec + 2, &dec23, 4);
+
+        __m256i s_lo = _mm256_unpacklo_epi8(survivor0, survivor1);
+        __m256i s_hi = _mm256_unpackhi_epi8(survivor0, survivor1);
+        _mm256_storeu_si256((__m256i *) Y, _mm256_permute2x128_si256(s_lo, s_hi, 0x20));
+        _mm256_storeu_si256((__m256i *) (Y + 32), _mm256_permute2x128_si256(s_lo, s_hi, 0x31));
+
+        // Renormalize the metrics before they can saturate
+        if (Y[0] > 210) {
+            __m256i y_lo = _mm256_loadu_si256((const __m256i *) Y);
+            __m256i y_hi = _mm256_loadu_si256((const __m256i *) (Y + 32));
+            __m256i m = _mm256_min_epu8(y_lo, y_hi);
+            __m128i n = _mm_min_epu8(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+            n = _mm_min_epu8(_mm_srli_si128(n, 8), n);
+            n = _mm_min_epu8(_mm_srli_epi64(n, 32), n);
+            n = _mm_min_epu8(_mm_srli_epi64(n, 16), n);
+            n = _mm_min_epu8(_mm_srli_epi64(n, 8), n);
+            __m256i minimum = _mm256_broadcastb_epi8(n);
+            _mm256_storeu_si256((__m256i *) Y, _mm256_subs_epu8(y_lo, minimum));
+            _mm256_storeu_si256((__m256i *) (Y + 32), _mm256_subs_epu8(y_hi, minimum));
+        }
+    }
+
+    /*!
+     * \brief AVX2 version of viterbi::FULL_SPIRAL
+     *
+     * Produces exactly the same metrics and decisions as the SSE version.
+     */
+    __attribute__((target("avx2")))
+    void viterbi::FULL_SPIRAL_AVX2(int nbits, unsigned char *Y, unsigned char *X, const unsigned char *syms, unsigned char *dec, unsigned char *Branchtab) {
+        short *d = (short *) dec;
+        for(int i9 = 0; i9 <= (nbits/2-1); i9++) {
+            spiral_bit_avx2(X, Y, syms[4*i9], syms[4*i9+1], d + 8*i9, Branchtab);
+            spiral_bit_avx2(Y, X, syms[4*i9+2], syms[4*i9+3], d + 8*i9 + 4, Branchtab);
+        }
+    }
+#endif
+
     /*!
      * \brief viterbi::FULL_SPIRAL
      * \param nbits
@@ -20,6 +20,8 @@
 #include <xmmintrin.h>
 #include <mmintrin.h>
 
+#include "rates.h"
+
 #define K 7
 #define RATE 2
 #define POLYS { 121, 91 }
@@ -28,6 +30,24 @@
 #define DECISIONTYPE_BITSIZE 8
 #define COMPUTETYPE unsigned char
 
+/*! \def VITERBI_MIN_SEGMENT_BITS
+ *  \brief Fewest data bits each window of a segmented decode (see viterbi::viterbi()) is given.
+ *
+ *  Frames shorter than two segments are always decoded in one pass since the extra trellis
+ *  steps of the window margins would cost more than decoding in parallel saves.
+ */
+#define VITERBI_MIN_SEGMENT_BITS 1024
+
+/*! \def VITERBI_WINDOW_MARGIN
+ *  \brief Number of extra trellis steps each window of a segmented decode runs before and after its segment.
+ *
+ *  The steps before the segment let the path metrics converge from an unknown starting state
+ *  (training) and the steps after it let the survivor paths merge before the chainback reaches
+ *  the segment (traceback). Roughly 18 constraint lengths, which is plenty even for the
+ *  punctured 3/4 rate codes. Must be a multiple of 8.
+ */
+#define VITERBI_WINDOW_MARGIN 128
+
 namespace fun
 {
     //decision_t is a BIT vector
@@ -67,6 +87,29 @@ namespace fun
 
         COMPUTETYPE Branchtab[NUMSTATES/2*RATE] __attribute__ ((aligned (16)));
 
+        struct v * m_vp; //!< Decoder state including the decision trellis, reused for every frame
+
+        int m_max_bits; //!< Number of data bits the decision trellis in #m_vp can currently hold
+
+        int m_steps; //!< Trellis steps taken so far by the incremental decode (see begin_decode())
+
+        bool m_use_avx2; //!< Whether the AVX2 version of #FULL_SPIRAL is used
+
+        /*!
+         * \brief The segment workers and the frame they are decoding, shared by conv_decode() and the workers.
+         */
+        struct segment_pool;
+
+        /*!
+         * \brief The trellis & scratch buffer of one thread of a segmented decode.
+         */
+        struct segment_state;
+
+        segment_pool * m_pool; //!< The segment workers, NULL if there are none
+
+        viterbi(const viterbi &); //!< Not copyable since it owns #m_vp
+        viterbi & operator=(const viterbi &); //!< Not copyable since it owns #m_vp
+
         void viterbi_chainback(struct v *vp,
               unsigned char *data, /* Decoded output data */
               unsigned int nbits, /* Number of data bits */
@@ -74,6 +117,17 @@ namespace fun
 
         void FULL_SPIRAL(int nbits, unsigned char *Y, unsigned char *X, const unsigned char *syms, unsigned char *dec, unsigned char *Branchtab);
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __attribute__((target("avx2")))
+        void FULL_SPIRAL_AVX2(int nbits, unsigned char *Y, unsigned char *X, const unsigned char *syms, unsigned char *dec, unsigned char *Branchtab);
+#endif
+
+        /*!
+         * \brief Grows #m_vp if it can't hold data_bits data bits.
+         * \return false if the trellis couldn't be allocated
+         */
+        bool reserve_trellis(int data_bits);
+
         /*!
          * \brief Create a new instance of a Viterbi decoder
          * \param len = FRAMEBITS (unpadded! data bits)
@@ -104,12 +158,59 @@ namespace fun
          */
         void viterbi_decode(struct v *vp, const COMPUTETYPE *symbols, unsigned char *data, int nbits);
 
+        /*!
+         * \brief Decodes a frame in overlapping windows, one segment per thread.
+         * \param symbols Input symbols to be decoded
+         * \param data Output data that has been decoded
+         * \param data_bits Number of data bits (not counting the tail)
+         * \param segments Number of segments to split the frame into
+         */
+        void decode_segments(const COMPUTETYPE *symbols, unsigned char *data, int data_bits, int segments);
+
+        /*!
+         * \brief Decodes segments of the current frame until none are left.
+         * \param state The trellis & scratch buffer of the calling thread
+         */
+        void decode_pending_segments(segment_state * state);
+
+        /*!
+         * \brief Decodes one segment of the current frame.
+         * \param state The trellis & scratch buffer of the calling thread
+         * \param segment Index of the segment
+         */
+        void decode_segment(segment_state * state, int segment);
+
+        /*!
+         * \brief Main loop of a segment worker thread.
+         * \param state The worker's own trellis & scratch buffer
+         */
+        void segment_worker(segment_state * state);
+
         /*! \brief set the viterbi decoder to use a specific implementation */
         void viterbi_update_blk_SPIRAL(struct v *vp, const COMPUTETYPE *syms, int nbits);
         //void viterbi_spiral(struct v *vp);
 
     public:
 
+        /*!
+         * \brief Constructor for viterbi decoder.
+         * \param max_data_bits The number of data bits to preallocate the decision
+         *  trellis for. Decoding more bits than this grows the trellis, so sizing it for
+         *  the largest expected frame keeps #conv_decode() from allocating at all.
+         *
+         * \param segment_threads Number of worker threads to decode long frames with. If more than 0
+         *  frames of at least 2 * #VITERBI_MIN_SEGMENT_BITS data bits are split into segments that
+         *  are decoded in parallel by the workers and the calling thread, each in a window that
+         *  overlaps its neighbours by #VITERBI_WINDOW_MARGIN trellis steps. The decoded bits are
+         *  practically always the same as a decode in one pass, only the latency is lower.
+         *
+         *  Also builds the branch table and selects the AVX2 trellis update if the
+         *  CPU supports it.
+         */
+        viterbi(int max_data_bits = 0, int segment_threads = 0);
+
+        ~viterbi(); //!< Frees the decision trellis and stops the segment workers.
+
         /*!
          * \brief Decodes convolutionally encoded data using the viterbi algorithm.
          * \param symbols Coded symbols that need to be decoded.
@@ -118,13 +219,53 @@ namespace fun
          */
         void conv_decode(unsigned char * symbols, unsigned char * data, int data_bits);
 
+        /*!
+         * \brief Starts decoding a frame incrementally.
+         * \param data_bits Number of data bits the frame will have (not counting the tail)
+         *
+         * Instead of passing the whole frame to conv_decode() the coded symbols are passed to
+         * update() as they arrive, which runs the trellis over them right away, and end_decode()
+         * only has to do the chainback. The segment workers aren't used for incremental decodes.
+         */
+        void begin_decode(int data_bits);
+
+        /*!
+         * \brief Runs the trellis of the incremental decode over the next coded symbols.
+         * \param symbols The next coded symbols, two per trellis step.
+         * \param steps Number of trellis steps, which must be even (every PHY rate has an even
+         *  number of data bits per OFDM symbol). Steps past the data_bits + tail of begin_decode()
+         *  are ignored.
+         */
+        void update(const unsigned char * symbols, int steps);
+
+        /*!
+         * \brief Finishes the incremental decode with the chainback.
+         * \param data Output data that has been decoded.
+         * \param data_bits Number of data bits, the same as passed to begin_decode().
+         */
+        void end_decode(unsigned char * data, int data_bits);
+
         /*!
          * \brief Convolutionally encodeds data.
          * \param data The data to be coded.
          * \param symbols The coded output symbols.
          * \param data_bits The number of bits in the data input.
          */
-        void conv_encode(unsigned char * data, unsigned char * symbols, int data_bits);
+        static void conv_encode(unsigned char * data, unsigned char * symbols, int data_bits);
+
+        /*!
+         * \brief Convolutionally encodes and punctures data in one pass.
+         *
+         * Equivalent to conv_encode() followed by puncturer::puncture() but without the full
+         * rate intermediate buffer.
+         *
+         * \param data The data to be coded (the 6 tail bits following data_bits are read from it too).
+         * \param symbols The punctured coded output symbols, one bit per byte.
+         * \param data_bits The number of bits in the data input (not counting the 6 tail bits).
+         * \param rate The PHY rate from which the coding rate is extracted.
+         * \return The number of coded symbols written.
+         */
+        static int conv_encode(const unsigned char * data, unsigned char * symbols, int data_bits, Rate rate);
     };
 
 }